@@ -0,0 +1,119 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import io.grpc.CallOptions;
+import io.grpc.Channel;
+import io.grpc.ClientCall;
+import io.grpc.Metadata;
+import io.grpc.MethodDescriptor;
+import io.grpc.Status;
+
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.util.concurrent.Executor;
+
+/**
+ * A gRPC channel serving unary calls with {@link JniLocalService}, so that the generated stubs can
+ * call the helper library in-process.
+ */
+public class JniChannel extends Channel {
+
+    private static final String AUTHORITY = "zetasql-helper-jni";
+
+    @Override
+    public <RequestT, ResponseT> ClientCall<RequestT, ResponseT> newCall(
+            MethodDescriptor<RequestT, ResponseT> method, CallOptions callOptions) {
+        return new JniCall<>(method, callOptions);
+    }
+
+    @Override
+    public String authority() {
+        return AUTHORITY;
+    }
+
+    private static class JniCall<RequestT, ResponseT> extends ClientCall<RequestT, ResponseT> {
+
+        private final MethodDescriptor<RequestT, ResponseT> method;
+        private final Executor executor;
+        private Listener<ResponseT> listener;
+        private RequestT request;
+        private boolean cancelled;
+
+        JniCall(MethodDescriptor<RequestT, ResponseT> method, CallOptions callOptions) {
+            this.method = method;
+            // Run the callbacks where the stub expects them, e.g. on the thread of a blocking call.
+            this.executor = callOptions.getExecutor() != null ? callOptions.getExecutor() : Runnable::run;
+        }
+
+        @Override
+        public void start(Listener<ResponseT> listener, Metadata headers) {
+            this.listener = listener;
+        }
+
+        @Override
+        public void request(int numMessages) {
+        }
+
+        @Override
+        public void cancel(String message, Throwable cause) {
+            if (!cancelled) {
+                cancelled = true;
+                Status status = Status.CANCELLED.withDescription(message).withCause(cause);
+                executor.execute(() -> listener.onClose(status, new Metadata()));
+            }
+        }
+
+        @Override
+        public void halfClose() {
+            if (cancelled) {
+                return;
+            }
+            if (method.getType() != MethodDescriptor.MethodType.UNARY || request == null) {
+                Status status = Status.UNIMPLEMENTED.withDescription("Only unary calls are supported");
+                executor.execute(() -> listener.onClose(status, new Metadata()));
+                return;
+            }
+
+            ResponseT response;
+            try {
+                byte[] responseBytes = JniLocalService.invoke(bareMethodName(), toBytes(method.streamRequest(request)));
+                response = method.parseResponse(new ByteArrayInputStream(responseBytes));
+            } catch (JniLocalService.NativeCallException exception) {
+                Status status = Status.fromCodeValue(exception.getCode()).withDescription(exception.getMessage());
+                executor.execute(() -> listener.onClose(status, new Metadata()));
+                return;
+            } catch (RuntimeException | IOException exception) {
+                Status status = Status.INTERNAL.withDescription(exception.getMessage()).withCause(exception);
+                executor.execute(() -> listener.onClose(status, new Metadata()));
+                return;
+            }
+
+            executor.execute(() -> {
+                listener.onHeaders(new Metadata());
+                listener.onMessage(response);
+                listener.onClose(Status.OK, new Metadata());
+            });
+        }
+
+        @Override
+        public void sendMessage(RequestT message) {
+            request = message;
+        }
+
+        private String bareMethodName() {
+            String fullMethodName = method.getFullMethodName();
+            return fullMethodName.substring(fullMethodName.lastIndexOf('/') + 1);
+        }
+
+        private static byte[] toBytes(InputStream stream) throws IOException {
+            ByteArrayOutputStream output = new ByteArrayOutputStream();
+            byte[] buffer = new byte[8192];
+            int length;
+            while ((length = stream.read(buffer)) != -1) {
+                output.write(buffer, 0, length);
+            }
+            return output.toByteArray();
+        }
+    }
+}
@@ -0,0 +1,84 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+/**
+ * Binding of the ZetaSQL Helper library loaded into the JVM through JNI. The methods of the service
+ * are called in-process on serialized requests and responses.
+ *
+ * <p>The native library is loaded from the path in the {@value #LIBRARY_PATH_PROPERTY} system
+ * property if it is set, or else as {@value #LIBRARY_NAME} from the {@code java.library.path}.
+ */
+public final class JniLocalService {
+
+    public static final String LIBRARY_PATH_PROPERTY = "zetasql.helper.jni.library";
+    public static final String LIBRARY_NAME = "zetasql_helper_jni";
+
+    private static Boolean available;
+    private static Throwable loadError;
+
+    private JniLocalService() {
+    }
+
+    /**
+     * Load the native library if it is not loaded yet.
+     *
+     * @return whether the native library is loaded.
+     */
+    public static synchronized boolean isAvailable() {
+        if (available == null) {
+            try {
+                String path = System.getProperty(LIBRARY_PATH_PROPERTY);
+                if (path != null && !path.isEmpty()) {
+                    System.load(path);
+                } else {
+                    System.loadLibrary(LIBRARY_NAME);
+                }
+                available = true;
+            } catch (UnsatisfiedLinkError | SecurityException error) {
+                loadError = error;
+                available = false;
+            }
+        }
+        return available;
+    }
+
+    /**
+     * @return the error raised while loading the native library, or null.
+     */
+    public static synchronized Throwable getLoadError() {
+        return loadError;
+    }
+
+    /**
+     * Call a method of the service.
+     *
+     * @param method  name of the RPC, e.g. "Tokenize"
+     * @param request serialized request of the RPC
+     * @return serialized response of the RPC
+     * @throws NativeCallException if the call fails
+     */
+    public static byte[] invoke(String method, byte[] request) {
+        if (!isAvailable()) {
+            throw new LocalServiceException("The ZetaSQL Helper JNI library is not available: " + loadError);
+        }
+        return call(method, request);
+    }
+
+    private static native byte[] call(String method, byte[] request);
+
+    /**
+     * Failure of a native call. The code is the canonical status code (the same as the gRPC one).
+     */
+    public static class NativeCallException extends RuntimeException {
+
+        private final int code;
+
+        public NativeCallException(int code, String message) {
+            super(message);
+            this.code = code;
+        }
+
+        public int getCode() {
+            return code;
+        }
+    }
+}
@@ -1,6 +1,7 @@
 package com.google.bigquery.utils.zetasqlhelper;
 
 import com.github.dockerjava.api.DockerClient;
+import com.github.dockerjava.api.command.CreateContainerCmd;
 import com.github.dockerjava.api.command.CreateContainerResponse;
 import com.github.dockerjava.api.model.*;
 import com.github.dockerjava.core.DefaultDockerClientConfig;
@@ -10,13 +11,28 @@ import com.github.dockerjava.httpclient5.ApacheDockerHttpClient;
 import com.github.dockerjava.transport.DockerHttpClient;
 import io.grpc.Channel;
 import io.grpc.ManagedChannelBuilder;
-
+import io.grpc.netty.shaded.io.grpc.netty.NettyChannelBuilder;
+import io.grpc.netty.shaded.io.netty.bootstrap.Bootstrap;
+import io.grpc.netty.shaded.io.netty.channel.ChannelFuture;
+import io.grpc.netty.shaded.io.netty.channel.ChannelInboundHandlerAdapter;
+import io.grpc.netty.shaded.io.netty.channel.EventLoopGroup;
+import io.grpc.netty.shaded.io.netty.channel.epoll.Epoll;
+import io.grpc.netty.shaded.io.netty.channel.epoll.EpollDomainSocketChannel;
+import io.grpc.netty.shaded.io.netty.channel.epoll.EpollEventLoopGroup;
+import io.grpc.netty.shaded.io.netty.channel.unix.DomainSocketAddress;
+import io.grpc.netty.shaded.io.netty.util.concurrent.DefaultThreadFactory;
+
+import java.io.File;
 import java.util.Collections;
 import java.util.List;
 
 /**
  * A controller responsible for managing the Docker Image of ZetaSQL Helper server. It can check
  * if a server container is started, start a server and connect to a server.
+ *
+ * <p>On Linux, the server also listens on a Unix domain socket in a directory shared with the
+ * container, and the client connects through it to skip the TCP stack. The TCP port is still
+ * published, and used when the socket is unavailable (e.g. on macOS, where Docker runs in a VM).
  */
 public class LocalServiceDockerProvider implements LocalServiceProvider {
 
@@ -30,6 +46,16 @@ public class LocalServiceDockerProvider implements LocalServiceProvider {
     // it will be considered shutdown. Unit is millisecond.
     private final static long START_SERVER_TIMEOUT = 5000;
 
+    // Directory of the Unix domain socket inside the container.
+    private final static String CONTAINER_SOCKET_DIR = "/var/run/zetasql_helper";
+    private final static String SOCKET_NAME = "zetasql_helper.sock";
+    // Time to connect to the Unix domain socket before falling back to TCP. Unit is millisecond.
+    private final static long SOCKET_PROBE_TIMEOUT = 500;
+
+    // Event loop shared by all the Unix domain socket channels. Its threads are daemons, so that
+    // it does not keep the JVM alive.
+    private static EventLoopGroup domainSocketEventLoop;
+
     private final DockerClient client;
 
     public LocalServiceDockerProvider() {
@@ -50,13 +76,26 @@ public class LocalServiceDockerProvider implements LocalServiceProvider {
     @Override
     public void startServer(final Integer port) {
         String binding = String.format("%d:%d", port, SERVER_PORT);
-        CreateContainerResponse response =
-                client
-                        .createContainerCmd(IMAGE)
-                        .withExposedPorts(ExposedPort.parse("" + SERVER_PORT))
-                        .withHostConfig(
-                                HostConfig.newHostConfig().withPortBindings(PortBinding.parse(binding)))
-                        .exec();
+        HostConfig hostConfig = HostConfig.newHostConfig().withPortBindings(PortBinding.parse(binding));
+        CreateContainerCmd command = client
+                .createContainerCmd(IMAGE)
+                .withExposedPorts(ExposedPort.parse("" + SERVER_PORT));
+
+        File socketDir = getSocketDir(port);
+        if (isDomainSocketSupported() && createSocketDir(socketDir)) {
+            // A socket left by a stopped container would accept no connection.
+            new File(socketDir, SOCKET_NAME).delete();
+            hostConfig.withBinds(new Bind(socketDir.getAbsolutePath(), new Volume(CONTAINER_SOCKET_DIR)));
+            // The directory is only accessible by the current user, so the socket itself can be
+            // opened to everyone: the server runs as root in the container. Images built before
+            // these flags ignore them (--undefok), and the client then falls back to TCP.
+            command.withCmd(
+                    "./run_server",
+                    String.format("--listen=unix:%s/%s,0.0.0.0:%d", CONTAINER_SOCKET_DIR, SOCKET_NAME, SERVER_PORT),
+                    "--unix_socket_mode=0666",
+                    "--undefok=listen,unix_socket_mode");
+        }
+        CreateContainerResponse response = command.withHostConfig(hostConfig).exec();
 
         String containerId = response.getId();
         client.startContainerCmd(containerId).exec();
@@ -106,6 +145,17 @@ public class LocalServiceDockerProvider implements LocalServiceProvider {
             throw new LocalServiceException("unable to create a channel to ZetaSql Helper Service through Docker", exception);
         }
 
+        // The socket may be left by a stopped or crashed container, so only use it if it accepts
+        // a connection.
+        File socket = new File(getSocketDir(port), SOCKET_NAME);
+        if (isDomainSocketSupported() && socket.exists() && canConnect(socket)) {
+            return NettyChannelBuilder.forAddress(new DomainSocketAddress(socket))
+                    .eventLoopGroup(getDomainSocketEventLoop())
+                    .channelType(EpollDomainSocketChannel.class)
+                    .usePlaintext()
+                    .build();
+        }
+
         return ManagedChannelBuilder.forTarget(LOCAL_HOST + port)
                 // Channels are secure by default (via SSL/TLS). For the example we disable TLS to avoid
                 // needing certificates.
@@ -113,6 +163,43 @@ public class LocalServiceDockerProvider implements LocalServiceProvider {
                 .build();
     }
 
+    private static boolean isDomainSocketSupported() {
+        return System.getProperty("os.name", "").toLowerCase().startsWith("linux") && Epoll.isAvailable();
+    }
+
+    // The host directory shared with the container serving the given port.
+    private static File getSocketDir(final Integer port) {
+        return new File(System.getProperty("java.io.tmpdir"), "zetasql-helper-" + port);
+    }
+
+    private static boolean createSocketDir(File dir) {
+        if (!dir.isDirectory() && !dir.mkdirs()) {
+            return false;
+        }
+        // Only the current user may reach the socket.
+        return dir.setReadable(false, false) && dir.setReadable(true, true)
+                && dir.setWritable(false, false) && dir.setWritable(true, true)
+                && dir.setExecutable(false, false) && dir.setExecutable(true, true);
+    }
+
+    private static boolean canConnect(File socket) {
+        ChannelFuture future = new Bootstrap()
+                .group(getDomainSocketEventLoop())
+                .channel(EpollDomainSocketChannel.class)
+                .handler(new ChannelInboundHandlerAdapter())
+                .connect(new DomainSocketAddress(socket));
+        boolean connected = future.awaitUninterruptibly(SOCKET_PROBE_TIMEOUT) && future.isSuccess();
+        future.channel().close();
+        return connected;
+    }
+
+    private static synchronized EventLoopGroup getDomainSocketEventLoop() {
+        if (domainSocketEventLoop == null) {
+            domainSocketEventLoop = new EpollEventLoopGroup(1, new DefaultThreadFactory("zetasql-helper-uds", true));
+        }
+        return domainSocketEventLoop;
+    }
+
     private boolean waitServerToStart(String ContainerId) {
         long now = System.currentTimeMillis();
         long endTime = now + LocalServiceDockerProvider.START_SERVER_TIMEOUT;
@@ -0,0 +1,34 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import io.grpc.Channel;
+
+/**
+ * Provide the ZetaSQL Helper service in-process through the JNI library, without starting a server.
+ * It is only available when the native library can be loaded (see {@link JniLocalService}), and
+ * otherwise the next provider (e.g. Docker) is used. The port is ignored.
+ */
+public class LocalServiceJniProvider implements LocalServiceProvider {
+
+    @Override
+    public boolean isAvailable() {
+        return JniLocalService.isAvailable();
+    }
+
+    @Override
+    public void startServer(final Integer port) {
+    }
+
+    @Override
+    public boolean isServerOn(final Integer port) {
+        return isAvailable();
+    }
+
+    @Override
+    public Channel connect(final Integer port) {
+        if (!isAvailable()) {
+            throw new LocalServiceException("The ZetaSQL Helper JNI library is not available: "
+                    + JniLocalService.getLoadError());
+        }
+        return new JniChannel();
+    }
+}
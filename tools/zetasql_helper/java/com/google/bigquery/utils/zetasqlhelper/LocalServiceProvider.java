@@ -15,16 +15,27 @@ public interface LocalServiceProvider {
 
     Channel connect(Integer port);
 
+    /**
+     * Whether the provider can be used in the current environment.
+     *
+     * @return true by default.
+     */
+    default boolean isAvailable() {
+        return true;
+    }
 
     /**
-     * User a service loader to provide the available ZetaSQL Helper service.
+     * User a service loader to provide the available ZetaSQL Helper service. The providers are tried
+     * in the order of the service file, and the unavailable ones are skipped.
      *
      * @param port port number to host the service.
      * @return Channel to the ZetaSQL Helper server.
      */
     static Channel loadChannel(Integer port) {
         for (LocalServiceProvider provider : ServiceLoader.load(LocalServiceProvider.class)) {
-            return provider.connect(port);
+            if (provider.isAvailable()) {
+                return provider.connect(port);
+            }
         }
         throw new IllegalStateException("No ZetaSQL Helper LocalServiceProvider loaded.");
     }
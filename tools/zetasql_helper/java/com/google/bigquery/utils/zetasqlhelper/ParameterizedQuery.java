@@ -0,0 +1,22 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import lombok.Value;
+
+import java.util.List;
+import java.util.stream.Collectors;
+
+/**
+ * A query whose literals are replaced by named parameters, and the values of the parameters.
+ */
+@Value
+public class ParameterizedQuery {
+    String query;
+    List<QueryParameter> parameters;
+
+    public ParameterizedQuery(String originalQuery, LocalService.ParameterizeLiteralsResponse response) {
+        query = response.getParameterizedQuery();
+        parameters = response.getParametersList().stream()
+                .map(proto -> new QueryParameter(originalQuery, proto))
+                .collect(Collectors.toList());
+    }
+}
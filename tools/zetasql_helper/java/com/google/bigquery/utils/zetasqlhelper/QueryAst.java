@@ -0,0 +1,106 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import com.google.bigquery.utils.zetasqlhelper.FlatAst.FlatAstProto;
+import com.google.protobuf.ByteString;
+
+import java.nio.ByteOrder;
+import java.nio.IntBuffer;
+import java.util.Arrays;
+import java.util.List;
+
+/**
+ * The AST of a query exported by ZetaSQL Helper server. Nodes are identified by their index in pre-order: the
+ * root is 0, a node comes before its descendants, and the descendants of a node have consecutive indices. The
+ * node arrays are read in place from the response, so no object is created per node.
+ */
+public class QueryAst {
+    private final String query;
+    private final int nodeCount;
+    private final IntBuffer kinds;
+    private final IntBuffer parents;
+    private final IntBuffer starts;
+    private final IntBuffer ends;
+    private final List<String> kindNames;
+    // The index in identifiers of every node, -1 if it is not an identifier.
+    private final int[] identifierIndexes;
+    private final List<String> identifiers;
+
+    public QueryAst(String query, FlatAstProto proto) {
+        this.query = query;
+        nodeCount = proto.getNodeCount();
+        kinds = asIntBuffer(proto.getKinds());
+        parents = asIntBuffer(proto.getParents());
+        starts = asIntBuffer(proto.getStarts());
+        ends = asIntBuffer(proto.getEnds());
+        kindNames = proto.getKindNamesList();
+        identifiers = proto.getIdentifiersList();
+
+        identifierIndexes = new int[nodeCount];
+        Arrays.fill(identifierIndexes, -1);
+        IntBuffer identifierNodes = asIntBuffer(proto.getIdentifierNodes());
+        for (int i = 0; i < identifierNodes.limit(); i++) {
+            identifierIndexes[identifierNodes.get(i)] = i;
+        }
+    }
+
+    private static IntBuffer asIntBuffer(ByteString bytes) {
+        return bytes.asReadOnlyByteBuffer().order(ByteOrder.LITTLE_ENDIAN).asIntBuffer();
+    }
+
+    public int getNodeCount() {
+        return nodeCount;
+    }
+
+    /**
+     * @return the kind of a node, e.g. "Select" or "PathExpression"
+     */
+    public String getKind(int node) {
+        return kindNames.get(kinds.get(node));
+    }
+
+    /**
+     * @return the parent of a node, -1 for the root
+     */
+    public int getParent(int node) {
+        return parents.get(node);
+    }
+
+    /**
+     * @return the start byte offset (UTF-8 based) of a node in the query
+     */
+    public int getStartByteOffset(int node) {
+        return starts.get(node);
+    }
+
+    /**
+     * @return the end byte offset (UTF-8 based, excluded) of a node in the query
+     */
+    public int getEndByteOffset(int node) {
+        return ends.get(node);
+    }
+
+    public QueryLocationRange getRange(int node) {
+        return new QueryLocationRange(query, starts.get(node), ends.get(node));
+    }
+
+    /**
+     * @return the name of an identifier node without backticks, or null if the node is not an identifier or the
+     * identifiers were not exported
+     */
+    public String getIdentifier(int node) {
+        int index = identifierIndexes[node];
+        return index < 0 ? null : identifiers.get(index);
+    }
+
+    /**
+     * @return the index after the last descendant of a node, so its descendants are the nodes in (node, end)
+     */
+    public int getSubtreeEnd(int node) {
+        // The first node after the subtree has its parent before the node.
+        int end = node + 1;
+        while (end < nodeCount && parents.get(end) >= node) {
+            end++;
+        }
+        return end;
+    }
+}
@@ -0,0 +1,19 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import com.google.bigquery.utils.zetasqlhelper.QueryFixes.QueryEditProto;
+import lombok.Value;
+
+/**
+ * An edit of a query: the substring at the range is replaced by the replacement. An empty range
+ * inserts the replacement at its start.
+ */
+@Value
+public class QueryEdit {
+    QueryLocationRange range;
+    String replacement;
+
+    public QueryEdit(String query, QueryEditProto proto) {
+        range = new QueryLocationRange(query, proto.getRange());
+        replacement = proto.getReplacement();
+    }
+}
@@ -0,0 +1,27 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import com.google.bigquery.utils.zetasqlhelper.QueryFixes.QueryFixProto;
+import lombok.Value;
+
+import java.util.List;
+import java.util.stream.Collectors;
+
+/**
+ * A fix of a query error. It contains the edits of the fix and the query with the edits applied.
+ */
+@Value
+public class QueryFix {
+    String fixer;
+    String title;
+    List<QueryEdit> edits;
+    String fixedQuery;
+
+    public QueryFix(String query, QueryFixProto proto) {
+        fixer = proto.getFixer();
+        title = proto.getTitle();
+        edits = proto.getEditsList().stream()
+                .map(edit -> new QueryEdit(query, edit))
+                .collect(Collectors.toList());
+        fixedQuery = proto.getFixedQuery();
+    }
+}
@@ -0,0 +1,40 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import com.google.zetasql.ZetaSQLValue.ValueProto;
+import lombok.Value;
+
+/**
+ * A query parameter replacing a literal of a query. The value is a Long, a Double, a String or a ByteString,
+ * following the BigQuery type of the parameter.
+ */
+@Value
+public class QueryParameter {
+    String name;
+    String type;
+    Object value;
+    QueryLocationRange literalRange;
+
+    public QueryParameter(String query, LocalService.QueryParameterProto proto) {
+        name = proto.getName();
+        type = proto.getType();
+        value = decodeValue(proto.getValue());
+        literalRange = new QueryLocationRange(query, proto.getLiteralRange());
+    }
+
+    private static Object decodeValue(ValueProto value) {
+        switch (value.getValueCase()) {
+            case INT64_VALUE:
+                return value.getInt64Value();
+            case UINT64_VALUE:
+                return value.getUint64Value();
+            case DOUBLE_VALUE:
+                return value.getDoubleValue();
+            case STRING_VALUE:
+                return value.getStringValue();
+            case BYTES_VALUE:
+                return value.getBytesValue();
+            default:
+                return null;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+package com.google.bigquery.utils.zetasqlhelper;
+
+import lombok.Value;
+
+import java.util.List;
+import java.util.stream.Collectors;
+
+/**
+ * Identical subqueries or expressions found at several places of one or more queries. Aliases, comments,
+ * whitespace and case are ignored when comparing them.
+ */
+@Value
+public class RepeatedSubtree {
+    long fingerprint;
+    int size;
+    String kind;
+    List<Instance> instances;
+
+    /**
+     * An occurrence of the subtree: the index of its query and its range in the query.
+     */
+    @Value
+    public static class Instance {
+        int queryIndex;
+        QueryLocationRange range;
+    }
+
+    public RepeatedSubtree(List<String> queries, LocalService.RepeatedSubtreeProto proto) {
+        fingerprint = proto.getFingerprint();
+        size = proto.getSize();
+        kind = proto.getKind();
+        instances = proto.getInstancesList().stream()
+                .map(instance -> new Instance(instance.getQueryIndex(),
+                        new QueryLocationRange(queries.get(instance.getQueryIndex()), instance.getRange())))
+                .collect(Collectors.toList());
+    }
+}
@@ -1,6 +1,8 @@
 package com.google.bigquery.utils.zetasqlhelper;
 
+import java.util.ArrayList;
 import java.util.List;
+import java.util.Map;
 import java.util.stream.Collectors;
 
 /**
@@ -59,6 +61,87 @@ public class ZetaSqlHelper {
                 .collect(Collectors.toList());
     }
 
+    /**
+     * Replace the literals of a query with the named parameters @p0, @p1, ..., e.g. so that generated queries only
+     * differing by their literals share a cache entry. The literals BigQuery requires, such as the ordinals of
+     * GROUP BY or the string of DATE '2020-01-01', are kept.
+     *
+     * @param query query whose literals are replaced
+     * @return the parameterized query and the values of its parameters
+     */
+    public static ParameterizedQuery parameterizeLiterals(String query) {
+        LocalService.ParameterizeLiteralsRequest request = LocalService.ParameterizeLiteralsRequest.newBuilder()
+                .setQuery(query)
+                .build();
+
+        LocalService.ParameterizeLiteralsResponse response = Client.getStub().parameterizeLiterals(request);
+        return new ParameterizedQuery(query, response);
+    }
+
+    /**
+     * Parse a query and get its AST, e.g. to find the ranges of its clauses without parsing it again in Java.
+     *
+     * @param query              query to be parsed
+     * @param includeIdentifiers whether to get the names of the identifiers
+     * @return the AST of the query
+     */
+    public static QueryAst exportAst(String query, boolean includeIdentifiers) {
+        LocalService.ExportAstRequest request = LocalService.ExportAstRequest.newBuilder()
+                .setQuery(query)
+                .setIncludeIdentifiers(includeIdentifiers)
+                .build();
+
+        LocalService.ExportAstResponse response = Client.getStub().exportAst(request);
+        return new QueryAst(query, response.getAst());
+    }
+
+    /**
+     * Find the subqueries and expressions repeated within or across queries, e.g. to turn them into WITH clauses or
+     * materialized tables. A subtree inside a larger repeated one is not reported. Queries that do not parse are
+     * skipped.
+     *
+     * @param queries queries to search, e.g. the queries of related jobs
+     * @param minSize the minimum number of AST nodes of a reported subtree
+     * @return the repeated subtrees, largest first
+     */
+    public static List<RepeatedSubtree> findRepeatedSubtrees(List<String> queries, int minSize) {
+        LocalService.FindRepeatedSubtreesRequest request = LocalService.FindRepeatedSubtreesRequest.newBuilder()
+                .addAllQueries(queries)
+                .setMinSize(minSize)
+                .build();
+
+        LocalService.FindRepeatedSubtreesResponse response = Client.getStub().findRepeatedSubtrees(request);
+        return response.getSubtreesList().stream()
+                .map(proto -> new RepeatedSubtree(queries, proto))
+                .collect(Collectors.toList());
+    }
+
+    /**
+     * Rename the tables of queries in one call. Every table whose name ([[project.]dataset.]table, without
+     * backticks) matches a regex is renamed to its replacement, where "$1" refers to the first group of the regex.
+     * The regexes are tried in the iteration order of the map. A query that does not parse is returned unchanged.
+     *
+     * @param queries      queries whose tables are renamed
+     * @param tableRenames map from the regexes matching table names to their replacements
+     * @return the rewritten queries, in the order of the input
+     */
+    public static List<String> rewriteTables(List<String> queries, Map<String, String> tableRenames) {
+        LocalService.RewriteTablesRequest.Builder request = LocalService.RewriteTablesRequest.newBuilder()
+                .addAllQueries(queries);
+        tableRenames.forEach((regex, replacement) -> request.addRewrites(
+                LocalService.TableRewriteProto.newBuilder()
+                        .setNameRegex(regex)
+                        .setReplacement(replacement)));
+
+        LocalService.RewriteTablesResponse response = Client.getStub().rewriteTables(request.build());
+        List<String> rewritten = new ArrayList<>();
+        for (int i = 0; i < queries.size(); i++) {
+            LocalService.RewriteTablesResponse.Result result = response.getResults(i);
+            rewritten.add(result.getError().isEmpty() ? result.getRewrittenQuery() : queries.get(i));
+        }
+        return rewritten;
+    }
+
     /**
      * Extract the range of a function given the starting position of the function. The range is presented by the
      * start and end byte offsets (UTF-8 based) of the input query, and end offset is excluded (i.e [start, end)).
@@ -122,4 +205,25 @@ public class ZetaSqlHelper {
         LocalService.FixDuplicateColumnsResponse response = Client.getStub().fixDuplicateColumns(request);
         return response.getFixedQuery();
     }
+
+    /**
+     * Fix a query given the message of its BigQuery error, e.g. "Duplicate column names in the result are not
+     * supported. Found duplicate(s): a". The fixes are returned as edits of the query, so the rest of the query
+     * keeps its formatting and comments.
+     *
+     * @param query        query with the error
+     * @param errorMessage message of the error, including its " at [line:column]" suffix if any
+     * @return the fixes of the error, empty if no fixer handles it
+     */
+    public static List<QueryFix> autoFix(String query, String errorMessage) {
+        LocalService.AutoFixRequest request = LocalService.AutoFixRequest.newBuilder()
+                .setQuery(query)
+                .setErrorMessage(errorMessage)
+                .build();
+
+        LocalService.AutoFixResponse response = Client.getStub().autoFix(request);
+        return response.getFixesList().stream()
+                .map(proto -> new QueryFix(query, proto))
+                .collect(Collectors.toList());
+    }
 }
@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+# Copyright 2020 BigQuery Utils
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Build bazel-bin/zetasql_helper/local_service/run_server_pgo: build the instrumented training
+# binary, run it to collect the profile, and build run_server with the profile and LTO.
+#
+# Usage (from the workspace root): zetasql_helper/benchmark/build_pgo.sh [bazel] [training flags]
+# e.g. zetasql_helper/benchmark/build_pgo.sh bazel-1.0.0 --corpus=/path/to/queries.sql
+
+set -euo pipefail
+
+BAZEL=${1:-bazel}
+shift || true
+# Must match the directory of the pgo configs in .bazelrc.
+PROFILE_DIR=/tmp/zetasql_helper_pgo
+
+rm -rf "${PROFILE_DIR}"
+"${BAZEL}" build --config=pgo_instrument //zetasql_helper/benchmark:pgo_training
+bazel-bin/zetasql_helper/benchmark/pgo_training "$@"
+
+# The profile is not an input Bazel knows about, so a changed --action_env forces the optimized
+# actions to run again with the new profile.
+"${BAZEL}" build --config=pgo --action_env=ZETASQL_HELPER_PGO_PROFILE="$(date +%s)" \
+  //zetasql_helper/local_service:run_server_pgo
@@ -0,0 +1,66 @@
+#!/bin/bash
+#
+# Copyright 2020 BigQuery Utils
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Compare the default build of run_server with run_server_pgo (see build_pgo.sh) under the same
+# load_generator run, and print the report of each build. The reports are also written, with the
+# machine and the commit they were taken on, to zetasql_helper/benchmark/PGO_RESULTS.md, to be checked
+# in.
+#
+# Usage (from the workspace root): zetasql_helper/benchmark/compare_pgo.sh [bazel] [load_generator flags]
+# e.g. zetasql_helper/benchmark/compare_pgo.sh bazel-1.0.0 --rpc_mix=Tokenize=5,LocateTableRanges=2
+
+set -euo pipefail
+
+BAZEL=${1:-bazel}
+shift || true
+PORT=50151
+OUT=$(mktemp -d)
+REPORT=zetasql_helper/benchmark/PGO_RESULTS.md
+
+"${BAZEL}" build -c opt //zetasql_helper/local_service:run_server
+cp bazel-bin/zetasql_helper/local_service/run_server "${OUT}/run_server_default"
+zetasql_helper/benchmark/build_pgo.sh "${BAZEL}"
+cp bazel-bin/zetasql_helper/local_service/run_server_pgo "${OUT}/run_server_pgo"
+"${BAZEL}" build -c opt //zetasql_helper/benchmark:load_generator
+cp bazel-bin/zetasql_helper/benchmark/load_generator "${OUT}/load_generator"
+
+{
+  echo "# PGO comparison"
+  echo
+  echo "Generated by zetasql_helper/benchmark/compare_pgo.sh."
+  echo
+  echo "- Commit: $(git rev-parse HEAD)$(git diff --quiet HEAD || echo ' (with local changes)')"
+  echo "- Date: $(date -u +%Y-%m-%dT%H:%M:%SZ)"
+  echo "- Machine: $(uname -srm), $(nproc) CPUs, $(grep -m1 'model name' /proc/cpuinfo | cut -d: -f2 | sed 's/^ //')"
+  echo "- Compiler: $(gcc --version | head -n1)"
+  echo "- load_generator flags: \`$*\`"
+} > "${OUT}/report.md"
+
+for build in default pgo; do
+  "${OUT}/run_server_${build}" --listen="127.0.0.1:${PORT}" &
+  server=$!
+  sleep 5
+  echo "=== ${build}"
+  printf '\n## %s\n\n```\n' "${build}" >> "${OUT}/report.md"
+  "${OUT}/load_generator" --target="127.0.0.1:${PORT}" "$@" | tee -a "${OUT}/report.md"
+  echo '```' >> "${OUT}/report.md"
+  kill "${server}"
+  wait "${server}" || true
+done
+cp "${OUT}/report.md" "${REPORT}"
+echo "Report written to ${REPORT}"
+rm -rf "${OUT}"
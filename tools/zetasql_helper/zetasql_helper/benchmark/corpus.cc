@@ -0,0 +1,168 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zetasql_helper/benchmark/corpus.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/strip.h"
+
+namespace bigquery::utils::zetasql_helper::benchmark {
+
+namespace {
+
+constexpr absl::string_view kMetadataPrefix = "-- helper:";
+
+// Parse a position written as "<line>:<column>".
+absl::Status ParsePosition(absl::string_view text, Position& position) {
+  std::vector<absl::string_view> parts = absl::StrSplit(text, ':');
+  if (parts.size() != 2 || !absl::SimpleAtoi(parts[0], &position.line) ||
+      !absl::SimpleAtoi(parts[1], &position.column)) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        absl::StrCat("Invalid corpus position: ", text));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ParseMetadata(absl::string_view line, CorpusEntry& entry) {
+  for (absl::string_view item : absl::StrSplit(line, ' ', absl::SkipWhitespace())) {
+    std::pair<absl::string_view, absl::string_view> key_value = absl::StrSplit(item, absl::MaxSplits('=', 1));
+    if (key_value.first == "column") {
+      entry.column = std::string(key_value.second);
+    } else if (key_value.first == "column_at") {
+      auto status = ParsePosition(key_value.second, entry.column_position);
+      if (!status.ok()) {
+        return status;
+      }
+    } else if (key_value.first == "function_at") {
+      auto status = ParsePosition(key_value.second, entry.function_position);
+      if (!status.ok()) {
+        return status;
+      }
+    } else {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("Unknown corpus metadata: ", item));
+    }
+  }
+  return absl::OkStatus();
+}
+
+}
+
+const std::vector<CorpusEntry>& DefaultCorpus() {
+  static const auto* corpus = new std::vector<CorpusEntry>{
+      {
+          "SELECT status, max(unique_key) FROM `bigquery-public-data.austin_311.311_request` LIMIT 1000",
+          "status", {1, 8}, {1, 16},
+      },
+      {
+          "SELECT status, status FROM `bigquery-public-data.austin_311.311_request` LIMIT 1000",
+          "status", {1, 8}, {},
+      },
+      {
+          "select foo.bar((select a from b), \", a, b, c\", foo.bar(1,2,3))",
+          "", {}, {1, 8},
+      },
+      {
+          "SELECT `特殊字符 (unicode characters)`, status FROM bigquery-public-data.`austin_311.311_request` "
+          "cross join `austin_311`.311_request\n"
+          "where status = '`bigquery-public-data.austin_311.311_request`'",
+          "", {}, {},
+      },
+      {
+          "SELECT\n"
+          "  o.customer_id,\n"
+          "  c.name,\n"
+          "  SUM(o.amount) AS total,\n"
+          "  COUNT(DISTINCT o.order_id) AS orders\n"
+          "FROM `project.sales.orders` AS o\n"
+          "JOIN `project.sales.customers` AS c ON o.customer_id = c.id\n"
+          "WHERE o.created_at >= TIMESTAMP('2020-01-01') AND c.country IN ('US', 'CA', 'MX')\n"
+          "GROUP BY o.customer_id\n"
+          "ORDER BY total DESC\n"
+          "LIMIT 100",
+          "name", {3, 3}, {4, 3},
+      },
+      {
+          "WITH daily AS (\n"
+          "  SELECT DATE(created_date) AS day, complaint_type, COUNT(*) AS cnt\n"
+          "  FROM `bigquery-public-data.austin_311.311_request`\n"
+          "  GROUP BY day, complaint_type\n"
+          ")\n"
+          "SELECT day, complaint_type, cnt,\n"
+          "  RANK() OVER (PARTITION BY day ORDER BY cnt DESC) AS rank_in_day\n"
+          "FROM daily\n"
+          "WHERE cnt > (SELECT AVG(cnt) FROM daily)",
+          "", {}, {2, 10},
+      },
+  };
+  return *corpus;
+}
+
+absl::Status ParseCorpus(absl::string_view text, std::vector<CorpusEntry>& corpus) {
+  CorpusEntry entry;
+  std::vector<absl::string_view> query_lines;
+
+  auto flush = [&]() {
+    while (!query_lines.empty() && absl::StripAsciiWhitespace(query_lines.back()).empty()) {
+      query_lines.pop_back();
+    }
+    if (!query_lines.empty()) {
+      entry.query = absl::StrJoin(query_lines, "\n");
+      corpus.push_back(std::move(entry));
+    }
+    entry = CorpusEntry();
+    query_lines.clear();
+  };
+
+  for (absl::string_view line : absl::StrSplit(text, '\n')) {
+    line = absl::StripSuffix(line, "\r");
+    if (absl::StripAsciiWhitespace(line) == ";") {
+      flush();
+      continue;
+    }
+    if (query_lines.empty() && absl::ConsumePrefix(&line, kMetadataPrefix)) {
+      auto status = ParseMetadata(line, entry);
+      if (!status.ok()) {
+        return status;
+      }
+      continue;
+    }
+    if (query_lines.empty() && absl::StripAsciiWhitespace(line).empty()) {
+      continue;
+    }
+    query_lines.push_back(line);
+  }
+  flush();
+  return absl::OkStatus();
+}
+
+absl::Status LoadCorpus(const std::string& path, std::vector<CorpusEntry>& corpus) {
+  std::ifstream file(path);
+  if (!file) {
+    return absl::Status(absl::StatusCode::kNotFound, absl::StrCat("Unable to open corpus file ", path));
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return ParseCorpus(buffer.str(), corpus);
+}
+
+}  // bigquery::utils::zetasql_helper::benchmark
@@ -0,0 +1,67 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_BENCHMARK_CORPUS_H_
+#define ZETASQL_HELPER_BENCHMARK_CORPUS_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace bigquery::utils::zetasql_helper::benchmark {
+
+// A 1-based line and column position inside a query. A zero line number means the position
+// is not set.
+struct Position {
+  int line = 0;
+  int column = 0;
+
+  bool is_set() const { return line > 0 && column > 0; }
+};
+
+// A query of the benchmark corpus, together with the extra arguments needed by the RPCs that
+// take a column or a position besides the query.
+struct CorpusEntry {
+  std::string query;
+  // Name of a column referenced by the query. Used by FixColumnNotGrouped and
+  // FixDuplicateColumns.
+  std::string column;
+  // Starting position of `column`. Used by FixColumnNotGrouped.
+  Position column_position;
+  // Starting position of a function call. Used by ExtractFunctionRange.
+  Position function_position;
+};
+
+// A small built-in corpus covering every RPC of the helper service.
+const std::vector<CorpusEntry>& DefaultCorpus();
+
+// Parse a corpus from its text. Queries are separated by lines only containing ";". An entry
+// may start with a metadata line providing the extra RPC arguments, which is not part of the
+// query:
+//
+//   -- helper: column=status column_at=1:8 function_at=1:16
+//   SELECT status, max(unique_key) FROM t
+//   ;
+absl::Status ParseCorpus(absl::string_view text, std::vector<CorpusEntry>& corpus);
+
+// Read and parse the corpus file at `path`.
+absl::Status LoadCorpus(const std::string& path, std::vector<CorpusEntry>& corpus);
+
+}  // bigquery::utils::zetasql_helper::benchmark
+
+#endif  // ZETASQL_HELPER_BENCHMARK_CORPUS_H_
@@ -0,0 +1,52 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "gtest/gtest.h"
+#include "zetasql_helper/benchmark/corpus.h"
+
+using namespace bigquery::utils::zetasql_helper::benchmark;
+
+class CorpusTest : public ::testing::Test {
+
+};
+
+TEST_F(CorpusTest, ParseCorpus) {
+  std::string text = "-- helper: column=status column_at=1:8 function_at=1:16\n"
+                     "SELECT status, max(unique_key)\n"
+                     "FROM t\n"
+                     ";\n"
+                     "\n"
+                     "select 1\n";
+
+  std::vector<CorpusEntry> corpus;
+  auto status = ParseCorpus(text, corpus);
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(2, corpus.size());
+  EXPECT_EQ("SELECT status, max(unique_key)\nFROM t", corpus[0].query);
+  EXPECT_EQ("status", corpus[0].column);
+  EXPECT_EQ(8, corpus[0].column_position.column);
+  EXPECT_EQ(16, corpus[0].function_position.column);
+  EXPECT_EQ("select 1", corpus[1].query);
+  EXPECT_FALSE(corpus[1].function_position.is_set());
+}
+
+TEST_F(CorpusTest, ParseCorpusRejectsUnknownMetadata) {
+  std::vector<CorpusEntry> corpus;
+  auto status = ParseCorpus("-- helper: foo=bar\nselect 1\n", corpus);
+
+  EXPECT_FALSE(status.ok());
+}
@@ -0,0 +1,346 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// A load generator driving a running ZetaSQL Helper server (see run_server.cc). It sends a
+// weighted mix of RPCs built from a query corpus from several concurrent workers, and reports
+// the throughput and the latency percentiles of every RPC.
+//
+// In closed-loop mode (the default) every worker sends its next request as soon as the previous
+// one returns. In open-loop mode (--qps > 0) requests arrive following a Poisson process of the
+// given aggregate rate, and latencies are measured from the scheduled arrival time, so a
+// server falling behind shows up as queueing delay instead of a lower request rate.
+//
+// Example:
+//   bazel run //zetasql_helper/benchmark:load_generator -- \
+//     --target=localhost:50051 --rpc_mix=Tokenize=5,LocateTableRanges=2 --concurrency=16 --qps=2000
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <thread>
+
+#include <grpcpp/grpcpp.h>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "zetasql_helper/benchmark/corpus.h"
+#include "zetasql_helper/local_service/local_service.grpc.pb.h"
+#include "zetasql_helper/stats/histogram.h"
+
+ABSL_FLAG(std::string, target, "localhost:50051", "Address of the ZetaSQL Helper server.");
+ABSL_FLAG(std::string, rpc_mix, "Tokenize=1",
+          "Comma separated list of <RPC name>=<weight>, e.g. Tokenize=5,LocateTableRanges=1.");
+ABSL_FLAG(int32_t, concurrency, 8, "Number of concurrent workers issuing requests.");
+ABSL_FLAG(int32_t, channels, 1, "Number of gRPC channels (TCP connections) shared by the workers.");
+ABSL_FLAG(double, qps, 0,
+          "Aggregate request rate of the open-loop mode. 0 runs the closed-loop mode.");
+ABSL_FLAG(int32_t, duration_seconds, 30, "Length of the measured period.");
+ABSL_FLAG(int32_t, warmup_seconds, 5, "Length of the unmeasured period before the measurement.");
+ABSL_FLAG(int32_t, deadline_ms, 10000, "Deadline of every RPC.");
+ABSL_FLAG(std::string, corpus, "",
+          "Corpus file (see benchmark/corpus.h for its format). The built-in corpus is used if empty.");
+ABSL_FLAG(std::string, table_regex, ".*", "Table regex sent with LocateTableRanges.");
+
+namespace bigquery::utils::zetasql_helper::benchmark {
+
+using local_service::ZetaSqlHelperLocalService;
+
+namespace {
+
+enum class Rpc {
+  kTokenize,
+  kExtractFunctionRange,
+  kLocateTableRanges,
+  kGetAllKeywords,
+  kFixColumnNotGrouped,
+  kFixDuplicateColumns,
+};
+
+const std::map<std::string, Rpc>& RpcsByName() {
+  static const auto* rpcs = new std::map<std::string, Rpc>{
+      {"Tokenize", Rpc::kTokenize},
+      {"ExtractFunctionRange", Rpc::kExtractFunctionRange},
+      {"LocateTableRanges", Rpc::kLocateTableRanges},
+      {"GetAllKeywords", Rpc::kGetAllKeywords},
+      {"FixColumnNotGrouped", Rpc::kFixColumnNotGrouped},
+      {"FixDuplicateColumns", Rpc::kFixDuplicateColumns},
+  };
+  return *rpcs;
+}
+
+// Whether a corpus entry carries the arguments needed by an RPC.
+bool IsEligible(Rpc rpc, const CorpusEntry& entry) {
+  switch (rpc) {
+    case Rpc::kExtractFunctionRange:
+      return entry.function_position.is_set();
+    case Rpc::kFixColumnNotGrouped:
+      return !entry.column.empty() && entry.column_position.is_set();
+    case Rpc::kFixDuplicateColumns:
+      return !entry.column.empty();
+    default:
+      return true;
+  }
+}
+
+// One RPC of the mix, with the corpus entries it can be sent with.
+struct MixItem {
+  std::string name;
+  Rpc rpc;
+  double weight;
+  std::vector<const CorpusEntry*> entries;
+};
+
+// The measurements of one RPC collected by one worker.
+struct RpcResult {
+  stats::Histogram latency_ns;
+  int64_t errors = 0;
+};
+
+absl::Status ParseRpcMix(const std::string& text, const std::vector<CorpusEntry>& corpus,
+                         std::vector<MixItem>& mix) {
+  for (absl::string_view item : absl::StrSplit(text, ',', absl::SkipWhitespace())) {
+    std::pair<std::string, std::string> name_weight = absl::StrSplit(item, absl::MaxSplits('=', 1));
+    auto it = RpcsByName().find(name_weight.first);
+    if (it == RpcsByName().end()) {
+      return absl::Status(absl::StatusCode::kInvalidArgument, "Unknown RPC in --rpc_mix: " + name_weight.first);
+    }
+    double weight = 1;
+    if (!name_weight.second.empty() && !absl::SimpleAtod(name_weight.second, &weight)) {
+      return absl::Status(absl::StatusCode::kInvalidArgument, "Invalid weight in --rpc_mix: " + std::string(item));
+    }
+
+    MixItem mix_item{it->first, it->second, weight, {}};
+    for (const auto& entry : corpus) {
+      if (IsEligible(mix_item.rpc, entry)) {
+        mix_item.entries.push_back(&entry);
+      }
+    }
+    if (mix_item.entries.empty()) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          "No corpus entry has the arguments needed by " + mix_item.name);
+    }
+    mix.push_back(std::move(mix_item));
+  }
+  if (mix.empty()) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "--rpc_mix is empty");
+  }
+  return absl::OkStatus();
+}
+
+// Send one request and return its status.
+grpc::Status Send(ZetaSqlHelperLocalService::Stub& stub, Rpc rpc, const CorpusEntry& entry,
+                  const std::string& table_regex, absl::Duration deadline) {
+  grpc::ClientContext context;
+  context.set_deadline(absl::ToChronoTime(absl::Now() + deadline));
+
+  switch (rpc) {
+    case Rpc::kTokenize: {
+      local_service::TokenizeRequest request;
+      local_service::TokenizeResponse response;
+      request.set_query(entry.query);
+      return stub.Tokenize(&context, request, &response);
+    }
+    case Rpc::kExtractFunctionRange: {
+      local_service::ExtractFunctionRangeRequest request;
+      local_service::ExtractFunctionRangeResponse response;
+      request.set_query(entry.query);
+      request.set_line_number(entry.function_position.line);
+      request.set_column_number(entry.function_position.column);
+      return stub.ExtractFunctionRange(&context, request, &response);
+    }
+    case Rpc::kLocateTableRanges: {
+      local_service::LocateTableRangesRequest request;
+      local_service::LocateTableRangesResponse response;
+      request.set_query(entry.query);
+      request.set_table_regex(table_regex);
+      return stub.LocateTableRanges(&context, request, &response);
+    }
+    case Rpc::kGetAllKeywords: {
+      local_service::GetAllKeywordsRequest request;
+      local_service::GetAllKeywordsResponse response;
+      return stub.GetAllKeywords(&context, request, &response);
+    }
+    case Rpc::kFixColumnNotGrouped: {
+      local_service::FixColumnNotGroupedRequest request;
+      local_service::FixColumnNotGroupedResponse response;
+      request.set_query(entry.query);
+      request.set_missing_column(entry.column);
+      request.set_line_number(entry.column_position.line);
+      request.set_column_number(entry.column_position.column);
+      return stub.FixColumnNotGrouped(&context, request, &response);
+    }
+    case Rpc::kFixDuplicateColumns: {
+      local_service::FixDuplicateColumnsRequest request;
+      local_service::FixDuplicateColumnsResponse response;
+      request.set_query(entry.query);
+      request.set_duplicate_column(entry.column);
+      return stub.FixDuplicateColumns(&context, request, &response);
+    }
+  }
+  return grpc::Status(grpc::StatusCode::INTERNAL, "unreachable");
+}
+
+// The loop run by every worker. Results are only recorded after `measure_start`.
+void RunWorker(int worker_id, ZetaSqlHelperLocalService::Stub* stub, const std::vector<MixItem>* mix,
+               double worker_qps, absl::Time measure_start, absl::Time end,
+               std::vector<RpcResult>* results) {
+  std::mt19937_64 random(worker_id);
+  std::vector<double> weights;
+  for (const auto& item : *mix) {
+    weights.push_back(item.weight);
+  }
+  std::discrete_distribution<int> pick_rpc(weights.begin(), weights.end());
+  std::exponential_distribution<double> inter_arrival(worker_qps > 0 ? worker_qps : 1);
+
+  const auto table_regex = absl::GetFlag(FLAGS_table_regex);
+  const auto deadline = absl::Milliseconds(absl::GetFlag(FLAGS_deadline_ms));
+
+  // Randomize the first arrival so that the workers do not start in lockstep.
+  absl::Time next_arrival = absl::Now() + absl::Seconds(inter_arrival(random));
+  while (true) {
+    absl::Time start;
+    if (worker_qps > 0) {
+      absl::SleepFor(next_arrival - absl::Now());
+      start = next_arrival;
+      next_arrival += absl::Seconds(inter_arrival(random));
+    } else {
+      start = absl::Now();
+    }
+    if (start >= end) {
+      break;
+    }
+
+    int index = pick_rpc(random);
+    const auto& item = (*mix)[index];
+    const auto& entry = *item.entries[random() % item.entries.size()];
+    auto status = Send(*stub, item.rpc, entry, table_regex, deadline);
+    absl::Time finish = absl::Now();
+
+    if (start < measure_start) {
+      continue;
+    }
+    auto& result = (*results)[index];
+    if (status.ok()) {
+      result.latency_ns.Record(absl::ToInt64Nanoseconds(finish - start));
+    } else {
+      result.errors++;
+    }
+  }
+}
+
+void PrintReport(const std::vector<MixItem>& mix, const std::vector<RpcResult>& results,
+                 absl::Duration measured) {
+  auto ms = [](int64_t nanos) { return nanos / 1e6; };
+  auto seconds = absl::ToDoubleSeconds(measured);
+
+  std::cout << std::left << std::setw(24) << "rpc" << std::right
+            << std::setw(10) << "count" << std::setw(8) << "errors" << std::setw(10) << "qps"
+            << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+            << std::setw(10) << "p99.9" << std::setw(10) << "max" << "   (latency in ms)" << std::endl;
+
+  stats::Histogram total;
+  int64_t total_errors = 0;
+  auto print_row = [&](const std::string& name, const stats::Histogram& latency, int64_t errors) {
+    std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << latency.count() << std::setw(8) << errors
+              << std::setw(10) << std::setprecision(1) << latency.count() / seconds << std::setprecision(3)
+              << std::setw(10) << ms(latency.Percentile(50)) << std::setw(10) << ms(latency.Percentile(90))
+              << std::setw(10) << ms(latency.Percentile(99)) << std::setw(10) << ms(latency.Percentile(99.9))
+              << std::setw(10) << ms(latency.max()) << std::endl;
+  };
+  for (int i = 0; i < mix.size(); i++) {
+    print_row(mix[i].name, results[i].latency_ns, results[i].errors);
+    total.Merge(results[i].latency_ns);
+    total_errors += results[i].errors;
+  }
+  print_row("TOTAL", total, total_errors);
+}
+
+absl::Status Run() {
+  std::vector<CorpusEntry> corpus;
+  auto corpus_path = absl::GetFlag(FLAGS_corpus);
+  if (corpus_path.empty()) {
+    corpus = DefaultCorpus();
+  } else {
+    auto status = LoadCorpus(corpus_path, corpus);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  std::vector<MixItem> mix;
+  auto status = ParseRpcMix(absl::GetFlag(FLAGS_rpc_mix), corpus, mix);
+  if (!status.ok()) {
+    return status;
+  }
+
+  int concurrency = std::max(1, absl::GetFlag(FLAGS_concurrency));
+  int num_channels = std::max(1, absl::GetFlag(FLAGS_channels));
+  std::vector<std::unique_ptr<ZetaSqlHelperLocalService::Stub>> stubs;
+  for (int i = 0; i < num_channels; i++) {
+    grpc::ChannelArguments args;
+    // Keep a separate connection per channel instead of sharing one subchannel.
+    args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+    auto channel = grpc::CreateCustomChannel(absl::GetFlag(FLAGS_target), grpc::InsecureChannelCredentials(), args);
+    stubs.push_back(ZetaSqlHelperLocalService::NewStub(channel));
+  }
+
+  double worker_qps = absl::GetFlag(FLAGS_qps) / concurrency;
+  absl::Time measure_start = absl::Now() + absl::Seconds(absl::GetFlag(FLAGS_warmup_seconds));
+  absl::Time end = measure_start + absl::Seconds(absl::GetFlag(FLAGS_duration_seconds));
+
+  std::cout << "Running " << (worker_qps > 0 ? "open" : "closed") << "-loop load against "
+            << absl::GetFlag(FLAGS_target) << " with " << concurrency << " workers" << std::endl;
+
+  std::vector<std::vector<RpcResult>> results(concurrency, std::vector<RpcResult>(mix.size()));
+  std::vector<std::thread> workers;
+  for (int i = 0; i < concurrency; i++) {
+    workers.emplace_back(RunWorker, i, stubs[i % num_channels].get(), &mix, worker_qps, measure_start, end,
+                         &results[i]);
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  std::vector<RpcResult> merged(mix.size());
+  for (const auto& worker_results : results) {
+    for (int i = 0; i < mix.size(); i++) {
+      merged[i].latency_ns.Merge(worker_results[i].latency_ns);
+      merged[i].errors += worker_results[i].errors;
+    }
+  }
+  PrintReport(mix, merged, end - measure_start);
+  return absl::OkStatus();
+}
+
+}
+
+}  // bigquery::utils::zetasql_helper::benchmark
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  auto status = bigquery::utils::zetasql_helper::benchmark::Run();
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// The training workload of the profile-guided build of run_server (see build_pgo.sh). It replays
+// a query corpus through every RPC of the helper service in-process, so that the profile covers
+// the parser, the traversals and the fixers the way the server runs them, without the noise of
+// the network.
+//
+// Example:
+//   bazel run --config=pgo_instrument //zetasql_helper/benchmark:pgo_training -- --rounds=200
+
+#include <iostream>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "zetasql_helper/benchmark/corpus.h"
+#include "zetasql_helper/local_service/warmup.h"
+
+ABSL_FLAG(int32_t, rounds, 200, "Number of times the corpus is replayed.");
+ABSL_FLAG(std::string, corpus, "",
+          "Corpus file (see benchmark/corpus.h for its format). The built-in corpus is used if empty.");
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  using namespace bigquery::utils::zetasql_helper;
+
+  std::vector<benchmark::CorpusEntry> corpus = benchmark::DefaultCorpus();
+  auto path = absl::GetFlag(FLAGS_corpus);
+  if (!path.empty()) {
+    corpus.clear();
+    auto status = benchmark::LoadCorpus(path, corpus);
+    if (!status.ok()) {
+      std::cerr << status << std::endl;
+      return 1;
+    }
+  }
+
+  local_service::ZetaSqlHelperLocalServiceImpl service;
+  auto start = absl::Now();
+  auto requests = local_service::ReplayCorpus(service, corpus, absl::GetFlag(FLAGS_rounds));
+  std::cout << "Replayed " << requests << " requests in " << absl::FormatDuration(absl::Now() - start)
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,165 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/benchmark/scalability.h"
+
+#include <cmath>
+
+#include "absl/strings/str_cat.h"
+
+namespace bigquery::utils::zetasql_helper::benchmark {
+
+namespace {
+
+// SELECT
+//   c0,
+//   ...
+//   c<size-1>,
+//   max(x) AS m,
+//   c0
+// FROM t
+//
+// The last column duplicates the first one, so that both fixers have something to fix.
+CorpusEntry WideSelect(int size) {
+  CorpusEntry entry;
+  entry.query = "SELECT\n";
+  for (int i = 0; i < size; i++) {
+    absl::StrAppend(&entry.query, "  c", i, ",\n");
+  }
+  absl::StrAppend(&entry.query, "  max(x) AS m,\n  c0\nFROM t");
+  entry.column = "c0";
+  entry.column_position = {2, 3};
+  entry.function_position = {size + 2, 3};
+  return entry;
+}
+
+// SELECT c0, max(x)
+// FROM t
+// WHERE c0 IN (
+//   0,
+//   ...
+//   <size-1>
+// )
+CorpusEntry LongInList(int size) {
+  CorpusEntry entry;
+  entry.query = "SELECT c0, max(x)\nFROM t\nWHERE c0 IN (\n";
+  for (int i = 0; i < size; i++) {
+    absl::StrAppend(&entry.query, "  ", i, i + 1 < size ? ",\n" : "\n");
+  }
+  absl::StrAppend(&entry.query, ")");
+  entry.column = "c0";
+  entry.column_position = {1, 8};
+  entry.function_position = {1, 12};
+  return entry;
+}
+
+// SELECT c0, max(x)
+// FROM (SELECT c0, x
+// FROM (SELECT c0, x
+// ...
+// FROM t))
+CorpusEntry DeepNesting(int size) {
+  CorpusEntry entry;
+  entry.query = "SELECT c0, max(x)\n";
+  for (int i = 0; i < size; i++) {
+    absl::StrAppend(&entry.query, "FROM (SELECT c0, x\n");
+  }
+  absl::StrAppend(&entry.query, "FROM t", std::string(size, ')'));
+  entry.column = "c0";
+  entry.column_position = {1, 8};
+  entry.function_position = {1, 12};
+  return entry;
+}
+
+// SELECT t0.c0, max(t1.x)
+// FROM t0
+// JOIN t1 USING (c0)
+// ...
+// JOIN t<size-1> USING (c0)
+CorpusEntry ManyJoins(int size) {
+  CorpusEntry entry;
+  entry.query = "SELECT t0.c0, max(t1.x)\nFROM t0";
+  for (int i = 1; i < size; i++) {
+    absl::StrAppend(&entry.query, "\nJOIN t", i, " USING (c0)");
+  }
+  entry.column = "c0";
+  entry.column_position = {1, 8};
+  entry.function_position = {1, 15};
+  return entry;
+}
+
+}
+
+const std::vector<QueryShape>& AllQueryShapes() {
+  static const auto* shapes = new std::vector<QueryShape>{
+      QueryShape::kWideSelect, QueryShape::kLongInList, QueryShape::kDeepNesting, QueryShape::kManyJoins,
+  };
+  return *shapes;
+}
+
+absl::string_view QueryShapeName(QueryShape shape) {
+  switch (shape) {
+    case QueryShape::kWideSelect:
+      return "wide_select";
+    case QueryShape::kLongInList:
+      return "long_in_list";
+    case QueryShape::kDeepNesting:
+      return "deep_nesting";
+    case QueryShape::kManyJoins:
+      return "many_joins";
+  }
+  return "unknown";
+}
+
+CorpusEntry GenerateQuery(QueryShape shape, int size) {
+  switch (shape) {
+    case QueryShape::kWideSelect:
+      return WideSelect(size);
+    case QueryShape::kLongInList:
+      return LongInList(size);
+    case QueryShape::kDeepNesting:
+      return DeepNesting(size);
+    case QueryShape::kManyJoins:
+      return ManyJoins(size);
+  }
+  return CorpusEntry();
+}
+
+std::vector<int> ScalingSizes(QueryShape shape) {
+  // Every node of a nested subquery is deeper in the parse tree, so keep the recursion of the
+  // parser and of the unparser shallow.
+  if (shape == QueryShape::kDeepNesting) {
+    return {25, 50, 100, 200, 400};
+  }
+  return {250, 500, 1000, 2000, 4000};
+}
+
+double FitGrowthExponent(const std::vector<int>& sizes, const std::vector<double>& seconds) {
+  double n = sizes.size();
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (int i = 0; i < sizes.size(); i++) {
+    double x = std::log(static_cast<double>(sizes[i]));
+    double y = std::log(seconds[i]);
+    sum_x += x;
+    sum_y += y;
+    sum_xx += x * x;
+    sum_xy += x * y;
+  }
+  return (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+}
+
+}  // bigquery::utils::zetasql_helper::benchmark
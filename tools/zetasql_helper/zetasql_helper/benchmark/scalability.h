@@ -0,0 +1,59 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_BENCHMARK_SCALABILITY_H_
+#define ZETASQL_HELPER_BENCHMARK_SCALABILITY_H_
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "zetasql_helper/benchmark/corpus.h"
+
+namespace bigquery::utils::zetasql_helper::benchmark {
+
+// The shapes of the queries generated to measure how the RPCs scale with the size of a query.
+enum class QueryShape {
+  // SELECT with `size` columns, one per line.
+  kWideSelect = 0,
+  // WHERE ... IN with `size` values.
+  kLongInList,
+  // `size` nested subqueries.
+  kDeepNesting,
+  // FROM with `size` joined tables.
+  kManyJoins,
+};
+
+const std::vector<QueryShape>& AllQueryShapes();
+
+absl::string_view QueryShapeName(QueryShape shape);
+
+// Generate a query of the given shape and size. Like the entries of the default corpus, it
+// references a column and calls a function at the positions set in the entry, so that it can be
+// given to every RPC.
+CorpusEntry GenerateQuery(QueryShape shape, int size);
+
+// The sizes at which the growth of a shape is measured, in increasing order.
+std::vector<int> ScalingSizes(QueryShape shape);
+
+// The exponent k of the power law time = c * size^k fitted to the samples by least squares in
+// log-log space, i.e. ~1 for a linear algorithm and ~2 for a quadratic one. `sizes` and `seconds`
+// have the same length, at least 2, and positive values.
+double FitGrowthExponent(const std::vector<int>& sizes, const std::vector<double>& seconds);
+
+}  // bigquery::utils::zetasql_helper::benchmark
+
+#endif  // ZETASQL_HELPER_BENCHMARK_SCALABILITY_H_
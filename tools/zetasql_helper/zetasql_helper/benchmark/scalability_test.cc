@@ -0,0 +1,255 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// Fails if the time of an RPC grows faster than linearly with the size of the query, so that a
+// quadratic traversal or fixer does not land unnoticed. Every RPC is timed on queries of growing
+// size for each QueryShape, and the exponent of the power law fitted to the timings must stay
+// below kMaxGrowthExponent.
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "zetasql_helper/benchmark/scalability.h"
+#include "zetasql_helper/local_service/local_service.h"
+
+using namespace bigquery::utils::zetasql_helper;
+using namespace bigquery::utils::zetasql_helper::benchmark;
+
+namespace {
+
+// Linear algorithms fit ~1.0 (a bit more with the cache misses of larger trees), and quadratic
+// ones ~2.0.
+constexpr double kMaxGrowthExponent = 1.5;
+
+// Every timing is the median of kSamples samples, to filter out the noise of the machine. A sample
+// is the mean time of as many calls as fit in kMinSampleDuration, so that the small queries are
+// not timed at the resolution of the clock.
+constexpr int kSamples = 9;
+constexpr absl::Duration kMinSampleDuration = absl::Milliseconds(10);
+
+// The RPCs taking a query. The others (GetAllKeywords, LoadCatalog and the stats RPCs) do not
+// depend on the size of a query.
+struct Rpc {
+  std::string name;
+  std::function<void(local_service::ZetaSqlHelperLocalServiceImpl&, const CorpusEntry&)> call;
+};
+
+std::vector<Rpc> AllRpcs() {
+  using local_service::ZetaSqlHelperLocalServiceImpl;
+  return {
+      {"Tokenize", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::TokenizeRequest request;
+        local_service::TokenizeResponse response;
+        request.set_query(entry.query);
+        service.Tokenize(request, &response).IgnoreError();
+      }},
+      {"ExtractFunctionRange", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::ExtractFunctionRangeRequest request;
+        local_service::ExtractFunctionRangeResponse response;
+        request.set_query(entry.query);
+        request.set_line_number(entry.function_position.line);
+        request.set_column_number(entry.function_position.column);
+        service.ExtractFunctionRange(request, &response).IgnoreError();
+      }},
+      {"LocateTableRanges", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::LocateTableRangesRequest request;
+        local_service::LocateTableRangesResponse response;
+        request.set_query(entry.query);
+        request.set_table_regex("t.*");
+        service.LocateTableRanges(request, &response).IgnoreError();
+      }},
+      {"ExportAst", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::ExportAstRequest request;
+        local_service::ExportAstResponse response;
+        request.set_query(entry.query);
+        request.set_include_identifiers(true);
+        service.ExportAst(request, &response).IgnoreError();
+      }},
+      {"FindRepeatedSubtrees", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::FindRepeatedSubtreesRequest request;
+        local_service::FindRepeatedSubtreesResponse response;
+        request.add_queries(entry.query);
+        request.add_queries(entry.query);
+        service.FindRepeatedSubtrees(request, &response).IgnoreError();
+      }},
+      {"RewriteTables", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::RewriteTablesRequest request;
+        local_service::RewriteTablesResponse response;
+        request.add_queries(entry.query);
+        auto* rewrite = request.add_rewrites();
+        rewrite->set_name_regex("t(.*)");
+        rewrite->set_replacement("u$1");
+        service.RewriteTables(request, &response).IgnoreError();
+      }},
+      {"ParameterizeLiterals", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::ParameterizeLiteralsRequest request;
+        local_service::ParameterizeLiteralsResponse response;
+        request.set_query(entry.query);
+        service.ParameterizeLiterals(request, &response).IgnoreError();
+      }},
+      {"GetSemanticTokens", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::GetSemanticTokensRequest request;
+        local_service::GetSemanticTokensResponse response;
+        request.set_query(entry.query);
+        service.GetSemanticTokens(request, &response).IgnoreError();
+      }},
+      {"FixColumnNotGrouped", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::FixColumnNotGroupedRequest request;
+        local_service::FixColumnNotGroupedResponse response;
+        request.set_query(entry.query);
+        request.set_missing_column(entry.column);
+        request.set_line_number(entry.column_position.line);
+        request.set_column_number(entry.column_position.column);
+        service.FixColumnNotGrouped(request, &response).IgnoreError();
+      }},
+      {"FixDuplicateColumns", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::FixDuplicateColumnsRequest request;
+        local_service::FixDuplicateColumnsResponse response;
+        request.set_query(entry.query);
+        request.set_duplicate_column(entry.column);
+        service.FixDuplicateColumns(request, &response).IgnoreError();
+      }},
+      {"AutoFix", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::AutoFixRequest request;
+        local_service::AutoFixResponse response;
+        request.set_query(entry.query);
+        request.set_error_message(absl::StrCat("SELECT list expression references column ", entry.column,
+                                               " which is neither grouped nor aggregated at [",
+                                               entry.column_position.line, ":", entry.column_position.column, "]"));
+        service.AutoFix(request, &response).IgnoreError();
+      }},
+      {"AnalyzeQuery", [](ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+        local_service::AnalyzeQueryRequest request;
+        local_service::AnalyzeQueryResponse response;
+        request.set_query(entry.query);
+        service.AnalyzeQuery(request, &response).IgnoreError();
+      }},
+  };
+}
+
+double TimeRpc(const Rpc& rpc, local_service::ZetaSqlHelperLocalServiceImpl& service, const CorpusEntry& entry) {
+  // The first run warms up the caches and the lazily initialized state of ZetaSQL.
+  rpc.call(service, entry);
+  std::vector<double> samples;
+  for (int sample = 0; sample < kSamples; sample++) {
+    int calls = 0;
+    auto start = absl::Now();
+    auto elapsed = absl::ZeroDuration();
+    while (elapsed < kMinSampleDuration) {
+      rpc.call(service, entry);
+      calls++;
+      elapsed = absl::Now() - start;
+    }
+    samples.push_back(absl::ToDoubleSeconds(elapsed) / calls);
+  }
+  std::nth_element(samples.begin(), samples.begin() + kSamples / 2, samples.end());
+  return samples[kSamples / 2];
+}
+
+}
+
+class ScalabilityTest : public ::testing::Test {
+ protected:
+  void ExpectLinearGrowth(QueryShape shape) {
+    auto sizes = ScalingSizes(shape);
+    std::vector<CorpusEntry> queries;
+    for (auto size : sizes) {
+      queries.push_back(GenerateQuery(shape, size));
+    }
+
+    for (const auto& rpc : AllRpcs()) {
+      std::vector<double> seconds;
+      for (const auto& query : queries) {
+        seconds.push_back(TimeRpc(rpc, service_, query));
+      }
+      auto exponent = FitGrowthExponent(sizes, seconds);
+
+      std::cout << QueryShapeName(shape) << " " << rpc.name << ": exponent " << exponent << " (";
+      for (int i = 0; i < sizes.size(); i++) {
+        std::cout << (i > 0 ? ", " : "") << sizes[i] << " -> " << seconds[i] * 1e6 << "us";
+      }
+      std::cout << ")" << std::endl;
+      EXPECT_LT(exponent, kMaxGrowthExponent) << rpc.name << " grows super-linearly on " << QueryShapeName(shape);
+    }
+  }
+
+  local_service::ZetaSqlHelperLocalServiceImpl service_;
+};
+
+TEST_F(ScalabilityTest, FitGrowthExponent) {
+  std::vector<int> sizes = {10, 20, 40, 80};
+
+  EXPECT_NEAR(1.0, FitGrowthExponent(sizes, {1, 2, 4, 8}), 1e-9);
+  EXPECT_NEAR(2.0, FitGrowthExponent(sizes, {1, 4, 16, 64}), 1e-9);
+  EXPECT_NEAR(0.0, FitGrowthExponent(sizes, {3, 3, 3, 3}), 1e-9);
+}
+
+TEST_F(ScalabilityTest, GenerateQuery) {
+  auto wide = GenerateQuery(QueryShape::kWideSelect, 3);
+  EXPECT_EQ("SELECT\n  c0,\n  c1,\n  c2,\n  max(x) AS m,\n  c0\nFROM t", wide.query);
+  EXPECT_EQ(5, wide.function_position.line);
+
+  EXPECT_EQ("SELECT c0, max(x)\nFROM t\nWHERE c0 IN (\n  0,\n  1\n)",
+            GenerateQuery(QueryShape::kLongInList, 2).query);
+  EXPECT_EQ("SELECT c0, max(x)\nFROM (SELECT c0, x\nFROM (SELECT c0, x\nFROM t))",
+            GenerateQuery(QueryShape::kDeepNesting, 2).query);
+  EXPECT_EQ("SELECT t0.c0, max(t1.x)\nFROM t0\nJOIN t1 USING (c0)\nJOIN t2 USING (c0)",
+            GenerateQuery(QueryShape::kManyJoins, 3).query);
+}
+
+TEST_F(ScalabilityTest, GeneratedQueriesAreFixable) {
+  for (auto shape : AllQueryShapes()) {
+    auto entry = GenerateQuery(shape, 10);
+
+    local_service::FixColumnNotGroupedRequest request;
+    local_service::FixColumnNotGroupedResponse response;
+    request.set_query(entry.query);
+    request.set_missing_column(entry.column);
+    request.set_line_number(entry.column_position.line);
+    request.set_column_number(entry.column_position.column);
+    EXPECT_TRUE(service_.FixColumnNotGrouped(request, &response).ok()) << QueryShapeName(shape);
+
+    local_service::ExtractFunctionRangeRequest function_request;
+    local_service::ExtractFunctionRangeResponse function_response;
+    function_request.set_query(entry.query);
+    function_request.set_line_number(entry.function_position.line);
+    function_request.set_column_number(entry.function_position.column);
+    EXPECT_TRUE(service_.ExtractFunctionRange(function_request, &function_response).ok())
+        << QueryShapeName(shape);
+  }
+}
+
+TEST_F(ScalabilityTest, WideSelect) {
+  ExpectLinearGrowth(QueryShape::kWideSelect);
+}
+
+TEST_F(ScalabilityTest, LongInList) {
+  ExpectLinearGrowth(QueryShape::kLongInList);
+}
+
+TEST_F(ScalabilityTest, DeepNesting) {
+  ExpectLinearGrowth(QueryShape::kDeepNesting);
+}
+
+TEST_F(ScalabilityTest, ManyJoins) {
+  ExpectLinearGrowth(QueryShape::kManyJoins);
+}
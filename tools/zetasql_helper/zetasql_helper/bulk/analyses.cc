@@ -0,0 +1,245 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/bulk/analyses.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql_helper/bulk/record_reader.h"
+#include "zetasql_helper/fixer/fix_duplicate_columns.h"
+#include "zetasql_helper/token/token.h"
+#include "zetasql_helper/util/fingerprint.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+namespace {
+
+void AppendError(absl::string_view name, const absl::Status& status, std::string* json) {
+  absl::StrAppend(json, ",\"", name, "\":");
+  AppendJsonString(status.message(), json);
+}
+
+void AnalyzeTokens(const std::string& query, uint32_t analyses, const CancellationToken* cancellation,
+                   std::string* json) {
+  std::vector<zetasql::ParseToken> tokens;
+  auto status = Tokenize(query, tokens, cancellation);
+  if (!status.ok()) {
+    AppendError("token_error", status, json);
+    return;
+  }
+  if (!tokens.empty() && tokens.back().IsEndOfInput()) {
+    tokens.pop_back();
+  }
+
+  if (analyses & kTokens) {
+    absl::StrAppend(json, ",\"token_count\":", tokens.size());
+  }
+  if (analyses & kFingerprint) {
+    std::string normalized;
+    for (const auto& token : tokens) {
+      if (!normalized.empty()) {
+        normalized.push_back(' ');
+      }
+      if (token.kind() == zetasql::ParseToken::VALUE) {
+        normalized.push_back('?');
+      } else if (token.kind() == zetasql::ParseToken::KEYWORD ||
+          token.kind() == zetasql::ParseToken::IDENTIFIER_OR_KEYWORD) {
+        normalized.append(absl::AsciiStrToUpper(token.GetImage()));
+      } else {
+        normalized.append(std::string(token.GetImage()));
+      }
+    }
+    absl::StrAppend(json, ",\"fingerprint\":\"", FingerprintToHex(Fingerprint64(query)),
+                    "\",\"normalized_fingerprint\":\"", FingerprintToHex(Fingerprint64(normalized)), "\"");
+  }
+}
+
+void AnalyzeTables(const zetasql::ASTStatement* statement, std::string* json) {
+  auto table_nodes = FindAllNodes(statement, [](const zetasql::ASTNode* node) {
+    return node->node_kind() == zetasql::AST_TABLE_PATH_EXPRESSION;
+  });
+  std::set<std::string> tables;
+  for (auto node : table_nodes) {
+    auto table_path = static_cast<const zetasql::ASTTablePathExpression*>(node);
+    // UNNEST(...) is a table path expression without a path.
+    if (table_path->path_expr() != nullptr) {
+      tables.insert(absl::StrJoin(ReadNames(*table_path->path_expr()), "."));
+    }
+  }
+  json->append(",\"tables\":[");
+  bool first = true;
+  for (const auto& table : tables) {
+    if (!first) {
+      json->push_back(',');
+    }
+    first = false;
+    AppendJsonString(table, json);
+  }
+  json->push_back(']');
+}
+
+void AnalyzeComplexity(const zetasql::ASTStatement* statement, std::string* json) {
+  int64_t nodes = 0, depth = 0, selects = 0, joins = 0, subqueries = 0;
+  std::vector<std::pair<const zetasql::ASTNode*, int64_t>> stack = {{statement, 1}};
+  while (!stack.empty()) {
+    auto [node, node_depth] = stack.back();
+    stack.pop_back();
+    nodes++;
+    depth = std::max(depth, node_depth);
+    switch (node->node_kind()) {
+      case zetasql::AST_SELECT:
+        selects++;
+        break;
+      case zetasql::AST_JOIN:
+        joins++;
+        break;
+      case zetasql::AST_TABLE_SUBQUERY:
+      case zetasql::AST_EXPRESSION_SUBQUERY:
+        subqueries++;
+        break;
+      default:
+        break;
+    }
+    for (int i = 0; i < node->num_children(); i++) {
+      stack.push_back({node->child(i), node_depth + 1});
+    }
+  }
+  absl::StrAppend(json, ",\"ast_nodes\":", nodes, ",\"ast_depth\":", depth, ",\"selects\":", selects,
+                  ",\"joins\":", joins, ",\"subqueries\":", subqueries);
+}
+
+// The names appearing more than once in a select list, in the order of the query, with the
+// number of select lists in which they do.
+std::vector<std::pair<std::string, int>> FindDuplicateColumns(const zetasql::ASTStatement* statement) {
+  auto select_lists = FindAllNodes(statement, [](const zetasql::ASTNode* node) {
+    return node->node_kind() == zetasql::AST_SELECT_LIST;
+  });
+  std::vector<std::pair<std::string, int>> duplicates;
+  absl::flat_hash_map<std::string, int> duplicate_index;
+  for (auto node : select_lists) {
+    auto select_list = static_cast<const zetasql::ASTSelectList*>(node);
+    absl::flat_hash_map<std::string, int> counts;
+    for (auto column : select_list->columns()) {
+      auto name = GetColumnName(column);
+      if (!name.empty() && ++counts[name] == 2) {
+        auto [it, inserted] = duplicate_index.emplace(name, duplicates.size());
+        if (inserted) {
+          duplicates.push_back({name, 0});
+        }
+        duplicates[it->second].second++;
+      }
+    }
+  }
+  return duplicates;
+}
+
+void AnalyzeFixes(const std::string& query, const std::vector<std::pair<std::string, int>>& duplicates,
+                  const CancellationToken* cancellation, std::string* json) {
+  std::string fixed_query = query;
+  std::vector<std::string> fixes;
+  for (const auto& [name, select_lists] : duplicates) {
+    // Every call fixes one select list.
+    for (int i = 0; i < select_lists; i++) {
+      auto fixed = FixDuplicateColumns(fixed_query, name, cancellation);
+      if (!fixed.ok()) {
+        AppendError("fix_error", fixed.status(), json);
+        return;
+      }
+      fixed_query = std::move(fixed).value();
+    }
+    fixes.push_back(absl::StrCat("duplicate_columns:", name));
+  }
+  json->append(",\"fixes\":[");
+  for (int i = 0; i < fixes.size(); i++) {
+    if (i > 0) {
+      json->push_back(',');
+    }
+    AppendJsonString(fixes[i], json);
+  }
+  json->append("],\"fixed_query\":");
+  AppendJsonString(fixed_query, json);
+}
+
+}
+
+absl::Status ParseAnalyses(absl::string_view names, uint32_t* analyses) {
+  static const auto* kNames = new std::vector<std::pair<absl::string_view, uint32_t>>{
+      {"tokens", kTokens},
+      {"tables", kTables},
+      {"fingerprint", kFingerprint},
+      {"complexity", kComplexity},
+      {"fixes", kFixes},
+      {"all", kAllAnalyses},
+  };
+  *analyses = 0;
+  for (absl::string_view name : absl::StrSplit(names, ',', absl::SkipWhitespace())) {
+    name = absl::StripAsciiWhitespace(name);
+    auto it = std::find_if(kNames->begin(), kNames->end(), [name](const auto& entry) { return entry.first == name; });
+    if (it == kNames->end()) {
+      return absl::Status(absl::StatusCode::kInvalidArgument, absl::StrCat("unknown analysis: ", name));
+    }
+    *analyses |= it->second;
+  }
+  if (*analyses == 0) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "no analysis selected");
+  }
+  return absl::OkStatus();
+}
+
+void AnalyzeQuery(const std::string& query, uint32_t analyses, const CancellationToken* cancellation,
+                  std::string* json) {
+  if (analyses & (kTokens | kFingerprint)) {
+    AnalyzeTokens(query, analyses, cancellation, json);
+  }
+  if (!(analyses & (kTables | kComplexity | kFixes))) {
+    return;
+  }
+
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+  auto status = ParseBigQueryStatement(query, &parser_output, cancellation);
+  if (!status.ok()) {
+    AppendError("parse_error", status, json);
+    return;
+  }
+  if (analyses & kTables) {
+    AnalyzeTables(parser_output->statement(), json);
+  }
+  if (analyses & kComplexity) {
+    AnalyzeComplexity(parser_output->statement(), json);
+  }
+  if (!(analyses & kFixes)) {
+    return;
+  }
+  auto duplicates = FindDuplicateColumns(parser_output->statement());
+  // The fixer parses the query again, in the arena of the thread once it is released.
+  parser_output.reset();
+  if (!duplicates.empty()) {
+    AnalyzeFixes(query, duplicates, cancellation, json);
+  }
+}
+
+}  // bigquery::utils::zetasql_helper::bulk
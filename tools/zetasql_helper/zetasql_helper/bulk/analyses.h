@@ -0,0 +1,60 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_BULK_ANALYSES_H_
+#define ZETASQL_HELPER_BULK_ANALYSES_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+// The analyses run on every query, as flags.
+enum Analysis : uint32_t {
+  // "token_count": the number of tokens, comments excluded.
+  kTokens = 1 << 0,
+  // "tables": the sorted names of the tables referenced by the query, as written.
+  kTables = 1 << 1,
+  // "fingerprint": the Fingerprint64 of the query, and "normalized_fingerprint": the fingerprint
+  // of its tokens with the literals replaced by "?" and the keywords upper-cased, so that the
+  // queries only differing by their constants, comments or spacing share it.
+  kFingerprint = 1 << 2,
+  // "ast_nodes", "ast_depth", "selects", "joins" and "subqueries".
+  kComplexity = 1 << 3,
+  // "fixes": the columns renamed by FixDuplicateColumns in the select lists having duplicate
+  // names, and "fixed_query": the fixed query. Only present if something is fixed.
+  kFixes = 1 << 4,
+};
+constexpr uint32_t kAllAnalyses = kTokens | kTables | kFingerprint | kComplexity | kFixes;
+
+// Parse a comma-separated list of analysis names: tokens, tables, fingerprint, complexity,
+// fixes, or all.
+absl::Status ParseAnalyses(absl::string_view names, uint32_t* analyses);
+
+// Run the analyses on a query, and append their results to `json` as members of a JSON object,
+// each preceded by a comma. An analysis which fails adds a "token_error", "parse_error" or
+// "fix_error" member instead of its results.
+void AnalyzeQuery(const std::string& query, uint32_t analyses, const CancellationToken* cancellation,
+                  std::string* json);
+
+}  // bigquery::utils::zetasql_helper::bulk
+
+#endif  // ZETASQL_HELPER_BULK_ANALYSES_H_
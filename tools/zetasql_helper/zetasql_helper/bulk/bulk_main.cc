@@ -0,0 +1,115 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// Analyzes a file of queries offline, e.g. a log of historical jobs, without a server. The file
+// is mapped in memory, split into batches of records, and the batches are analyzed by a
+// work-stealing thread pool. The results are written as JSON lines, in the order of the input.
+//
+// Example:
+//   zetasql_helper_bulk --input=jobs.jsonl --output=analysis.jsonl --analyses=tables,fingerprint
+
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/match.h"
+#include "zetasql_helper/bulk/pipeline.h"
+
+ABSL_FLAG(std::string, input, "", "File of queries, as JSON lines or CSV with a header.");
+ABSL_FLAG(std::string, output, "-", "File receiving the JSON lines of the results, or - for stdout.");
+ABSL_FLAG(std::string, format, "",
+          "jsonl or csv. By default, csv if the input ends with .csv, and jsonl otherwise.");
+ABSL_FLAG(std::string, query_field, "query", "The JSON field or the CSV column holding the query.");
+ABSL_FLAG(std::string, id_field, "", "The JSON field or the CSV column copied to the results as the id.");
+ABSL_FLAG(std::string, analyses, "all",
+          "Comma-separated analyses: tokens, tables, fingerprint, complexity, fixes, or all.");
+ABSL_FLAG(int32_t, threads, 0, "Number of worker threads. 0 uses one per core.");
+ABSL_FLAG(int32_t, batch_size, 256, "Number of records analyzed by one task.");
+ABSL_FLAG(int32_t, query_timeout_ms, 0,
+          "Time allowed to the analyses of one query; the others are reported as errors. 0 disables it.");
+ABSL_FLAG(int32_t, progress_seconds, 10, "Interval between two progress reports on stderr.");
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  using namespace bigquery::utils::zetasql_helper::bulk;
+
+  auto input_path = absl::GetFlag(FLAGS_input);
+  if (input_path.empty()) {
+    std::cerr << "--input is required" << std::endl;
+    return 1;
+  }
+
+  PipelineOptions options;
+  auto format = absl::GetFlag(FLAGS_format);
+  if (format.empty()) {
+    format = absl::EndsWith(input_path, ".csv") ? "csv" : "jsonl";
+  }
+  if (format == "csv") {
+    options.reader.format = InputFormat::kCsv;
+  } else if (format == "jsonl") {
+    options.reader.format = InputFormat::kJsonLines;
+  } else {
+    std::cerr << "Unknown --format: " << format << std::endl;
+    return 1;
+  }
+  options.reader.query_field = absl::GetFlag(FLAGS_query_field);
+  options.reader.id_field = absl::GetFlag(FLAGS_id_field);
+  auto status = ParseAnalyses(absl::GetFlag(FLAGS_analyses), &options.analyses);
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  options.threads = absl::GetFlag(FLAGS_threads);
+  if (options.threads <= 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  options.batch_size = std::max(1, absl::GetFlag(FLAGS_batch_size));
+  if (absl::GetFlag(FLAGS_query_timeout_ms) > 0) {
+    options.query_timeout = absl::Milliseconds(absl::GetFlag(FLAGS_query_timeout_ms));
+  }
+  options.progress_interval = absl::Seconds(std::max(1, absl::GetFlag(FLAGS_progress_seconds)));
+
+  std::unique_ptr<MappedFile> input;
+  status = MappedFile::Open(input_path, &input);
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+
+  std::ofstream file;
+  auto output_path = absl::GetFlag(FLAGS_output);
+  if (output_path != "-") {
+    file.open(output_path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      std::cerr << "Unable to open " << output_path << std::endl;
+      return 1;
+    }
+  } else {
+    std::ios::sync_with_stdio(false);
+  }
+  std::ostream& output = output_path == "-" ? std::cout : file;
+
+  PipelineStats stats;
+  status = RunPipeline(input->data(), options, output, &std::cerr, &stats);
+  if (!status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  return 0;
+}
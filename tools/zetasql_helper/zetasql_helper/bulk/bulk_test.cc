@@ -0,0 +1,252 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <atomic>
+#include <sstream>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "gtest/gtest.h"
+#include "zetasql_helper/bulk/analyses.h"
+#include "zetasql_helper/bulk/pipeline.h"
+#include "zetasql_helper/bulk/record_reader.h"
+#include "zetasql_helper/bulk/work_stealing_pool.h"
+
+using namespace bigquery::utils::zetasql_helper::bulk;
+
+class BulkTest : public ::testing::Test {
+
+};
+
+namespace {
+
+// Return the value of a member of a JSON line written by AnalyzeQuery, as written.
+std::string Member(absl::string_view json, absl::string_view name) {
+  auto key = absl::StrCat("\"", name, "\":");
+  auto start = json.find(key);
+  if (start == absl::string_view::npos) {
+    return "";
+  }
+  start += key.size();
+  auto end = start;
+  int depth = 0;
+  bool quoted = false;
+  for (; end < json.size(); end++) {
+    auto c = json[end];
+    if (quoted) {
+      if (c == '\\') {
+        end++;
+      } else if (c == '"') {
+        quoted = false;
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == '[' || c == '{') {
+      depth++;
+    } else if (c == ']' || c == '}') {
+      if (depth-- == 0) {
+        break;
+      }
+    } else if (c == ',' && depth == 0) {
+      break;
+    }
+  }
+  return std::string(json.substr(start, end - start));
+}
+
+}
+
+TEST_F(BulkTest, ReadJsonLines) {
+  std::string input = "{\"id\": 7, \"meta\": {\"a\": [1, \"}\"]}, \"query\": \"select\\n\\\"\\u00e9\\ud83d\\ude00\\\"\"}\n"
+                      "\n"
+                      "{\"query\": \"select 2\", \"id\": \"q2\"}\r\n"
+                      "[1]\n";
+  RecordReaderOptions options;
+  options.id_field = "id";
+  std::unique_ptr<RecordReader> reader;
+  ASSERT_TRUE(RecordReader::Create(input, options, &reader).ok());
+
+  RawRecord record;
+  std::string query, id;
+  ASSERT_TRUE(reader->Next(&record));
+  EXPECT_EQ(0, record.index);
+  EXPECT_EQ(1, record.line);
+  ASSERT_TRUE(reader->Decode(record.text, &query, &id).ok());
+  EXPECT_EQ("select\n\"\xc3\xa9\xf0\x9f\x98\x80\"", query);
+  EXPECT_EQ("7", id);
+
+  ASSERT_TRUE(reader->Next(&record));
+  EXPECT_EQ(1, record.index);
+  EXPECT_EQ(3, record.line);
+  ASSERT_TRUE(reader->Decode(record.text, &query, &id).ok());
+  EXPECT_EQ("select 2", query);
+  EXPECT_EQ("q2", id);
+
+  ASSERT_TRUE(reader->Next(&record));
+  EXPECT_FALSE(reader->Decode(record.text, &query, &id).ok());
+  EXPECT_FALSE(reader->Next(&record));
+  EXPECT_EQ(input.size(), reader->position());
+}
+
+TEST_F(BulkTest, ReadJsonLinesRejectsMalformedRecords) {
+  RecordReaderOptions options;
+  std::unique_ptr<RecordReader> reader;
+  ASSERT_TRUE(RecordReader::Create("", options, &reader).ok());
+  std::string query, id;
+
+  EXPECT_FALSE(reader->Decode("{\"query\": \"select 1}", &query, &id).ok());
+  EXPECT_FALSE(reader->Decode("{\"query\": 1}", &query, &id).ok());
+  EXPECT_FALSE(reader->Decode("{\"other\": \"select 1\"}", &query, &id).ok());
+  EXPECT_FALSE(reader->Decode("{\"query\": \"\\x\"}", &query, &id).ok());
+  EXPECT_TRUE(reader->Decode("{ \"query\" : \"select 1\" }", &query, &id).ok());
+}
+
+TEST_F(BulkTest, ReadCsv) {
+  std::string input = "id,query\n"
+                      "1,select 1\n"
+                      "2,\"select \"\"a\"\",\n  b\"\n"
+                      "3\n";
+  RecordReaderOptions options;
+  options.format = InputFormat::kCsv;
+  options.id_field = "id";
+  std::unique_ptr<RecordReader> reader;
+  ASSERT_TRUE(RecordReader::Create(input, options, &reader).ok());
+
+  RawRecord record;
+  std::string query, id;
+  ASSERT_TRUE(reader->Next(&record));
+  EXPECT_EQ(2, record.line);
+  ASSERT_TRUE(reader->Decode(record.text, &query, &id).ok());
+  EXPECT_EQ("select 1", query);
+  EXPECT_EQ("1", id);
+
+  ASSERT_TRUE(reader->Next(&record));
+  EXPECT_EQ(3, record.line);
+  ASSERT_TRUE(reader->Decode(record.text, &query, &id).ok());
+  EXPECT_EQ("select \"a\",\n  b", query);
+  EXPECT_EQ("2", id);
+
+  ASSERT_TRUE(reader->Next(&record));
+  EXPECT_EQ(5, record.line);
+  EXPECT_FALSE(reader->Decode(record.text, &query, &id).ok());
+  EXPECT_FALSE(reader->Next(&record));
+}
+
+TEST_F(BulkTest, ReadCsvNeedsTheQueryColumn) {
+  RecordReaderOptions options;
+  options.format = InputFormat::kCsv;
+  std::unique_ptr<RecordReader> reader;
+
+  EXPECT_FALSE(RecordReader::Create("id,sql\n1,select 1\n", options, &reader).ok());
+}
+
+TEST_F(BulkTest, AppendJsonString) {
+  std::string json;
+  AppendJsonString("a\"b\\c\nd\x01", &json);
+
+  EXPECT_EQ("\"a\\\"b\\\\c\\nd\\u0001\"", json);
+}
+
+TEST_F(BulkTest, WorkStealingPoolRunsEveryTask) {
+  std::atomic<int> count{0};
+  {
+    WorkStealingPool pool(4);
+    for (int i = 0; i < 100; i++) {
+      pool.Schedule([&pool, &count]() {
+        count++;
+        // A task scheduled by a worker goes to its own queue, and may be stolen.
+        pool.Schedule([&count]() { count++; });
+      });
+    }
+  }
+
+  EXPECT_EQ(200, count.load());
+}
+
+TEST_F(BulkTest, ParseAnalyses) {
+  uint32_t analyses;
+  ASSERT_TRUE(ParseAnalyses("tables, fingerprint", &analyses).ok());
+  EXPECT_EQ(kTables | kFingerprint, analyses);
+  ASSERT_TRUE(ParseAnalyses("all", &analyses).ok());
+  EXPECT_EQ(kAllAnalyses, analyses);
+  EXPECT_FALSE(ParseAnalyses("tables,ast", &analyses).ok());
+  EXPECT_FALSE(ParseAnalyses("", &analyses).ok());
+}
+
+TEST_F(BulkTest, AnalyzeQuery) {
+  std::string json;
+  AnalyzeQuery("SELECT a, a FROM d.t JOIN (SELECT a FROM `p.d.u`) USING (a) WHERE b = 1", kAllAnalyses,
+               nullptr, &json);
+
+  EXPECT_EQ("20", Member(json, "token_count"));
+  EXPECT_EQ(18, Member(json, "fingerprint").size());
+  EXPECT_EQ("[\"d.t\",\"p.d.u\"]", Member(json, "tables"));
+  EXPECT_EQ("2", Member(json, "selects"));
+  EXPECT_EQ("1", Member(json, "joins"));
+  EXPECT_EQ("1", Member(json, "subqueries"));
+  EXPECT_EQ("[\"duplicate_columns:a\"]", Member(json, "fixes"));
+  EXPECT_TRUE(absl::StrContains(Member(json, "fixed_query"), "a AS a_2")) << json;
+}
+
+TEST_F(BulkTest, NormalizedFingerprintIgnoresConstants) {
+  std::string first, second, other;
+  AnalyzeQuery("select x from t where y = 1 -- comment", kFingerprint, nullptr, &first);
+  AnalyzeQuery("SELECT x\nFROM t\nWHERE y = 'two'", kFingerprint, nullptr, &second);
+  AnalyzeQuery("SELECT x FROM t WHERE z = 1", kFingerprint, nullptr, &other);
+
+  EXPECT_NE(Member(first, "fingerprint"), Member(second, "fingerprint"));
+  EXPECT_EQ(Member(first, "normalized_fingerprint"), Member(second, "normalized_fingerprint"));
+  EXPECT_NE(Member(first, "normalized_fingerprint"), Member(other, "normalized_fingerprint"));
+}
+
+TEST_F(BulkTest, AnalyzeQueryReportsParseErrors) {
+  std::string json;
+  AnalyzeQuery("SELECT FROM", kTokens | kTables, nullptr, &json);
+
+  EXPECT_EQ("2", Member(json, "token_count"));
+  EXPECT_FALSE(Member(json, "parse_error").empty());
+  EXPECT_EQ("", Member(json, "tables"));
+}
+
+TEST_F(BulkTest, RunPipelineKeepsTheInputOrder) {
+  std::string input;
+  for (int i = 0; i < 1000; i++) {
+    absl::StrAppend(&input, i == 500 ? "not json" : absl::StrCat("{\"query\":\"SELECT * FROM t", i, "\"}"), "\n");
+  }
+  PipelineOptions options;
+  options.analyses = kTables;
+  options.threads = 4;
+  options.batch_size = 7;
+  std::ostringstream output;
+  PipelineStats stats;
+
+  ASSERT_TRUE(RunPipeline(input, options, output, nullptr, &stats).ok());
+
+  EXPECT_EQ(1000, stats.records);
+  EXPECT_EQ(1, stats.errors);
+  std::vector<std::string> lines = absl::StrSplit(output.str(), '\n', absl::SkipEmpty());
+  ASSERT_EQ(1000, lines.size());
+  for (int i = 0; i < lines.size(); i++) {
+    EXPECT_EQ(std::to_string(i), Member(lines[i], "record"));
+    EXPECT_EQ(std::to_string(i + 1), Member(lines[i], "line"));
+    if (i != 500) {
+      EXPECT_EQ(absl::StrCat("[\"t", i, "\"]"), Member(lines[i], "tables"));
+    }
+  }
+  EXPECT_EQ("\"the record is not a JSON object\"", Member(lines[500], "error"));
+}
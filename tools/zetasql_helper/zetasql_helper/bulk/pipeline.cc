@@ -0,0 +1,167 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/bulk/pipeline.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "zetasql_helper/bulk/work_stealing_pool.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+namespace {
+
+struct Batch {
+  std::vector<RawRecord> records;
+  // The JSON lines of the records.
+  std::string output;
+  int64_t errors = 0;
+  int64_t bytes = 0;
+  // Set by the worker once `output` is complete. Guarded by the mutex of the pipeline.
+  bool done = false;
+};
+
+void AnalyzeBatch(const RecordReader& reader, const PipelineOptions& options, Batch* batch) {
+  std::string query;
+  std::string id;
+  for (const auto& record : batch->records) {
+    batch->bytes += record.text.size();
+    absl::StrAppend(&batch->output, "{\"record\":", record.index, ",\"line\":", record.line);
+    auto status = reader.Decode(record.text, &query, &id);
+    if (!status.ok()) {
+      batch->errors++;
+      batch->output.append(",\"error\":");
+      AppendJsonString(status.message(), &batch->output);
+    } else {
+      if (!id.empty()) {
+        batch->output.append(",\"id\":");
+        AppendJsonString(id, &batch->output);
+      }
+      if (options.query_timeout == absl::InfiniteDuration()) {
+        AnalyzeQuery(query, options.analyses, nullptr, &batch->output);
+      } else {
+        CancellationToken cancellation(nullptr, absl::Now() + options.query_timeout);
+        AnalyzeQuery(query, options.analyses, &cancellation, &batch->output);
+      }
+    }
+    batch->output.append("}\n");
+  }
+}
+
+void ReportProgress(const PipelineStats& stats, std::ostream& progress) {
+  auto seconds = std::max(absl::ToDoubleSeconds(stats.elapsed), 1e-9);
+  progress << absl::StrFormat("%d records (%.0f/s), %.1f MB (%.1f MB/s), %d errors in %s", stats.records,
+                              stats.records / seconds, stats.bytes / 1e6, stats.bytes / 1e6 / seconds, stats.errors,
+                              absl::FormatDuration(absl::Trunc(stats.elapsed, absl::Milliseconds(1))))
+           << std::endl;
+}
+
+}
+
+absl::Status RunPipeline(absl::string_view input, const PipelineOptions& options, std::ostream& output,
+                         std::ostream* progress, PipelineStats* stats) {
+  std::unique_ptr<RecordReader> reader;
+  auto status = RecordReader::Create(input, options.reader, &reader);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto start = absl::Now();
+  auto next_report = start + options.progress_interval;
+  *stats = PipelineStats();
+
+  // The pool is declared last, so that its destructor waits for the tasks before the state they
+  // use is destroyed.
+  absl::Mutex mutex;
+  absl::CondVar done_cv;
+  // The batches being analyzed or waiting to be written, in the order of the input. Only used by
+  // this thread.
+  std::deque<std::unique_ptr<Batch>> batches;
+  WorkStealingPool pool(options.threads);
+  auto max_batches = std::max(1, options.max_batches_per_thread * pool.size());
+
+  // Wait for the oldest batch and write it.
+  auto write_oldest = [&]() {
+    auto* batch = batches.front().get();
+    while (true) {
+      bool done;
+      {
+        absl::MutexLock lock(&mutex);
+        if (!batch->done) {
+          done_cv.WaitWithTimeout(&mutex, absl::Seconds(1));
+        }
+        done = batch->done;
+      }
+      if (progress != nullptr && absl::Now() >= next_report) {
+        stats->elapsed = absl::Now() - start;
+        ReportProgress(*stats, *progress);
+        next_report = absl::Now() + options.progress_interval;
+      }
+      if (done) {
+        break;
+      }
+    }
+    output.write(batch->output.data(), batch->output.size());
+    stats->records += batch->records.size();
+    stats->errors += batch->errors;
+    stats->bytes += batch->bytes;
+    batches.pop_front();
+  };
+
+  while (true) {
+    auto batch = std::make_unique<Batch>();
+    RawRecord record;
+    while (batch->records.size() < options.batch_size && reader->Next(&record)) {
+      batch->records.push_back(record);
+    }
+    if (batch->records.empty()) {
+      break;
+    }
+    auto* scheduled = batch.get();
+    batches.push_back(std::move(batch));
+    pool.Schedule([&, scheduled]() {
+      AnalyzeBatch(*reader, options, scheduled);
+      absl::MutexLock lock(&mutex);
+      scheduled->done = true;
+      done_cv.SignalAll();
+    });
+    while (batches.size() >= max_batches) {
+      write_oldest();
+    }
+  }
+  while (!batches.empty()) {
+    write_oldest();
+  }
+  output.flush();
+
+  stats->elapsed = absl::Now() - start;
+  if (progress != nullptr) {
+    ReportProgress(*stats, *progress);
+  }
+  if (!output) {
+    return absl::Status(absl::StatusCode::kInternal, "unable to write the output");
+  }
+  return absl::OkStatus();
+}
+
+}  // bigquery::utils::zetasql_helper::bulk
@@ -0,0 +1,69 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_BULK_PIPELINE_H_
+#define ZETASQL_HELPER_BULK_PIPELINE_H_
+
+#include <cstdint>
+#include <ostream>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "zetasql_helper/bulk/analyses.h"
+#include "zetasql_helper/bulk/record_reader.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+struct PipelineOptions {
+  RecordReaderOptions reader;
+  // The Analysis flags.
+  uint32_t analyses = kAllAnalyses;
+  int threads = 1;
+  // Number of records analyzed by one task.
+  int batch_size = 256;
+  // Number of batches per thread which may be analyzed or waiting to be written at once. Bounds
+  // the memory used when a batch is much slower than the following ones.
+  int max_batches_per_thread = 4;
+  // Time allowed to the analyses of one query.
+  absl::Duration query_timeout = absl::InfiniteDuration();
+  absl::Duration progress_interval = absl::Seconds(10);
+};
+
+struct PipelineStats {
+  int64_t records = 0;
+  // Records which could not be decoded.
+  int64_t errors = 0;
+  // Bytes of the records.
+  int64_t bytes = 0;
+  absl::Duration elapsed;
+};
+
+// Analyze the records of `input` on a WorkStealingPool, and write one JSON line per record to
+// `output`, in the order of the input:
+//
+//   {"record":0,"line":1,"id":"q1","token_count":12,...}
+//   {"record":1,"line":2,"error":"malformed JSON at byte 17"}
+//
+// The "id" is only present if the id field of the record is set. If `progress` is not null, the
+// number of records analyzed and the throughput are written to it every progress_interval.
+absl::Status RunPipeline(absl::string_view input, const PipelineOptions& options, std::ostream& output,
+                         std::ostream* progress, PipelineStats* stats);
+
+}  // bigquery::utils::zetasql_helper::bulk
+
+#endif  // ZETASQL_HELPER_BULK_PIPELINE_H_
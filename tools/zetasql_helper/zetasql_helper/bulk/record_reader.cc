@@ -0,0 +1,507 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/bulk/record_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+namespace {
+
+absl::Status ErrnoStatus(absl::string_view action, const std::string& path) {
+  return absl::Status(absl::StatusCode::kInternal,
+                      absl::StrCat("unable to ", action, " ", path, ": ", std::strerror(errno)));
+}
+
+void AppendUtf8(uint32_t code_point, std::string* output) {
+  if (code_point < 0x80) {
+    output->push_back(code_point);
+  } else if (code_point < 0x800) {
+    output->push_back(0xc0 | (code_point >> 6));
+    output->push_back(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    output->push_back(0xe0 | (code_point >> 12));
+    output->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    output->push_back(0x80 | (code_point & 0x3f));
+  } else {
+    output->push_back(0xf0 | (code_point >> 18));
+    output->push_back(0x80 | ((code_point >> 12) & 0x3f));
+    output->push_back(0x80 | ((code_point >> 6) & 0x3f));
+    output->push_back(0x80 | (code_point & 0x3f));
+  }
+}
+
+// Reads the members of a JSON object. Only the strings are decoded, the other values are skipped
+// or returned as they are written.
+class JsonCursor {
+ public:
+  explicit JsonCursor(absl::string_view text) : text_(text) {}
+
+  bool ok() const { return ok_; }
+  size_t offset() const { return offset_; }
+
+  void SkipWhitespace() {
+    while (offset_ < text_.size() && absl::ascii_isspace(text_[offset_])) {
+      offset_++;
+    }
+  }
+
+  // Consume `c` after optional whitespace.
+  bool Consume(char c) {
+    SkipWhitespace();
+    if (offset_ < text_.size() && text_[offset_] == c) {
+      offset_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool Peek(char c) {
+    SkipWhitespace();
+    return offset_ < text_.size() && text_[offset_] == c;
+  }
+
+  // Read a string, and decode it into `value` unless it is null.
+  bool ReadString(std::string* value) {
+    if (!Consume('"')) {
+      return Fail();
+    }
+    while (offset_ < text_.size()) {
+      // Copy the unescaped characters in one go.
+      auto end = offset_;
+      while (end < text_.size() && text_[end] != '"' && text_[end] != '\\') {
+        end++;
+      }
+      if (value != nullptr) {
+        value->append(text_.data() + offset_, end - offset_);
+      }
+      offset_ = end;
+      if (offset_ == text_.size()) {
+        break;
+      }
+      if (text_[offset_++] == '"') {
+        return true;
+      }
+      if (offset_ == text_.size() || !ReadEscape(value)) {
+        return Fail();
+      }
+    }
+    return Fail();
+  }
+
+  // Skip a value, and return its text.
+  bool SkipValue(absl::string_view* raw) {
+    SkipWhitespace();
+    auto start = offset_;
+    if (Peek('"')) {
+      if (!ReadString(nullptr)) {
+        return false;
+      }
+    } else if (Peek('{') || Peek('[')) {
+      // Count the brackets, skipping over the strings which may contain some.
+      int depth = 0;
+      do {
+        SkipWhitespace();
+        if (offset_ == text_.size()) {
+          return Fail();
+        }
+        auto c = text_[offset_];
+        if (c == '"') {
+          if (!ReadString(nullptr)) {
+            return false;
+          }
+          continue;
+        }
+        if (c == '{' || c == '[') {
+          depth++;
+        } else if (c == '}' || c == ']') {
+          depth--;
+        }
+        offset_++;
+      } while (depth > 0);
+    } else {
+      // A number, true, false or null.
+      while (offset_ < text_.size() && text_[offset_] != ',' && text_[offset_] != '}' &&
+          !absl::ascii_isspace(text_[offset_])) {
+        offset_++;
+      }
+      if (offset_ == start) {
+        return Fail();
+      }
+    }
+    *raw = text_.substr(start, offset_ - start);
+    return true;
+  }
+
+ private:
+  bool Fail() {
+    ok_ = false;
+    return false;
+  }
+
+  bool ReadHex4(uint32_t* value) {
+    if (offset_ + 4 > text_.size()) {
+      return false;
+    }
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+      auto c = text_[offset_++];
+      *value <<= 4;
+      if (c >= '0' && c <= '9') {
+        *value |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        *value |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        *value |= c - 'A' + 10;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Read the escape sequence after a backslash.
+  bool ReadEscape(std::string* value) {
+    auto c = text_[offset_++];
+    char decoded;
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        decoded = c;
+        break;
+      case 'b':
+        decoded = '\b';
+        break;
+      case 'f':
+        decoded = '\f';
+        break;
+      case 'n':
+        decoded = '\n';
+        break;
+      case 'r':
+        decoded = '\r';
+        break;
+      case 't':
+        decoded = '\t';
+        break;
+      case 'u': {
+        uint32_t code_point;
+        if (!ReadHex4(&code_point)) {
+          return false;
+        }
+        // A character outside of the basic plane is written as a surrogate pair.
+        if (code_point >= 0xd800 && code_point < 0xdc00 && text_.substr(offset_, 2) == "\\u") {
+          offset_ += 2;
+          uint32_t low;
+          if (!ReadHex4(&low) || low < 0xdc00 || low >= 0xe000) {
+            return false;
+          }
+          code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        }
+        if (value != nullptr) {
+          AppendUtf8(code_point, value);
+        }
+        return true;
+      }
+      default:
+        return false;
+    }
+    if (value != nullptr) {
+      value->push_back(decoded);
+    }
+    return true;
+  }
+
+  absl::string_view text_;
+  size_t offset_ = 0;
+  bool ok_ = true;
+};
+
+// Split a CSV record into its fields, removing the quotes.
+bool SplitCsv(absl::string_view text, std::vector<std::string>* fields) {
+  fields->clear();
+  size_t offset = 0;
+  while (true) {
+    std::string field;
+    if (offset < text.size() && text[offset] == '"') {
+      offset++;
+      while (true) {
+        auto quote = text.find('"', offset);
+        if (quote == absl::string_view::npos) {
+          return false;
+        }
+        field.append(text.data() + offset, quote - offset);
+        offset = quote + 1;
+        // A doubled quote is a quote inside the field.
+        if (offset < text.size() && text[offset] == '"') {
+          field.push_back('"');
+          offset++;
+          continue;
+        }
+        break;
+      }
+      if (offset < text.size() && text[offset] != ',') {
+        return false;
+      }
+    } else {
+      auto comma = text.find(',', offset);
+      if (comma == absl::string_view::npos) {
+        comma = text.size();
+      }
+      field.assign(text.data() + offset, comma - offset);
+      offset = comma;
+    }
+    fields->push_back(std::move(field));
+    if (offset >= text.size()) {
+      return true;
+    }
+    // Skip the comma.
+    offset++;
+  }
+}
+
+}
+
+absl::Status MappedFile::Open(const std::string& path, std::unique_ptr<MappedFile>* file) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ErrnoStatus("open", path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    auto error = ErrnoStatus("stat", path);
+    close(fd);
+    return error;
+  }
+  const char* data = nullptr;
+  if (file_stat.st_size > 0) {
+    auto* map = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      auto error = ErrnoStatus("map", path);
+      close(fd);
+      return error;
+    }
+    // The file is read once from the start to the end.
+    madvise(map, file_stat.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(map);
+  }
+  // The mapping stays valid after the file is closed.
+  close(fd);
+  file->reset(new MappedFile(data, file_stat.st_size));
+  return absl::OkStatus();
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+RecordReader::RecordReader(absl::string_view data, RecordReaderOptions options)
+    : data_(data), options_(std::move(options)) {}
+
+absl::Status RecordReader::Create(absl::string_view data, RecordReaderOptions options,
+                                  std::unique_ptr<RecordReader>* reader) {
+  std::unique_ptr<RecordReader> result(new RecordReader(data, std::move(options)));
+  if (result->options_.format == InputFormat::kCsv) {
+    absl::string_view header;
+    int64_t line;
+    std::vector<std::string> columns;
+    if (!result->NextText(&header, &line) || !SplitCsv(header, &columns)) {
+      return absl::Status(absl::StatusCode::kInvalidArgument, "the CSV input has no header");
+    }
+    for (int i = 0; i < columns.size(); i++) {
+      if (columns[i] == result->options_.query_field) {
+        result->query_column_ = i;
+      } else if (!result->options_.id_field.empty() && columns[i] == result->options_.id_field) {
+        result->id_column_ = i;
+      }
+    }
+    if (result->query_column_ < 0) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("the CSV header has no ", result->options_.query_field, " column"));
+    }
+  }
+  *reader = std::move(result);
+  return absl::OkStatus();
+}
+
+bool RecordReader::NextText(absl::string_view* text, int64_t* line) {
+  while (position_ < data_.size()) {
+    auto start = position_;
+    *line = line_;
+    auto end = start;
+    if (options_.format == InputFormat::kJsonLines) {
+      // A JSON string cannot hold a raw line break.
+      end = data_.find('\n', start);
+      if (end == absl::string_view::npos) {
+        end = data_.size();
+      }
+      line_++;
+    } else {
+      // A line break inside quotes belongs to the field.
+      bool quoted = false;
+      for (; end < data_.size(); end++) {
+        auto c = data_[end];
+        if (c == '"') {
+          quoted = !quoted;
+        } else if (c == '\n') {
+          line_++;
+          if (!quoted) {
+            break;
+          }
+        }
+      }
+      if (end == data_.size()) {
+        line_++;
+      }
+    }
+    position_ = std::min<int64_t>(end + 1, data_.size());
+
+    auto record = data_.substr(start, end - start);
+    if (!record.empty() && record.back() == '\r') {
+      record.remove_suffix(1);
+    }
+    if (!absl::StripAsciiWhitespace(record).empty()) {
+      *text = record;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RecordReader::Next(RawRecord* record) {
+  if (!NextText(&record->text, &record->line)) {
+    return false;
+  }
+  record->index = next_index_++;
+  return true;
+}
+
+absl::Status RecordReader::Decode(absl::string_view text, std::string* query, std::string* id) const {
+  query->clear();
+  id->clear();
+  if (options_.format == InputFormat::kJsonLines) {
+    return DecodeJson(text, query, id);
+  }
+  return DecodeCsv(text, query, id);
+}
+
+absl::Status RecordReader::DecodeJson(absl::string_view text, std::string* query, std::string* id) const {
+  JsonCursor cursor(text);
+  bool has_query = false;
+  if (!cursor.Consume('{')) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "the record is not a JSON object");
+  }
+  if (!cursor.Consume('}')) {
+    do {
+      std::string key;
+      if (!cursor.ReadString(&key) || !cursor.Consume(':')) {
+        break;
+      }
+      if (key == options_.query_field && cursor.Peek('"')) {
+        query->clear();
+        cursor.ReadString(query);
+        has_query = true;
+      } else if (!options_.id_field.empty() && key == options_.id_field && cursor.Peek('"')) {
+        id->clear();
+        cursor.ReadString(id);
+      } else {
+        absl::string_view raw;
+        if (cursor.SkipValue(&raw) && !options_.id_field.empty() && key == options_.id_field) {
+          id->assign(raw.data(), raw.size());
+        }
+      }
+    } while (cursor.ok() && cursor.Consume(','));
+    if (cursor.ok() && !cursor.Consume('}')) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("malformed JSON at byte ", cursor.offset()));
+    }
+  }
+  if (!cursor.ok()) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        absl::StrCat("malformed JSON at byte ", cursor.offset()));
+  }
+  if (!has_query) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        absl::StrCat("the record has no string ", options_.query_field, " field"));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status RecordReader::DecodeCsv(absl::string_view text, std::string* query, std::string* id) const {
+  std::vector<std::string> fields;
+  if (!SplitCsv(text, &fields)) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "malformed CSV record");
+  }
+  if (query_column_ >= fields.size()) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        absl::StrCat("the record has no ", options_.query_field, " column"));
+  }
+  *query = std::move(fields[query_column_]);
+  if (id_column_ >= 0 && id_column_ < fields.size()) {
+    *id = std::move(fields[id_column_]);
+  }
+  return absl::OkStatus();
+}
+
+void AppendJsonString(absl::string_view value, std::string* json) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  json->push_back('"');
+  for (unsigned char c : value) {
+    switch (c) {
+      case '"':
+        json->append("\\\"");
+        break;
+      case '\\':
+        json->append("\\\\");
+        break;
+      case '\n':
+        json->append("\\n");
+        break;
+      case '\r':
+        json->append("\\r");
+        break;
+      case '\t':
+        json->append("\\t");
+        break;
+      default:
+        if (c < 0x20) {
+          json->append("\\u00");
+          json->push_back(kHex[c >> 4]);
+          json->push_back(kHex[c & 0xf]);
+        } else {
+          json->push_back(c);
+        }
+    }
+  }
+  json->push_back('"');
+}
+
+}  // bigquery::utils::zetasql_helper::bulk
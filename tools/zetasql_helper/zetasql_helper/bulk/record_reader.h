@@ -0,0 +1,113 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_BULK_RECORD_READER_H_
+#define ZETASQL_HELPER_BULK_RECORD_READER_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+// A read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  static absl::Status Open(const std::string& path, std::unique_ptr<MappedFile>* file);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  absl::string_view data() const { return absl::string_view(data_, size_); }
+
+ private:
+  MappedFile(const char* data, size_t size) : data_(data), size_(size) {}
+
+  const char* data_;
+  size_t size_;
+};
+
+enum class InputFormat {
+  // One JSON object per line.
+  kJsonLines,
+  // RFC 4180 CSV with a header line. Quoted fields may span several lines.
+  kCsv,
+};
+
+struct RecordReaderOptions {
+  InputFormat format = InputFormat::kJsonLines;
+  // The JSON field or the CSV column holding the query.
+  std::string query_field = "query";
+  // The JSON field or the CSV column identifying the record, copied to the output. Optional.
+  std::string id_field;
+};
+
+// A record of the input, not decoded yet.
+struct RawRecord {
+  // 0-based index of the record. Blank lines and the CSV header are not records.
+  int64_t index = 0;
+  // 1-based line where the record starts.
+  int64_t line = 0;
+  absl::string_view text;
+};
+
+// Splits an input into records, and extracts the query and the id of a record. Splitting only
+// looks for the line breaks, so that one thread can split the input while the workers decode and
+// analyze the records.
+class RecordReader {
+ public:
+  // `data` must outlive the reader. The header of a CSV input is read here.
+  static absl::Status Create(absl::string_view data, RecordReaderOptions options,
+                             std::unique_ptr<RecordReader>* reader);
+
+  // Read the next record. Return false at the end of the input. Not thread-safe.
+  bool Next(RawRecord* record);
+
+  // The bytes of the input read so far.
+  int64_t position() const { return position_; }
+
+  // Extract the query and the id (if `id_field` is set) of a record. Thread-safe.
+  absl::Status Decode(absl::string_view text, std::string* query, std::string* id) const;
+
+ private:
+  RecordReader(absl::string_view data, RecordReaderOptions options);
+
+  // Read the text of the next record without counting it.
+  bool NextText(absl::string_view* text, int64_t* line);
+
+  absl::Status DecodeJson(absl::string_view text, std::string* query, std::string* id) const;
+  absl::Status DecodeCsv(absl::string_view text, std::string* query, std::string* id) const;
+
+  absl::string_view data_;
+  RecordReaderOptions options_;
+  int64_t position_ = 0;
+  int64_t line_ = 1;
+  int64_t next_index_ = 0;
+  // The columns of the query and of the id in a CSV input. -1 if absent.
+  int query_column_ = -1;
+  int id_column_ = -1;
+};
+
+// Append `value` to `json` as a JSON string, with its quotes.
+void AppendJsonString(absl::string_view value, std::string* json);
+
+}  // bigquery::utils::zetasql_helper::bulk
+
+#endif  // ZETASQL_HELPER_BULK_RECORD_READER_H_
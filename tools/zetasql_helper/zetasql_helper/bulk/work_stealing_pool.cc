@@ -0,0 +1,117 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/bulk/work_stealing_pool.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+namespace {
+
+// The pool and the index of the worker running on the current thread.
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local int current_worker = -1;
+
+}
+
+WorkStealingPool::WorkStealingPool(int threads) {
+  if (threads < 1) {
+    threads = 1;
+  }
+  for (int i = 0; i < threads; i++) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (int i = 0; i < threads; i++) {
+    threads_.emplace_back([this, i] { Work(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopping_ = true;
+    work_cv_.SignalAll();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkStealingPool::Schedule(std::function<void()> task) {
+  int queue = current_pool == this ? current_worker : next_queue_.fetch_add(1) % queues_.size();
+  {
+    absl::MutexLock lock(&queues_[queue]->mutex);
+    queues_[queue]->tasks.push_back(std::move(task));
+  }
+  // The task is queued before it is counted, so a worker which reserved it finds it.
+  pending_.fetch_add(1);
+  if (idle_.load() > 0) {
+    absl::MutexLock lock(&mutex_);
+    work_cv_.Signal();
+  }
+}
+
+bool WorkStealingPool::ReserveTask() {
+  auto pending = pending_.load(std::memory_order_relaxed);
+  while (pending > 0) {
+    if (pending_.compare_exchange_weak(pending, pending - 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkStealingPool::TakeTask(int worker, std::function<void()>* task) {
+  for (int i = 0; i < queues_.size(); i++) {
+    auto& queue = *queues_[(worker + i) % queues_.size()];
+    absl::MutexLock lock(&queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::Work(int worker) {
+  current_pool = this;
+  current_worker = worker;
+  while (true) {
+    if (!ReserveTask()) {
+      absl::MutexLock lock(&mutex_);
+      idle_.fetch_add(1);
+      while (pending_.load() == 0 && !stopping_) {
+        work_cv_.Wait(&mutex_);
+      }
+      idle_.fetch_sub(1);
+      if (pending_.load() == 0) {
+        // Stopping, and every task is done or taken.
+        return;
+      }
+      continue;
+    }
+    // The count reserved one of the queued tasks. Another worker may take the task this worker
+    // would have found, but then it leaves another one, so keep looking.
+    std::function<void()> task;
+    while (!TakeTask(worker, &task)) {
+      std::this_thread::yield();
+    }
+    task();
+  }
+}
+
+}  // bigquery::utils::zetasql_helper::bulk
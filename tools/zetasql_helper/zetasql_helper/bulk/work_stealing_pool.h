@@ -0,0 +1,85 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_BULK_WORK_STEALING_POOL_H_
+#define ZETASQL_HELPER_BULK_WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+
+namespace bigquery::utils::zetasql_helper::bulk {
+
+// A fixed set of threads running tasks. Every worker has its own queue, so that scheduling a
+// task only contends with the worker owning the queue, plus the idle workers when there are some
+// to wake up. A worker runs the tasks of its own queue
+// in order, and steals the oldest task of another queue once its own is empty, so a worker stuck
+// on an expensive query does not hold back the tasks queued behind it.
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(int threads);
+  // Wait for all the scheduled tasks to finish.
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  // Schedule a task. Tasks scheduled by a worker go to its own queue, the others are spread
+  // over the queues round-robin.
+  void Schedule(std::function<void()> task);
+
+  int size() const { return queues_.size(); }
+
+ private:
+  struct Queue {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(mutex);
+  };
+
+  void Work(int worker);
+
+  // Reserve one of the queued tasks, if there is one not reserved yet.
+  bool ReserveTask();
+
+  // Pop a task from the queue of `worker`, or steal one from another queue.
+  bool TakeTask(int worker, std::function<void()>* task);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::atomic<uint64_t> next_queue_{0};
+
+  // The number of queued tasks not reserved by a worker yet.
+  std::atomic<int64_t> pending_{0};
+
+  // The idle workers wait on work_cv_. A task is counted in pending_ before idle_ is read, and a
+  // worker is counted in idle_ before it reads pending_, so either the worker sees the task or
+  // Schedule sees the worker and wakes it up.
+  absl::Mutex mutex_;
+  absl::CondVar work_cv_;
+  std::atomic<int> idle_{0};
+  bool stopping_ ABSL_GUARDED_BY(mutex_) = false;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // bigquery::utils::zetasql_helper::bulk
+
+#endif  // ZETASQL_HELPER_BULK_WORK_STEALING_POOL_H_
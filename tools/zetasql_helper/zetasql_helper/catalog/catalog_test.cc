@@ -0,0 +1,109 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/catalog/schema_catalog.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+using namespace bigquery::utils::zetasql_helper;
+
+namespace {
+
+constexpr char kRequests[] = R"({"tables": [{
+  "name": "bigquery-public-data.austin_311.311_request",
+  "schema": {"fields": [
+    {"name": "unique_key", "type": "STRING", "mode": "REQUIRED", "description": "ignored"},
+    {"name": "status", "type": "STRING"},
+    {"name": "created_date", "type": "TIMESTAMP"},
+    {"name": "tags", "type": "STRING", "mode": "REPEATED"},
+    {"name": "location", "type": "RECORD", "fields": [
+      {"name": "latitude", "type": "FLOAT"},
+      {"name": "longitude", "type": "FLOAT"}
+    ]}
+  ]}
+}]})";
+
+// The names and types of the output columns of a query, or the error of the analyzer.
+std::string Analyze(const SchemaCatalog& catalog, absl::string_view query) {
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const zetasql::AnalyzerOutput> output;
+  auto status = AnalyzeBigQueryStatement(query, *catalog.Current(), &type_factory, &output);
+  if (!status.ok()) {
+    return std::string(status.message());
+  }
+  std::string columns;
+  auto query_stmt = output->resolved_statement()->GetAs<zetasql::ResolvedQueryStmt>();
+  for (const auto& column : query_stmt->output_column_list()) {
+    absl::StrAppend(&columns, columns.empty() ? "" : ", ", column->name(), " ",
+                    column->column().type()->TypeName(zetasql::PRODUCT_EXTERNAL));
+  }
+  return columns;
+}
+
+}
+
+class CatalogTest : public ::testing::Test {
+
+};
+
+TEST_F(CatalogTest, ResolveLoadedTables) {
+  SchemaCatalog catalog;
+  EXPECT_EQ(0, catalog.Current()->version());
+  std::shared_ptr<const SchemaCatalog::Snapshot> snapshot;
+  ASSERT_TRUE(catalog.Load(kRequests, false, &snapshot).ok());
+  EXPECT_EQ(1, snapshot->version());
+  EXPECT_EQ(1, snapshot->table_count());
+
+  EXPECT_EQ("status STRING, n INT64",
+            Analyze(catalog, "SELECT status, count(*) AS n FROM `bigquery-public-data.austin_311.311_request` "
+                             "GROUP BY status"));
+  EXPECT_EQ("latitude FLOAT64, tags ARRAY<STRING>",
+            Analyze(catalog, "SELECT location.latitude, tags "
+                             "FROM `bigquery-public-data`.austin_311.`311_request`"));
+}
+
+TEST_F(CatalogTest, ReportAnalyzerErrors) {
+  SchemaCatalog catalog;
+  ASSERT_TRUE(catalog.Load(kRequests, false).ok());
+  EXPECT_EQ("Unrecognized name: foo [at 1:8]",
+            Analyze(catalog, "SELECT foo FROM `bigquery-public-data.austin_311.311_request`"));
+  EXPECT_EQ(0, Analyze(catalog, "SELECT 1 FROM `bigquery-public-data.austin_311.unknown`").find("Table not found"));
+}
+
+TEST_F(CatalogTest, VersionsAreIndependent) {
+  SchemaCatalog catalog;
+  ASSERT_TRUE(catalog.Load(kRequests, false).ok());
+  auto first = catalog.Current();
+
+  ASSERT_TRUE(catalog.Load(R"({"tables": [{"name": "t", "schema": {"fields": [{"name": "x", "type": "INT64"}]}}]})",
+                           false).ok());
+  EXPECT_EQ(2, catalog.Current()->version());
+  EXPECT_EQ(2, catalog.Current()->table_count());
+  EXPECT_EQ("x INT64", Analyze(catalog, "SELECT x FROM t"));
+
+  ASSERT_TRUE(catalog.Load(R"({"tables": []})", true).ok());
+  EXPECT_EQ(0, catalog.Current()->table_count());
+  // The requests holding an older version still see its tables.
+  EXPECT_EQ(1, first->table_count());
+
+  // A failed load keeps the current version.
+  auto status = catalog.Load(R"({"tables": [{"name": "t", "schema": {"fields": [{"name": "x", "type": "UUID"}]}}]})",
+                             false);
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument, status.code());
+  EXPECT_EQ(3, catalog.Current()->version());
+}
@@ -0,0 +1,261 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/catalog/schema_catalog.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "google/protobuf/util/json_util.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+// The state shared by all the snapshots of all the catalogs.
+struct Builtins {
+  Builtins() : catalog("builtins", &type_factory) {
+    options = BigQueryOptions();
+    auto language = options.language();
+    language.EnableMaximumLanguageFeatures();
+    language.SetSupportsAllStatementKinds();
+    options.set_language_options(language);
+    // Keep the location of an error in its message, e.g. "Unrecognized name: foo [at 1:8]".
+    options.set_error_message_mode(zetasql::ERROR_MESSAGE_ONE_LINE);
+    catalog.AddZetaSQLFunctions(zetasql::ZetaSQLBuiltinFunctionOptions(language));
+  }
+
+  zetasql::TypeFactory type_factory;
+  zetasql::AnalyzerOptions options;
+  zetasql::SimpleCatalog catalog;
+};
+
+Builtins& GetBuiltins() {
+  static auto* builtins = new Builtins();
+  return *builtins;
+}
+
+// The scalar types of the BigQuery schemas, by upper case name.
+const absl::flat_hash_map<std::string, const zetasql::Type*>& ScalarTypes() {
+  static const auto* types = new absl::flat_hash_map<std::string, const zetasql::Type*>{
+      {"STRING", zetasql::types::StringType()},
+      {"BYTES", zetasql::types::BytesType()},
+      {"INT64", zetasql::types::Int64Type()},
+      {"INTEGER", zetasql::types::Int64Type()},
+      {"FLOAT64", zetasql::types::DoubleType()},
+      {"FLOAT", zetasql::types::DoubleType()},
+      {"NUMERIC", zetasql::types::NumericType()},
+      {"BOOL", zetasql::types::BoolType()},
+      {"BOOLEAN", zetasql::types::BoolType()},
+      {"TIMESTAMP", zetasql::types::TimestampType()},
+      {"DATE", zetasql::types::DateType()},
+      {"TIME", zetasql::types::TimeType()},
+      {"DATETIME", zetasql::types::DatetimeType()},
+      {"GEOGRAPHY", zetasql::types::GeographyType()},
+  };
+  return *types;
+}
+
+absl::Status InvalidField(const TableFieldSchemaProto& field, absl::string_view problem) {
+  return absl::Status(absl::StatusCode::kInvalidArgument,
+                      absl::StrCat("Column \"", field.name(), "\" ", problem, "."));
+}
+
+absl::Status MakeType(const TableFieldSchemaProto& field, zetasql::TypeFactory* type_factory,
+                      const zetasql::Type** type) {
+  if (field.name().empty()) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "A column has no name.");
+  }
+  auto type_name = absl::AsciiStrToUpper(field.type());
+  if (type_name == "RECORD" || type_name == "STRUCT") {
+    if (field.fields().empty()) {
+      return InvalidField(field, "has no fields");
+    }
+    std::vector<zetasql::StructType::StructField> fields;
+    for (const auto& sub_field : field.fields()) {
+      const zetasql::Type* sub_type;
+      ZETASQL_RETURN_IF_ERROR(MakeType(sub_field, type_factory, &sub_type));
+      fields.emplace_back(sub_field.name(), sub_type);
+    }
+    const zetasql::StructType* struct_type;
+    ZETASQL_RETURN_IF_ERROR(type_factory->MakeStructType(fields, &struct_type));
+    *type = struct_type;
+  } else {
+    auto it = ScalarTypes().find(type_name);
+    if (it == ScalarTypes().end()) {
+      return InvalidField(field, absl::StrCat("has an unsupported type \"", field.type(), "\""));
+    }
+    *type = it->second;
+  }
+
+  auto mode = absl::AsciiStrToUpper(field.mode());
+  if (mode == "REPEATED") {
+    const zetasql::ArrayType* array_type;
+    ZETASQL_RETURN_IF_ERROR(type_factory->MakeArrayType(*type, &array_type));
+    *type = array_type;
+  } else if (!mode.empty() && mode != "NULLABLE" && mode != "REQUIRED") {
+    return InvalidField(field, absl::StrCat("has an unknown mode \"", field.mode(), "\""));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status MakeTable(const TableDefinitionProto& definition, absl::string_view name,
+                       zetasql::TypeFactory* type_factory, std::unique_ptr<zetasql::SimpleTable>* table) {
+  std::vector<zetasql::SimpleTable::NameAndType> columns;
+  absl::flat_hash_set<std::string> column_names;
+  for (const auto& field : definition.schema().fields()) {
+    const zetasql::Type* type;
+    auto status = MakeType(field, type_factory, &type);
+    if (!status.ok()) {
+      return absl::Status(status.code(), absl::StrCat("Table ", definition.name(), ": ", status.message()));
+    }
+    if (!column_names.insert(absl::AsciiStrToLower(field.name())).second) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("Table ", definition.name(), " has two columns named ", field.name(), "."));
+    }
+    columns.emplace_back(field.name(), type);
+  }
+  *table = absl::make_unique<zetasql::SimpleTable>(std::string(name), columns);
+  return absl::OkStatus();
+}
+
+}
+
+const zetasql::AnalyzerOptions& SchemaCatalog::Snapshot::analyzer_options() const {
+  return GetBuiltins().options;
+}
+
+SchemaCatalog::SchemaCatalog() {
+  Build({}, 0, &current_).IgnoreError();
+}
+
+std::shared_ptr<const SchemaCatalog::Snapshot> SchemaCatalog::Current() const {
+  absl::MutexLock lock(&mutex_);
+  return current_;
+}
+
+absl::Status SchemaCatalog::LoadFile(const std::string& path, bool replace,
+                                     std::shared_ptr<const Snapshot>* snapshot) {
+  std::ifstream file(path);
+  if (!file) {
+    return absl::Status(absl::StatusCode::kNotFound, absl::StrCat("Unable to read the catalog file ", path, "."));
+  }
+  std::stringstream json;
+  json << file.rdbuf();
+  return Load(json.str(), replace, snapshot);
+}
+
+absl::Status SchemaCatalog::Load(absl::string_view json, bool replace, std::shared_ptr<const Snapshot>* snapshot) {
+  CatalogDefinitionProto proto;
+  google::protobuf::util::JsonParseOptions options;
+  // Accept the other fields of the BigQuery schemas, e.g. the descriptions.
+  options.ignore_unknown_fields = true;
+  auto parse_status = google::protobuf::util::JsonStringToMessage(std::string(json), &proto, options);
+  if (!parse_status.ok()) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        absl::StrCat("Invalid catalog: ", parse_status.ToString()));
+  }
+
+  absl::MutexLock load_lock(&load_mutex_);
+  auto current = Current();
+  std::map<std::string, TableDefinitionProto> definitions;
+  if (!replace) {
+    definitions = current->definitions_;
+  }
+  for (const auto& table : proto.tables()) {
+    definitions[absl::AsciiStrToLower(table.name())] = table;
+  }
+  std::shared_ptr<const Snapshot> result;
+  ZETASQL_RETURN_IF_ERROR(Build(std::move(definitions), current->version() + 1, &result));
+  {
+    absl::MutexLock lock(&mutex_);
+    current_ = result;
+  }
+  if (snapshot != nullptr) {
+    *snapshot = std::move(result);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SchemaCatalog::Build(std::map<std::string, TableDefinitionProto> definitions, int64_t version,
+                                  std::shared_ptr<const Snapshot>* snapshot) {
+  std::shared_ptr<Snapshot> result(new Snapshot());
+  result->version_ = version;
+  result->tables_ = absl::make_unique<zetasql::SimpleCatalog>("tables", &result->type_factory_);
+
+  // A table is found by its path (project, dataset and table), and by its full name, which is how
+  // the parser reads a quoted `project.dataset.table`.
+  absl::flat_hash_map<std::string, zetasql::SimpleCatalog*> sub_catalogs;
+  for (const auto& [key, definition] : definitions) {
+    std::vector<std::string> path = absl::StrSplit(definition.name(), '.');
+    if (path.size() > 3 || std::any_of(path.begin(), path.end(), [](const auto& name) { return name.empty(); })) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("Invalid table name \"", definition.name(), "\"."));
+    }
+    std::unique_ptr<zetasql::SimpleTable> table;
+    ZETASQL_RETURN_IF_ERROR(MakeTable(definition, path.back(), &result->type_factory_, &table));
+    const zetasql::Table* full_name_table = table.get();
+
+    auto parent = result->tables_.get();
+    std::string parent_key;
+    for (int i = 0; i + 1 < path.size(); i++) {
+      absl::StrAppend(&parent_key, i == 0 ? "" : ".", absl::AsciiStrToLower(path[i]));
+      auto& sub_catalog = sub_catalogs[parent_key];
+      if (sub_catalog == nullptr) {
+        sub_catalog = parent->MakeOwnedSimpleCatalog(path[i]);
+      }
+      parent = sub_catalog;
+    }
+    parent->AddOwnedTable(path.back(), std::move(table));
+    if (path.size() > 1) {
+      result->tables_->AddTable(definition.name(), full_name_table);
+    }
+  }
+  result->definitions_ = std::move(definitions);
+
+  ZETASQL_RETURN_IF_ERROR(zetasql::MultiCatalog::Create(
+      "catalog", {result->tables_.get(), &GetBuiltins().catalog}, &result->catalog_));
+  *snapshot = std::move(result);
+  return absl::OkStatus();
+}
+
+absl::Status AnalyzeBigQueryStatement(absl::string_view query, const SchemaCatalog::Snapshot& snapshot,
+                                      zetasql::TypeFactory* type_factory,
+                                      std::unique_ptr<const zetasql::AnalyzerOutput>* output,
+                                      const CancellationToken* cancellation) {
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+  stats::ScopedPhase phase(stats::Phase::kAnalyze);
+  if (auto* request = stats::RequestScope::Current()) {
+    request->set_query(query);
+  }
+  ZETASQL_RETURN_IF_ERROR(zetasql::AnalyzeStatement(query, snapshot.analyzer_options(), snapshot.catalog(),
+                                                    type_factory, output));
+  return CheckCancellation(cancellation);
+}
+
+}  // bigquery::utils::zetasql_helper
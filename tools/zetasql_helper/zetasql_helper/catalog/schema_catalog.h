@@ -0,0 +1,111 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_CATALOG_SCHEMA_CATALOG_H_
+#define ZETASQL_HELPER_CATALOG_SCHEMA_CATALOG_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/multi_catalog.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/type.h"
+#include "zetasql_helper/catalog/catalog.pb.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// The table schemas the analyzer resolves the queries against. The catalog is long-lived and
+// versioned: every load builds a new immutable Snapshot, and the requests keep analyzing against
+// the snapshot they started with while a load is in progress.
+//
+// The builtin functions and the AnalyzerOptions are built once per process and shared by all the
+// snapshots, so a load only costs the conversion of its tables, and an analysis only the
+// resolution of its query.
+class SchemaCatalog {
+ public:
+  // One version of the catalog.
+  class Snapshot {
+   public:
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    // 0 for the empty catalog, incremented by every load.
+    int64_t version() const { return version_; }
+    int table_count() const { return definitions_.size(); }
+    // The tables and the builtin functions.
+    zetasql::Catalog* catalog() const { return catalog_.get(); }
+    const zetasql::AnalyzerOptions& analyzer_options() const;
+
+   private:
+    friend class SchemaCatalog;
+
+    Snapshot() = default;
+
+    int64_t version_ = 0;
+    // The definitions the snapshot was built from, by lowercase table name.
+    std::map<std::string, TableDefinitionProto> definitions_;
+    // Owns the types of the columns. Declared first, so that it outlives the tables.
+    zetasql::TypeFactory type_factory_;
+    std::unique_ptr<zetasql::SimpleCatalog> tables_;
+    std::unique_ptr<zetasql::MultiCatalog> catalog_;
+  };
+
+  SchemaCatalog();
+
+  SchemaCatalog(const SchemaCatalog&) = delete;
+  SchemaCatalog& operator=(const SchemaCatalog&) = delete;
+
+  // Load the tables of a catalog file (see CatalogDefinitionProto). Unless `replace` is set, the
+  // tables are added to the ones of the current version, replacing the tables of the same name.
+  // On success, the new version becomes current, and is returned in `snapshot` if not null. On
+  // failure, the current version is unchanged.
+  absl::Status Load(absl::string_view json, bool replace, std::shared_ptr<const Snapshot>* snapshot = nullptr);
+
+  // Same with the catalog file at `path`.
+  absl::Status LoadFile(const std::string& path, bool replace, std::shared_ptr<const Snapshot>* snapshot = nullptr);
+
+  // The current version.
+  std::shared_ptr<const Snapshot> Current() const;
+
+ private:
+  absl::Status Build(std::map<std::string, TableDefinitionProto> definitions, int64_t version,
+                     std::shared_ptr<const Snapshot>* snapshot);
+
+  // Serializes the loads, so that a load never drops the tables of a concurrent one.
+  absl::Mutex load_mutex_;
+  mutable absl::Mutex mutex_;
+  std::shared_ptr<const Snapshot> current_;
+};
+
+// Analyze a query as a BigQuery statement against `snapshot`. The resolved AST may reference types
+// of `type_factory`, which must outlive `output`. The time spent is counted as the analyze phase
+// of the request being served. The analyzer cannot be interrupted, so the optional `cancellation`
+// is checked before and after the analysis.
+absl::Status AnalyzeBigQueryStatement(absl::string_view query, const SchemaCatalog::Snapshot& snapshot,
+                                      zetasql::TypeFactory* type_factory,
+                                      std::unique_ptr<const zetasql::AnalyzerOutput>* output,
+                                      const CancellationToken* cancellation = nullptr);
+
+}  // bigquery::utils::zetasql_helper
+
+#endif  // ZETASQL_HELPER_CATALOG_SCHEMA_CATALOG_H_
@@ -0,0 +1,120 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// The fixers of the helper, registered in FixerRegistry. Unlike FixColumnNotGrouped and
+// FixDuplicateColumns, which unparse the modified AST, they return the edits of the fix, so that
+// the rest of the query keeps its formatting and comments.
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "zetasql_helper/fixer/fix_column_not_grouped.h"
+#include "zetasql_helper/fixer/fix_duplicate_columns.h"
+#include "zetasql_helper/fixer/fixer_registry.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+// An empty range at `offset`, to insert text.
+zetasql::ParseLocationRange InsertionAt(int offset) {
+  zetasql::ParseLocationRange range;
+  range.set_start(zetasql::ParseLocationPoint::FromByteOffset(offset));
+  range.set_end(zetasql::ParseLocationPoint::FromByteOffset(offset));
+  return range;
+}
+
+int EndOffset(const zetasql::ASTNode* node) {
+  return node->GetParseLocationRange().end().GetByteOffset();
+}
+
+// "SELECT list expression references column status which is neither grouped nor aggregated"
+absl::Status FixColumnNotGroupedEdits(const FixContext& context, QueryFix* fix) {
+  auto column = RemoveBacktick(context.captures[0]);
+  if (context.error_offset < 0) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "The error has no position.");
+  }
+  auto select_node = FindSelectNodeHavingColumn(context.statement, context.error_offset, column, context.checker);
+  if (select_node == nullptr) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "Cannot locate the ungrouped column.");
+  }
+
+  fix->title = absl::StrCat("Add ", column, " to the GROUP BY clause");
+  if (select_node->group_by() != nullptr) {
+    fix->edits.push_back({InsertionAt(EndOffset(select_node->group_by())), absl::StrCat(", ", column)});
+    return absl::OkStatus();
+  }
+  // A new GROUP BY clause follows the WHERE clause, the FROM clause or the select list.
+  const zetasql::ASTNode* previous = select_node->select_list();
+  if (select_node->where_clause() != nullptr) {
+    previous = select_node->where_clause();
+  } else if (select_node->from_clause() != nullptr) {
+    previous = select_node->from_clause();
+  }
+  fix->edits.push_back({InsertionAt(EndOffset(previous)), absl::StrCat(" GROUP BY ", column)});
+  return absl::OkStatus();
+}
+
+// "Duplicate column names in the result are not supported. Found duplicate(s): a, b"
+absl::Status FixDuplicateColumnsEdits(const FixContext& context, QueryFix* fix) {
+  std::vector<absl::string_view> names;
+  for (auto name : absl::StrSplit(context.captures[0], ',', absl::SkipWhitespace())) {
+    name = RemoveBacktick(absl::StripAsciiWhitespace(name));
+    auto select_list = FindSelectListWithDuplicateColumns(*context.statement, name, context.checker);
+    if (select_list == nullptr) {
+      continue;
+    }
+    names.push_back(name);
+
+    // Rename the duplicate columns with a 1-based suffix, like FixDuplicateColumns.
+    int index = 0;
+    for (auto column : select_list->columns()) {
+      if (name != GetColumnName(column)) {
+        continue;
+      }
+      auto new_alias = absl::StrCat(name, "_", ++index);
+      if (column->alias() != nullptr) {
+        fix->edits.push_back({column->alias()->identifier()->GetParseLocationRange(), new_alias});
+      } else {
+        fix->edits.push_back({InsertionAt(EndOffset(column)), absl::StrCat(" AS ", new_alias)});
+      }
+    }
+  }
+  if (names.empty()) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "Duplicate columns does not exist.");
+  }
+  fix->title = absl::StrCat("Rename the duplicate columns ", absl::StrJoin(names, ", "));
+  return absl::OkStatus();
+}
+
+}
+
+absl::Status RegisterBuiltinFixers(FixerRegistry* registry) {
+  ZETASQL_RETURN_IF_ERROR(registry->Register(
+      "column_not_grouped",
+      "SELECT list expression references column `?(.*?)`? which is neither grouped nor aggregated",
+      FixColumnNotGroupedEdits));
+  ZETASQL_RETURN_IF_ERROR(registry->Register(
+      "duplicate_columns",
+      "Duplicate column names in the result are not supported\\. Found duplicate\\(s\\): (.*)",
+      FixDuplicateColumnsEdits));
+  return absl::OkStatus();
+}
+
+} // bigquery::utils::zetasql_helper
@@ -19,17 +19,18 @@
 #include "absl/strings/str_cat.h"
 #include "zetasql/parser/parser.h"
 #include "zetasql_helper/util/util.h"
+#include "zetasql_helper/stats/server_stats.h"
 
 
 namespace bigquery::utils::zetasql_helper {
 
 
 zetasql_base::StatusOr<std::string>
-FixColumnNotGrouped(absl::string_view query, absl::string_view missing_column, int line_number, int column_number) {
+FixColumnNotGrouped(absl::string_view query, absl::string_view missing_column, int line_number, int column_number,
+                    const CancellationToken* cancellation) {
 
   std::unique_ptr<zetasql::ParserOutput> parser_output;
-  auto options = BigQueryOptions();
-  ZETASQL_RETURN_IF_ERROR(ParseStatement(query, options.GetParserOptions(), &parser_output));
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
 
   missing_column = RemoveBacktick(missing_column);
 
@@ -37,26 +38,36 @@ FixColumnNotGrouped(absl::string_view query, absl::string_view missing_column, i
   if (offset == -1) {
     return absl::Status(absl::StatusCode::kInvalidArgument, "Line and/or column numbers are incorrect.");
   }
-  auto select_node = FindSelectNodeHavingColumn(parser_output->statement(), offset, missing_column);
+  const zetasql::ASTSelect* select_node;
+  CancellationChecker checker(cancellation);
+  {
+    stats::ScopedPhase traversal(stats::Phase::kTraversal);
+    select_node = FindSelectNodeHavingColumn(parser_output->statement(), offset, missing_column, &checker);
+  }
+  ZETASQL_RETURN_IF_ERROR(checker.status());
   if (select_node == nullptr) {
     return absl::Status(absl::StatusCode::kInvalidArgument, "Cannot locate the ungrouped column.");
   }
 
+  stats::ScopedPhase fix(stats::Phase::kFix);
+
   AddColumnToGroupByClause(
       const_cast<zetasql::ASTSelect *>(select_node),
       missing_column, parser_output->arena().get(),
       parser_output->id_string_pool().get()
   );
 
+  // Unparsing cannot be interrupted, so check once more before it starts.
+  ZETASQL_RETURN_IF_ERROR(checker.CheckNow());
   return Unparse(parser_output->statement());
 }
 
 const zetasql::ASTSelect*
 FindSelectNodeHavingColumn(const zetasql::ASTStatement* statement, int column_start_offset,
-                           absl::string_view column) {
+                           absl::string_view column, CancellationChecker* checker) {
 
   // Find the Column node starting at the given offset
-  auto node = FindPathExpressionNode(*statement, column_start_offset, column);
+  auto node = FindPathExpressionNode(*statement, column_start_offset, column, checker);
   if (node == nullptr) {
     return nullptr;
   }
@@ -73,7 +84,8 @@ FindSelectNodeHavingColumn(const zetasql::ASTStatement* statement, int column_st
 }
 
 const zetasql::ASTNode*
-FindPathExpressionNode(const zetasql::ASTNode& node, int column_start_offset, absl::string_view name) {
+FindPathExpressionNode(const zetasql::ASTNode& node, int column_start_offset, absl::string_view name,
+                       CancellationChecker* checker) {
 
   // Setup the predicator to find the target path expression node
   auto predicator = [column_start_offset](const zetasql::ASTNode* node) {
@@ -81,7 +93,7 @@ FindPathExpressionNode(const zetasql::ASTNode& node, int column_start_offset, ab
         node->node_kind() == zetasql::ASTNodeKind::AST_PATH_EXPRESSION;
   };
 
-  auto candidate = FindNode(&node, predicator);
+  auto candidate = FindNode(&node, predicator, checker);
   if (IsPathExpression(candidate, name)) {
     return candidate;
   }
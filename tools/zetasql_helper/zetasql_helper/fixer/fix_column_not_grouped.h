@@ -20,6 +20,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "zetasql/parser/parse_tree.h"
+#include "zetasql_helper/util/cancellation.h"
 
 
 namespace bigquery::utils::zetasql_helper {
@@ -31,15 +32,16 @@ namespace bigquery::utils::zetasql_helper {
 // missing_column: name of the missing (ungrouped) column
 // line/column number: the starting position of the ungrouped column (1-based index)
 //
-// The function will return the fixed query.
+// The function will return the fixed query, or the status of `cancellation` if it is cancelled.
 zetasql_base::StatusOr<std::string>
-FixColumnNotGrouped(absl::string_view query, absl::string_view missing_column, int line_number, int column_number);
+FixColumnNotGrouped(absl::string_view query, absl::string_view missing_column, int line_number, int column_number,
+                    const CancellationToken* cancellation = nullptr);
 
 // Find the AST_Select Node having a column node. The column node should start at the given offset
 // and has the given column name.
 const zetasql::ASTSelect*
 FindSelectNodeHavingColumn(const zetasql::ASTStatement* statement, int column_start_offset,
-                           absl::string_view column);
+                           absl::string_view column, CancellationChecker* checker = nullptr);
 
 // Check if the input AST_Node pointer points to an AST_Path_Expression node whose column name is the
 // input name.
@@ -51,7 +53,8 @@ bool IsPathExpression(const zetasql::ASTNode* node, absl::string_view name);
 // the staring offset and name identical to the input values.
 // Return the AST_Path_Expression pointer if it is found. Otherwise, a null pointer will be returned.
 const zetasql::ASTNode*
-FindPathExpressionNode(const zetasql::ASTNode& node, int column_start_offset, absl::string_view name);
+FindPathExpressionNode(const zetasql::ASTNode& node, int column_start_offset, absl::string_view name,
+                       CancellationChecker* checker = nullptr);
 
 
 // Add a column to the group-by clause of the input AST_Select node.
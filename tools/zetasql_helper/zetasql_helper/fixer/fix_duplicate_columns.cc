@@ -18,31 +18,43 @@
 #include "zetasql/parser/parser.h"
 #include "zetasql/public/analyzer.h"
 #include "zetasql_helper/util/util.h"
+#include "zetasql_helper/stats/server_stats.h"
 
 
 namespace bigquery::utils::zetasql_helper {
 
 zetasql_base::StatusOr<std::string>
-FixDuplicateColumns(absl::string_view query, absl::string_view duplicate_column_name) {
+FixDuplicateColumns(absl::string_view query, absl::string_view duplicate_column_name,
+                    const CancellationToken* cancellation) {
   std::unique_ptr<zetasql::ParserOutput> parser_output;
-  auto options = BigQueryOptions();
-  ZETASQL_RETURN_IF_ERROR(ParseStatement(query, options.GetParserOptions(), &parser_output));
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
 
   duplicate_column_name = RemoveBacktick(duplicate_column_name);
 
-  auto select_list = FindSelectListWithDuplicateColumns(*parser_output->statement(), duplicate_column_name);
+  const zetasql::ASTSelectList* select_list;
+  CancellationChecker checker(cancellation);
+  {
+    stats::ScopedPhase traversal(stats::Phase::kTraversal);
+    select_list = FindSelectListWithDuplicateColumns(*parser_output->statement(), duplicate_column_name, &checker);
+  }
+  ZETASQL_RETURN_IF_ERROR(checker.status());
   if (select_list == nullptr) {
     return absl::Status(absl::StatusCode::kInvalidArgument, "Duplicate columns does not exist.");
   }
 
+  stats::ScopedPhase fix(stats::Phase::kFix);
+
   ReplaceDuplicateColumnsOfSelectList(*select_list, duplicate_column_name, parser_output->arena().get(),
                                       parser_output->id_string_pool().get());
 
+  // Unparsing cannot be interrupted, so check once more before it starts.
+  ZETASQL_RETURN_IF_ERROR(checker.CheckNow());
   return Unparse(parser_output->statement());
 }
 
 const zetasql::ASTSelectList*
-FindSelectListWithDuplicateColumns(const zetasql::ASTNode& node, absl::string_view column_name) {
+FindSelectListWithDuplicateColumns(const zetasql::ASTNode& node, absl::string_view column_name,
+                                   CancellationChecker* checker) {
   // Set up the predicator to find the target node.
   auto predicator = [column_name](const zetasql::ASTNode* node) {
     if (node->node_kind() != zetasql::ASTNodeKind::AST_SELECT_LIST) {
@@ -60,13 +72,10 @@ FindSelectListWithDuplicateColumns(const zetasql::ASTNode& node, absl::string_vi
     }
 
     // count > 1 means duplicate columns.
-    if (count > 1) {
-      return true;
-    }
-
+    return count > 1;
   };
 
-  auto candidate = FindNode(&node, predicator);
+  auto candidate = FindNode(&node, predicator, checker);
   return dynamic_cast<const zetasql::ASTSelectList*>(candidate);
 
 }
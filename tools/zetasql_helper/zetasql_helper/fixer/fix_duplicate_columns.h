@@ -20,6 +20,7 @@
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
 #include "zetasql/parser/parse_tree.h"
+#include "zetasql_helper/util/cancellation.h"
 
 namespace bigquery::utils::zetasql_helper {
 
@@ -29,14 +30,16 @@ namespace bigquery::utils::zetasql_helper {
 // query: incorrect SQL with the error
 // duplicate_column_name: name of the duplicate columns
 //
-// The function will return the fixed query.
+// The function will return the fixed query, or the status of `cancellation` if it is cancelled.
 zetasql_base::StatusOr<std::string>
-FixDuplicateColumns(absl::string_view query, absl::string_view duplicate_column_name);
+FixDuplicateColumns(absl::string_view query, absl::string_view duplicate_column_name,
+                    const CancellationToken* cancellation = nullptr);
 
 
 // Find the ASTSelectList Node having duplicate columns, whose name is the input name.
 const zetasql::ASTSelectList*
-FindSelectListWithDuplicateColumns(const zetasql::ASTNode& node, absl::string_view column_name);
+FindSelectListWithDuplicateColumns(const zetasql::ASTNode& node, absl::string_view column_name,
+                                   CancellationChecker* checker = nullptr);
 
 // Get the column name of an ASTSelectColumn node.
 std::string GetColumnName(const zetasql::ASTSelectColumn* column_node);
@@ -0,0 +1,161 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "fixer_registry.h"
+
+#include <algorithm>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/strip.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+// Split the position suffix " at [line:column]" from a BigQuery error message. Return false if
+// the message has none.
+bool SplitErrorPosition(absl::string_view* message, int* line, int* column) {
+  auto start = message->rfind(" at [");
+  if (start == absl::string_view::npos || !absl::EndsWith(*message, "]")) {
+    return false;
+  }
+  auto position = message->substr(start + 5, message->size() - start - 6);
+  auto colon = position.find(':');
+  if (colon == absl::string_view::npos || !absl::SimpleAtoi(position.substr(0, colon), line) ||
+      !absl::SimpleAtoi(position.substr(colon + 1), column)) {
+    return false;
+  }
+  message->remove_suffix(message->size() - start);
+  return true;
+}
+
+}
+
+FixerRegistry& FixerRegistry::Global() {
+  static auto* registry = []() {
+    auto* registry = new FixerRegistry();
+    // The patterns of the builtin fixers are valid (see fixer_test).
+    RegisterBuiltinFixers(registry).IgnoreError();
+    return registry;
+  }();
+  return *registry;
+}
+
+absl::Status FixerRegistry::Register(absl::string_view name, absl::string_view error_pattern, FixFunction fix) {
+  Fixer fixer;
+  fixer.name = std::string(name);
+  try {
+    fixer.error_pattern = std::regex(std::string(error_pattern));
+  } catch (const std::regex_error& error) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        absl::StrCat("Invalid error pattern of fixer ", name, ": ", error.what()));
+  }
+  fixer.fix = std::move(fix);
+  fixers_.push_back(std::move(fixer));
+  return absl::OkStatus();
+}
+
+absl::Status FixerRegistry::Fix(absl::string_view query, absl::string_view error_message,
+                                std::vector<QueryFix>* fixes, const CancellationToken* cancellation) const {
+  auto message = absl::StripAsciiWhitespace(error_message);
+  int error_offset = -1;
+  int line, column;
+  if (SplitErrorPosition(&message, &line, &column)) {
+    error_offset = get_offset(query, line, column);
+  }
+  return Fix(query, message, error_offset, fixes, cancellation);
+}
+
+absl::Status FixerRegistry::Fix(absl::string_view query, absl::string_view error_message, int error_offset,
+                                std::vector<QueryFix>* fixes, const CancellationToken* cancellation) const {
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+
+  auto message = absl::StripAsciiWhitespace(error_message);
+  int line, column;
+  SplitErrorPosition(&message, &line, &column);
+
+  // Match the patterns before parsing, so that an error no fixer knows costs no parse.
+  std::string message_text(message);
+  std::vector<std::pair<const Fixer*, std::vector<std::string>>> matches;
+  for (const auto& fixer : fixers_) {
+    std::smatch match;
+    if (std::regex_match(message_text, match, fixer.error_pattern)) {
+      std::vector<std::string> captures;
+      for (int i = 1; i < match.size(); i++) {
+        captures.push_back(match[i].str());
+      }
+      matches.push_back({&fixer, std::move(captures)});
+    }
+  }
+  if (matches.empty()) {
+    return absl::OkStatus();
+  }
+
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
+
+  stats::ScopedPhase phase(stats::Phase::kFix);
+  CancellationChecker checker(cancellation);
+  for (auto& [fixer, captures] : matches) {
+    FixContext context;
+    context.query = query;
+    context.statement = parser_output->statement();
+    context.captures = std::move(captures);
+    context.error_offset = error_offset;
+    context.checker = &checker;
+
+    QueryFix fix;
+    fix.fixer = fixer->name;
+    auto status = fixer->fix(context, &fix);
+    ZETASQL_RETURN_IF_ERROR(checker.status());
+    if (!status.ok() || fix.edits.empty()) {
+      continue;
+    }
+    ZETASQL_RETURN_IF_ERROR(ApplyEdits(query, fix.edits, &fix.fixed_query));
+    fixes->push_back(std::move(fix));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ApplyEdits(absl::string_view query, std::vector<QueryEdit> edits, std::string* output) {
+  // Edits inserting at the same offset keep their order.
+  std::stable_sort(edits.begin(), edits.end(), [](const QueryEdit& a, const QueryEdit& b) {
+    return a.range.start().GetByteOffset() < b.range.start().GetByteOffset();
+  });
+  output->clear();
+  int offset = 0;
+  for (const auto& edit : edits) {
+    int start = edit.range.start().GetByteOffset();
+    int end = edit.range.end().GetByteOffset();
+    if (start < offset || end < start || end > query.size()) {
+      return absl::Status(absl::StatusCode::kInternal, "The edits of a fix overlap or are out of the query.");
+    }
+    output->append(query.data() + offset, start - offset);
+    output->append(edit.replacement);
+    offset = end;
+  }
+  output->append(query.data() + offset, query.size() - offset);
+  return absl::OkStatus();
+}
+
+} // bigquery::utils::zetasql_helper
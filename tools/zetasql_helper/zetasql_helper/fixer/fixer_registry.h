@@ -0,0 +1,110 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_FIXER_FIXER_REGISTRY_H
+#define ZETASQL_HELPER_FIXER_FIXER_REGISTRY_H
+
+#include <functional>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "zetasql/parser/parse_tree.h"
+#include "zetasql/public/parse_location.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// Replace the text of a query within `range` by `replacement`. An empty range inserts it.
+struct QueryEdit {
+  zetasql::ParseLocationRange range;
+  std::string replacement;
+};
+
+// A fix proposed by a fixer: the edits to apply together to the query.
+struct QueryFix {
+  // The name of the fixer, as registered.
+  std::string fixer;
+  // A short description of the fix, e.g. "Add status to the GROUP BY clause".
+  std::string title;
+  std::vector<QueryEdit> edits;
+  // The query with the edits applied.
+  std::string fixed_query;
+};
+
+// What a fixer is given when its error pattern matches.
+struct FixContext {
+  absl::string_view query;
+  const zetasql::ASTStatement* statement;
+  // The groups captured by the error pattern, the whole match excluded.
+  std::vector<std::string> captures;
+  // The byte offset of the error position ("at [line:column]" in the message), or -1.
+  int error_offset = -1;
+  // Ticked by the traversals of the fixer.
+  CancellationChecker* checker;
+};
+
+// Build the edits of a fix from the AST. Return an error if the query cannot be fixed, e.g. the
+// error position does not point to the expected node.
+using FixFunction = std::function<absl::Status(const FixContext& context, QueryFix* fix)>;
+
+// The fixers of the helper, by the BigQuery error they fix. Given a query and its error message,
+// the registry parses the query once, and runs every fixer whose pattern matches the error on the
+// same AST. A new fixer only needs to be registered, with no new RPC.
+class FixerRegistry {
+ public:
+  // The registry holding the builtin fixers.
+  static FixerRegistry& Global();
+
+  // Register a fixer. `error_pattern` is an ECMAScript regular expression, which must match the
+  // whole error message with its position suffix (" at [line:column]") removed. Fixers run in
+  // the order of their registration. Not thread-safe: register before the registry is used.
+  absl::Status Register(absl::string_view name, absl::string_view error_pattern, FixFunction fix);
+
+  // Return the fixes of the fixers matching `error_message`, a BigQuery error of `query`, e.g.
+  // "Duplicate column names in the result are not supported. Found duplicate(s): a". A matching
+  // fixer which cannot fix the query proposes nothing. The query is only parsed if a fixer
+  // matches.
+  absl::Status Fix(absl::string_view query, absl::string_view error_message, std::vector<QueryFix>* fixes,
+                   const CancellationToken* cancellation = nullptr) const;
+
+  // Same, with the byte offset of the error in `query` (or -1) given by the caller instead of
+  // the position suffix of the message, e.g. when `query` is a statement of a larger script.
+  absl::Status Fix(absl::string_view query, absl::string_view error_message, int error_offset,
+                   std::vector<QueryFix>* fixes, const CancellationToken* cancellation = nullptr) const;
+
+ private:
+  struct Fixer {
+    std::string name;
+    std::regex error_pattern;
+    FixFunction fix;
+  };
+
+  std::vector<Fixer> fixers_;
+};
+
+// Apply non-overlapping edits to a query.
+absl::Status ApplyEdits(absl::string_view query, std::vector<QueryEdit> edits, std::string* output);
+
+// Register the fixes of FixColumnNotGrouped and FixDuplicateColumns, as edits.
+absl::Status RegisterBuiltinFixers(FixerRegistry* registry);
+
+} // bigquery::utils::zetasql_helper
+
+#endif //ZETASQL_HELPER_FIXER_FIXER_REGISTRY_H
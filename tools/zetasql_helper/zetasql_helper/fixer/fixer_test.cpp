@@ -17,6 +17,8 @@
 #include "gtest/gtest.h"
 #include "fix_duplicate_columns.h"
 #include "fix_column_not_grouped.h"
+#include "fixer_registry.h"
+#include "absl/strings/str_cat.h"
 
 using namespace bigquery::utils::zetasql_helper;
 
@@ -116,4 +118,106 @@ TEST_F(FixerTest, FixColumnNotGroupedTest4) {
             "  `bigquery-public-data.crypto_bitcoin.blocks`\n"
             "GROUP BY bucket, mod(number, 10), `hash`\n"
             "LIMIT 1000\n", fixed_query);
-}
\ No newline at end of file
+}
+
+TEST_F(FixerTest, FixDuplicateColumns_deadlineExceeded) {
+  absl::string_view query = "SELECT status, status FROM `bigquery-public-data.austin_311.311_request` LIMIT 1000";
+  CancellationToken cancellation(nullptr, absl::Now() - absl::Seconds(1));
+
+  auto status_or_value = FixDuplicateColumns(query, "status", &cancellation);
+  EXPECT_EQ(absl::StatusCode::kDeadlineExceeded, status_or_value.status().code());
+}
+
+TEST_F(FixerTest, FixColumnNotGrouped_cancelled) {
+  absl::string_view query = "SELECT status, max(unique_key) FROM `bigquery-public-data.austin_311.311_request` LIMIT 1000";
+  CancellationToken cancellation([]() { return true; });
+
+  auto status_or_value = FixColumnNotGrouped(query, "status", 1, 8, &cancellation);
+  EXPECT_EQ(absl::StatusCode::kCancelled, status_or_value.status().code());
+}
+
+TEST_F(FixerTest, FixerRegistry_columnNotGrouped) {
+  absl::string_view query = "SELECT status, max(unique_key)\n"
+                            "FROM `bigquery-public-data.austin_311.311_request` -- requests\n"
+                            "WHERE unique_key > 10 LIMIT 1000";
+  std::vector<QueryFix> fixes;
+
+  auto status = FixerRegistry::Global().Fix(
+      query, "SELECT list expression references column status which is neither grouped nor aggregated at [1:8]",
+      &fixes);
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(1, fixes.size());
+  EXPECT_EQ("column_not_grouped", fixes[0].fixer);
+  ASSERT_EQ(1, fixes[0].edits.size());
+  EXPECT_EQ(" GROUP BY status", fixes[0].edits[0].replacement);
+  EXPECT_EQ("SELECT status, max(unique_key)\n"
+            "FROM `bigquery-public-data.austin_311.311_request` -- requests\n"
+            "WHERE unique_key > 10 GROUP BY status LIMIT 1000", fixes[0].fixed_query);
+}
+
+TEST_F(FixerTest, FixerRegistry_columnNotGroupedWithGroupBy) {
+  std::vector<QueryFix> fixes;
+
+  auto status = FixerRegistry::Global().Fix(
+      "SELECT a, b, count(*) FROM t GROUP BY a",
+      "SELECT list expression references column b which is neither grouped nor aggregated at [1:11]", &fixes);
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(1, fixes.size());
+  EXPECT_EQ("SELECT a, b, count(*) FROM t GROUP BY a, b", fixes[0].fixed_query);
+}
+
+TEST_F(FixerTest, FixerRegistry_duplicateColumns) {
+  std::vector<QueryFix> fixes;
+
+  auto status = FixerRegistry::Global().Fix(
+      "SELECT a, b AS a, c, c FROM t",
+      "Duplicate column names in the result are not supported. Found duplicate(s): a, c", &fixes);
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(1, fixes.size());
+  EXPECT_EQ("Rename the duplicate columns a, c", fixes[0].title);
+  EXPECT_EQ(4, fixes[0].edits.size());
+  EXPECT_EQ("SELECT a AS a_1, b AS a_2, c AS c_1, c AS c_2 FROM t", fixes[0].fixed_query);
+}
+
+TEST_F(FixerTest, FixerRegistry_unknownError) {
+  std::vector<QueryFix> fixes;
+
+  // No fixer matches, so the query is not even parsed.
+  auto status = FixerRegistry::Global().Fix("SELECT FROM", "Unrecognized name: foo at [1:8]", &fixes);
+
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(fixes.empty());
+}
+
+TEST_F(FixerTest, FixerRegistry_customFixer) {
+  FixerRegistry registry;
+  ASSERT_TRUE(registry.Register("limit", "Result too large: (\\d+) rows", [](const FixContext& context, QueryFix* fix) {
+    int end = context.statement->GetParseLocationRange().end().GetByteOffset();
+    zetasql::ParseLocationRange range;
+    range.set_start(zetasql::ParseLocationPoint::FromByteOffset(end));
+    range.set_end(zetasql::ParseLocationPoint::FromByteOffset(end));
+    fix->title = "Add a LIMIT clause";
+    fix->edits.push_back({range, absl::StrCat(" LIMIT ", context.captures[0])});
+    return absl::OkStatus();
+  }).ok());
+  std::vector<QueryFix> fixes;
+
+  auto status = registry.Fix("SELECT a FROM t", "Result too large: 100 rows", &fixes);
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(1, fixes.size());
+  EXPECT_EQ("SELECT a FROM t LIMIT 100", fixes[0].fixed_query);
+  EXPECT_FALSE(registry.Register("invalid", "(", nullptr).ok());
+}
+
+TEST_F(FixerTest, ApplyEdits_overlapping) {
+  zetasql::ParseLocationRange range;
+  range.set_start(zetasql::ParseLocationPoint::FromByteOffset(0));
+  range.set_end(zetasql::ParseLocationPoint::FromByteOffset(4));
+  std::string output;
+
+  EXPECT_FALSE(ApplyEdits("SELECT 1", {{range, "a"}, {range, "b"}}, &output).ok());
+}
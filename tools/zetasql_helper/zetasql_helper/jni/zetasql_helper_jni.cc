@@ -0,0 +1,96 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// JNI binding of the helper service, used by com.google.bigquery.utils.zetasqlhelper.JniLocalService
+// to call the service in-process on serialized requests and responses, without Docker or gRPC.
+
+#include <jni.h>
+
+#include <string>
+
+#include "zetasql_helper/local_service/local_service.h"
+#include "zetasql_helper/local_service/raw_dispatcher.h"
+
+namespace {
+
+using bigquery::utils::zetasql_helper::local_service::RawDispatcher;
+using bigquery::utils::zetasql_helper::local_service::ZetaSqlHelperLocalServiceImpl;
+
+constexpr char kExceptionClass[] = "com/google/bigquery/utils/zetasqlhelper/JniLocalService$NativeCallException";
+
+const RawDispatcher& Dispatcher() {
+  static auto* service = new ZetaSqlHelperLocalServiceImpl();
+  static auto* dispatcher = new RawDispatcher(service);
+  return *dispatcher;
+}
+
+// Throw a JniLocalService.NativeCallException carrying the code and the message of a status.
+void ThrowStatus(JNIEnv* env, const absl::Status& status) {
+  auto exception_class = env->FindClass(kExceptionClass);
+  if (exception_class == nullptr) {
+    // FindClass already threw NoClassDefFoundError.
+    return;
+  }
+  auto constructor = env->GetMethodID(exception_class, "<init>", "(ILjava/lang/String;)V");
+  if (constructor == nullptr) {
+    return;
+  }
+  auto message = env->NewStringUTF(std::string(status.message()).c_str());
+  auto exception = env->NewObject(exception_class, constructor, static_cast<jint>(status.code()), message);
+  if (exception != nullptr) {
+    env->Throw(static_cast<jthrowable>(exception));
+  }
+}
+
+}
+
+extern "C" {
+
+// static native byte[] call(String method, byte[] request);
+JNIEXPORT jbyteArray JNICALL
+Java_com_google_bigquery_utils_zetasqlhelper_JniLocalService_call(JNIEnv* env, jclass, jstring method,
+                                                                  jbyteArray request) {
+  if (method == nullptr || request == nullptr) {
+    ThrowStatus(env, absl::Status(absl::StatusCode::kInvalidArgument, "The method and the request are required."));
+    return nullptr;
+  }
+
+  auto method_chars = env->GetStringUTFChars(method, nullptr);
+  std::string method_name(method_chars);
+  env->ReleaseStringUTFChars(method, method_chars);
+
+  // Copy the request, since the call may take long and must not pin the Java array.
+  std::string request_bytes(env->GetArrayLength(request), '\0');
+  env->GetByteArrayRegion(request, 0, request_bytes.size(), reinterpret_cast<jbyte*>(&request_bytes[0]));
+
+  std::string response_bytes;
+  auto status = Dispatcher().Call(method_name, request_bytes, &response_bytes);
+  if (!status.ok()) {
+    ThrowStatus(env, status);
+    return nullptr;
+  }
+
+  auto response = env->NewByteArray(response_bytes.size());
+  if (response == nullptr) {
+    // NewByteArray already threw OutOfMemoryError.
+    return nullptr;
+  }
+  env->SetByteArrayRegion(response, 0, response_bytes.size(), reinterpret_cast<const jbyte*>(response_bytes.data()));
+  return response;
+}
+
+}
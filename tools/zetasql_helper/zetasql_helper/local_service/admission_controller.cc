@@ -0,0 +1,242 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/local_service/admission_controller.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/stats/server_stats.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+namespace {
+
+// How often a queued request checks whether its caller gave up.
+constexpr absl::Duration kCancellationPollInterval = absl::Milliseconds(50);
+
+// Bounds of the retry-after hint.
+constexpr absl::Duration kMinRetryAfter = absl::Milliseconds(10);
+constexpr absl::Duration kMaxRetryAfter = absl::Seconds(30);
+// Hint used before any request of the class finished.
+constexpr absl::Duration kDefaultRetryAfter = absl::Milliseconds(100);
+
+// Weight of the last request in the moving average of the service time.
+constexpr double kServiceTimeWeight = 0.2;
+
+}
+
+AdmissionController::Permit::Permit(Permit&& other)
+    : controller_(other.controller_), cost_class_(other.cost_class_), priority_(other.priority_),
+      start_ns_(other.start_ns_) {
+  other.controller_ = nullptr;
+}
+
+AdmissionController::Permit& AdmissionController::Permit::operator=(Permit&& other) {
+  if (this != &other) {
+    Release();
+    controller_ = other.controller_;
+    cost_class_ = other.cost_class_;
+    priority_ = other.priority_;
+    start_ns_ = other.start_ns_;
+    other.controller_ = nullptr;
+  }
+  return *this;
+}
+
+AdmissionController::Permit::~Permit() {
+  Release();
+}
+
+void AdmissionController::Permit::Release() {
+  if (controller_ != nullptr) {
+    controller_->Release(cost_class_, priority_, stats::NowNanos() - start_ns_);
+    controller_ = nullptr;
+  }
+}
+
+AdmissionController::AdmissionController(const Options& options)
+    : large_request_bytes_(options.large_request_bytes), default_priority_(options.default_priority) {
+  lanes_[static_cast<int>(CostClass::kSmall)].options = options.small;
+  lanes_[static_cast<int>(CostClass::kLarge)].options = options.large;
+  auto reserved_share = std::clamp(options.interactive_reserved_share, 0.0, 1.0);
+  for (auto& lane : lanes_) {
+    lane.options.max_concurrency = std::max(lane.options.max_concurrency, 1);
+    lane.options.max_queue = std::max(lane.options.max_queue, 0);
+
+    auto& interactive = lane.queues[static_cast<int>(Priority::kInteractive)];
+    interactive.max_running = lane.options.max_concurrency;
+    interactive.stride = 1.0 / std::max(options.interactive_weight, 1);
+    auto& batch = lane.queues[static_cast<int>(Priority::kBatch)];
+    auto reserved = static_cast<int>(lane.options.max_concurrency * reserved_share);
+    batch.max_running = std::max(lane.options.max_concurrency - reserved, 1);
+    batch.stride = 1.0 / std::max(options.batch_weight, 1);
+  }
+}
+
+AdmissionController::CostClass AdmissionController::Classify(int64_t query_bytes) const {
+  return query_bytes >= large_request_bytes_ ? CostClass::kLarge : CostClass::kSmall;
+}
+
+absl::string_view AdmissionController::CostClassName(CostClass cost_class) {
+  switch (cost_class) {
+    case CostClass::kSmall:
+      return "small";
+    case CostClass::kLarge:
+      return "large";
+  }
+  return "unknown";
+}
+
+absl::string_view AdmissionController::PriorityName(Priority priority) {
+  switch (priority) {
+    case Priority::kInteractive:
+      return "interactive";
+    case Priority::kBatch:
+      return "batch";
+  }
+  return "unknown";
+}
+
+bool AdmissionController::ParsePriority(absl::string_view name, Priority* priority) {
+  for (int i = 0; i < kNumPriorities; i++) {
+    if (name == PriorityName(static_cast<Priority>(i))) {
+      *priority = static_cast<Priority>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+absl::Status AdmissionController::Admit(int64_t query_bytes, Priority priority,
+                                        const CancellationToken* cancellation, Permit* permit,
+                                        absl::Duration* retry_after) {
+  permit->Release();
+  auto cost_class = Classify(query_bytes);
+  auto& lane = lanes_[static_cast<int>(cost_class)];
+  auto& queue = lane.queues[static_cast<int>(priority)];
+
+  absl::MutexLock lock(&mutex_);
+  if (lane.running < lane.options.max_concurrency && queue.running < queue.max_running &&
+      queue.waiting.empty()) {
+    lane.running++;
+    queue.running++;
+  } else if (queue.waiting.size() >= lane.options.max_queue) {
+    queue.rejected++;
+    *retry_after = RetryAfterLocked(lane, queue);
+    return absl::Status(absl::StatusCode::kResourceExhausted,
+                        absl::StrCat("The server is overloaded with ", CostClassName(cost_class), " ",
+                                     PriorityName(priority), " requests. Retry after ",
+                                     absl::FormatDuration(*retry_after), "."));
+  } else {
+    if (queue.waiting.empty()) {
+      // An idle priority does not bank the slots it did not use.
+      queue.pass = std::max(queue.pass, lane.virtual_time);
+    }
+    Waiter waiter;
+    queue.waiting.push_back(&waiter);
+    while (!waiter.admitted) {
+      auto status = CheckCancellation(cancellation);
+      if (!status.ok()) {
+        queue.waiting.erase(std::find(queue.waiting.begin(), queue.waiting.end(), &waiter));
+        queue.cancelled++;
+        return status;
+      }
+      lane.admitted_cv.WaitWithTimeout(&mutex_, kCancellationPollInterval);
+    }
+    // The releasing request took the slot on behalf of this one.
+  }
+
+  queue.admitted++;
+  permit->controller_ = this;
+  permit->cost_class_ = cost_class;
+  permit->priority_ = priority;
+  permit->start_ns_ = stats::NowNanos();
+  return absl::OkStatus();
+}
+
+void AdmissionController::Release(CostClass cost_class, Priority priority, int64_t service_ns) {
+  absl::MutexLock lock(&mutex_);
+  auto& lane = lanes_[static_cast<int>(cost_class)];
+  lane.mean_service_ns = lane.mean_service_ns == 0
+                         ? service_ns
+                         : lane.mean_service_ns + kServiceTimeWeight * (service_ns - lane.mean_service_ns);
+  lane.running--;
+  lane.queues[static_cast<int>(priority)].running--;
+  DispatchLocked(lane);
+}
+
+void AdmissionController::DispatchLocked(Lane& lane) {
+  bool admitted = false;
+  while (lane.running < lane.options.max_concurrency) {
+    // The eligible queue which is the most behind its share.
+    Queue* next = nullptr;
+    for (auto& queue : lane.queues) {
+      if (!queue.waiting.empty() && queue.running < queue.max_running &&
+          (next == nullptr || queue.pass < next->pass)) {
+        next = &queue;
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    lane.virtual_time = next->pass;
+    next->pass += next->stride;
+    next->waiting.front()->admitted = true;
+    next->waiting.pop_front();
+    next->running++;
+    lane.running++;
+    admitted = true;
+  }
+  if (admitted) {
+    lane.admitted_cv.SignalAll();
+  }
+}
+
+absl::Duration AdmissionController::RetryAfterLocked(const Lane& lane, const Queue& queue) const {
+  if (lane.mean_service_ns == 0) {
+    return kDefaultRetryAfter;
+  }
+  // Time for the requests ahead to drain through the slots the priority may hold.
+  auto drain_ns = lane.mean_service_ns * (queue.waiting.size() + 1) / queue.max_running;
+  return std::clamp(absl::Nanoseconds(drain_ns), kMinRetryAfter, kMaxRetryAfter);
+}
+
+std::vector<AdmissionStatsProto> AdmissionController::Stats() {
+  absl::MutexLock lock(&mutex_);
+  std::vector<AdmissionStatsProto> stats;
+  for (int priority = 0; priority < kNumPriorities; priority++) {
+    for (int i = 0; i < kNumCostClasses; i++) {
+      const auto& lane = lanes_[i];
+      const auto& queue = lane.queues[priority];
+      AdmissionStatsProto proto;
+      proto.set_lane(std::string(CostClassName(static_cast<CostClass>(i))));
+      proto.set_priority(std::string(PriorityName(static_cast<Priority>(priority))));
+      proto.set_max_concurrency(queue.max_running);
+      proto.set_max_queue(lane.options.max_queue);
+      proto.set_running(queue.running);
+      proto.set_queued(queue.waiting.size());
+      proto.set_admitted(queue.admitted);
+      proto.set_rejected(queue.rejected);
+      proto.set_cancelled(queue.cancelled);
+      stats.push_back(proto);
+    }
+  }
+  return stats;
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
@@ -0,0 +1,179 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LOCAL_SERVICE_ADMISSION_CONTROLLER_H_
+#define ZETASQL_HELPER_LOCAL_SERVICE_ADMISSION_CONTROLLER_H_
+
+#include <array>
+#include <deque>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "zetasql_helper/stats/stats.pb.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+// Limits the number of requests served at once, so that a few expensive requests cannot take all
+// the workers while cheap interactive requests queue behind them.
+//
+// The cost of a request is estimated from the size of its query. Requests are split into a small
+// and a large class, each with its own concurrency budget. A request waits until a slot of its
+// class frees up, and is rejected with RESOURCE_EXHAUSTED when its queue is full, along with an
+// estimate of when to retry.
+//
+// Requests also have a priority, so that batch jobs cannot delay the interactive requests of the
+// editors. Each priority has its own bounded FIFO queue in each class. A freed slot goes to the
+// queue with the smallest weighted share of the slots handed out so far (stride scheduling), and a
+// share of the slots of each class is reserved to the interactive requests.
+class AdmissionController {
+ public:
+  enum class CostClass {
+    kSmall = 0,
+    kLarge,
+  };
+  static constexpr int kNumCostClasses = 2;
+
+  enum class Priority {
+    kInteractive = 0,
+    kBatch,
+  };
+  static constexpr int kNumPriorities = 2;
+
+  struct ClassOptions {
+    // Number of requests of the class served at once.
+    int max_concurrency;
+    // Number of requests of the class waiting for a slot. Further requests are rejected.
+    int max_queue;
+  };
+
+  struct Options {
+    // Requests whose query has at least this many bytes are large.
+    int64_t large_request_bytes = 64 * 1024;
+    ClassOptions small = {64, 1024};
+    ClassOptions large = {4, 16};
+    // Relative shares of the slots given to each priority while both have waiting requests.
+    int interactive_weight = 4;
+    int batch_weight = 1;
+    // Share of the slots of each class that batch requests cannot take. Batch requests can always
+    // take at least one slot.
+    double interactive_reserved_share = 0.25;
+    // Priority of the requests which do not tell theirs.
+    Priority default_priority = Priority::kInteractive;
+  };
+
+  // Returned by Admit. The slot is released when the permit is destroyed.
+  class Permit {
+   public:
+    Permit() = default;
+    Permit(Permit&& other);
+    Permit& operator=(Permit&& other);
+    ~Permit();
+
+    Permit(const Permit&) = delete;
+    Permit& operator=(const Permit&) = delete;
+
+   private:
+    friend class AdmissionController;
+
+    void Release();
+
+    AdmissionController* controller_ = nullptr;
+    CostClass cost_class_ = CostClass::kSmall;
+    Priority priority_ = Priority::kInteractive;
+    int64_t start_ns_ = 0;
+  };
+
+  explicit AdmissionController(const Options& options);
+
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+
+  CostClass Classify(int64_t query_bytes) const;
+
+  Priority default_priority() const { return default_priority_; }
+
+  // Wait for a slot for a request whose query has `query_bytes` bytes. On success, `permit` holds
+  // the slot. Return RESOURCE_EXHAUSTED and set `retry_after` if the queue of the request is full,
+  // or the status of `cancellation` if it is cancelled while waiting.
+  absl::Status Admit(int64_t query_bytes, Priority priority, const CancellationToken* cancellation,
+                     Permit* permit, absl::Duration* retry_after);
+
+  // Same for an interactive request.
+  absl::Status Admit(int64_t query_bytes, const CancellationToken* cancellation, Permit* permit,
+                     absl::Duration* retry_after) {
+    return Admit(query_bytes, Priority::kInteractive, cancellation, permit, retry_after);
+  }
+
+  // Current state and counters of each class and priority, the interactive ones first.
+  std::vector<AdmissionStatsProto> Stats();
+
+  static absl::string_view CostClassName(CostClass cost_class);
+  static absl::string_view PriorityName(Priority priority);
+  // Parse a priority name ("interactive" or "batch"). Return false if the name is unknown.
+  static bool ParsePriority(absl::string_view name, Priority* priority);
+
+ private:
+  // A request waiting in a queue. It is admitted by the request releasing its slot.
+  struct Waiter {
+    bool admitted = false;
+  };
+
+  // The requests of one priority within a class.
+  struct Queue {
+    // Slots of the class the priority may hold.
+    int max_running = 0;
+    int running = 0;
+    std::deque<Waiter*> waiting;
+    // Virtual time of the priority in the stride scheduling: it advances by the inverse of the
+    // weight of the priority every time one of its requests is admitted from the queue.
+    double pass = 0;
+    double stride = 1;
+    int64_t admitted = 0;
+    int64_t rejected = 0;
+    int64_t cancelled = 0;
+  };
+
+  struct Lane {
+    ClassOptions options;
+    int running = 0;
+    std::array<Queue, kNumPriorities> queues;
+    // Pass of the last request admitted from a queue.
+    double virtual_time = 0;
+    // Signaled when a waiter of the lane is admitted.
+    absl::CondVar admitted_cv;
+    // Moving average of the time a request holds its slot, used to estimate retry-after.
+    double mean_service_ns = 0;
+  };
+
+  void Release(CostClass cost_class, Priority priority, int64_t service_ns);
+  // Hand the free slots of a lane over to its waiters.
+  void DispatchLocked(Lane& lane);
+  absl::Duration RetryAfterLocked(const Lane& lane, const Queue& queue) const;
+
+  const int64_t large_request_bytes_;
+  const Priority default_priority_;
+  absl::Mutex mutex_;
+  // Guarded by mutex_.
+  std::array<Lane, kNumCostClasses> lanes_;
+};
+
+}  // bigquery::utils::zetasql_helper::local_service
+
+#endif  // ZETASQL_HELPER_LOCAL_SERVICE_ADMISSION_CONTROLLER_H_
@@ -16,22 +16,38 @@
 
 #include "local_service.h"
 #include "zetasql_helper/token/token.h"
+#include "zetasql_helper/token/parameterize_literals.h"
+#include "zetasql_helper/token/semantic_tokens.h"
 #include "zetasql_helper/scanner/extract_function.h"
+#include "zetasql_helper/scanner/flat_ast.h"
 #include "zetasql/parser/keywords.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql_helper/scanner/locate_table.h"
+#include "zetasql_helper/scanner/repeated_subtrees.h"
+#include "zetasql_helper/scanner/rewrite_tables.h"
 #include "zetasql_helper/fixer/fix_column_not_grouped.h"
 #include "zetasql_helper/fixer/fix_duplicate_columns.h"
+#include "zetasql_helper/fixer/fixer_registry.h"
+#include "zetasql_helper/stats/heap_profiler.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/stats/trace_buffer.h"
 
 namespace bigquery::utils::zetasql_helper::local_service {
 
 absl::Status ZetaSqlHelperLocalServiceImpl::Tokenize(
     const TokenizeRequest& request,
-    TokenizeResponse* response) {
+    TokenizeResponse* response,
+    const CancellationToken* cancellation) {
 
   std::vector<zetasql::ParseToken> tokens;
-  ZETASQL_RETURN_IF_ERROR(::bigquery::utils::zetasql_helper::Tokenize(request.query(), tokens));
+  ZETASQL_RETURN_IF_ERROR(::bigquery::utils::zetasql_helper::Tokenize(request.query(), tokens, cancellation));
 
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  CancellationChecker checker(cancellation);
   for (auto &token : tokens) {
+    if (checker.Tick()) {
+      return checker.status();
+    }
     auto token_proto = ::bigquery::utils::zetasql_helper::serialize_token(token);
     response->add_parse_tokens()->CopyFrom(token_proto);
   }
@@ -40,14 +56,16 @@ absl::Status ZetaSqlHelperLocalServiceImpl::Tokenize(
 
 absl::Status ZetaSqlHelperLocalServiceImpl::ExtractFunctionRange(
     const ExtractFunctionRangeRequest& request,
-    ExtractFunctionRangeResponse* response) {
+    ExtractFunctionRangeResponse* response,
+    const CancellationToken* cancellation) {
 
   std::unique_ptr<::bigquery::utils::zetasql_helper::FunctionRange> output;
   ZETASQL_RETURN_IF_ERROR(
       ::bigquery::utils::zetasql_helper::ExtractFunctionRange(
-          request.query(), request.line_number(), request.column_number(), &output
+          request.query(), request.line_number(), request.column_number(), &output, cancellation
       ));
 
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
   auto status_or_function_range_proto = output->ToProto();
   ZETASQL_RETURN_IF_ERROR(status_or_function_range_proto.status());
 
@@ -60,11 +78,15 @@ absl::Status ZetaSqlHelperLocalServiceImpl::ExtractFunctionRange(
 }
 
 absl::Status ZetaSqlHelperLocalServiceImpl::LocateTableRanges(const LocateTableRangesRequest& request,
-                                                              LocateTableRangesResponse* response) {
+                                                              LocateTableRangesResponse* response,
+                                                              const CancellationToken* cancellation) {
   std::vector<zetasql::ParseLocationRange> ranges;
   ZETASQL_RETURN_IF_ERROR(
-      ::bigquery::utils::zetasql_helper::LocateTableRanges(request.query(), request.table_regex(), ranges)
+      ::bigquery::utils::zetasql_helper::LocateTableRanges(request.query(), request.table_regex(), ranges,
+                                                           cancellation)
   );
+
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
   for (const auto& range : ranges) {
     ZETASQL_ASSIGN_OR_RETURN(auto value, range.ToProto());
     response->add_table_ranges()->CopyFrom(value);
@@ -73,12 +95,113 @@ absl::Status ZetaSqlHelperLocalServiceImpl::LocateTableRanges(const LocateTableR
   return absl::Status();
 }
 
+absl::Status ZetaSqlHelperLocalServiceImpl::ExportAst(const ExportAstRequest& request,
+                                                      ExportAstResponse* response,
+                                                      const CancellationToken* cancellation) {
+  return ::bigquery::utils::zetasql_helper::ExportAst(request.query(), request.include_identifiers(),
+                                                      response->mutable_ast(), cancellation);
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::FindRepeatedSubtrees(const FindRepeatedSubtreesRequest& request,
+                                                                 FindRepeatedSubtreesResponse* response,
+                                                                 const CancellationToken* cancellation) {
+  RepeatedSubtreeFinder finder(request.min_size());
+  // A query failing to parse does not fail the others, but a cancellation stops the batch.
+  for (const auto& query : request.queries()) {
+    ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+    auto status = finder.AddQuery(query, cancellation);
+    if (status.code() == absl::StatusCode::kCancelled || status.code() == absl::StatusCode::kDeadlineExceeded) {
+      return status;
+    }
+    response->add_errors(std::string(status.message()));
+  }
+
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  for (const auto& subtree : finder.Find()) {
+    auto* subtree_proto = response->add_subtrees();
+    subtree_proto->set_fingerprint(subtree.fingerprint);
+    subtree_proto->set_size(subtree.size);
+    subtree_proto->set_kind(subtree.kind);
+    for (const auto& instance : subtree.instances) {
+      auto* instance_proto = subtree_proto->add_instances();
+      instance_proto->set_query_index(instance.query_index);
+      instance_proto->mutable_range()->set_start(instance.start);
+      instance_proto->mutable_range()->set_end(instance.end);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::RewriteTables(const RewriteTablesRequest& request,
+                                                          RewriteTablesResponse* response,
+                                                          const CancellationToken* cancellation) {
+  std::vector<TableRewrite> rewrites;
+  for (const auto& rewrite : request.rewrites()) {
+    if (rewrite.has_name_regex()) {
+      rewrites.push_back({rewrite.name_regex(), true, rewrite.replacement()});
+    } else {
+      rewrites.push_back({rewrite.name(), false, rewrite.replacement()});
+    }
+  }
+  std::unique_ptr<TableRewriter> rewriter;
+  ZETASQL_RETURN_IF_ERROR(TableRewriter::Create(rewrites, &rewriter));
+
+  // A query failing to parse does not fail the others, but a cancellation stops the batch.
+  for (const auto& query : request.queries()) {
+    ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+    auto* result = response->add_results();
+    int replacements = 0;
+    auto status = rewriter->Rewrite(query, result->mutable_rewritten_query(), &replacements, cancellation);
+    if (status.code() == absl::StatusCode::kCancelled || status.code() == absl::StatusCode::kDeadlineExceeded) {
+      return status;
+    }
+    if (!status.ok()) {
+      result->clear_rewritten_query();
+      result->set_error(std::string(status.message()));
+      continue;
+    }
+    result->set_replacements(replacements);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::ParameterizeLiterals(const ParameterizeLiteralsRequest& request,
+                                                                 ParameterizeLiteralsResponse* response,
+                                                                 const CancellationToken* cancellation) {
+  std::vector<QueryParameter> parameters;
+  ZETASQL_RETURN_IF_ERROR(::bigquery::utils::zetasql_helper::ParameterizeLiterals(
+      request.query(), response->mutable_parameterized_query(), &parameters, cancellation));
+
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  for (const auto& parameter : parameters) {
+    auto* parameter_proto = response->add_parameters();
+    parameter_proto->set_name(parameter.name);
+    parameter_proto->set_type(parameter.value.type()->TypeName(zetasql::PRODUCT_EXTERNAL));
+    ZETASQL_RETURN_IF_ERROR(parameter.value.Serialize(parameter_proto->mutable_value()));
+    ZETASQL_ASSIGN_OR_RETURN(*parameter_proto->mutable_literal_range(), parameter.range.ToProto());
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::GetSemanticTokens(const GetSemanticTokensRequest& request,
+                                                              GetSemanticTokensResponse* response,
+                                                              const CancellationToken* cancellation) {
+  return EncodeSemanticTokens(request.query(), request.start_line(), request.end_line(),
+                              response->mutable_semantic_tokens(), cancellation);
+}
+
 absl::Status ZetaSqlHelperLocalServiceImpl::GetAllKeywords(const GetAllKeywordsRequest& request,
                                                            GetAllKeywordsResponse* response) {
-  auto keywordInfos = zetasql::parser::GetAllKeywords();
-  for (const auto& keywordInfo : keywordInfos) {
-    response->add_keywords(keywordInfo.keyword());
-  }
+  // The keywords never change, so the response is only built once.
+  static const auto* keywords = []() {
+    auto* keywords = new GetAllKeywordsResponse();
+    for (const auto& keywordInfo : zetasql::parser::GetAllKeywords()) {
+      keywords->add_keywords(keywordInfo.keyword());
+    }
+    return keywords;
+  }();
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  response->CopyFrom(*keywords);
 
   return absl::Status();
 }
@@ -86,12 +209,14 @@ absl::Status ZetaSqlHelperLocalServiceImpl::GetAllKeywords(const GetAllKeywordsR
 
 absl::Status ZetaSqlHelperLocalServiceImpl::FixColumnNotGrouped(
     const FixColumnNotGroupedRequest& request,
-    FixColumnNotGroupedResponse* response) {
+    FixColumnNotGroupedResponse* response,
+    const CancellationToken* cancellation) {
 
   ZETASQL_ASSIGN_OR_RETURN(
       auto fixed_query,
       ::bigquery::utils::zetasql_helper::FixColumnNotGrouped(
-          request.query(), request.missing_column(), request.line_number(), request.column_number()
+          request.query(), request.missing_column(), request.line_number(), request.column_number(),
+          cancellation
       ));
 
   response->set_fixed_query(fixed_query);
@@ -100,17 +225,113 @@ absl::Status ZetaSqlHelperLocalServiceImpl::FixColumnNotGrouped(
 
 absl::Status ZetaSqlHelperLocalServiceImpl::FixDuplicateColumns(
     const FixDuplicateColumnsRequest& request,
-    FixDuplicateColumnsResponse* response) {
+    FixDuplicateColumnsResponse* response,
+    const CancellationToken* cancellation) {
 
   ZETASQL_ASSIGN_OR_RETURN(
       auto fixed_query,
       ::bigquery::utils::zetasql_helper::FixDuplicateColumns(
-          request.query(), request.duplicate_column()
+          request.query(), request.duplicate_column(), cancellation
       ));
 
   response->set_fixed_query(fixed_query);
   return absl::OkStatus();
 }
 
+absl::Status ZetaSqlHelperLocalServiceImpl::AutoFix(
+    const AutoFixRequest& request,
+    AutoFixResponse* response,
+    const CancellationToken* cancellation) {
+
+  std::vector<QueryFix> fixes;
+  ZETASQL_RETURN_IF_ERROR(FixerRegistry::Global().Fix(request.query(), request.error_message(), &fixes, cancellation));
+
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  for (const auto& fix : fixes) {
+    auto* fix_proto = response->add_fixes();
+    fix_proto->set_fixer(fix.fixer);
+    fix_proto->set_title(fix.title);
+    fix_proto->set_fixed_query(fix.fixed_query);
+    for (const auto& edit : fix.edits) {
+      auto* edit_proto = fix_proto->add_edits();
+      ZETASQL_ASSIGN_OR_RETURN(auto range, edit.range.ToProto());
+      edit_proto->mutable_range()->CopyFrom(range);
+      edit_proto->set_replacement(edit.replacement);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::LoadCatalog(
+    const LoadCatalogRequest& request,
+    LoadCatalogResponse* response) {
+
+  std::shared_ptr<const SchemaCatalog::Snapshot> snapshot;
+  if (request.has_json() || !request.has_path()) {
+    ZETASQL_RETURN_IF_ERROR(catalog_.Load(request.json(), request.replace(), &snapshot));
+  } else {
+    ZETASQL_RETURN_IF_ERROR(catalog_.LoadFile(request.path(), request.replace(), &snapshot));
+  }
+  response->set_catalog_version(snapshot->version());
+  response->set_table_count(snapshot->table_count());
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::AnalyzeQuery(
+    const AnalyzeQueryRequest& request,
+    AnalyzeQueryResponse* response,
+    const CancellationToken* cancellation) {
+
+  auto snapshot = catalog_.Current();
+  response->set_catalog_version(snapshot->version());
+  zetasql::TypeFactory type_factory;
+  std::unique_ptr<const zetasql::AnalyzerOutput> output;
+  auto status = AnalyzeBigQueryStatement(request.query(), *snapshot, &type_factory, &output, cancellation);
+  if (status.code() == absl::StatusCode::kInvalidArgument) {
+    // An invalid query is an answer, not a failure of the RPC.
+    response->set_error(std::string(status.message()));
+    return absl::OkStatus();
+  }
+  ZETASQL_RETURN_IF_ERROR(status);
+
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  if (output->resolved_statement()->node_kind() == zetasql::RESOLVED_QUERY_STMT) {
+    auto query = output->resolved_statement()->GetAs<zetasql::ResolvedQueryStmt>();
+    for (const auto& column : query->output_column_list()) {
+      auto* column_proto = response->add_output_columns();
+      column_proto->set_name(column->name());
+      column_proto->set_type(column->column().type()->TypeName(zetasql::PRODUCT_EXTERNAL));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::GetStats(
+    const GetStatsRequest& request,
+    GetStatsResponse* response) {
+
+  *response->mutable_stats() = stats::ServerStats::Global().Snapshot();
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::DumpTraces(
+    const DumpTracesRequest& request,
+    DumpTracesResponse* response) {
+
+  auto& traces = stats::TraceBuffer::Global();
+  response->set_json(traces.ToJson());
+  if (request.clear()) {
+    traces.Clear();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ZetaSqlHelperLocalServiceImpl::GetHeapProfile(
+    const GetHeapProfileRequest& request,
+    GetHeapProfileResponse* response) {
+
+  return stats::GetHeapProfile(response->mutable_heap_profile());
+}
+
 }//bigquery::utils::zetasql_helper::local_service
 
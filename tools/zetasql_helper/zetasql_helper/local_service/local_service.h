@@ -19,33 +19,86 @@
 
 #include "zetasql_helper/local_service/local_service.pb.h"
 #include "absl/status/status.h"
+#include "zetasql_helper/catalog/schema_catalog.h"
+#include "zetasql_helper/util/cancellation.h"
 
 namespace bigquery::utils::zetasql_helper::local_service {
 
+// The implementation of the RPCs. The methods parsing a query take an optional cancellation token,
+// and stop as soon as it is cancelled.
 class ZetaSqlHelperLocalServiceImpl {
  public:
   ZetaSqlHelperLocalServiceImpl(const ZetaSqlHelperLocalServiceImpl &) = delete;
   ZetaSqlHelperLocalServiceImpl &operator=(const ZetaSqlHelperLocalServiceImpl &) = delete;
 
   absl::Status Tokenize(const TokenizeRequest& req,
-                        TokenizeResponse* resp);
+                        TokenizeResponse* resp,
+                        const CancellationToken* cancellation = nullptr);
 
   absl::Status ExtractFunctionRange(const ExtractFunctionRangeRequest& request,
-                                    ExtractFunctionRangeResponse* response);
+                                    ExtractFunctionRangeResponse* response,
+                                    const CancellationToken* cancellation = nullptr);
 
   absl::Status LocateTableRanges(const LocateTableRangesRequest& request,
-                                 LocateTableRangesResponse* response);
+                                 LocateTableRangesResponse* response,
+                                 const CancellationToken* cancellation = nullptr);
+
+  absl::Status ExportAst(const ExportAstRequest& request,
+                         ExportAstResponse* response,
+                         const CancellationToken* cancellation = nullptr);
+
+  absl::Status FindRepeatedSubtrees(const FindRepeatedSubtreesRequest& request,
+                                    FindRepeatedSubtreesResponse* response,
+                                    const CancellationToken* cancellation = nullptr);
+
+  absl::Status RewriteTables(const RewriteTablesRequest& request,
+                             RewriteTablesResponse* response,
+                             const CancellationToken* cancellation = nullptr);
+
+  absl::Status ParameterizeLiterals(const ParameterizeLiteralsRequest& request,
+                                    ParameterizeLiteralsResponse* response,
+                                    const CancellationToken* cancellation = nullptr);
+
+  absl::Status GetSemanticTokens(const GetSemanticTokensRequest& request,
+                                 GetSemanticTokensResponse* response,
+                                 const CancellationToken* cancellation = nullptr);
 
   absl::Status GetAllKeywords(const GetAllKeywordsRequest&request,
                               GetAllKeywordsResponse* response);
 
   absl::Status FixColumnNotGrouped(const FixColumnNotGroupedRequest& request,
-                                   FixColumnNotGroupedResponse* response);
+                                   FixColumnNotGroupedResponse* response,
+                                   const CancellationToken* cancellation = nullptr);
 
   absl::Status FixDuplicateColumns(const FixDuplicateColumnsRequest& request,
-                                   FixDuplicateColumnsResponse* response);
+                                   FixDuplicateColumnsResponse* response,
+                                   const CancellationToken* cancellation = nullptr);
+
+  absl::Status AutoFix(const AutoFixRequest& request,
+                       AutoFixResponse* response,
+                       const CancellationToken* cancellation = nullptr);
+
+  absl::Status LoadCatalog(const LoadCatalogRequest& request,
+                           LoadCatalogResponse* response);
+
+  absl::Status AnalyzeQuery(const AnalyzeQueryRequest& request,
+                            AnalyzeQueryResponse* response,
+                            const CancellationToken* cancellation = nullptr);
+
+  absl::Status GetStats(const GetStatsRequest& request,
+                        GetStatsResponse* response);
+
+  absl::Status DumpTraces(const DumpTracesRequest& request,
+                          DumpTracesResponse* response);
+
+  absl::Status GetHeapProfile(const GetHeapProfileRequest& request,
+                              GetHeapProfileResponse* response);
 
   ZetaSqlHelperLocalServiceImpl() = default;
+
+ private:
+  // The tables loaded by LoadCatalog.
+  SchemaCatalog catalog_;
 };
 
 }
@@ -15,6 +15,12 @@
 //
 
 #include "zetasql_helper/local_service/local_service_grpc.h"
+#include "zetasql_helper/stats/server_stats.h"
+
+#include <optional>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 
 namespace {
 
@@ -59,49 +65,286 @@ grpc::Status ToGrpcStatus(absl::Status status) {
   }
   return grpc::Status(grpc_code, std::string(status.message()), "");
 }
+
+// The deadline of a call, or absl::InfiniteFuture() if it has none.
+absl::Time DeadlineOf(const grpc::ServerContext& context) {
+  auto deadline = context.deadline();
+  if (deadline == std::chrono::system_clock::time_point::max()) {
+    return absl::InfiniteFuture();
+  }
+  return absl::FromChrono(deadline);
+}
+
+// The size of the queries of a request, by which admission control classifies it.
+template<typename Request>
+int64_t QueryBytes(const Request& request) {
+  return request.query().size();
+}
+
+using bigquery::utils::zetasql_helper::local_service::FindRepeatedSubtreesRequest;
+using bigquery::utils::zetasql_helper::local_service::RewriteTablesRequest;
+
+int64_t TotalBytes(const google::protobuf::RepeatedPtrField<std::string>& queries) {
+  int64_t bytes = 0;
+  for (const auto& query : queries) {
+    bytes += query.size();
+  }
+  return bytes;
+}
+
+int64_t QueryBytes(const RewriteTablesRequest& request) {
+  return TotalBytes(request.queries());
+}
+
+int64_t QueryBytes(const FindRepeatedSubtreesRequest& request) {
+  return TotalBytes(request.queries());
+}
+
+// Metadata key of the priority of a call: "interactive" or "batch".
+constexpr char kPriorityMetadata[] = "x-zetasql-helper-priority";
+
+using bigquery::utils::zetasql_helper::stats::ServerStats;
+
+// Ids of the RPCs in the server stats. They are registered up front so that GetStats lists every
+// RPC, including the ones not called yet.
+const int kTokenizeRpc = ServerStats::Global().RegisterRpc("Tokenize");
+const int kExtractFunctionRangeRpc = ServerStats::Global().RegisterRpc("ExtractFunctionRange");
+const int kLocateTableRangesRpc = ServerStats::Global().RegisterRpc("LocateTableRanges");
+const int kExportAstRpc = ServerStats::Global().RegisterRpc("ExportAst");
+const int kFindRepeatedSubtreesRpc = ServerStats::Global().RegisterRpc("FindRepeatedSubtrees");
+const int kRewriteTablesRpc = ServerStats::Global().RegisterRpc("RewriteTables");
+const int kParameterizeLiteralsRpc = ServerStats::Global().RegisterRpc("ParameterizeLiterals");
+const int kGetSemanticTokensRpc = ServerStats::Global().RegisterRpc("GetSemanticTokens");
+const int kGetAllKeywordsRpc = ServerStats::Global().RegisterRpc("GetAllKeywords");
+const int kFixColumnNotGroupedRpc = ServerStats::Global().RegisterRpc("FixColumnNotGrouped");
+const int kFixDuplicateColumnsRpc = ServerStats::Global().RegisterRpc("FixDuplicateColumns");
+const int kAutoFixRpc = ServerStats::Global().RegisterRpc("AutoFix");
+const int kLoadCatalogRpc = ServerStats::Global().RegisterRpc("LoadCatalog");
+const int kAnalyzeQueryRpc = ServerStats::Global().RegisterRpc("AnalyzeQuery");
 }
 
 
 namespace bigquery::utils::zetasql_helper::local_service {
 using namespace bigquery::utils::zetasql_helper;
 
+ZetaSqlHelperLocalServiceGrpcImpl::ZetaSqlHelperLocalServiceGrpcImpl()
+    : ZetaSqlHelperLocalServiceGrpcImpl(AdmissionController::Options()) {}
+
+ZetaSqlHelperLocalServiceGrpcImpl::ZetaSqlHelperLocalServiceGrpcImpl(
+    const AdmissionController::Options& admission_options, ResultCache* cache)
+    : admission_(admission_options), cache_(cache) {}
+
+AdmissionController::Priority ZetaSqlHelperLocalServiceGrpcImpl::PriorityOf(
+    const grpc::ServerContext* context) const {
+  auto priority = admission_.default_priority();
+  if (context == nullptr) {
+    return priority;
+  }
+  auto it = context->client_metadata().find(kPriorityMetadata);
+  if (it != context->client_metadata().end()) {
+    // Unknown priorities get the default one.
+    AdmissionController::ParsePriority(absl::string_view(it->second.data(), it->second.size()), &priority);
+  }
+  return priority;
+}
+
+template<typename Request, typename Response>
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::Serve(
+    int rpc_id, const Request& request, Response* response,
+    absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*)) {
+  stats::RequestScope scope(rpc_id);
+  scope.set_request_bytes(request.ByteSizeLong());
+
+  auto status = (service_.*method)(request, response);
+
+  scope.set_ok(status.ok());
+  scope.set_response_bytes(response->ByteSizeLong());
+  return ToGrpcStatus(status);
+}
+
+template<typename Request, typename Response>
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::Serve(
+    int rpc_id, grpc::ServerContext* context, const Request& request, Response* response,
+    absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*, const CancellationToken*),
+    bool cacheable) {
+  stats::RequestScope scope(rpc_id);
+  scope.set_request_bytes(request.ByteSizeLong());
+
+  std::optional<CancellationToken> cancellation;
+  if (context != nullptr) {
+    cancellation.emplace([context]() { return context->IsCancelled(); }, DeadlineOf(*context));
+  }
+  auto token = cancellation ? &*cancellation : nullptr;
+  auto priority = PriorityOf(context);
+
+  auto request_bytes = request.SerializeAsString();
+  auto cache = cacheable ? cache_ : nullptr;
+  std::string rpc_name;
+  if (cache != nullptr) {
+    rpc_name = ServerStats::Global().RpcName(rpc_id);
+    std::string cached;
+    if (cache->Lookup(rpc_name, request_bytes, &cached) && response->ParseFromString(cached)) {
+      scope.set_cached(true);
+      scope.set_response_bytes(cached.size());
+      return grpc::Status();
+    }
+    response->Clear();
+  }
+
+  // Identical requests in flight are computed once. Only the computing request goes through
+  // admission control, so the waiting ones do not take its slots. Requests of different
+  // priorities are not coalesced, so that an interactive request never waits behind a batch one.
+  auto compute = [&](Response* computed) {
+    AdmissionController::Permit permit;
+    absl::Duration retry_after;
+    absl::Status status;
+    {
+      stats::ScopedPhase queue(stats::Phase::kQueue);
+      status = admission_.Admit(QueryBytes(request), priority, token, &permit, &retry_after);
+    }
+    if (status.ok()) {
+      status = (service_.*method)(request, computed, token);
+      if (status.ok() && cache != nullptr) {
+        cache->Insert(rpc_name, request_bytes, computed->SerializeAsString());
+      }
+    } else if (status.code() == absl::StatusCode::kResourceExhausted && context != nullptr) {
+      context->AddTrailingMetadata("grpc-retry-pushback-ms",
+                                   absl::StrCat(absl::ToInt64Milliseconds(retry_after)));
+    }
+    return status;
+  };
+  bool coalesced = false;
+  // Keyed by the request itself: a hash collision would give a request the response of another.
+  auto key = absl::StrCat(rpc_id, ":", static_cast<int>(priority), ":", request_bytes);
+  auto status = single_flight_.Do<Response>(key, token, response, compute, &coalesced);
+
+  scope.set_coalesced(coalesced);
+  scope.set_ok(status.ok());
+  scope.set_response_bytes(response->ByteSizeLong());
+  return ToGrpcStatus(status);
+}
+
 grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::Tokenize(grpc::ServerContext* context, const TokenizeRequest* request,
                                                          TokenizeResponse* response) {
-  return ToGrpcStatus(service_.Tokenize(*request, response));
+  return Serve(kTokenizeRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::Tokenize);
 }
 
 grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::ExtractFunctionRange(grpc::ServerContext* context,
                                                                      const ExtractFunctionRangeRequest* request,
                                                                      ExtractFunctionRangeResponse* response) {
-  return ToGrpcStatus(service_.ExtractFunctionRange(*request, response));
+  return Serve(kExtractFunctionRangeRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::ExtractFunctionRange);
 }
 
 grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::LocateTableRanges(grpc::ServerContext* context,
                                                                   const LocateTableRangesRequest* request,
                                                                   LocateTableRangesResponse* response) {
 
-  return ToGrpcStatus(service_.LocateTableRanges(*request, response));
+  return Serve(kLocateTableRangesRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::LocateTableRanges);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::ExportAst(grpc::ServerContext* context,
+                                                          const ExportAstRequest* request,
+                                                          ExportAstResponse* response) {
+  return Serve(kExportAstRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::ExportAst);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::FindRepeatedSubtrees(grpc::ServerContext* context,
+                                                                     const FindRepeatedSubtreesRequest* request,
+                                                                     FindRepeatedSubtreesResponse* response) {
+  return Serve(kFindRepeatedSubtreesRpc, context, *request, response,
+               &ZetaSqlHelperLocalServiceImpl::FindRepeatedSubtrees);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::RewriteTables(grpc::ServerContext* context,
+                                                              const RewriteTablesRequest* request,
+                                                              RewriteTablesResponse* response) {
+  return Serve(kRewriteTablesRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::RewriteTables);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::ParameterizeLiterals(grpc::ServerContext* context,
+                                                                     const ParameterizeLiteralsRequest* request,
+                                                                     ParameterizeLiteralsResponse* response) {
+  return Serve(kParameterizeLiteralsRpc, context, *request, response,
+               &ZetaSqlHelperLocalServiceImpl::ParameterizeLiterals);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::GetSemanticTokens(grpc::ServerContext* context,
+                                                                  const GetSemanticTokensRequest* request,
+                                                                  GetSemanticTokensResponse* response) {
+
+  return Serve(kGetSemanticTokensRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::GetSemanticTokens);
 }
 
 grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::GetAllKeywords(grpc::ServerContext* context,
                                                             const GetAllKeywordsRequest* request,
                                                             GetAllKeywordsResponse* response) {
 
-  return ToGrpcStatus(service_.GetAllKeywords(*request, response));
+  return Serve(kGetAllKeywordsRpc, *request, response, &ZetaSqlHelperLocalServiceImpl::GetAllKeywords);
 }
 
 grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::FixColumnNotGrouped(grpc::ServerContext* context,
                                                                     const FixColumnNotGroupedRequest* request,
                                                                     FixColumnNotGroupedResponse* response) {
 
-  return ToGrpcStatus(service_.FixColumnNotGrouped(*request, response));
+  return Serve(kFixColumnNotGroupedRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::FixColumnNotGrouped);
 }
 
 grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::FixDuplicateColumns(grpc::ServerContext* context,
                                                                     const FixDuplicateColumnsRequest* request,
                                                                     FixDuplicateColumnsResponse* response) {
 
-  return ToGrpcStatus(service_.FixDuplicateColumns(*request, response));
+  return Serve(kFixDuplicateColumnsRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::FixDuplicateColumns);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::AutoFix(grpc::ServerContext* context,
+                                                        const AutoFixRequest* request,
+                                                        AutoFixResponse* response) {
+
+  return Serve(kAutoFixRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::AutoFix);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::LoadCatalog(grpc::ServerContext* context,
+                                                            const LoadCatalogRequest* request,
+                                                            LoadCatalogResponse* response) {
+
+  return Serve(kLoadCatalogRpc, *request, response, &ZetaSqlHelperLocalServiceImpl::LoadCatalog);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::AnalyzeQuery(grpc::ServerContext* context,
+                                                             const AnalyzeQueryRequest* request,
+                                                             AnalyzeQueryResponse* response) {
+
+  // The result depends on the version of the catalog, so it is not cached across requests.
+  return Serve(kAnalyzeQueryRpc, context, *request, response, &ZetaSqlHelperLocalServiceImpl::AnalyzeQuery,
+               /*cacheable=*/false);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::GetStats(grpc::ServerContext* context,
+                                                         const GetStatsRequest* request,
+                                                         GetStatsResponse* response) {
+
+  auto status = service_.GetStats(*request, response);
+  for (const auto& lane : admission_.Stats()) {
+    *response->mutable_stats()->add_admission() = lane;
+  }
+  if (cache_ != nullptr) {
+    *response->mutable_stats()->mutable_cache() = cache_->Stats();
+  }
+  return ToGrpcStatus(status);
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::DumpTraces(grpc::ServerContext* context,
+                                                           const DumpTracesRequest* request,
+                                                           DumpTracesResponse* response) {
+
+  return ToGrpcStatus(service_.DumpTraces(*request, response));
+}
+
+grpc::Status ZetaSqlHelperLocalServiceGrpcImpl::GetHeapProfile(grpc::ServerContext* context,
+                                                               const GetHeapProfileRequest* request,
+                                                               GetHeapProfileResponse* response) {
+
+  return ToGrpcStatus(service_.GetHeapProfile(*request, response));
 }
 
 } // bigquery::utils::zetasql_helper::local_service
@@ -20,12 +20,22 @@
 #include "zetasql_helper/local_service/local_service.grpc.pb.h"
 #include "zetasql_helper/local_service/local_service.pb.h"
 #include "zetasql_helper/local_service/local_service.h"
+#include "zetasql_helper/local_service/admission_controller.h"
+#include "zetasql_helper/local_service/result_cache.h"
+#include "zetasql_helper/local_service/single_flight.h"
 
 namespace bigquery::utils::zetasql_helper::local_service {
 
-// Implementation of ZetaSql Helper LocalService Grpc service.
+// Implementation of ZetaSql Helper LocalService Grpc service. The RPCs taking a query go through
+// an AdmissionController before reaching the implementation, and identical concurrent requests
+// of these RPCs are coalesced by a SingleFlight. Their responses can also be kept in a persistent
+// ResultCache.
 class ZetaSqlHelperLocalServiceGrpcImpl : public ZetaSqlHelperLocalService::Service {
  public:
+  ZetaSqlHelperLocalServiceGrpcImpl();
+  // `cache` is optional, and must outlive the service.
+  explicit ZetaSqlHelperLocalServiceGrpcImpl(const AdmissionController::Options& admission_options,
+                                             ResultCache* cache = nullptr);
 
   grpc::Status Tokenize(grpc::ServerContext* context, const TokenizeRequest* request,
                         TokenizeResponse* response) override;
@@ -37,6 +47,25 @@ class ZetaSqlHelperLocalServiceGrpcImpl : public ZetaSqlHelperLocalService::Serv
                                  const LocateTableRangesRequest* request,
                                  LocateTableRangesResponse* response) override;
 
+  grpc::Status ExportAst(grpc::ServerContext* context,
+                         const ExportAstRequest* request,
+                         ExportAstResponse* response) override;
+
+  grpc::Status FindRepeatedSubtrees(grpc::ServerContext* context,
+                                    const FindRepeatedSubtreesRequest* request,
+                                    FindRepeatedSubtreesResponse* response) override;
+
+  grpc::Status RewriteTables(grpc::ServerContext* context,
+                             const RewriteTablesRequest* request,
+                             RewriteTablesResponse* response) override;
+
+  grpc::Status ParameterizeLiterals(grpc::ServerContext* context,
+                                    const ParameterizeLiteralsRequest* request,
+                                    ParameterizeLiteralsResponse* response) override;
+
+  grpc::Status GetSemanticTokens(grpc::ServerContext* context, const GetSemanticTokensRequest* request,
+                                 GetSemanticTokensResponse* response) override;
+
   grpc::Status GetAllKeywords(grpc::ServerContext* context,
                            const GetAllKeywordsRequest* request,
                            GetAllKeywordsResponse* response) override;
@@ -47,8 +76,50 @@ class ZetaSqlHelperLocalServiceGrpcImpl : public ZetaSqlHelperLocalService::Serv
   grpc::Status FixDuplicateColumns(grpc::ServerContext* context, const FixDuplicateColumnsRequest* request,
                                    FixDuplicateColumnsResponse* response) override;
 
+  grpc::Status AutoFix(grpc::ServerContext* context, const AutoFixRequest* request,
+                       AutoFixResponse* response) override;
+
+  grpc::Status LoadCatalog(grpc::ServerContext* context, const LoadCatalogRequest* request,
+                           LoadCatalogResponse* response) override;
+
+  grpc::Status AnalyzeQuery(grpc::ServerContext* context, const AnalyzeQueryRequest* request,
+                            AnalyzeQueryResponse* response) override;
+
+  grpc::Status GetStats(grpc::ServerContext* context, const GetStatsRequest* request,
+                        GetStatsResponse* response) override;
+
+  grpc::Status DumpTraces(grpc::ServerContext* context, const DumpTracesRequest* request,
+                          DumpTracesResponse* response) override;
+
+  grpc::Status GetHeapProfile(grpc::ServerContext* context, const GetHeapProfileRequest* request,
+                              GetHeapProfileResponse* response) override;
+
  private:
+  // Serve a request with a method of the implementation, and record it into the server stats.
+  template<typename Request, typename Response>
+  grpc::Status Serve(int rpc_id, const Request& request, Response* response,
+                     absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*));
+
+  // Same for the methods taking a query and a cancellation token. The response is taken from
+  // cache_ if it has one and the response only depends on the request (`cacheable`). Otherwise,
+  // if an identical request is in flight, the request waits for its response. Otherwise, the
+  // request is admitted by admission_ at the priority in the "x-zetasql-helper-priority" metadata
+  // of the call, and is rejected with the retry-after hint in the "grpc-retry-pushback-ms"
+  // trailing metadata if the server is saturated. The method is cancelled when the client
+  // cancels the call or when the deadline of the call passes. `context` may be null.
+  template<typename Request, typename Response>
+  grpc::Status Serve(int rpc_id, grpc::ServerContext* context, const Request& request, Response* response,
+                     absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*,
+                                                                           const CancellationToken*),
+                     bool cacheable = true);
+
+  // The priority a client asked for, or the default priority of admission_.
+  AdmissionController::Priority PriorityOf(const grpc::ServerContext* context) const;
+
   ZetaSqlHelperLocalServiceImpl service_;
+  AdmissionController admission_;
+  SingleFlight single_flight_;
+  ResultCache* cache_;
 };
 
 }  // bigquery::utils::zetasql_helper::local_service
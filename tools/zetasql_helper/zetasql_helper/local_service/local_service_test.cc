@@ -15,7 +15,22 @@
 //
 
 #include "googletest/include/gtest/gtest.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/notification.h"
+#include "zetasql_helper/local_service/admission_controller.h"
 #include "zetasql_helper/local_service/local_service_grpc.h"
+#include "zetasql_helper/local_service/prefork.h"
+#include "zetasql_helper/local_service/raw_dispatcher.h"
+#include "zetasql_helper/local_service/result_cache.h"
+#include "zetasql_helper/local_service/single_flight.h"
+#include "zetasql_helper/local_service/warmup.h"
 #include "zetasql/public/parse_location.h"
 
 namespace bigquery::utils::zetasql_helper::local_service {
@@ -88,6 +103,100 @@ TEST_F(LocalServiceTest, LocateTableRanges) {
   EXPECT_EQ("`austin_311`.311_request", range_to_string(query, response.table_ranges()[1]));
 }
 
+TEST_F(LocalServiceTest, ExportAst) {
+  ExportAstRequest request;
+  ExportAstResponse response;
+  request.set_query("SELECT status FROM t");
+  request.set_include_identifiers(true);
+  ASSERT_TRUE(GetService().ExportAst(nullptr, &request, &response).ok());
+
+  const auto& ast = response.ast();
+  EXPECT_LT(0, ast.node_count());
+  EXPECT_EQ(4 * ast.node_count(), ast.parents().size());
+  ASSERT_EQ(2, ast.identifiers_size());
+  EXPECT_EQ("status", ast.identifiers(0));
+  EXPECT_EQ("t", ast.identifiers(1));
+}
+
+TEST_F(LocalServiceTest, FindRepeatedSubtrees) {
+  FindRepeatedSubtreesRequest request;
+  FindRepeatedSubtreesResponse response;
+  std::string subquery = "(SELECT MAX(amount) FROM sales WHERE region = 'EU')";
+  request.add_queries("SELECT * FROM orders WHERE amount > " + subquery);
+  request.add_queries("SELECT");
+  request.add_queries("SELECT id, " + subquery + " AS best FROM customers");
+  request.set_min_size(5);
+  ASSERT_TRUE(GetService().FindRepeatedSubtrees(nullptr, &request, &response).ok());
+
+  ASSERT_EQ(3, response.errors_size());
+  EXPECT_TRUE(response.errors(0).empty());
+  EXPECT_FALSE(response.errors(1).empty());
+  ASSERT_EQ(1, response.subtrees_size());
+  const auto& subtree = response.subtrees(0);
+  EXPECT_EQ("ExpressionSubquery", subtree.kind());
+  ASSERT_EQ(2, subtree.instances_size());
+  EXPECT_EQ(0, subtree.instances(0).query_index());
+  EXPECT_EQ(36, subtree.instances(0).range().start());
+  EXPECT_EQ(2, subtree.instances(1).query_index());
+  EXPECT_EQ(11, subtree.instances(1).range().start());
+}
+
+TEST_F(LocalServiceTest, RewriteTables) {
+  RewriteTablesRequest request;
+  RewriteTablesResponse response;
+  request.add_queries("SELECT * FROM bigquery-public-data.`austin_311.311_request` JOIN d.t USING (id)");
+  request.add_queries("SELECT * FROM");
+  request.add_queries("SELECT * FROM d.t AS t1, d.t AS t2");
+  auto* rewrite = request.add_rewrites();
+  rewrite->set_name_regex("bigquery-public-data\\.(.*)");
+  rewrite->set_replacement("my-project.$1");
+  rewrite = request.add_rewrites();
+  rewrite->set_name("d.t");
+  rewrite->set_replacement("p.d.t");
+  ASSERT_TRUE(GetService().RewriteTables(nullptr, &request, &response).ok());
+
+  ASSERT_EQ(3, response.results_size());
+  EXPECT_EQ("SELECT * FROM `my-project.austin_311.311_request` JOIN p.d.t USING (id)",
+            response.results(0).rewritten_query());
+  EXPECT_EQ(2, response.results(0).replacements());
+  EXPECT_FALSE(response.results(1).error().empty());
+  EXPECT_EQ("SELECT * FROM p.d.t AS t1, p.d.t AS t2", response.results(2).rewritten_query());
+  EXPECT_EQ(2, response.results(2).replacements());
+}
+
+TEST_F(LocalServiceTest, ParameterizeLiterals) {
+  ParameterizeLiteralsRequest request;
+  ParameterizeLiteralsResponse response;
+  request.set_query("SELECT * FROM t WHERE status = 'closed' AND id > 100");
+  ASSERT_TRUE(GetService().ParameterizeLiterals(nullptr, &request, &response).ok());
+
+  EXPECT_EQ("SELECT * FROM t WHERE status = @p0 AND id > @p1", response.parameterized_query());
+  ASSERT_EQ(2, response.parameters_size());
+  EXPECT_EQ("p0", response.parameters(0).name());
+  EXPECT_EQ("STRING", response.parameters(0).type());
+  EXPECT_EQ("closed", response.parameters(0).value().string_value());
+  EXPECT_EQ(31, response.parameters(0).literal_range().start());
+  EXPECT_EQ(39, response.parameters(0).literal_range().end());
+  EXPECT_EQ("INT64", response.parameters(1).type());
+  EXPECT_EQ(100, response.parameters(1).value().int64_value());
+}
+
+TEST_F(LocalServiceTest, GetSemanticTokens) {
+  GetSemanticTokensRequest request;
+  GetSemanticTokensResponse response;
+  request.set_query("SELECT 1;\nSELECT status FROM t;\nSELECT 3;");
+  request.set_start_line(1);
+  request.set_end_line(2);
+  ASSERT_TRUE(GetService().GetSemanticTokens(nullptr, &request, &response).ok());
+
+  // SELECT, status, FROM, t and the semicolon, the first one on line 1.
+  const auto& data = response.semantic_tokens().data();
+  ASSERT_EQ(25, data.size());
+  EXPECT_EQ(1, data[0]);
+  EXPECT_EQ(SemanticTokensProto::COLUMN, data[8]);
+  EXPECT_EQ(SemanticTokensProto::TABLE, data[18]);
+}
+
 
 TEST_F(LocalServiceTest, GetAllKeywords) {
   GetAllKeywordsRequest request;
@@ -97,6 +206,23 @@ TEST_F(LocalServiceTest, GetAllKeywords) {
   EXPECT_EQ(231, response.keywords().size());
 }
 
+TEST_F(LocalServiceTest, AutoFix) {
+  AutoFixRequest request;
+  request.set_query("SELECT status, max(unique_key) FROM t");
+  request.set_error_message(
+      "SELECT list expression references column status which is neither grouped nor aggregated at [1:8]");
+
+  AutoFixResponse response;
+  ASSERT_TRUE(GetService().AutoFix(nullptr, &request, &response).ok());
+
+  ASSERT_EQ(1, response.fixes().size());
+  EXPECT_EQ("column_not_grouped", response.fixes(0).fixer());
+  EXPECT_EQ("SELECT status, max(unique_key) FROM t GROUP BY status", response.fixes(0).fixed_query());
+  ASSERT_EQ(1, response.fixes(0).edits().size());
+  EXPECT_EQ(37, response.fixes(0).edits(0).range().start());
+  EXPECT_EQ(37, response.fixes(0).edits(0).range().end());
+}
+
 TEST_F(LocalServiceTest, FixDuplicateColumns) {
   std::string query = "SELECT status, status FROM `bigquery-public-data.austin_311.311_request` LIMIT 1000";
   std::string duplicate_column = "status";
@@ -141,5 +267,535 @@ TEST_F(LocalServiceTest, FixColumnNotGrouped) {
             "GROUP BY status\n"
             "LIMIT 1000\n", response.fixed_query());
 }
+
+TEST_F(LocalServiceTest, LoadCatalogAndAnalyzeQuery) {
+  ZetaSqlHelperLocalServiceGrpcImpl service;
+  LoadCatalogRequest load_request;
+  LoadCatalogResponse load_response;
+  load_request.set_json(R"({"tables": [{"name": "dataset.t", "schema": {"fields": [{"name": "x", "type": "INT64"}]}}]})");
+  ASSERT_TRUE(service.LoadCatalog(nullptr, &load_request, &load_response).ok());
+  EXPECT_EQ(1, load_response.catalog_version());
+  EXPECT_EQ(1, load_response.table_count());
+
+  AnalyzeQueryRequest request;
+  AnalyzeQueryResponse response;
+  request.set_query("SELECT x, x + 1.5 AS y FROM dataset.t");
+  ASSERT_TRUE(service.AnalyzeQuery(nullptr, &request, &response).ok());
+  EXPECT_EQ(1, response.catalog_version());
+  EXPECT_EQ("", response.error());
+  ASSERT_EQ(2, response.output_columns_size());
+  EXPECT_EQ("x", response.output_columns(0).name());
+  EXPECT_EQ("INT64", response.output_columns(0).type());
+  EXPECT_EQ("FLOAT64", response.output_columns(1).type());
+
+  request.set_query("SELECT z FROM dataset.t");
+  response.Clear();
+  ASSERT_TRUE(service.AnalyzeQuery(nullptr, &request, &response).ok());
+  EXPECT_EQ("Unrecognized name: z [at 1:8]", response.error());
+}
+
+TEST_F(LocalServiceTest, Warmup) {
+  ZetaSqlHelperLocalServiceImpl service;
+  EXPECT_LT(0, Warmup(service, 1));
+
+  // The keywords are built once and copied into every response.
+  GetAllKeywordsRequest request;
+  GetAllKeywordsResponse first, second;
+  ASSERT_TRUE(service.GetAllKeywords(request, &first).ok());
+  ASSERT_TRUE(service.GetAllKeywords(request, &second).ok());
+  EXPECT_LT(0, first.keywords_size());
+  EXPECT_EQ(first.SerializeAsString(), second.SerializeAsString());
+}
+
+TEST_F(LocalServiceTest, GetStats) {
+  TokenizeRequest tokenize_request;
+  TokenizeResponse tokenize_response;
+  tokenize_request.set_query("select 1");
+  GetService().Tokenize(nullptr, &tokenize_request, &tokenize_response);
+
+  GetStatsRequest request;
+  GetStatsResponse response;
+  GetService().GetStats(nullptr, &request, &response);
+
+  const RpcStatsProto* tokenize_stats = nullptr;
+  for (const auto& rpc_stats : response.stats().rpcs()) {
+    if (rpc_stats.rpc() == "Tokenize") {
+      tokenize_stats = &rpc_stats;
+    }
+  }
+  ASSERT_NE(nullptr, tokenize_stats);
+  EXPECT_LE(1, tokenize_stats->count());
+  EXPECT_LT(0, tokenize_stats->request_bytes());
+  EXPECT_LT(0, tokenize_stats->response_bytes());
+  EXPECT_EQ("parse", tokenize_stats->phases(0).phase());
+  ASSERT_EQ(4, response.stats().admission_size());
+  EXPECT_EQ("small", response.stats().admission(0).lane());
+  EXPECT_EQ("interactive", response.stats().admission(0).priority());
+  EXPECT_LE(1, response.stats().admission(0).admitted());
+}
+
+TEST_F(LocalServiceTest, DumpTraces) {
+  DumpTracesRequest request;
+  DumpTracesResponse response;
+  request.set_clear(true);
+  // Drop the traces of the other tests, so that the next request is among the slowest ones.
+  GetService().DumpTraces(nullptr, &request, &response);
+
+  ExtractFunctionRangeRequest extract_request;
+  ExtractFunctionRangeResponse extract_response;
+  extract_request.set_query("select foo(1)");
+  extract_request.set_line_number(1);
+  extract_request.set_column_number(8);
+  GetService().ExtractFunctionRange(nullptr, &extract_request, &extract_response);
+
+  GetService().DumpTraces(nullptr, &request, &response);
+  EXPECT_NE(std::string::npos, response.json().find("\"rpc\":\"ExtractFunctionRange\""));
+  EXPECT_NE(std::string::npos, response.json().find("\"query_bytes\":13"));
+  EXPECT_NE(std::string::npos, response.json().find("\"ast_nodes\":"));
+
+  GetService().DumpTraces(nullptr, &request, &response);
+  EXPECT_EQ("{\"slowest\":[],\"sampled\":[]}", response.json());
+}
+
+class AdmissionControllerTest : public ::testing::Test {
+
+};
+
+TEST_F(AdmissionControllerTest, Classify) {
+  AdmissionController::Options options;
+  options.large_request_bytes = 100;
+  AdmissionController admission(options);
+  EXPECT_EQ(AdmissionController::CostClass::kSmall, admission.Classify(99));
+  EXPECT_EQ(AdmissionController::CostClass::kLarge, admission.Classify(100));
+}
+
+TEST_F(AdmissionControllerTest, QueueAndReject) {
+  AdmissionController::Options options;
+  options.large_request_bytes = 100;
+  options.small = {1, 1};
+  AdmissionController admission(options);
+  absl::Duration retry_after;
+
+  auto first = absl::make_unique<AdmissionController::Permit>();
+  ASSERT_TRUE(admission.Admit(10, nullptr, first.get(), &retry_after).ok());
+
+  // The second request waits for the first one.
+  absl::Notification second_admitted;
+  std::thread second([&]() {
+    AdmissionController::Permit permit;
+    EXPECT_TRUE(admission.Admit(10, nullptr, &permit, &retry_after).ok());
+    second_admitted.Notify();
+  });
+  while (admission.Stats()[0].queued() == 0) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+
+  // The queue is full, so the third one is rejected, while large requests are still admitted.
+  AdmissionController::Permit third;
+  auto status = admission.Admit(10, nullptr, &third, &retry_after);
+  EXPECT_EQ(absl::StatusCode::kResourceExhausted, status.code());
+  EXPECT_LT(absl::ZeroDuration(), retry_after);
+  AdmissionController::Permit large;
+  EXPECT_TRUE(admission.Admit(1000, nullptr, &large, &retry_after).ok());
+
+  EXPECT_FALSE(second_admitted.HasBeenNotified());
+  first.reset();
+  second.join();
+  EXPECT_TRUE(second_admitted.HasBeenNotified());
+
+  auto stats = admission.Stats();
+  EXPECT_EQ("small", stats[0].lane());
+  EXPECT_EQ(2, stats[0].admitted());
+  EXPECT_EQ(1, stats[0].rejected());
+  EXPECT_EQ(0, stats[0].running());
+  EXPECT_EQ(1, stats[1].running());
+}
+
+TEST_F(AdmissionControllerTest, CancelWhileQueued) {
+  AdmissionController::Options options;
+  options.small = {1, 1};
+  AdmissionController admission(options);
+  absl::Duration retry_after;
+
+  AdmissionController::Permit first;
+  ASSERT_TRUE(admission.Admit(10, nullptr, &first, &retry_after).ok());
+
+  CancellationToken cancellation([]() { return true; });
+  AdmissionController::Permit second;
+  auto status = admission.Admit(10, &cancellation, &second, &retry_after);
+  EXPECT_EQ(absl::StatusCode::kCancelled, status.code());
+  EXPECT_EQ(0, admission.Stats()[0].queued());
+  EXPECT_EQ(1, admission.Stats()[0].cancelled());
+}
+
+TEST_F(AdmissionControllerTest, ReserveInteractiveSlots) {
+  AdmissionController::Options options;
+  options.small = {4, 4};
+  options.interactive_reserved_share = 0.5;
+  AdmissionController admission(options);
+  absl::Duration retry_after;
+
+  AdmissionController::Permit batch[2];
+  for (auto& permit : batch) {
+    ASSERT_TRUE(admission.Admit(10, AdmissionController::Priority::kBatch, nullptr, &permit, &retry_after).ok());
+  }
+  // The last two slots are kept for the interactive requests.
+  CancellationToken cancellation([]() { return true; });
+  AdmissionController::Permit third_batch;
+  auto status = admission.Admit(10, AdmissionController::Priority::kBatch, &cancellation, &third_batch,
+                                &retry_after);
+  EXPECT_EQ(absl::StatusCode::kCancelled, status.code());
+  AdmissionController::Permit interactive[2];
+  for (auto& permit : interactive) {
+    EXPECT_TRUE(admission.Admit(10, nullptr, &permit, &retry_after).ok());
+  }
+
+  auto stats = admission.Stats();
+  ASSERT_EQ(4, stats.size());
+  EXPECT_EQ("interactive", stats[0].priority());
+  EXPECT_EQ(4, stats[0].max_concurrency());
+  EXPECT_EQ(2, stats[0].running());
+  EXPECT_EQ("batch", stats[2].priority());
+  EXPECT_EQ(2, stats[2].max_concurrency());
+  EXPECT_EQ(2, stats[2].running());
+  EXPECT_EQ(1, stats[2].cancelled());
+}
+
+TEST_F(AdmissionControllerTest, WeightedDispatch) {
+  AdmissionController::Options options;
+  options.small = {1, 8};
+  options.interactive_weight = 2;
+  options.batch_weight = 1;
+  options.interactive_reserved_share = 0;
+  AdmissionController admission(options);
+  absl::Duration retry_after;
+
+  auto first = absl::make_unique<AdmissionController::Permit>();
+  ASSERT_TRUE(admission.Admit(10, nullptr, first.get(), &retry_after).ok());
+
+  // Each waiter records its priority once admitted, and releases its slot to the next one.
+  absl::Mutex mutex;
+  std::vector<std::string> order;
+  std::vector<std::thread> waiters;
+  auto wait = [&](AdmissionController::Priority priority) {
+    AdmissionController::Permit permit;
+    EXPECT_TRUE(admission.Admit(10, priority, nullptr, &permit, &retry_after).ok());
+    absl::MutexLock lock(&mutex);
+    order.emplace_back(AdmissionController::PriorityName(priority));
+  };
+  for (int i = 0; i < 4; i++) {
+    waiters.emplace_back(wait, AdmissionController::Priority::kInteractive);
+  }
+  for (int i = 0; i < 2; i++) {
+    waiters.emplace_back(wait, AdmissionController::Priority::kBatch);
+  }
+  while (admission.Stats()[0].queued() + admission.Stats()[2].queued() < 6) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+
+  first.reset();
+  for (auto& waiter : waiters) {
+    waiter.join();
+  }
+  std::vector<std::string> expected = {"interactive", "batch", "interactive", "interactive", "batch", "interactive"};
+  EXPECT_EQ(expected, order);
+}
+
+class RawDispatcherTest : public ::testing::Test {
+
+};
+
+TEST_F(RawDispatcherTest, CallOnSerializedMessages) {
+  ZetaSqlHelperLocalServiceImpl service;
+  RawDispatcher dispatcher(&service);
+
+  TokenizeRequest request;
+  request.set_query("select 1 foo");
+  std::string response_bytes;
+  ASSERT_TRUE(dispatcher.Call("Tokenize", request.SerializeAsString(), &response_bytes).ok());
+
+  TokenizeResponse response;
+  ASSERT_TRUE(response.ParseFromString(response_bytes));
+  ASSERT_EQ(4, response.parse_tokens_size());
+  EXPECT_EQ("foo", response.parse_tokens(2).image());
+}
+
+TEST_F(RawDispatcherTest, Errors) {
+  ZetaSqlHelperLocalServiceImpl service;
+  RawDispatcher dispatcher(&service);
+  std::string response_bytes;
+
+  EXPECT_EQ(absl::StatusCode::kUnimplemented, dispatcher.Call("Unknown", "", &response_bytes).code());
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument,
+            dispatcher.Call("Tokenize", "not a proto", &response_bytes).code());
+
+  FixDuplicateColumnsRequest request;
+  request.set_query("select a from b");
+  request.set_duplicate_column("a");
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument,
+            dispatcher.Call("FixDuplicateColumns", request.SerializeAsString(), &response_bytes).code());
+}
+
+class SingleFlightTest : public ::testing::Test {
+ protected:
+  // Wait until `count` requests wait for a call computed by another thread.
+  void WaitForWaiters(int count) {
+    while (waiting_.load() < count) {
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+    // The waiters increment waiting_ just before joining the call.
+    absl::SleepFor(absl::Milliseconds(20));
+  }
+
+  std::atomic<int> waiting_{0};
+};
+
+TEST_F(SingleFlightTest, CoalesceIdenticalRequests) {
+  SingleFlight single_flight;
+  std::atomic<int> computed{0};
+  absl::Notification release;
+  std::function<absl::Status(TokenizeResponse*)> compute = [&](TokenizeResponse* response) {
+    computed++;
+    release.WaitForNotification();
+    response->add_parse_tokens()->set_image("foo");
+    return absl::OkStatus();
+  };
+
+  std::vector<std::thread> threads;
+  std::atomic<int> coalesced_count{0};
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&]() {
+      waiting_++;
+      TokenizeResponse response;
+      bool coalesced = false;
+      EXPECT_TRUE(single_flight.Do<TokenizeResponse>("key", nullptr, &response, compute, &coalesced).ok());
+      ASSERT_EQ(1, response.parse_tokens_size());
+      EXPECT_EQ("foo", response.parse_tokens(0).image());
+      coalesced_count += coalesced ? 1 : 0;
+    });
+  }
+  WaitForWaiters(4);
+
+  // A distinct request is computed independently.
+  TokenizeResponse other;
+  bool coalesced = true;
+  std::function<absl::Status(TokenizeResponse*)> compute_other = [](TokenizeResponse* response) {
+    response->add_parse_tokens()->set_image("bar");
+    return absl::OkStatus();
+  };
+  EXPECT_TRUE(single_flight.Do<TokenizeResponse>("other", nullptr, &other, compute_other, &coalesced).ok());
+  EXPECT_FALSE(coalesced);
+  EXPECT_EQ("bar", other.parse_tokens(0).image());
+
+  release.Notify();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(1, computed.load());
+  EXPECT_EQ(3, coalesced_count.load());
+  EXPECT_EQ(0, single_flight.InFlight());
+}
+
+TEST_F(SingleFlightTest, RecomputeAfterCancelledRequest) {
+  SingleFlight single_flight;
+  absl::Notification release;
+  std::function<absl::Status(TokenizeResponse*)> cancelled = [&](TokenizeResponse* response) {
+    release.WaitForNotification();
+    return absl::Status(absl::StatusCode::kCancelled, "cancelled");
+  };
+  std::thread leader([&]() {
+    TokenizeResponse response;
+    bool coalesced = false;
+    EXPECT_EQ(absl::StatusCode::kCancelled,
+              single_flight.Do<TokenizeResponse>("key", nullptr, &response, cancelled, &coalesced).code());
+  });
+  while (single_flight.InFlight() == 0) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+
+  std::thread waiter([&]() {
+    waiting_++;
+    TokenizeResponse response;
+    bool coalesced = true;
+    std::function<absl::Status(TokenizeResponse*)> compute = [](TokenizeResponse* response) {
+      response->add_parse_tokens()->set_image("foo");
+      return absl::OkStatus();
+    };
+    EXPECT_TRUE(single_flight.Do<TokenizeResponse>("key", nullptr, &response, compute, &coalesced).ok());
+    EXPECT_FALSE(coalesced);
+    EXPECT_EQ(1, response.parse_tokens_size());
+  });
+  WaitForWaiters(1);
+  release.Notify();
+  leader.join();
+  waiter.join();
 }
 
+TEST_F(SingleFlightTest, CancelWhileWaiting) {
+  SingleFlight single_flight;
+  absl::Notification release;
+  std::function<absl::Status(TokenizeResponse*)> compute = [&](TokenizeResponse* response) {
+    release.WaitForNotification();
+    return absl::OkStatus();
+  };
+  std::thread leader([&]() {
+    TokenizeResponse response;
+    bool coalesced = false;
+    EXPECT_TRUE(single_flight.Do<TokenizeResponse>("key", nullptr, &response, compute, &coalesced).ok());
+  });
+  while (single_flight.InFlight() == 0) {
+    absl::SleepFor(absl::Milliseconds(1));
+  }
+
+  CancellationToken cancellation([]() { return true; });
+  TokenizeResponse response;
+  bool coalesced = false;
+  EXPECT_EQ(absl::StatusCode::kCancelled,
+            single_flight.Do<TokenizeResponse>("key", &cancellation, &response, compute, &coalesced).code());
+  release.Notify();
+  leader.join();
+}
+
+class ResultCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "/result_cache_test_" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    unlink(path_.c_str());
+  }
+
+  std::string path_;
+};
+
+TEST_F(ResultCacheTest, InsertAndReopen) {
+  {
+    std::unique_ptr<ResultCache> cache;
+    ASSERT_TRUE(ResultCache::Open(path_, 1 << 20, &cache).ok());
+    std::string response;
+    EXPECT_FALSE(cache->Lookup("Tokenize", "select 1", &response));
+    cache->Insert("Tokenize", "select 1", "tokens");
+    ASSERT_TRUE(cache->Lookup("Tokenize", "select 1", &response));
+    EXPECT_EQ("tokens", response);
+    // The RPC is part of the key.
+    EXPECT_FALSE(cache->Lookup("LocateTableRanges", "select 1", &response));
+
+    // The file is locked while the cache is open.
+    std::unique_ptr<ResultCache> other;
+    EXPECT_EQ(absl::StatusCode::kFailedPrecondition, ResultCache::Open(path_, 1 << 20, &other).code());
+  }
+
+  std::unique_ptr<ResultCache> cache;
+  ASSERT_TRUE(ResultCache::Open(path_, 1 << 20, &cache).ok());
+  std::string response;
+  ASSERT_TRUE(cache->Lookup("Tokenize", "select 1", &response));
+  EXPECT_EQ("tokens", response);
+  auto stats = cache->Stats();
+  EXPECT_EQ(1, stats.entries());
+  EXPECT_EQ(1, stats.hits());
+}
+
+TEST_F(ResultCacheTest, DropTruncatedRecord) {
+  int64_t size;
+  {
+    std::unique_ptr<ResultCache> cache;
+    ASSERT_TRUE(ResultCache::Open(path_, 1 << 20, &cache).ok());
+    cache->Insert("Tokenize", "a", "first");
+    cache->Insert("Tokenize", "b", "second");
+    size = cache->Stats().bytes();
+  }
+  // Simulate a crash in the middle of the last write.
+  ASSERT_EQ(0, truncate(path_.c_str(), size - 2));
+
+  std::unique_ptr<ResultCache> cache;
+  ASSERT_TRUE(ResultCache::Open(path_, 1 << 20, &cache).ok());
+  std::string response;
+  EXPECT_TRUE(cache->Lookup("Tokenize", "a", &response));
+  EXPECT_FALSE(cache->Lookup("Tokenize", "b", &response));
+  cache->Insert("Tokenize", "b", "second");
+  EXPECT_TRUE(cache->Lookup("Tokenize", "b", &response));
+  EXPECT_EQ("second", response);
+}
+
+TEST_F(ResultCacheTest, CompactWhenFull) {
+  constexpr int64_t kMaxBytes = 4096;
+  std::unique_ptr<ResultCache> cache;
+  ASSERT_TRUE(ResultCache::Open(path_, kMaxBytes, &cache).ok());
+  std::string value(100, 'x');
+  for (int i = 0; i < 100; i++) {
+    cache->Insert("Tokenize", std::to_string(i), value);
+    EXPECT_LE(cache->Stats().bytes(), kMaxBytes);
+  }
+  std::string response;
+  EXPECT_TRUE(cache->Lookup("Tokenize", "99", &response));
+  EXPECT_EQ(value, response);
+  EXPECT_FALSE(cache->Lookup("Tokenize", "0", &response));
+  EXPECT_LT(0, cache->Stats().compactions());
+  EXPECT_EQ(0, cache->Stats().write_errors());
+}
+
+class PreforkTest : public ::testing::Test {
+
+};
+
+TEST_F(PreforkTest, SplitCpus) {
+  auto sets = SplitCpus({0, 1, 2, 3, 4}, 2);
+  ASSERT_EQ(2, sets.size());
+  EXPECT_EQ(std::vector<int>({0, 1}), sets[0]);
+  EXPECT_EQ(std::vector<int>({2, 3, 4}), sets[1]);
+
+  sets = SplitCpus({0, 1}, 3);
+  ASSERT_EQ(3, sets.size());
+  EXPECT_EQ(std::vector<int>({0}), sets[2]);
+}
+
+TEST_F(PreforkTest, RestartCrashedWorker) {
+  // The workers only share the file system with the test.
+  auto marker = ::testing::TempDir() + "/prefork_test_crashed";
+  unlink(marker.c_str());
+
+  PreforkOptions options;
+  options.workers = 2;
+  options.pin_cpus = false;
+  options.min_restart_delay = absl::ZeroDuration();
+  auto status = RunPreforked(options, [&](int index) {
+    if (index == 0 && access(marker.c_str(), F_OK) != 0) {
+      // Crash on the first run.
+      fclose(fopen(marker.c_str(), "w"));
+      raise(SIGKILL);
+    }
+    return 0;
+  });
+  EXPECT_EQ(0, status);
+  EXPECT_EQ(0, access(marker.c_str(), F_OK));
+}
+
+TEST_F(PreforkTest, StopWorkersWhenOneFails) {
+  PreforkOptions options;
+  options.workers = 2;
+  options.pin_cpus = false;
+  auto status = RunPreforked(options, [](int index) {
+    if (index == 0) {
+      return 3;
+    }
+    // Wait to be stopped.
+    pause();
+    return 0;
+  });
+  EXPECT_EQ(3, status);
+}
+
+TEST_F(PreforkTest, StopOnSigterm) {
+  PreforkOptions options;
+  options.workers = 2;
+  options.pin_cpus = false;
+  auto status = RunPreforked(options, [](int index) {
+    if (index == 1) {
+      // Stop the supervisor while it may still be starting the workers.
+      kill(getppid(), SIGTERM);
+    }
+    pause();
+    return 0;
+  });
+  EXPECT_EQ(0, status);
+}
+}
@@ -0,0 +1,243 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/local_service/prefork.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "absl/time/clock.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+namespace {
+
+struct Worker {
+  pid_t pid = -1;
+  absl::Time start;
+};
+
+// The CPUs the current process may run on.
+std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return cpus;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+// Fork a worker. Return its pid in the supervisor, or -1 if the fork failed. `mask` is the signal
+// mask to restore in the worker.
+pid_t StartWorker(int index, const std::vector<int>& cpus, const sigset_t& mask,
+                  const std::function<int(int)>& worker) {
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = fork();
+  if (pid != 0) {
+    return pid;
+  }
+
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGINT, SIG_DFL);
+  sigprocmask(SIG_SETMASK, &mask, nullptr);
+  if (!cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+      CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      std::cerr << "Unable to pin worker " << index << ": " << std::strerror(errno) << std::endl;
+    }
+  }
+  auto status = worker(index);
+  std::cout.flush();
+  std::cerr.flush();
+  // Skip the exit handlers inherited from the supervisor.
+  _exit(status);
+}
+
+// Wait until one of the blocked `signals` is pending, or until `deadline`, and return it, or 0 on
+// timeout. Spurious wake-ups also return 0.
+int WaitForSignal(const sigset_t& signals, absl::Time deadline) {
+  if (deadline == absl::InfiniteFuture()) {
+    int signal = sigwaitinfo(&signals, nullptr);
+    return signal < 0 ? 0 : signal;
+  }
+  auto timeout = absl::ToTimespec(std::max(deadline - absl::Now(), absl::ZeroDuration()));
+  int signal = sigtimedwait(&signals, nullptr, &timeout);
+  return signal < 0 ? 0 : signal;
+}
+
+bool IsStopSignal(int signal) {
+  return signal == SIGTERM || signal == SIGINT;
+}
+
+void StopWorkers(const std::vector<Worker>& workers) {
+  for (const auto& worker : workers) {
+    if (worker.pid > 0) {
+      kill(worker.pid, SIGTERM);
+    }
+  }
+}
+
+}
+
+std::vector<std::vector<int>> SplitCpus(const std::vector<int>& cpus, int workers) {
+  std::vector<std::vector<int>> sets(workers);
+  if (cpus.empty()) {
+    return sets;
+  }
+  if (cpus.size() < workers) {
+    for (int i = 0; i < workers; i++) {
+      sets[i].push_back(cpus[i % cpus.size()]);
+    }
+    return sets;
+  }
+  for (int i = 0; i < workers; i++) {
+    auto begin = cpus.size() * i / workers;
+    auto end = cpus.size() * (i + 1) / workers;
+    sets[i].assign(cpus.begin() + begin, cpus.begin() + end);
+  }
+  return sets;
+}
+
+int RunPreforked(const PreforkOptions& options, const std::function<int(int)>& worker) {
+  std::vector<std::vector<int>> cpu_sets(options.workers);
+  if (options.pin_cpus) {
+    cpu_sets = SplitCpus(AllowedCpus(), options.workers);
+  }
+
+  // The signals stay blocked in the supervisor, which only takes them with sigwaitinfo() and
+  // sigtimedwait(). A SIGTERM or SIGCHLD arriving while the supervisor is not waiting stays
+  // pending instead of being lost between a check and a blocking waitpid().
+  sigset_t signals, old_mask;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &signals, &old_mask);
+
+  int result = 0;
+  bool stopping = false;
+  int running = 0;
+  std::vector<Worker> workers(options.workers);
+  for (int i = 0; i < options.workers; i++) {
+    workers[i].pid = StartWorker(i, cpu_sets[i], old_mask, worker);
+    workers[i].start = absl::Now();
+    if (workers[i].pid < 0) {
+      std::cerr << "Unable to start worker " << i << ": " << std::strerror(errno) << std::endl;
+      result = 1;
+      stopping = true;
+      StopWorkers(workers);
+      break;
+    }
+    running++;
+  }
+
+  while (running > 0) {
+    int status;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (pid == 0) {
+      // No worker exited yet: wait for a SIGCHLD or a stop signal.
+      if (IsStopSignal(WaitForSignal(signals, absl::InfiniteFuture())) && !stopping) {
+        stopping = true;
+        StopWorkers(workers);
+      }
+      continue;
+    }
+    int index = 0;
+    while (index < workers.size() && workers[index].pid != pid) {
+      index++;
+    }
+    if (index == workers.size()) {
+      continue;
+    }
+    workers[index].pid = -1;
+    running--;
+    if (stopping) {
+      continue;
+    }
+
+    if (WIFEXITED(status)) {
+      if (WEXITSTATUS(status) != 0) {
+        // The worker could not start, and the other ones will not either.
+        std::cerr << "Worker " << index << " exited with status " << WEXITSTATUS(status) << std::endl;
+        result = WEXITSTATUS(status);
+        stopping = true;
+        StopWorkers(workers);
+      }
+      continue;
+    }
+
+    std::cerr << "Worker " << index << " (pid " << pid << ") was killed by signal "
+              << (WIFSIGNALED(status) ? WTERMSIG(status) : 0) << ", restarting it" << std::endl;
+    // Wait for the rest of the restart delay, but stop right away on SIGTERM. A SIGCHLD consumed
+    // here is harmless, since the loop reaps with waitpid() before waiting again.
+    auto deadline = workers[index].start + options.min_restart_delay;
+    while (!stopping && absl::Now() < deadline) {
+      if (IsStopSignal(WaitForSignal(signals, deadline))) {
+        stopping = true;
+        StopWorkers(workers);
+      }
+    }
+    if (stopping) {
+      continue;
+    }
+    workers[index].pid = StartWorker(index, cpu_sets[index], old_mask, worker);
+    workers[index].start = absl::Now();
+    if (workers[index].pid < 0) {
+      std::cerr << "Unable to restart worker " << index << ": " << std::strerror(errno) << std::endl;
+      result = 1;
+      stopping = true;
+      StopWorkers(workers);
+      continue;
+    }
+    running++;
+  }
+
+  // Discard the signals that arrived too late to be handled, as the handlers used to, instead of
+  // delivering them once unblocked.
+  struct timespec no_wait = {0, 0};
+  while (sigtimedwait(&signals, nullptr, &no_wait) > 0) {
+  }
+  sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+  return result;
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
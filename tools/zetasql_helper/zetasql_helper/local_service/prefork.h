@@ -0,0 +1,56 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LOCAL_SERVICE_PREFORK_H_
+#define ZETASQL_HELPER_LOCAL_SERVICE_PREFORK_H_
+
+#include <functional>
+#include <vector>
+
+#include "absl/time/time.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+struct PreforkOptions {
+  // Number of worker processes.
+  int workers = 1;
+  // Pin each worker to its own share of the CPUs the supervisor may run on.
+  bool pin_cpus = true;
+  // A worker crashing sooner than this after its start is restarted after the rest of the delay,
+  // so that a query crashing the workers on startup does not make them spin.
+  absl::Duration min_restart_delay = absl::Seconds(1);
+};
+
+// Split `cpus` into `workers` contiguous sets of nearly equal sizes. If there are fewer CPUs than
+// workers, the CPUs are shared round-robin.
+std::vector<std::vector<int>> SplitCpus(const std::vector<int>& cpus, int workers);
+
+// Run `worker(index)` in `options.workers` child processes, and supervise them. The workers are
+// expected to share their listening ports with SO_REUSEPORT, so that the kernel spreads the
+// connections among them, and a crash only takes down the requests of one worker.
+//
+// A worker killed by a signal (e.g. a segmentation fault on a malformed query) is restarted. If a
+// worker exits with a non-zero status, which means it could not start, the other workers are
+// stopped and the status is returned. SIGTERM and SIGINT are forwarded to the workers. Return 0
+// once all the workers exited with status 0 or were stopped by a signal.
+//
+// Must be called before any thread is started, since only the calling thread survives fork().
+int RunPreforked(const PreforkOptions& options, const std::function<int(int)>& worker);
+
+}  // bigquery::utils::zetasql_helper::local_service
+
+#endif  // ZETASQL_HELPER_LOCAL_SERVICE_PREFORK_H_
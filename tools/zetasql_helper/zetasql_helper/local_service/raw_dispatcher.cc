@@ -0,0 +1,104 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/local_service/raw_dispatcher.h"
+
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/stats/server_stats.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+template<typename Request, typename Response, typename Invoke>
+void RawDispatcher::RegisterHandler(absl::string_view name, Invoke invoke) {
+  auto rpc_id = stats::ServerStats::Global().RegisterRpc(name);
+  handlers_[name] = [invoke, rpc_id](absl::string_view request_bytes, std::string* response_bytes,
+                                     const CancellationToken* cancellation) {
+    stats::RequestScope scope(rpc_id);
+    scope.set_request_bytes(request_bytes.size());
+
+    Request request;
+    if (!request.ParseFromArray(request_bytes.data(), request_bytes.size())) {
+      scope.set_ok(false);
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("Unable to parse ", Request::descriptor()->name(), "."));
+    }
+    Response response;
+    auto status = invoke(request, &response, cancellation);
+    if (status.ok()) {
+      response.SerializeToString(response_bytes);
+    }
+
+    scope.set_ok(status.ok());
+    scope.set_response_bytes(response_bytes->size());
+    return status;
+  };
+  methods_.emplace_back(name);
+}
+
+template<typename Request, typename Response>
+void RawDispatcher::Register(
+    absl::string_view name,
+    absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*, const CancellationToken*)) {
+  auto service = service_;
+  RegisterHandler<Request, Response>(
+      name, [service, method](const Request& request, Response* response, const CancellationToken* cancellation) {
+        return (service->*method)(request, response, cancellation);
+      });
+}
+
+template<typename Request, typename Response>
+void RawDispatcher::Register(
+    absl::string_view name,
+    absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*)) {
+  auto service = service_;
+  RegisterHandler<Request, Response>(
+      name, [service, method](const Request& request, Response* response, const CancellationToken*) {
+        return (service->*method)(request, response);
+      });
+}
+
+RawDispatcher::RawDispatcher(ZetaSqlHelperLocalServiceImpl* service) : service_(service) {
+  Register("Tokenize", &ZetaSqlHelperLocalServiceImpl::Tokenize);
+  Register("ExtractFunctionRange", &ZetaSqlHelperLocalServiceImpl::ExtractFunctionRange);
+  Register("LocateTableRanges", &ZetaSqlHelperLocalServiceImpl::LocateTableRanges);
+  Register("ExportAst", &ZetaSqlHelperLocalServiceImpl::ExportAst);
+  Register("FindRepeatedSubtrees", &ZetaSqlHelperLocalServiceImpl::FindRepeatedSubtrees);
+  Register("RewriteTables", &ZetaSqlHelperLocalServiceImpl::RewriteTables);
+  Register("ParameterizeLiterals", &ZetaSqlHelperLocalServiceImpl::ParameterizeLiterals);
+  Register("GetSemanticTokens", &ZetaSqlHelperLocalServiceImpl::GetSemanticTokens);
+  Register("GetAllKeywords", &ZetaSqlHelperLocalServiceImpl::GetAllKeywords);
+  Register("FixColumnNotGrouped", &ZetaSqlHelperLocalServiceImpl::FixColumnNotGrouped);
+  Register("FixDuplicateColumns", &ZetaSqlHelperLocalServiceImpl::FixDuplicateColumns);
+  Register("AutoFix", &ZetaSqlHelperLocalServiceImpl::AutoFix);
+  Register("LoadCatalog", &ZetaSqlHelperLocalServiceImpl::LoadCatalog);
+  Register("AnalyzeQuery", &ZetaSqlHelperLocalServiceImpl::AnalyzeQuery);
+  Register("GetStats", &ZetaSqlHelperLocalServiceImpl::GetStats);
+  Register("DumpTraces", &ZetaSqlHelperLocalServiceImpl::DumpTraces);
+  Register("GetHeapProfile", &ZetaSqlHelperLocalServiceImpl::GetHeapProfile);
+}
+
+absl::Status RawDispatcher::Call(absl::string_view method, absl::string_view request, std::string* response,
+                                 const CancellationToken* cancellation) const {
+  auto handler = handlers_.find(method);
+  if (handler == handlers_.end()) {
+    return absl::Status(absl::StatusCode::kUnimplemented, absl::StrCat("Unknown method ", method, "."));
+  }
+  response->clear();
+  return handler->second(request, response, cancellation);
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
@@ -0,0 +1,77 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LOCAL_SERVICE_RAW_DISPATCHER_H_
+#define ZETASQL_HELPER_LOCAL_SERVICE_RAW_DISPATCHER_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "zetasql_helper/local_service/local_service.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+// Calls the methods of ZetaSqlHelperLocalServiceImpl on serialized requests and responses, by the
+// name of the RPC (e.g. "Tokenize"). It lets in-process callers, like the JNI binding, use the
+// service without a gRPC server. The calls are recorded into the server stats like gRPC calls.
+//
+// The dispatcher is thread-safe.
+class RawDispatcher {
+ public:
+  explicit RawDispatcher(ZetaSqlHelperLocalServiceImpl* service);
+
+  RawDispatcher(const RawDispatcher&) = delete;
+  RawDispatcher& operator=(const RawDispatcher&) = delete;
+
+  // Parse `request` as the request of `method`, call the method and serialize its response into
+  // `response`. Return kUnimplemented for an unknown method, and kInvalidArgument if the request
+  // cannot be parsed.
+  absl::Status Call(absl::string_view method, absl::string_view request, std::string* response,
+                    const CancellationToken* cancellation = nullptr) const;
+
+  // Names of the methods, in registration order.
+  const std::vector<std::string>& methods() const { return methods_; }
+
+ private:
+  using Handler = std::function<absl::Status(absl::string_view, std::string*, const CancellationToken*)>;
+
+  template<typename Request, typename Response>
+  void Register(absl::string_view name,
+                absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*,
+                                                                      const CancellationToken*));
+
+  template<typename Request, typename Response>
+  void Register(absl::string_view name,
+                absl::Status (ZetaSqlHelperLocalServiceImpl::*method)(const Request&, Response*));
+
+  // Register a handler parsing a Request, calling `invoke` and serializing its Response.
+  template<typename Request, typename Response, typename Invoke>
+  void RegisterHandler(absl::string_view name, Invoke invoke);
+
+  ZetaSqlHelperLocalServiceImpl* service_;
+  absl::flat_hash_map<std::string, Handler> handlers_;
+  std::vector<std::string> methods_;
+};
+
+}  // bigquery::utils::zetasql_helper::local_service
+
+#endif  // ZETASQL_HELPER_LOCAL_SERVICE_RAW_DISPATCHER_H_
@@ -0,0 +1,373 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zetasql_helper/local_service/result_cache.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/util/fingerprint.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+namespace {
+
+// The last character is the version of the record format.
+constexpr char kMagic[8] = {'Z', 'S', 'H', 'C', 'A', 'C', 'H', '2'};
+
+struct FileHeader {
+  char magic[8];
+  // Fingerprint64 of kResultVersion.
+  uint64_t version;
+};
+
+// A record is its header, the RPC and the request separated by a NUL character (the key data),
+// and the value.
+struct RecordHeader {
+  uint64_t key_high;
+  uint64_t key_low;
+  uint32_t value_size;
+  uint32_t key_data_size;
+  // Checksum of the key, the key data and the value.
+  uint64_t checksum;
+};
+
+constexpr int64_t kFileHeaderSize = sizeof(FileHeader);
+constexpr int64_t kRecordHeaderSize = sizeof(RecordHeader);
+
+// Seeds of the two halves of a key.
+constexpr uint64_t kKeyHighSeed = 0x5a4853514c686967;
+constexpr uint64_t kKeyLowSeed = 0x5a4853514c6c6f77;
+
+// `payload` is the key data followed by the value.
+uint64_t Checksum(const RecordHeader& header, absl::string_view payload) {
+  return Fingerprint64(payload, header.key_high ^ header.key_low ^ header.value_size ^
+      (static_cast<uint64_t>(header.key_data_size) << 32));
+}
+
+int64_t RecordSize(const RecordHeader& header) {
+  return kRecordHeaderSize + header.key_data_size + header.value_size;
+}
+
+// Whether the key data of a record is `rpc` and `request`.
+bool KeyDataMatches(absl::string_view key_data, absl::string_view rpc, absl::string_view request) {
+  return key_data.size() == rpc.size() + 1 + request.size() && key_data.substr(0, rpc.size()) == rpc &&
+      key_data[rpc.size()] == '\0' && key_data.substr(rpc.size() + 1) == request;
+}
+
+FileHeader MakeFileHeader() {
+  FileHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = Fingerprint64(kResultVersion);
+  return header;
+}
+
+absl::Status ErrnoStatus(absl::string_view action, const std::string& path) {
+  return absl::Status(absl::StatusCode::kInternal,
+                      absl::StrCat("unable to ", action, " ", path, ": ", std::strerror(errno)));
+}
+
+// Write all of `data` at `offset`.
+bool WriteAt(int fd, absl::string_view data, int64_t offset) {
+  while (!data.empty()) {
+    auto written = pwrite(fd, data.data(), data.size(), offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(written);
+    offset += written;
+  }
+  return true;
+}
+
+absl::string_view AsBytes(const void* data, size_t size) {
+  return absl::string_view(static_cast<const char*>(data), size);
+}
+
+}
+
+ResultCache::ResultCache(std::string path, int64_t max_bytes) : path_(std::move(path)), max_bytes_(max_bytes) {}
+
+absl::Status ResultCache::Open(const std::string& path, int64_t max_bytes, std::unique_ptr<ResultCache>* cache) {
+  if (max_bytes < kFileHeaderSize + kRecordHeaderSize) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, "the maximum size of the cache is too small");
+  }
+  std::unique_ptr<ResultCache> result(new ResultCache(path, max_bytes));
+  {
+    absl::MutexLock lock(&result->mutex_);
+    auto status = result->Load();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  *cache = std::move(result);
+  return absl::OkStatus();
+}
+
+ResultCache::~ResultCache() {
+  Unmap();
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+  if (lock_fd_ >= 0) {
+    // Closing the file releases the lock.
+    close(lock_fd_);
+  }
+}
+
+ResultCache::Key ResultCache::MakeKey(absl::string_view rpc, absl::string_view request) {
+  auto data = absl::StrCat(rpc, absl::string_view("\0", 1), kResultVersion, absl::string_view("\0", 1), request);
+  return {Fingerprint64(data, kKeyHighSeed), Fingerprint64(data, kKeyLowSeed)};
+}
+
+absl::Status ResultCache::Load() {
+  auto lock_path = path_ + ".lock";
+  lock_fd_ = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (lock_fd_ < 0) {
+    return ErrnoStatus("open", lock_path);
+  }
+  if (flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) {
+    return absl::Status(absl::StatusCode::kFailedPrecondition, absl::StrCat(path_, " is used by another process"));
+  }
+  fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    return ErrnoStatus("open", path_);
+  }
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) != 0) {
+    return ErrnoStatus("stat", path_);
+  }
+  end_ = file_stat.st_size;
+  auto status = Remap();
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto expected = MakeFileHeader();
+  FileHeader header;
+  if (end_ >= kFileHeaderSize) {
+    std::memcpy(&header, map_, kFileHeaderSize);
+  }
+  if (end_ < kFileHeaderSize || std::memcmp(header.magic, expected.magic, sizeof(kMagic)) != 0 ||
+      header.version != expected.version) {
+    // A new file, or the results of another version.
+    Unmap();
+    if (ftruncate(fd_, 0) != 0 || !WriteAt(fd_, AsBytes(&expected, kFileHeaderSize), 0)) {
+      return ErrnoStatus("initialize", path_);
+    }
+    end_ = kFileHeaderSize;
+    return Remap();
+  }
+
+  // Index the records up to the first truncated or corrupted one.
+  int64_t offset = kFileHeaderSize;
+  while (offset + kRecordHeaderSize <= end_) {
+    RecordHeader record;
+    std::memcpy(&record, map_ + offset, kRecordHeaderSize);
+    auto record_end = offset + RecordSize(record);
+    if (record_end > end_ ||
+        record.checksum != Checksum(record, AsBytes(map_ + offset + kRecordHeaderSize, record_end - offset -
+            kRecordHeaderSize))) {
+      break;
+    }
+    index_[{record.key_high, record.key_low}] = {offset, record_end - offset};
+    offset = record_end;
+  }
+  if (offset < end_) {
+    Unmap();
+    if (ftruncate(fd_, offset) != 0) {
+      return ErrnoStatus("truncate", path_);
+    }
+    end_ = offset;
+    return Remap();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ResultCache::Remap() {
+  Unmap();
+  if (end_ == 0) {
+    return absl::OkStatus();
+  }
+  auto* map = mmap(nullptr, end_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    return ErrnoStatus("map", path_);
+  }
+  map_ = static_cast<const char*>(map);
+  map_size_ = end_;
+  return absl::OkStatus();
+}
+
+void ResultCache::Unmap() {
+  if (map_ != nullptr) {
+    munmap(const_cast<char*>(map_), map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+  }
+}
+
+bool ResultCache::Lookup(absl::string_view rpc, absl::string_view request, std::string* response) {
+  auto key = MakeKey(rpc, request);
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(key);
+  if (broken_ || it == index_.end()) {
+    misses_++;
+    return false;
+  }
+  const auto& entry = it->second;
+  // Records appended since the last lookup are not mapped yet.
+  if (entry.offset + entry.size > map_size_ && !Remap().ok()) {
+    misses_++;
+    return false;
+  }
+  RecordHeader record;
+  std::memcpy(&record, map_ + entry.offset, kRecordHeaderSize);
+  auto payload = AsBytes(map_ + entry.offset + kRecordHeaderSize, entry.size - kRecordHeaderSize);
+  if (record.key_high != key.first || record.key_low != key.second || RecordSize(record) != entry.size ||
+      record.checksum != Checksum(record, payload)) {
+    // The file was modified behind our back.
+    index_.erase(it);
+    misses_++;
+    return false;
+  }
+  if (!KeyDataMatches(payload.substr(0, record.key_data_size), rpc, request)) {
+    // Another request with the same fingerprint.
+    misses_++;
+    return false;
+  }
+  auto value = payload.substr(record.key_data_size);
+  hits_++;
+  response->assign(value.data(), value.size());
+  return true;
+}
+
+void ResultCache::Insert(absl::string_view rpc, absl::string_view request, absl::string_view response) {
+  auto payload = absl::StrCat(rpc, absl::string_view("\0", 1), request, response);
+  auto record_size = kRecordHeaderSize + static_cast<int64_t>(payload.size());
+  if (kFileHeaderSize + record_size > max_bytes_ / 2) {
+    // It would not survive a compaction.
+    return;
+  }
+  auto key = MakeKey(rpc, request);
+  RecordHeader record;
+  record.key_high = key.first;
+  record.key_low = key.second;
+  record.value_size = response.size();
+  record.key_data_size = payload.size() - response.size();
+  record.checksum = Checksum(record, payload);
+  auto data = absl::StrCat(AsBytes(&record, kRecordHeaderSize), payload);
+
+  absl::MutexLock lock(&mutex_);
+  if (broken_ || index_.contains(key)) {
+    return;
+  }
+  if (end_ + record_size > max_bytes_ && !Compact().ok()) {
+    write_errors_++;
+    return;
+  }
+  if (!WriteAt(fd_, data, end_)) {
+    // Drop the partial record, so that the next one is appended at the right place. If it cannot
+    // be dropped, the file ends with garbage and the next records would be lost on reopen.
+    write_errors_++;
+    if (ftruncate(fd_, end_) != 0) {
+      write_errors_++;
+      broken_ = true;
+    }
+    return;
+  }
+  index_[key] = {end_, record_size};
+  end_ += record_size;
+}
+
+absl::Status ResultCache::Compact() {
+  auto status = Remap();
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Keep the newest records that fit in half of the maximum size.
+  std::vector<std::pair<Key, Entry>> entries(index_.begin(), index_.end());
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.second.offset > b.second.offset; });
+  int64_t size = kFileHeaderSize;
+  size_t kept = 0;
+  for (; kept < entries.size(); kept++) {
+    auto record_size = entries[kept].second.size;
+    if (size + record_size > max_bytes_ / 2) {
+      break;
+    }
+    size += record_size;
+  }
+  entries.resize(kept);
+  std::reverse(entries.begin(), entries.end());
+
+  auto compact_path = path_ + ".compact";
+  int fd = open(compact_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return ErrnoStatus("open", compact_path);
+  }
+  std::string data;
+  data.reserve(size);
+  auto header = MakeFileHeader();
+  data.append(reinterpret_cast<const char*>(&header), kFileHeaderSize);
+  absl::flat_hash_map<Key, Entry> index;
+  for (const auto& [key, entry] : entries) {
+    index[key] = {static_cast<int64_t>(data.size()), entry.size};
+    data.append(map_ + entry.offset, entry.size);
+  }
+  if (!WriteAt(fd, data, 0) || rename(compact_path.c_str(), path_.c_str()) != 0) {
+    auto error = ErrnoStatus("compact", path_);
+    close(fd);
+    unlink(compact_path.c_str());
+    return error;
+  }
+
+  Unmap();
+  close(fd_);
+  fd_ = fd;
+  end_ = data.size();
+  index_ = std::move(index);
+  compactions_++;
+  return Remap();
+}
+
+CacheStatsProto ResultCache::Stats() {
+  absl::MutexLock lock(&mutex_);
+  CacheStatsProto stats;
+  stats.set_path(path_);
+  stats.set_entries(index_.size());
+  stats.set_bytes(end_);
+  stats.set_max_bytes(max_bytes_);
+  stats.set_hits(hits_);
+  stats.set_misses(misses_);
+  stats.set_write_errors(write_errors_);
+  stats.set_compactions(compactions_);
+  return stats;
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
@@ -0,0 +1,115 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LOCAL_SERVICE_RESULT_CACHE_H_
+#define ZETASQL_HELPER_LOCAL_SERVICE_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "zetasql_helper/stats/stats.pb.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+// Version of the cached results. It must change whenever the responses of the RPCs may change,
+// i.e. when ZetaSQL is upgraded (see WORKSPACE) or when the helper changes its output.
+constexpr absl::string_view kResultVersion = "zetasql-2020.07.01/2";
+
+// A persistent cache of the responses of the deterministic RPCs, so that the queries analyzed by
+// a previous run of the server are not parsed again.
+//
+// The cache is an append-only file of records, each holding a 128-bit fingerprint of
+// (RPC, request, kResultVersion), the RPC and the request, the serialized response and a
+// checksum. The file is memory mapped for lookups, and an in-memory index maps the fingerprints
+// to their records. The fingerprint is not collision-resistant, so a lookup also compares the RPC
+// and the request with the ones of the record, and a collision is a miss. A record
+// truncated by a crash or failing its checksum is ignored. When the file would exceed its
+// maximum size, it is compacted by rewriting the most recently added half of its records into a
+// new file. A file written with another kResultVersion is discarded on open.
+//
+// The file is locked while open, so a cache can only be used by one process at a time.
+class ResultCache {
+ public:
+  // Open or create the cache at `path`.
+  static absl::Status Open(const std::string& path, int64_t max_bytes, std::unique_ptr<ResultCache>* cache);
+
+  ~ResultCache();
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  // Set `response` to the cached response of `request` for `rpc`, and return whether there is one.
+  bool Lookup(absl::string_view rpc, absl::string_view request, std::string* response);
+
+  // Add the response of `request` for `rpc`. Failures to write are counted but not reported,
+  // since the cache is only an optimization. A write that cannot be undone disables the cache.
+  void Insert(absl::string_view rpc, absl::string_view request, absl::string_view response);
+
+  CacheStatsProto Stats();
+
+ private:
+  using Key = std::pair<uint64_t, uint64_t>;
+
+  struct Entry {
+    // Offset of the record header in the file.
+    int64_t offset;
+    // Size of the record, its header included.
+    int64_t size;
+  };
+
+  ResultCache(std::string path, int64_t max_bytes);
+
+  static Key MakeKey(absl::string_view rpc, absl::string_view request);
+
+  // Open the file, check its header and index its records.
+  absl::Status Load();
+  // Map the file up to end_.
+  absl::Status Remap();
+  void Unmap();
+  // Rewrite the newest records into a new file, keeping at most half of max_bytes_.
+  absl::Status Compact();
+
+  const std::string path_;
+  const int64_t max_bytes_;
+
+  absl::Mutex mutex_;
+  int fd_ = -1;
+  int lock_fd_ = -1;
+  const char* map_ = nullptr;
+  int64_t map_size_ = 0;
+  // End of the last valid record.
+  int64_t end_ = 0;
+  absl::flat_hash_map<Key, Entry> index_;
+  // Whether a failed write left the file in an unknown state. The cache is then unusable: lookups
+  // miss and insertions are dropped.
+  bool broken_ = false;
+
+  int64_t hits_ = 0;
+  int64_t misses_ = 0;
+  int64_t write_errors_ = 0;
+  int64_t compactions_ = 0;
+};
+
+}  // bigquery::utils::zetasql_helper::local_service
+
+#endif  // ZETASQL_HELPER_LOCAL_SERVICE_RESULT_CACHE_H_
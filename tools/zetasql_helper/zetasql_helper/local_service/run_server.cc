@@ -14,42 +14,271 @@
 // limitations under the License.
 //
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/health_check_service_interface.h>
 #include <grpcpp/ext/proto_server_reflection_plugin.h>
 
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/time/clock.h"
 #include "zetasql_helper/local_service/local_service_grpc.h"
+#include "zetasql_helper/local_service/prefork.h"
+#include "zetasql_helper/local_service/result_cache.h"
+#include "zetasql_helper/local_service/warmup.h"
+#include "zetasql_helper/stats/heap_profiler.h"
+#include "zetasql_helper/stats/http_exporter.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/stats/trace_buffer.h"
 
+// Docker image will listen to external connections, so localhost would fail to do it.
+// Thus 0.0.0.0 is needed.
+ABSL_FLAG(std::vector<std::string>, listen, {"0.0.0.0:50051"},
+          "Comma-separated addresses the server listens on. An address is either host:port or "
+          "unix:/path/to/socket for a Unix domain socket, which avoids the TCP stack for clients "
+          "on the same host.");
+ABSL_FLAG(std::string, unix_socket_mode, "",
+          "Octal permissions (e.g. 0660) set on the Unix domain sockets the server listens on. "
+          "The permissions are left as created by the process umask if empty.");
+ABSL_FLAG(int32_t, warmup_rounds, 1,
+          "Number of times the built-in corpus is replayed through every RPC before the health "
+          "service reports the server as serving. No warmup if 0.");
+ABSL_FLAG(int32_t, workers, 0,
+          "Number of server processes sharing the TCP listening ports through SO_REUSEPORT, under "
+          "a supervisor restarting the ones that crash. The server runs in a single process if 0.");
+ABSL_FLAG(bool, pin_workers, true, "Pin each worker process to its own share of the CPUs.");
+ABSL_FLAG(std::string, cache_path, "",
+          "File of the persistent cache of the RPC results, which survives restarts. "
+          "The cache is disabled if empty.");
+ABSL_FLAG(int64_t, cache_max_bytes, 256 << 20,
+          "Maximum size of the cache file. The oldest results are dropped when it is reached.");
+ABSL_FLAG(int32_t, stats_port, 0,
+          "Port of the HTTP endpoint exposing the server stats in the Prometheus text format. "
+          "The endpoint is disabled if 0.");
+ABSL_FLAG(std::string, stats_address, "127.0.0.1", "IPv4 address the stats endpoint listens on.");
+ABSL_FLAG(int32_t, trace_slowest, 32, "Number of the slowest requests whose traces are kept.");
+ABSL_FLAG(int32_t, trace_sampled, 256, "Number of the sampled request traces kept.");
+ABSL_FLAG(int32_t, trace_sample_every, 1000,
+          "Sample the trace of one request out of this many. Sampling is disabled if 0.");
+ABSL_FLAG(int64_t, large_request_bytes, 64 * 1024,
+          "Requests whose query has at least this many bytes are admitted as large requests.");
+ABSL_FLAG(int32_t, max_small_requests, 64, "Number of small requests served at once.");
+ABSL_FLAG(int32_t, max_small_queue, 1024,
+          "Number of small requests waiting to be served. Further small requests are rejected.");
+ABSL_FLAG(int32_t, max_large_requests, 4, "Number of large requests served at once.");
+ABSL_FLAG(int32_t, max_large_queue, 16,
+          "Number of large requests waiting to be served. Further large requests are rejected.");
+ABSL_FLAG(std::string, default_priority, "interactive",
+          "Priority (interactive or batch) of the calls without the x-zetasql-helper-priority metadata.");
+ABSL_FLAG(int32_t, interactive_weight, 4,
+          "Relative share of the freed slots given to interactive requests while batch requests wait.");
+ABSL_FLAG(int32_t, batch_weight, 1,
+          "Relative share of the freed slots given to batch requests while interactive requests wait.");
+ABSL_FLAG(double, interactive_reserved_share, 0.25,
+          "Share of the slots of each request size that batch requests cannot take.");
 
+using bigquery::utils::zetasql_helper::local_service::AdmissionController;
+using bigquery::utils::zetasql_helper::local_service::PreforkOptions;
+using bigquery::utils::zetasql_helper::local_service::ResultCache;
+using bigquery::utils::zetasql_helper::local_service::Warmup;
 using bigquery::utils::zetasql_helper::local_service::ZetaSqlHelperLocalServiceGrpcImpl;
+using bigquery::utils::zetasql_helper::local_service::ZetaSqlHelperLocalServiceImpl;
+using bigquery::utils::zetasql_helper::stats::HttpExporter;
+using bigquery::utils::zetasql_helper::stats::ServerStats;
+using bigquery::utils::zetasql_helper::stats::TraceBuffer;
+
+namespace {
+
+constexpr absl::string_view kUnixPrefix = "unix:";
+
+bool IsUnixAddress(absl::string_view address) {
+  return absl::StartsWith(address, kUnixPrefix);
+}
 
-// This function starts a server and listens to the input address.
-void RunServer(const std::string &server_address) {
-  ZetaSqlHelperLocalServiceGrpcImpl service;
+// The path of a unix:/path or unix://path address.
+std::string UnixSocketPath(absl::string_view address) {
+  address.remove_prefix(kUnixPrefix.size());
+  if (absl::StartsWith(address, "//")) {
+    address.remove_prefix(2);
+  }
+  return std::string(address);
+}
+
+// Check the listen addresses before building the server, so that a typo fails with a clear
+// message instead of a generic bind error.
+bool ValidateListenAddresses(const std::vector<std::string> &addresses, bool preforked) {
+  if (addresses.empty()) {
+    std::cerr << "--listen needs at least one address" << std::endl;
+    return false;
+  }
+  for (const auto &address : addresses) {
+    // Binding a socket file replaces the one of the previous worker.
+    if (preforked && IsUnixAddress(address)) {
+      std::cerr << "Unix domain sockets cannot be shared by --workers: " << address << std::endl;
+      return false;
+    }
+    // The gRPC release bundled with ZetaSQL binds "unix:@name" as a file named "@name", and
+    // does not know the "unix-abstract:" scheme.
+    if (absl::StartsWith(address, "unix-abstract:") ||
+        (IsUnixAddress(address) && absl::StartsWith(UnixSocketPath(address), "@"))) {
+      std::cerr << "Abstract Unix domain sockets are not supported: " << address << std::endl;
+      return false;
+    }
+    if (IsUnixAddress(address) && UnixSocketPath(address).empty()) {
+      std::cerr << "Missing socket path: " << address << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Apply --unix_socket_mode to the sockets created by the server.
+void ChmodUnixSockets(const std::vector<std::string> &addresses) {
+  auto mode_flag = absl::GetFlag(FLAGS_unix_socket_mode);
+  if (mode_flag.empty()) {
+    return;
+  }
+  char *end = nullptr;
+  auto mode = std::strtol(mode_flag.c_str(), &end, 8);
+  if (*end != '\0' || mode < 0 || mode > 0777) {
+    std::cerr << "Invalid --unix_socket_mode: " << mode_flag << std::endl;
+    return;
+  }
+  for (const auto &address : addresses) {
+    if (IsUnixAddress(address) && chmod(UnixSocketPath(address).c_str(), mode) != 0) {
+      std::cerr << "Unable to change the permissions of " << address << std::endl;
+    }
+  }
+}
+
+}
+
+// This function starts a server and listens to the input addresses. It returns false if the
+// server cannot be started. `worker` is the index of the worker process in the prefork mode, and
+// -1 otherwise. Each worker has its own result cache and stats port.
+bool RunServer(const std::vector<std::string> &listen_addresses, int worker) {
+
+  AdmissionController::Options admission_options;
+  admission_options.large_request_bytes = absl::GetFlag(FLAGS_large_request_bytes);
+  admission_options.small = {absl::GetFlag(FLAGS_max_small_requests), absl::GetFlag(FLAGS_max_small_queue)};
+  admission_options.large = {absl::GetFlag(FLAGS_max_large_requests), absl::GetFlag(FLAGS_max_large_queue)};
+  admission_options.interactive_weight = absl::GetFlag(FLAGS_interactive_weight);
+  admission_options.batch_weight = absl::GetFlag(FLAGS_batch_weight);
+  admission_options.interactive_reserved_share = absl::GetFlag(FLAGS_interactive_reserved_share);
+  if (!AdmissionController::ParsePriority(absl::GetFlag(FLAGS_default_priority),
+                                          &admission_options.default_priority)) {
+    std::cerr << "Unknown --default_priority: " << absl::GetFlag(FLAGS_default_priority) << std::endl;
+    return false;
+  }
+
+  std::unique_ptr<ResultCache> cache;
+  auto cache_path = absl::GetFlag(FLAGS_cache_path);
+  if (!cache_path.empty() && worker >= 0) {
+    cache_path = absl::StrCat(cache_path, ".", worker);
+  }
+  if (!cache_path.empty()) {
+    // The server still works without its cache.
+    auto status = ResultCache::Open(cache_path, absl::GetFlag(FLAGS_cache_max_bytes), &cache);
+    if (status.ok()) {
+      std::cout << "Caching results in " << cache_path << std::endl;
+    } else {
+      std::cerr << "Unable to open the result cache: " << status << std::endl;
+    }
+  }
+  ZetaSqlHelperLocalServiceGrpcImpl service(admission_options, cache.get());
 
   grpc::EnableDefaultHealthCheckService(true);
   grpc::reflection::InitProtoReflectionServerBuilderPlugin();
   grpc::ServerBuilder builder;
-  // Listen on the given address without any authentication mechanism.
-  builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
+  // Listen on the given addresses without any authentication mechanism. gRPC removes a stale
+  // socket file left by a previous server before binding a Unix domain socket.
+  for (const auto &address : listen_addresses) {
+    builder.AddListeningPort(address, grpc::InsecureServerCredentials());
+  }
   // Register "service" as the instance through which we'll communicate with
   // clients. In this case it corresponds to an *synchronous* service.
   builder.RegisterService(&service);
+  // Let the workers of the prefork mode bind the same ports.
+  builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, 1);
   // Finally assemble the server.
   std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
-  std::cout << "Server listening on " << server_address << std::endl;
+  if (server == nullptr) {
+    std::cerr << "Unable to listen on " << absl::StrJoin(listen_addresses, ", ") << std::endl;
+    return false;
+  }
+  ChmodUnixSockets(listen_addresses);
+  if (worker >= 0) {
+    std::cout << "Worker " << worker << " (pid " << getpid() << ") listening on "
+              << absl::StrJoin(listen_addresses, ", ") << std::endl;
+  } else {
+    std::cout << "Server listening on " << absl::StrJoin(listen_addresses, ", ") << std::endl;
+  }
+
+  // Report the server as not serving until the first requests are as fast as the next ones.
+  auto warmup_rounds = absl::GetFlag(FLAGS_warmup_rounds);
+  auto* health = server->GetHealthCheckService();
+  if (warmup_rounds > 0) {
+    if (health != nullptr) {
+      health->SetServingStatus(false);
+    }
+    // A separate implementation, so that the warmup is not part of the stats nor of the cache.
+    ZetaSqlHelperLocalServiceImpl warmup_service;
+    auto start = absl::Now();
+    auto requests = Warmup(warmup_service, warmup_rounds);
+    std::cout << "Warmed up with " << requests << " requests in " << absl::Now() - start << std::endl;
+    if (health != nullptr) {
+      health->SetServingStatus(true);
+    }
+  }
+
+  HttpExporter stats_exporter([]() { return ServerStats::Global().ToPrometheusText(); });
+  auto stats_port = absl::GetFlag(FLAGS_stats_port);
+  if (stats_port != 0 && worker >= 0) {
+    stats_port += worker;
+  }
+  if (stats_port != 0) {
+    auto status = stats_exporter.Start(absl::GetFlag(FLAGS_stats_address), stats_port);
+    if (status.ok()) {
+      std::cout << "Stats exported on " << absl::GetFlag(FLAGS_stats_address) << ":" << stats_port << std::endl;
+    } else {
+      std::cerr << "Unable to export stats: " << status << std::endl;
+    }
+  }
 
   // Wait for the server to shutdown. Note that some other thread must be
   // responsible for shutting down the server for this call to ever return.
   server->Wait();
+  return true;
 }
 
 
-int main() {
-  // Docker image will listen to external connections, so localhost would fail to do it.
-  // Thus 0.0.0.0 is needed.
-  RunServer("0.0.0.0:50051");
-  return 0;
-}
\ No newline at end of file
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  bigquery::utils::zetasql_helper::stats::InstallAllocationCounters();
+  TraceBuffer::Global().Configure(absl::GetFlag(FLAGS_trace_slowest), absl::GetFlag(FLAGS_trace_sampled),
+                                  absl::GetFlag(FLAGS_trace_sample_every));
+  auto listen_addresses = absl::GetFlag(FLAGS_listen);
+  auto workers = absl::GetFlag(FLAGS_workers);
+  if (!ValidateListenAddresses(listen_addresses, workers > 0)) {
+    return 1;
+  }
+  if (workers <= 0) {
+    return RunServer(listen_addresses, -1) ? 0 : 1;
+  }
+
+  // gRPC is only initialized by the workers, since its threads would not survive fork().
+  PreforkOptions options;
+  options.workers = workers;
+  options.pin_cpus = absl::GetFlag(FLAGS_pin_workers);
+  return RunPreforked(options, [&](int worker) { return RunServer(listen_addresses, worker) ? 0 : 1; });
+}
@@ -0,0 +1,82 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/local_service/single_flight.h"
+
+#include "absl/time/time.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+namespace {
+
+// How often a waiting request checks whether its caller gave up.
+constexpr absl::Duration kCancellationPollInterval = absl::Milliseconds(50);
+
+}
+
+std::shared_ptr<SingleFlight::Call> SingleFlight::Join(const std::string& key,
+                                                       std::shared_ptr<Call>* leader_call) {
+  absl::MutexLock lock(&mutex_);
+  auto& call = calls_[key];
+  if (call != nullptr) {
+    call->waiters++;
+    return call;
+  }
+  call = std::make_shared<Call>();
+  *leader_call = call;
+  return nullptr;
+}
+
+bool SingleFlight::Leave(const std::string& key) {
+  absl::MutexLock lock(&mutex_);
+  auto it = calls_.find(key);
+  auto waiters = it->second->waiters;
+  calls_.erase(it);
+  return waiters > 0;
+}
+
+absl::Status SingleFlight::Wait(Call* call, const CancellationToken* cancellation) {
+  if (cancellation == nullptr) {
+    call->done.WaitForNotification();
+    return absl::OkStatus();
+  }
+  while (!call->done.WaitForNotificationWithTimeout(kCancellationPollInterval)) {
+    auto status = cancellation->Check();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+bool SingleFlight::IsShareable(const absl::Status& status) {
+  switch (status.code()) {
+    case absl::StatusCode::kCancelled:
+    case absl::StatusCode::kDeadlineExceeded:
+    case absl::StatusCode::kResourceExhausted:
+      return false;
+    default:
+      return true;
+  }
+}
+
+int SingleFlight::InFlight() {
+  absl::MutexLock lock(&mutex_);
+  return calls_.size();
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
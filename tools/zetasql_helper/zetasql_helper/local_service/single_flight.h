@@ -0,0 +1,120 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LOCAL_SERVICE_SINGLE_FLIGHT_H_
+#define ZETASQL_HELPER_LOCAL_SERVICE_SINGLE_FLIGHT_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+// Coalesces identical concurrent requests: while a request is being computed, the requests with
+// the same key wait for it and receive a copy of its response instead of computing it again.
+// Requests with distinct keys are not affected.
+//
+// A response is only shared if it does not depend on the call that computed it. When the
+// computing call is cancelled, times out or is rejected by admission control, the waiting
+// requests compute the response themselves.
+class SingleFlight {
+ public:
+  // Set `response` to the result of `compute` for `key`. If a request with the same key is in
+  // flight, wait for it and parse its response instead, and set `*coalesced` to true. A waiting
+  // request stops waiting when `cancellation` fires.
+  template<typename Response>
+  absl::Status Do(const std::string& key, const CancellationToken* cancellation, Response* response,
+                  const std::function<absl::Status(Response*)>& compute, bool* coalesced);
+
+  // Number of keys in flight.
+  int InFlight();
+
+ private:
+  struct Call {
+    absl::Notification done;
+    // Whether the waiting requests can use the result of the call.
+    bool shared = false;
+    absl::Status status;
+    // The serialized response, only set if some request waits for it.
+    std::string response;
+    int waiters = 0;
+  };
+
+  // Return the call in flight for `key` and register as its waiter, or register a new call and
+  // return null if there is none. `*leader_call` is set to the new call.
+  std::shared_ptr<Call> Join(const std::string& key, std::shared_ptr<Call>* leader_call);
+
+  // Remove the call of `key`, and return whether any request waits for it.
+  bool Leave(const std::string& key);
+
+  // Wait until the call is done or `cancellation` fires.
+  static absl::Status Wait(Call* call, const CancellationToken* cancellation);
+
+  // Whether a response computed with the given status can be given to the waiting requests.
+  static bool IsShareable(const absl::Status& status);
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::shared_ptr<Call>> calls_;
+};
+
+template<typename Response>
+absl::Status SingleFlight::Do(const std::string& key, const CancellationToken* cancellation, Response* response,
+                              const std::function<absl::Status(Response*)>& compute, bool* coalesced) {
+  *coalesced = false;
+  while (true) {
+    std::shared_ptr<Call> leader_call;
+    auto call = Join(key, &leader_call);
+    if (call == nullptr) {
+      auto status = compute(response);
+      // No request can join the call after Leave, so the waiters are known here.
+      if (Leave(key) && IsShareable(status)) {
+        leader_call->shared = true;
+        leader_call->status = status;
+        if (status.ok()) {
+          response->SerializeToString(&leader_call->response);
+        }
+      }
+      leader_call->done.Notify();
+      return status;
+    }
+
+    auto status = Wait(call.get(), cancellation);
+    if (!status.ok()) {
+      return status;
+    }
+    if (!call->shared) {
+      // Compute the response without the failed call.
+      continue;
+    }
+    *coalesced = true;
+    response->Clear();
+    if (call->status.ok() && !response->ParseFromString(call->response)) {
+      return absl::Status(absl::StatusCode::kInternal, "unable to parse a coalesced response");
+    }
+    return call->status;
+  }
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
+
+#endif  // ZETASQL_HELPER_LOCAL_SERVICE_SINGLE_FLIGHT_H_
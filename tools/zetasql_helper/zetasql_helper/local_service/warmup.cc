@@ -0,0 +1,159 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/local_service/warmup.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+namespace {
+
+// Matches every table, so that LocateTableRanges and RewriteTables visit all of them.
+constexpr char kAnyTable[] = ".*";
+
+// Round-trip a request through its serialized form, call the RPC and serialize the response.
+template<typename Request, typename Response, typename Method>
+void Replay(const Request& request, Method method) {
+  Request parsed;
+  parsed.ParseFromString(request.SerializeAsString());
+  Response response;
+  method(parsed, &response).IgnoreError();
+  response.SerializeAsString();
+}
+
+}
+
+int64_t Warmup(ZetaSqlHelperLocalServiceImpl& service, int rounds) {
+  return ReplayCorpus(service, benchmark::DefaultCorpus(), rounds);
+}
+
+int64_t ReplayCorpus(ZetaSqlHelperLocalServiceImpl& service, const std::vector<benchmark::CorpusEntry>& corpus,
+                     int rounds) {
+  int64_t requests = 0;
+  for (int round = 0; round < rounds; round++) {
+    for (const auto& entry : corpus) {
+      TokenizeRequest tokenize;
+      tokenize.set_query(entry.query);
+      Replay<TokenizeRequest, TokenizeResponse>(tokenize, [&](const auto& request, auto* response) {
+        return service.Tokenize(request, response);
+      });
+
+      ExtractFunctionRangeRequest extract_function;
+      extract_function.set_query(entry.query);
+      extract_function.set_line_number(entry.function_position.line);
+      extract_function.set_column_number(entry.function_position.column);
+      Replay<ExtractFunctionRangeRequest, ExtractFunctionRangeResponse>(
+          extract_function, [&](const auto& request, auto* response) {
+            return service.ExtractFunctionRange(request, response);
+          });
+
+      LocateTableRangesRequest locate_table;
+      locate_table.set_query(entry.query);
+      locate_table.set_table_regex(kAnyTable);
+      Replay<LocateTableRangesRequest, LocateTableRangesResponse>(
+          locate_table, [&](const auto& request, auto* response) {
+            return service.LocateTableRanges(request, response);
+          });
+
+      ExportAstRequest export_ast;
+      export_ast.set_query(entry.query);
+      export_ast.set_include_identifiers(true);
+      Replay<ExportAstRequest, ExportAstResponse>(export_ast, [&](const auto& request, auto* response) {
+        return service.ExportAst(request, response);
+      });
+
+      FindRepeatedSubtreesRequest repeated_subtrees;
+      repeated_subtrees.add_queries(entry.query);
+      Replay<FindRepeatedSubtreesRequest, FindRepeatedSubtreesResponse>(
+          repeated_subtrees, [&](const auto& request, auto* response) {
+            return service.FindRepeatedSubtrees(request, response);
+          });
+
+      RewriteTablesRequest rewrite_tables;
+      rewrite_tables.add_queries(entry.query);
+      auto* rewrite = rewrite_tables.add_rewrites();
+      rewrite->set_name_regex(kAnyTable);
+      rewrite->set_replacement("$&");
+      Replay<RewriteTablesRequest, RewriteTablesResponse>(
+          rewrite_tables, [&](const auto& request, auto* response) {
+            return service.RewriteTables(request, response);
+          });
+
+      ParameterizeLiteralsRequest parameterize_literals;
+      parameterize_literals.set_query(entry.query);
+      Replay<ParameterizeLiteralsRequest, ParameterizeLiteralsResponse>(
+          parameterize_literals, [&](const auto& request, auto* response) {
+            return service.ParameterizeLiterals(request, response);
+          });
+
+      GetSemanticTokensRequest semantic_tokens;
+      semantic_tokens.set_query(entry.query);
+      Replay<GetSemanticTokensRequest, GetSemanticTokensResponse>(
+          semantic_tokens, [&](const auto& request, auto* response) {
+            return service.GetSemanticTokens(request, response);
+          });
+
+      FixColumnNotGroupedRequest fix_column_not_grouped;
+      fix_column_not_grouped.set_query(entry.query);
+      fix_column_not_grouped.set_missing_column(entry.column);
+      fix_column_not_grouped.set_line_number(entry.column_position.line);
+      fix_column_not_grouped.set_column_number(entry.column_position.column);
+      Replay<FixColumnNotGroupedRequest, FixColumnNotGroupedResponse>(
+          fix_column_not_grouped, [&](const auto& request, auto* response) {
+            return service.FixColumnNotGrouped(request, response);
+          });
+
+      FixDuplicateColumnsRequest fix_duplicate_columns;
+      fix_duplicate_columns.set_query(entry.query);
+      fix_duplicate_columns.set_duplicate_column(entry.column);
+      Replay<FixDuplicateColumnsRequest, FixDuplicateColumnsResponse>(
+          fix_duplicate_columns, [&](const auto& request, auto* response) {
+            return service.FixDuplicateColumns(request, response);
+          });
+
+      AutoFixRequest auto_fix;
+      auto_fix.set_query(entry.query);
+      auto_fix.set_error_message(absl::StrCat("SELECT list expression references column ", entry.column,
+                                              " which is neither grouped nor aggregated at [",
+                                              entry.column_position.line, ":", entry.column_position.column, "]"));
+      Replay<AutoFixRequest, AutoFixResponse>(
+          auto_fix, [&](const auto& request, auto* response) {
+            return service.AutoFix(request, response);
+          });
+
+      AnalyzeQueryRequest analyze_query;
+      analyze_query.set_query(entry.query);
+      Replay<AnalyzeQueryRequest, AnalyzeQueryResponse>(
+          analyze_query, [&](const auto& request, auto* response) {
+            return service.AnalyzeQuery(request, response);
+          });
+      requests += 12;
+    }
+
+    Replay<GetAllKeywordsRequest, GetAllKeywordsResponse>(
+        GetAllKeywordsRequest(), [&](const auto& request, auto* response) {
+          return service.GetAllKeywords(request, response);
+        });
+    requests++;
+  }
+  return requests;
+}
+
+}  // bigquery::utils::zetasql_helper::local_service
@@ -0,0 +1,45 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LOCAL_SERVICE_WARMUP_H_
+#define ZETASQL_HELPER_LOCAL_SERVICE_WARMUP_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "zetasql_helper/benchmark/corpus.h"
+#include "zetasql_helper/local_service/local_service.h"
+
+namespace bigquery::utils::zetasql_helper::local_service {
+
+// Replay the default benchmark corpus through every RPC of `service` `rounds` times, so that the
+// lazily initialized state (the keyword tables and globals of ZetaSQL, the parser, the builtin
+// functions of the analyzer, the protobuf descriptors, the arena of the calling thread) is ready
+// before the first real request. The requests and responses go through their serialized form
+// like in the gRPC service. Failed requests are expected, e.g. a fixer given a query it cannot
+// fix, and are not reported.
+//
+// Return the number of requests replayed.
+int64_t Warmup(ZetaSqlHelperLocalServiceImpl& service, int rounds);
+
+// Same with another corpus, e.g. to train a profile-guided build on a representative workload.
+int64_t ReplayCorpus(ZetaSqlHelperLocalServiceImpl& service, const std::vector<benchmark::CorpusEntry>& corpus,
+                     int rounds);
+
+}  // bigquery::utils::zetasql_helper::local_service
+
+#endif  // ZETASQL_HELPER_LOCAL_SERVICE_WARMUP_H_
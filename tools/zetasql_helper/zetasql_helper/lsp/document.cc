@@ -0,0 +1,177 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/lsp/document.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/strings/ascii.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+namespace {
+
+bool IsContinuationByte(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// The offset after the quoted string or identifier starting at `start`, or the end of the text
+// if it is not terminated.
+int SkipQuoted(absl::string_view text, int start) {
+  char quote = text[start];
+  bool triple = quote != '`' && text.substr(start, 3) == std::string(3, quote);
+  int i = start + (triple ? 3 : 1);
+  while (i < text.size()) {
+    if (text[i] == '\\') {
+      i += 2;
+    } else if (text[i] == quote && (!triple || text.substr(i, 3) == std::string(3, quote))) {
+      return i + (triple ? 3 : 1);
+    } else if (text[i] == '\n' && !triple && quote != '`') {
+      // An unterminated string ends with its line, so that it does not swallow the script.
+      return i;
+    } else {
+      i++;
+    }
+  }
+  return text.size();
+}
+
+TextSpan Trim(absl::string_view text, int start, int end) {
+  while (start < end && absl::ascii_isspace(text[start])) {
+    start++;
+  }
+  while (end > start && absl::ascii_isspace(text[end - 1])) {
+    end--;
+  }
+  return {start, end};
+}
+
+}
+
+Document::Document(std::string text, int64_t version) : text_(std::move(text)), version_(version) {
+  IndexLinesFrom(0);
+}
+
+void Document::SetText(std::string text, int64_t version) {
+  text_ = std::move(text);
+  version_ = version;
+  IndexLinesFrom(0);
+}
+
+void Document::Apply(const Position& start, const Position& end, absl::string_view text, int64_t version) {
+  auto start_offset = OffsetAt(start);
+  auto end_offset = std::max(start_offset, OffsetAt(end));
+  text_.replace(start_offset, end_offset - start_offset, text.data(), text.size());
+  version_ = version;
+  IndexLinesFrom(std::min(start.line, line_count() - 1));
+}
+
+void Document::IndexLinesFrom(int line) {
+  line = std::max(line, 0);
+  line_starts_.resize(line + 1);
+  if (line == 0) {
+    line_starts_[0] = 0;
+  }
+  auto data = text_.data();
+  auto offset = line_starts_[line];
+  while (offset < text_.size()) {
+    auto newline = static_cast<const char*>(std::memchr(data + offset, '\n', text_.size() - offset));
+    if (newline == nullptr) {
+      break;
+    }
+    offset = newline - data + 1;
+    line_starts_.push_back(offset);
+  }
+}
+
+int Document::OffsetAt(const Position& position) const {
+  if (position.line < 0) {
+    return 0;
+  }
+  if (position.line >= line_count()) {
+    return text_.size();
+  }
+  int offset = line_starts_[position.line];
+  int line_end = position.line + 1 < line_count() ? line_starts_[position.line + 1] - 1 : text_.size();
+  if (line_end > offset && text_[line_end - 1] == '\r') {
+    line_end--;
+  }
+  int units = 0;
+  while (offset < line_end && units < position.character) {
+    units += static_cast<unsigned char>(text_[offset]) >= 0xF0 ? 2 : 1;
+    offset++;
+    while (offset < line_end && IsContinuationByte(text_[offset])) {
+      offset++;
+    }
+  }
+  return offset;
+}
+
+Position Document::PositionAt(int offset) const {
+  offset = std::clamp(offset, 0, static_cast<int>(text_.size()));
+  auto it = std::upper_bound(line_starts_.begin(), line_starts_.end(), offset);
+  Position position;
+  position.line = it - line_starts_.begin() - 1;
+  auto line_start = line_starts_[position.line];
+  position.character = Utf16Length(absl::string_view(text_).substr(line_start, offset - line_start));
+  return position;
+}
+
+int Utf16Length(absl::string_view text) {
+  int units = 0;
+  for (char c : text) {
+    if (!IsContinuationByte(c)) {
+      // Code points of 4 bytes in UTF-8 are surrogate pairs in UTF-16.
+      units += static_cast<unsigned char>(c) >= 0xF0 ? 2 : 1;
+    }
+  }
+  return units;
+}
+
+std::vector<TextSpan> SplitStatements(absl::string_view text) {
+  std::vector<TextSpan> statements;
+  int start = 0;
+  int i = 0;
+  auto add_statement = [&](int end) {
+    auto span = Trim(text, start, end);
+    if (span.start < span.end) {
+      statements.push_back(span);
+    }
+  };
+  while (i < text.size()) {
+    char c = text[i];
+    if (c == '\'' || c == '"' || c == '`') {
+      i = SkipQuoted(text, i);
+    } else if (c == '#' || (c == '-' && text.substr(i, 2) == "--")) {
+      auto newline = text.find('\n', i);
+      i = newline == absl::string_view::npos ? text.size() : newline + 1;
+    } else if (c == '/' && text.substr(i, 2) == "/*") {
+      auto comment_end = text.find("*/", i + 2);
+      i = comment_end == absl::string_view::npos ? text.size() : comment_end + 2;
+    } else if (c == ';') {
+      add_statement(i);
+      start = ++i;
+    } else {
+      i++;
+    }
+  }
+  add_statement(text.size());
+  return statements;
+}
+
+}  // bigquery::utils::zetasql_helper::lsp
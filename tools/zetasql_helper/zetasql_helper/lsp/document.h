@@ -0,0 +1,86 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LSP_DOCUMENT_H_
+#define ZETASQL_HELPER_LSP_DOCUMENT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+// A position as the Language Server Protocol sends it: a 0-based line, and an offset in UTF-16
+// code units within the line.
+struct Position {
+  int line = 0;
+  int character = 0;
+};
+
+// A range of byte offsets [start, end) in a text.
+struct TextSpan {
+  int start = 0;
+  int end = 0;
+};
+
+// The text of an open document. Edits are applied in place, and the index of the line starts is
+// only rebuilt from the first edited line, so an edit costs a copy of the text after it instead
+// of a new document.
+class Document {
+ public:
+  Document(std::string text, int64_t version);
+
+  const std::string& text() const { return text_; }
+  int64_t version() const { return version_; }
+  int line_count() const { return line_starts_.size(); }
+
+  // Replace the text between two positions.
+  void Apply(const Position& start, const Position& end, absl::string_view text, int64_t version);
+
+  // Replace the whole text.
+  void SetText(std::string text, int64_t version);
+
+  // The byte offset of a position. Positions past the end of their line are moved to the end of
+  // the line, and positions past the last line to the end of the text.
+  int OffsetAt(const Position& position) const;
+
+  // The position of a byte offset, which is clamped to the text.
+  Position PositionAt(int offset) const;
+
+ private:
+  void IndexLinesFrom(int line);
+
+  std::string text_;
+  int64_t version_;
+  // Byte offset of the start of each line.
+  std::vector<int> line_starts_;
+};
+
+// Number of UTF-16 code units of a UTF-8 text.
+int Utf16Length(absl::string_view text);
+
+// Split a script into its statements, at the semicolons outside of the strings, quoted
+// identifiers and comments. The spans exclude the semicolons and the surrounding whitespace, and
+// the empty statements are dropped. A compound statement (e.g. BEGIN ... END) is split at the
+// semicolons of its body, like the rest of the script.
+std::vector<TextSpan> SplitStatements(absl::string_view text);
+
+}  // bigquery::utils::zetasql_helper::lsp
+
+#endif  // ZETASQL_HELPER_LSP_DOCUMENT_H_
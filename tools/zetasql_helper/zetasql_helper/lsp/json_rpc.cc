@@ -0,0 +1,62 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/lsp/json_rpc.h"
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/strip.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+namespace {
+
+constexpr absl::string_view kContentLength = "Content-Length:";
+
+}
+
+bool ReadMessage(std::istream& input, std::string* body) {
+  int64_t length = -1;
+  std::string header;
+  while (std::getline(input, header)) {
+    absl::string_view line = absl::StripSuffix(header, "\r");
+    if (line.empty()) {
+      if (length < 0) {
+        // Keep-alive blank lines between messages.
+        continue;
+      }
+      body->resize(length);
+      input.read(&(*body)[0], length);
+      return input.gcount() == length;
+    }
+    if (absl::StartsWithIgnoreCase(line, kContentLength)) {
+      auto value = absl::StripAsciiWhitespace(line.substr(kContentLength.size()));
+      if (!absl::SimpleAtoi(value, &length) || length < 0) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+void WriteMessage(std::ostream& output, absl::string_view body) {
+  output << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+  output.flush();
+}
+
+}  // bigquery::utils::zetasql_helper::lsp
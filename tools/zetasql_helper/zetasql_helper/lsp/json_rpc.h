@@ -0,0 +1,39 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LSP_JSON_RPC_H_
+#define ZETASQL_HELPER_LSP_JSON_RPC_H_
+
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+// Read the body of the next message of the base protocol of the Language Server Protocol: a
+// Content-Length header, the other headers, an empty line and the body. Return false at the end
+// of the input, or if the headers are malformed.
+bool ReadMessage(std::istream& input, std::string* body);
+
+// Write a message with its Content-Length header, and flush it.
+void WriteMessage(std::ostream& output, absl::string_view body);
+
+}  // bigquery::utils::zetasql_helper::lsp
+
+#endif  // ZETASQL_HELPER_LSP_JSON_RPC_H_
@@ -0,0 +1,466 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/lsp/language_server.h"
+
+#include <algorithm>
+#include <charconv>
+#include <initializer_list>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/util/json_util.h"
+#include "zetasql_helper/lsp/json_rpc.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+namespace {
+
+using google::protobuf::Value;
+
+// Error codes of JSON-RPC.
+constexpr int kParseError = -32700;
+constexpr int kInvalidRequest = -32600;
+constexpr int kMethodNotFound = -32601;
+
+// The diagnostic severity of the Language Server Protocol for errors.
+constexpr int kSeverityError = 1;
+
+const Value& EmptyValue() {
+  static const auto* value = new Value();
+  return *value;
+}
+
+// The field at `path` in nested objects, or null if there is none.
+const Value* Get(const Value& value, std::initializer_list<absl::string_view> path) {
+  const auto* current = &value;
+  for (auto name : path) {
+    if (current->kind_case() != Value::kStructValue) {
+      return nullptr;
+    }
+    const auto& fields = current->struct_value().fields();
+    auto it = fields.find(std::string(name));
+    if (it == fields.end()) {
+      return nullptr;
+    }
+    current = &it->second;
+  }
+  return current;
+}
+
+std::string GetString(const Value& value, std::initializer_list<absl::string_view> path) {
+  const auto* field = Get(value, path);
+  return field != nullptr && field->kind_case() == Value::kStringValue ? field->string_value() : "";
+}
+
+int64_t GetInt(const Value& value, std::initializer_list<absl::string_view> path) {
+  const auto* field = Get(value, path);
+  return field != nullptr && field->kind_case() == Value::kNumberValue ? field->number_value() : 0;
+}
+
+Position GetPosition(const Value& value, std::initializer_list<absl::string_view> path) {
+  const auto* field = Get(value, path);
+  if (field == nullptr) {
+    return {};
+  }
+  return {static_cast<int>(GetInt(*field, {"line"})), static_cast<int>(GetInt(*field, {"character"}))};
+}
+
+// The field `name` of an object, which is added if it is missing.
+Value& Field(Value& object, absl::string_view name) {
+  return (*object.mutable_struct_value()->mutable_fields())[std::string(name)];
+}
+
+// Append an element to a list.
+Value& Append(Value& list) {
+  return *list.mutable_list_value()->add_values();
+}
+
+Value Number(double number) {
+  Value value;
+  value.set_number_value(number);
+  return value;
+}
+
+Value String(absl::string_view text) {
+  Value value;
+  value.set_string_value(std::string(text));
+  return value;
+}
+
+Value Bool(bool flag) {
+  Value value;
+  value.set_bool_value(flag);
+  return value;
+}
+
+Value Null() {
+  Value value;
+  value.set_null_value(google::protobuf::NULL_VALUE);
+  return value;
+}
+
+Value EmptyList() {
+  Value value;
+  value.mutable_list_value();
+  return value;
+}
+
+Value ToValue(const Position& position) {
+  Value value;
+  Field(value, "line") = Number(position.line);
+  Field(value, "character") = Number(position.character);
+  return value;
+}
+
+Value RangeValue(const Document& document, int start, int end) {
+  Value value;
+  Field(value, "start") = ToValue(document.PositionAt(start));
+  Field(value, "end") = ToValue(document.PositionAt(end));
+  return value;
+}
+
+std::string ToJson(const Value& value) {
+  std::string json;
+  if (!google::protobuf::util::MessageToJsonString(value, &json).ok()) {
+    return "null";
+  }
+  return json;
+}
+
+std::string Response(const Value& id, Value result) {
+  Value response;
+  Field(response, "jsonrpc") = String("2.0");
+  Field(response, "id") = id;
+  Field(response, "result") = std::move(result);
+  return ToJson(response);
+}
+
+std::string ErrorResponse(const Value& id, int code, absl::string_view message) {
+  Value response;
+  Field(response, "jsonrpc") = String("2.0");
+  Field(response, "id") = id;
+  auto& error = Field(response, "error");
+  Field(error, "code") = Number(code);
+  Field(error, "message") = String(message);
+  return ToJson(response);
+}
+
+std::string Notification(absl::string_view method, Value params) {
+  Value notification;
+  Field(notification, "jsonrpc") = String("2.0");
+  Field(notification, "method") = String(method);
+  Field(notification, "params") = std::move(params);
+  return ToJson(notification);
+}
+
+// Append an integer and a comma.
+void AppendInt(std::string& text, int number) {
+  char buffer[16];
+  auto result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+  text.append(buffer, result.ptr - buffer);
+  text.push_back(',');
+}
+
+Value Capabilities() {
+  Value result;
+  auto& capabilities = Field(result, "capabilities");
+
+  auto& sync = Field(capabilities, "textDocumentSync");
+  Field(sync, "openClose") = Bool(true);
+  // Incremental.
+  Field(sync, "change") = Number(2);
+
+  auto& semantic_tokens = Field(capabilities, "semanticTokensProvider");
+  auto& legend = Field(semantic_tokens, "legend");
+  auto& token_types = Field(legend, "tokenTypes");
+  for (int i = 0; i < SemanticTokensProto::Type_ARRAYSIZE; i++) {
+    Append(token_types) = String(TokenTypeName(static_cast<SemanticTokensProto::Type>(i)));
+  }
+  // The bit of SemanticTokensProto::DECLARATION.
+  Append(Field(legend, "tokenModifiers")) = String("declaration");
+  Field(semantic_tokens, "full") = Bool(true);
+
+  Field(capabilities, "documentSymbolProvider") = Bool(true);
+  Append(Field(Field(capabilities, "codeActionProvider"), "codeActionKinds")) = String("quickfix");
+
+  Field(Field(result, "serverInfo"), "name") = String("zetasql_helper");
+  return result;
+}
+
+}
+
+int LanguageServer::Run(std::istream& input, std::ostream& output) {
+  std::string body;
+  std::vector<std::string> replies;
+  while (ReadMessage(input, &body)) {
+    replies.clear();
+    bool running = Handle(body, &replies);
+    for (const auto& reply : replies) {
+      WriteMessage(output, reply);
+    }
+    if (!running) {
+      return shutdown_ ? 0 : 1;
+    }
+  }
+  return 1;
+}
+
+bool LanguageServer::Handle(absl::string_view message, std::vector<std::string>* replies) {
+  Value request;
+  if (!google::protobuf::util::JsonStringToMessage(std::string(message), &request).ok()) {
+    replies->push_back(ErrorResponse(Null(), kParseError, "the message is not valid JSON"));
+    return true;
+  }
+  auto method = GetString(request, {"method"});
+  const auto* id = Get(request, {"id"});
+  const auto* params = Get(request, {"params"});
+  if (params == nullptr) {
+    params = &EmptyValue();
+  }
+
+  if (method == "exit") {
+    return false;
+  }
+  if (id == nullptr) {
+    // A notification. The ones not listed here (e.g. initialized) need no action.
+    if (method == "textDocument/didOpen") {
+      DidOpen(*params, replies);
+    } else if (method == "textDocument/didChange") {
+      DidChange(*params, replies);
+    } else if (method == "textDocument/didClose") {
+      DidClose(*params, replies);
+    }
+    return true;
+  }
+  if (method.empty()) {
+    // A response to a request of the server, which sends none.
+    return true;
+  }
+
+  if (shutdown_) {
+    replies->push_back(ErrorResponse(*id, kInvalidRequest, "the server is shut down"));
+  } else if (method == "initialize") {
+    replies->push_back(Response(*id, Capabilities()));
+  } else if (method == "shutdown") {
+    shutdown_ = true;
+    replies->push_back(Response(*id, Null()));
+  } else if (method == "textDocument/semanticTokens/full") {
+    replies->push_back(SemanticTokens(*id, *params));
+  } else if (method == "textDocument/documentSymbol") {
+    replies->push_back(Response(*id, DocumentSymbols(*params)));
+  } else if (method == "textDocument/codeAction") {
+    replies->push_back(Response(*id, CodeActions(*params)));
+  } else {
+    replies->push_back(ErrorResponse(*id, kMethodNotFound, absl::StrCat("unknown method ", method)));
+  }
+  return true;
+}
+
+void LanguageServer::Analyze(OpenDocument& open_document) {
+  absl::string_view text = open_document.document.text();
+  auto spans = SplitStatements(text);
+  absl::flat_hash_map<std::string, std::shared_ptr<const StatementAnalysis>> analyses;
+  analyses.reserve(spans.size());
+  open_document.statements.clear();
+  for (const auto& span : spans) {
+    auto statement = text.substr(span.start, span.end - span.start);
+    std::shared_ptr<const StatementAnalysis> analysis;
+    if (auto it = analyses.find(statement); it != analyses.end()) {
+      analysis = it->second;
+    } else {
+      if (auto cached = open_document.analyses.find(statement); cached != open_document.analyses.end()) {
+        analysis = cached->second;
+      } else {
+        analysis = std::make_shared<StatementAnalysis>(AnalyzeStatement(statement));
+      }
+      analyses.emplace(statement, analysis);
+    }
+    open_document.statements.push_back({span, std::move(analysis)});
+  }
+  // Only keep the statements still in the document.
+  open_document.analyses = std::move(analyses);
+}
+
+LanguageServer::OpenDocument* LanguageServer::FindDocument(const Value& params) {
+  auto it = documents_.find(GetString(params, {"textDocument", "uri"}));
+  return it == documents_.end() ? nullptr : it->second.get();
+}
+
+void LanguageServer::DidOpen(const Value& params, std::vector<std::string>* replies) {
+  auto uri = GetString(params, {"textDocument", "uri"});
+  auto& open_document = documents_[uri];
+  open_document = std::make_unique<OpenDocument>(GetString(params, {"textDocument", "text"}),
+                                                 GetInt(params, {"textDocument", "version"}));
+  Analyze(*open_document);
+  replies->push_back(PublishDiagnostics(uri, *open_document));
+}
+
+void LanguageServer::DidChange(const Value& params, std::vector<std::string>* replies) {
+  auto* open_document = FindDocument(params);
+  const auto* changes = Get(params, {"contentChanges"});
+  if (open_document == nullptr || changes == nullptr) {
+    return;
+  }
+  auto version = GetInt(params, {"textDocument", "version"});
+  auto& document = open_document->document;
+  for (const auto& change : changes->list_value().values()) {
+    if (Get(change, {"range"}) == nullptr) {
+      document.SetText(GetString(change, {"text"}), version);
+    } else {
+      document.Apply(GetPosition(change, {"range", "start"}), GetPosition(change, {"range", "end"}),
+                     GetString(change, {"text"}), version);
+    }
+  }
+  Analyze(*open_document);
+  replies->push_back(PublishDiagnostics(GetString(params, {"textDocument", "uri"}), *open_document));
+}
+
+void LanguageServer::DidClose(const Value& params, std::vector<std::string>* replies) {
+  auto uri = GetString(params, {"textDocument", "uri"});
+  if (documents_.erase(uri) == 0) {
+    return;
+  }
+  // Clear the diagnostics of the closed document.
+  Value diagnostics;
+  Field(diagnostics, "uri") = String(uri);
+  Field(diagnostics, "diagnostics") = EmptyList();
+  replies->push_back(Notification("textDocument/publishDiagnostics", std::move(diagnostics)));
+}
+
+std::string LanguageServer::PublishDiagnostics(const std::string& uri, const OpenDocument& open_document) {
+  const auto& document = open_document.document;
+  Value params;
+  Field(params, "uri") = String(uri);
+  Field(params, "version") = Number(document.version());
+  auto& diagnostics = Field(params, "diagnostics");
+  diagnostics.mutable_list_value();
+  for (const auto& statement : open_document.statements) {
+    for (const auto& diagnostic : statement.analysis->diagnostics) {
+      auto& value = Append(diagnostics);
+      Field(value, "range") =
+          RangeValue(document, statement.span.start + diagnostic.start, statement.span.start + diagnostic.end);
+      Field(value, "severity") = Number(kSeverityError);
+      Field(value, "source") = String("zetasql");
+      Field(value, "message") = String(diagnostic.message);
+    }
+  }
+  return Notification("textDocument/publishDiagnostics", std::move(params));
+}
+
+std::string LanguageServer::SemanticTokens(const Value& id, const Value& params) {
+  auto* open_document = FindDocument(params);
+  if (open_document == nullptr) {
+    return Response(id, Null());
+  }
+
+  // The data is written directly, since it is by far the largest reply: five integers per
+  // token, relative to the previous token.
+  const auto& document = open_document->document;
+  absl::string_view text = document.text();
+  std::string data;
+  data.reserve(open_document->statements.size() * 64);
+  Position previous;
+  for (const auto& statement : open_document->statements) {
+    for (const auto& token : statement.analysis->tokens) {
+      int start = statement.span.start + token.start;
+      // Tokens spanning several lines (e.g. comments) are cut at the end of their first line.
+      int end = statement.span.start + token.end;
+      auto line_end = text.find('\n', start);
+      if (line_end != absl::string_view::npos) {
+        end = std::min<int>(end, line_end);
+      }
+      if (end > start && text[end - 1] == '\r') {
+        end--;
+      }
+      auto length = Utf16Length(text.substr(start, end - start));
+      if (length == 0) {
+        continue;
+      }
+      auto position = document.PositionAt(start);
+      auto delta_line = position.line - previous.line;
+      auto delta_character = delta_line == 0 ? position.character - previous.character : position.character;
+      for (int number : {delta_line, delta_character, length, static_cast<int>(token.type), token.modifiers}) {
+        AppendInt(data, number);
+      }
+      previous = position;
+    }
+  }
+  if (!data.empty()) {
+    // The comma after the last integer.
+    data.pop_back();
+  }
+  return absl::StrCat(R"({"jsonrpc":"2.0","id":)", ToJson(id), R"(,"result":{"data":[)", data, "]}}");
+}
+
+LanguageServer::Value LanguageServer::DocumentSymbols(const Value& params) {
+  auto* open_document = FindDocument(params);
+  if (open_document == nullptr) {
+    return Null();
+  }
+  const auto& document = open_document->document;
+  auto symbols = EmptyList();
+  for (const auto& statement : open_document->statements) {
+    auto offset = statement.span.start;
+    for (const auto& symbol : statement.analysis->symbols) {
+      auto& value = Append(symbols);
+      Field(value, "name") = String(symbol.name);
+      Field(value, "kind") = Number(static_cast<int>(symbol.kind));
+      Field(value, "range") = RangeValue(document, offset + symbol.start, offset + symbol.end);
+      Field(value, "selectionRange") = RangeValue(document, offset + symbol.name_start, offset + symbol.name_end);
+    }
+  }
+  return symbols;
+}
+
+LanguageServer::Value LanguageServer::CodeActions(const Value& params) {
+  auto actions = EmptyList();
+  auto* open_document = FindDocument(params);
+  const auto* diagnostics = Get(params, {"context", "diagnostics"});
+  if (open_document == nullptr || diagnostics == nullptr) {
+    return actions;
+  }
+  const auto& document = open_document->document;
+  absl::string_view text = document.text();
+  auto uri = GetString(params, {"textDocument", "uri"});
+  for (const auto& diagnostic : diagnostics->list_value().values()) {
+    auto offset = document.OffsetAt(GetPosition(diagnostic, {"range", "start"}));
+    auto statement = std::find_if(open_document->statements.begin(), open_document->statements.end(),
+                                  [offset](const Statement& statement) { return offset <= statement.span.end; });
+    if (statement == open_document->statements.end() || offset < statement->span.start) {
+      continue;
+    }
+    const auto& span = statement->span;
+    auto fixes = FixStatement(text.substr(span.start, span.end - span.start), GetString(diagnostic, {"message"}),
+                              offset - span.start);
+    for (const auto& fix : fixes) {
+      auto& action = Append(actions);
+      Field(action, "title") = String(fix.title);
+      Field(action, "kind") = String("quickfix");
+      Append(Field(action, "diagnostics")) = diagnostic;
+      auto& changes = Field(Field(Field(action, "edit"), "changes"), uri);
+      for (const auto& query_edit : fix.edits) {
+        auto& edit = Append(changes);
+        Field(edit, "range") = RangeValue(document, span.start + query_edit.range.start().GetByteOffset(),
+                                          span.start + query_edit.range.end().GetByteOffset());
+        Field(edit, "newText") = String(query_edit.replacement);
+      }
+    }
+  }
+  return actions;
+}
+
+}  // bigquery::utils::zetasql_helper::lsp
@@ -0,0 +1,99 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LSP_LANGUAGE_SERVER_H_
+#define ZETASQL_HELPER_LSP_LANGUAGE_SERVER_H_
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/struct.pb.h"
+#include "zetasql_helper/lsp/document.h"
+#include "zetasql_helper/lsp/statement_analysis.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+// A Language Server for BigQuery scripts, speaking JSON-RPC over a pair of streams. It supports
+// the incremental synchronization of the documents, the diagnostics of the parser, the semantic
+// tokens, the document symbols, and code actions fixing the errors reported by BigQuery with the
+// helper fixers.
+//
+// A document is analyzed one statement at a time, and the analysis of a statement is kept until
+// its text changes, so an edit only re-parses the statements it touched.
+//
+// The class is not thread-safe: the messages are handled one at a time, in order.
+class LanguageServer {
+ public:
+  LanguageServer() = default;
+
+  LanguageServer(const LanguageServer&) = delete;
+  LanguageServer& operator=(const LanguageServer&) = delete;
+
+  // Serve the messages of `input` until the exit notification or the end of the input. Return
+  // the exit code of the server: 0 if it was shut down before exiting, and 1 otherwise.
+  int Run(std::istream& input, std::ostream& output);
+
+  // Handle one message, and append the messages to send back (a response and notifications)
+  // to `replies`. Return false once the exit notification is received.
+  bool Handle(absl::string_view message, std::vector<std::string>* replies);
+
+ private:
+  struct Statement {
+    TextSpan span;
+    std::shared_ptr<const StatementAnalysis> analysis;
+  };
+
+  struct OpenDocument {
+    explicit OpenDocument(std::string text, int64_t version) : document(std::move(text), version) {}
+
+    Document document;
+    // The statements of the document, in order.
+    std::vector<Statement> statements;
+    // The analysis of the statements, by text.
+    absl::flat_hash_map<std::string, std::shared_ptr<const StatementAnalysis>> analyses;
+  };
+
+  using Value = google::protobuf::Value;
+
+  // Split a document into statements, and analyze the ones which are not cached.
+  void Analyze(OpenDocument& open_document);
+
+  void DidOpen(const Value& params, std::vector<std::string>* replies);
+  void DidChange(const Value& params, std::vector<std::string>* replies);
+  void DidClose(const Value& params, std::vector<std::string>* replies);
+  std::string SemanticTokens(const Value& id, const Value& params);
+  Value DocumentSymbols(const Value& params);
+  Value CodeActions(const Value& params);
+
+  // The publishDiagnostics notification of a document.
+  std::string PublishDiagnostics(const std::string& uri, const OpenDocument& open_document);
+
+  // The open document of a request, or null.
+  OpenDocument* FindDocument(const Value& params);
+
+  absl::flat_hash_map<std::string, std::unique_ptr<OpenDocument>> documents_;
+  bool shutdown_ = false;
+};
+
+}  // bigquery::utils::zetasql_helper::lsp
+
+#endif  // ZETASQL_HELPER_LSP_LANGUAGE_SERVER_H_
@@ -0,0 +1,33 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+// A Language Server for BigQuery scripts, speaking the Language Server Protocol over stdin and
+// stdout. The editor starts it as a subprocess, e.g. `lsp_server` in the server command of its
+// LSP client.
+
+#include <iostream>
+
+#include "zetasql_helper/lsp/language_server.h"
+
+int main(int argc, char** argv) {
+  // The messages are framed by their length, so the streams must not be synchronized with stdio
+  // nor translated.
+  std::ios::sync_with_stdio(false);
+  std::cin.tie(nullptr);
+  bigquery::utils::zetasql_helper::lsp::LanguageServer server;
+  return server.Run(std::cin, std::cout);
+}
@@ -0,0 +1,201 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/lsp/document.h"
+#include "zetasql_helper/lsp/json_rpc.h"
+#include "zetasql_helper/lsp/language_server.h"
+#include "zetasql_helper/lsp/statement_analysis.h"
+
+using namespace bigquery::utils::zetasql_helper;
+using namespace bigquery::utils::zetasql_helper::lsp;
+
+namespace {
+
+std::string Text(absl::string_view text, const TextSpan& span) {
+  return std::string(text.substr(span.start, span.end - span.start));
+}
+
+}
+
+class LspTest : public ::testing::Test {
+
+};
+
+TEST_F(LspTest, ApplyEditsToDocument) {
+  Document document("SELECT 1;\nSELECT 2;\nSELECT 3;", 1);
+  EXPECT_EQ(document.line_count(), 3);
+
+  // Replace "2" with "x,\n  y".
+  document.Apply({1, 7}, {1, 8}, "x,\n  y", 2);
+  EXPECT_EQ(document.text(), "SELECT 1;\nSELECT x,\n  y;\nSELECT 3;");
+  EXPECT_EQ(document.version(), 2);
+  EXPECT_EQ(document.line_count(), 4);
+  EXPECT_EQ(document.OffsetAt({3, 0}), 25);
+
+  // Join the first two lines.
+  document.Apply({0, 9}, {1, 0}, " ", 3);
+  EXPECT_EQ(document.text(), "SELECT 1; SELECT x,\n  y;\nSELECT 3;");
+  EXPECT_EQ(document.line_count(), 3);
+  EXPECT_EQ(document.PositionAt(document.text().find("y")).line, 1);
+
+  // Positions past the end are clamped.
+  EXPECT_EQ(document.OffsetAt({0, 100}), 19);
+  EXPECT_EQ(document.OffsetAt({10, 0}), document.text().size());
+}
+
+TEST_F(LspTest, CountPositionsInUtf16) {
+  // "é" is 2 bytes and 1 unit, and "😀" is 4 bytes and 2 units.
+  Document document("SELECT 'é😀', x", 1);
+  EXPECT_EQ(Utf16Length("é😀"), 3);
+  auto x = document.text().find("x");
+  EXPECT_EQ(document.PositionAt(x).character, 14);
+  EXPECT_EQ(document.OffsetAt({0, 14}), x);
+}
+
+TEST_F(LspTest, SplitStatements) {
+  absl::string_view script = "SELECT ';' AS a; -- comment;\n"
+                             "SELECT `x;y` FROM t /* ; */;\n"
+                             " ; \n"
+                             "SELECT \"\"\"a;\nb\"\"\"";
+  auto spans = SplitStatements(script);
+  ASSERT_EQ(spans.size(), 3);
+  EXPECT_EQ(Text(script, spans[0]), "SELECT ';' AS a");
+  EXPECT_EQ(Text(script, spans[1]), "-- comment;\nSELECT `x;y` FROM t /* ; */");
+  EXPECT_EQ(Text(script, spans[2]), "SELECT \"\"\"a;\nb\"\"\"");
+}
+
+TEST_F(LspTest, FrameMessages) {
+  std::stringstream stream;
+  WriteMessage(stream, R"({"id":1})");
+  WriteMessage(stream, "{}");
+  EXPECT_TRUE(absl::StartsWith(stream.str(), "Content-Length: 8\r\n\r\n"));
+
+  std::string body;
+  ASSERT_TRUE(ReadMessage(stream, &body));
+  EXPECT_EQ(body, R"({"id":1})");
+  ASSERT_TRUE(ReadMessage(stream, &body));
+  EXPECT_EQ(body, "{}");
+  EXPECT_FALSE(ReadMessage(stream, &body));
+}
+
+TEST_F(LspTest, AnalyzeStatement) {
+  auto analysis = AnalyzeStatement("SELECT COUNT(*), 'a' -- total\nFROM t WHERE x = 1");
+  std::vector<SemanticTokensProto::Type> types;
+  for (const auto& token : analysis.tokens) {
+    types.push_back(token.type);
+  }
+  // The same types as GetSemanticTokens, from the parse tree.
+  std::vector<SemanticTokensProto::Type> expected = {
+      SemanticTokensProto::KEYWORD, SemanticTokensProto::FUNCTION, SemanticTokensProto::OPERATOR,
+      SemanticTokensProto::OPERATOR, SemanticTokensProto::OPERATOR, SemanticTokensProto::OPERATOR,
+      SemanticTokensProto::STRING, SemanticTokensProto::COMMENT, SemanticTokensProto::KEYWORD,
+      SemanticTokensProto::TABLE, SemanticTokensProto::KEYWORD, SemanticTokensProto::COLUMN,
+      SemanticTokensProto::OPERATOR, SemanticTokensProto::NUMBER,
+  };
+  EXPECT_EQ(types, expected);
+  EXPECT_TRUE(analysis.diagnostics.empty());
+
+  analysis = AnalyzeStatement("SELECT a FROM");
+  ASSERT_EQ(analysis.diagnostics.size(), 1);
+  EXPECT_EQ(analysis.diagnostics[0].start, 13);
+  EXPECT_TRUE(absl::StartsWith(analysis.diagnostics[0].message, "Syntax error"));
+
+  // The statements of a script are not parsed.
+  EXPECT_TRUE(AnalyzeStatement("DECLARE x INT64 DEFAULT 1").diagnostics.empty());
+}
+
+TEST_F(LspTest, FindSymbols) {
+  auto symbols = AnalyzeStatement("CREATE OR REPLACE TEMP TABLE `p.d.t` AS SELECT 1 AS a").symbols;
+  ASSERT_EQ(symbols.size(), 1);
+  EXPECT_EQ(symbols[0].name, "p.d.t");
+  EXPECT_EQ(symbols[0].kind, SymbolKind::kClass);
+
+  symbols = AnalyzeStatement("DECLARE x, y INT64").symbols;
+  ASSERT_EQ(symbols.size(), 2);
+  EXPECT_EQ(symbols[1].name, "y");
+  EXPECT_EQ(symbols[1].kind, SymbolKind::kVariable);
+
+  symbols = AnalyzeStatement("WITH a AS (SELECT 1), b AS (SELECT 2) SELECT * FROM a, b").symbols;
+  ASSERT_EQ(symbols.size(), 2);
+  EXPECT_EQ(symbols[0].name, "a");
+  EXPECT_EQ(symbols[1].name, "b");
+}
+
+TEST_F(LspTest, FixStatement) {
+  auto fixes = FixStatement("SELECT status FROM t GROUP BY key",
+                            "SELECT list expression references column status which is neither grouped nor "
+                            "aggregated at [1:8]", 7);
+  ASSERT_EQ(fixes.size(), 1);
+  EXPECT_EQ(fixes[0].title, "Add status to the GROUP BY clause");
+  EXPECT_EQ(fixes[0].fixed_query, "SELECT status FROM t GROUP BY key, status");
+
+  fixes = FixStatement("SELECT a, a FROM t",
+                       "Duplicate column names in the result are not supported. Found duplicate(s): a", 0);
+  ASSERT_EQ(fixes.size(), 1);
+  EXPECT_EQ(fixes[0].fixed_query, "SELECT a AS a_1, a AS a_2 FROM t");
+
+  // The position in the message is relative to the script, not to the statement.
+  fixes = FixStatement("SELECT status FROM t GROUP BY key",
+                       "SELECT list expression references column status which is neither grouped nor "
+                       "aggregated at [3:8]", 7);
+  ASSERT_EQ(fixes.size(), 1);
+  ASSERT_EQ(fixes[0].edits.size(), 1);
+  EXPECT_EQ(fixes[0].edits[0].range.start().GetByteOffset(), 33);
+  EXPECT_EQ(fixes[0].edits[0].replacement, ", status");
+}
+
+TEST_F(LspTest, ServeDocument) {
+  auto message = [](absl::string_view body) { return absl::StrCat("Content-Length: ", body.size(), "\r\n\r\n", body); };
+  std::stringstream input;
+  input << message(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})")
+        << message(R"({"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":)"
+                   R"({"uri":"file:///a.sql","version":1,"text":"SELECT 1;\nSELECT x FROM"}}})")
+        << message(R"({"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":)"
+                   R"({"uri":"file:///a.sql","version":2},"contentChanges":[)"
+                   R"({"range":{"start":{"line":1,"character":14},"end":{"line":1,"character":14}},"text":" t"}]}})")
+        << message(R"({"jsonrpc":"2.0","id":2,"method":"textDocument/semanticTokens/full",)"
+                   R"("params":{"textDocument":{"uri":"file:///a.sql"}}})")
+        << message(R"({"jsonrpc":"2.0","id":3,"method":"unknown"})")
+        << message(R"({"jsonrpc":"2.0","id":4,"method":"shutdown"})")
+        << message(R"({"jsonrpc":"2.0","method":"exit"})");
+  std::stringstream output;
+  LanguageServer server;
+  EXPECT_EQ(server.Run(input, output), 0);
+
+  std::vector<std::string> replies;
+  std::string body;
+  while (ReadMessage(output, &body)) {
+    replies.push_back(body);
+  }
+  ASSERT_EQ(replies.size(), 6);
+  EXPECT_TRUE(absl::StrContains(replies[0], R"("semanticTokensProvider")"));
+  EXPECT_TRUE(absl::StrContains(replies[0], R"("tokenTypes":["keyword","class","property",)"));
+  EXPECT_TRUE(absl::StrContains(replies[0], R"("tokenModifiers":["declaration"])"));
+  // The missing table name, and then no error once it is typed.
+  EXPECT_TRUE(absl::StrContains(replies[1], R"("line":1)"));
+  EXPECT_TRUE(absl::StrContains(replies[1], "Syntax error"));
+  EXPECT_TRUE(absl::StrContains(replies[2], R"("diagnostics":[])"));
+  // SELECT 1 on line 0, then SELECT x FROM t on line 1, with the column x and the table t.
+  EXPECT_TRUE(absl::StrContains(replies[3], R"("data":[0,0,6,0,0,0,7,1,8,0,1,0,6,0,0,0,7,1,2,0,0,2,4,0,0,0,5,1,1,0])"));
+  EXPECT_TRUE(absl::StrContains(replies[4], "-32601"));
+  EXPECT_TRUE(absl::StrContains(replies[5], R"("result":null)"));
+}
@@ -0,0 +1,131 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/lsp/statement_analysis.h"
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "zetasql/public/error_helpers.h"
+#include "zetasql_helper/token/token.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+namespace {
+
+// The first keywords of the statements of the scripting language, which the statement parser
+// does not accept.
+constexpr absl::string_view kScriptKeywords[] = {
+    "BEGIN", "END", "IF", "ELSEIF", "ELSE", "LOOP", "WHILE", "REPEAT", "UNTIL", "FOR",
+    "EXCEPTION", "DECLARE", "SET", "CALL", "RETURN", "BREAK", "LEAVE", "CONTINUE", "ITERATE",
+    "RAISE", "EXECUTE",
+};
+
+bool IsScriptStatement(const std::vector<zetasql::ParseToken>& tokens, absl::string_view statement) {
+  for (const auto& token : tokens) {
+    if (token.kind() == zetasql::ParseToken::COMMENT) {
+      continue;
+    }
+    if (token.IsEndOfInput()) {
+      break;
+    }
+    auto range = token.GetLocationRange();
+    auto word = statement.substr(range.start().GetByteOffset(),
+                                 range.end().GetByteOffset() - range.start().GetByteOffset());
+    for (auto keyword : kScriptKeywords) {
+      if (absl::EqualsIgnoreCase(word, keyword)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  // Only comments.
+  return true;
+}
+
+// Turn an error of the parser into a diagnostic. The location is read from the one-line error
+// message, e.g. "Syntax error: Unexpected end of statement [at 1:15]", and the diagnostic
+// covers the word starting there.
+Diagnostic ToDiagnostic(absl::string_view statement, const absl::Status& status) {
+  auto error = zetasql::MaybeUpdateErrorFromPayload(zetasql::ERROR_MESSAGE_ONE_LINE, statement, status);
+  absl::string_view message = error.message();
+  Diagnostic diagnostic{0, static_cast<int>(statement.size()), std::string(message)};
+
+  auto location_start = message.rfind(" [at ");
+  if (location_start == absl::string_view::npos || !absl::EndsWith(message, "]")) {
+    return diagnostic;
+  }
+  auto location = message.substr(location_start + 5, message.size() - location_start - 6);
+  std::pair<absl::string_view, absl::string_view> line_and_column = absl::StrSplit(location, ':');
+  int line, column;
+  if (!absl::SimpleAtoi(line_and_column.first, &line) || !absl::SimpleAtoi(line_and_column.second, &column)) {
+    return diagnostic;
+  }
+  auto offset = get_offset(statement, line, column);
+  if (offset < 0) {
+    return diagnostic;
+  }
+  diagnostic.message = std::string(message.substr(0, location_start));
+  diagnostic.start = offset;
+  diagnostic.end = offset;
+  while (diagnostic.end < statement.size() &&
+         (absl::ascii_isalnum(statement[diagnostic.end]) || statement[diagnostic.end] == '_')) {
+    diagnostic.end++;
+  }
+  if (diagnostic.end == diagnostic.start && diagnostic.end < statement.size()) {
+    diagnostic.end++;
+  }
+  return diagnostic;
+}
+
+}
+
+StatementAnalysis AnalyzeStatement(absl::string_view statement) {
+  StatementAnalysis analysis;
+  std::vector<zetasql::ParseToken> parse_tokens;
+  auto status = Tokenize(std::string(statement), parse_tokens, nullptr, /*include_comments=*/true);
+  if (!status.ok()) {
+    // E.g. an unclosed string literal.
+    analysis.diagnostics.push_back(ToDiagnostic(statement, status));
+    return analysis;
+  }
+  std::unique_ptr<zetasql::ParserOutput> output;
+  const zetasql::ASTNode* root = nullptr;
+  if (!IsScriptStatement(parse_tokens, statement)) {
+    status = ParseBigQueryStatement(statement, &output);
+    if (status.ok()) {
+      root = output->statement();
+    } else {
+      analysis.diagnostics.push_back(ToDiagnostic(statement, status));
+    }
+  }
+  // Without a cancellation token, the tokens are always typed.
+  ClassifyTokens(parse_tokens, root, 0, statement.size(), &analysis.tokens).IgnoreError();
+  analysis.symbols = FindSymbols(statement, analysis.tokens);
+  return analysis;
+}
+
+std::vector<QueryFix> FixStatement(absl::string_view statement, absl::string_view message, int offset) {
+  std::vector<QueryFix> fixes;
+  // A statement which does not parse has no fix.
+  FixerRegistry::Global().Fix(statement, message, offset, &fixes).IgnoreError();
+  return fixes;
+}
+
+}  // bigquery::utils::zetasql_helper::lsp
@@ -0,0 +1,84 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_LSP_STATEMENT_ANALYSIS_H_
+#define ZETASQL_HELPER_LSP_STATEMENT_ANALYSIS_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "zetasql_helper/fixer/fixer_registry.h"
+#include "zetasql_helper/token/semantic_tokens.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+// The name of a token type in the Language Server Protocol. The legend sent to the client lists
+// the types in the order of SemanticTokensProto::Type, so that a type is sent as its number.
+absl::string_view TokenTypeName(SemanticTokensProto::Type type);
+
+struct Diagnostic {
+  int start;
+  int end;
+  std::string message;
+};
+
+// The symbol kinds of the Language Server Protocol used for the symbols of a script.
+enum class SymbolKind {
+  kClass = 5,
+  kFunction = 12,
+  kVariable = 13,
+};
+
+// A name declared by a statement: a created table, view, function or procedure, a declared
+// variable, or a WITH clause.
+struct Symbol {
+  std::string name;
+  SymbolKind kind;
+  // The declaration, and the name within it.
+  int start;
+  int end;
+  int name_start;
+  int name_end;
+};
+
+// What the language server knows about one statement of a script. The offsets are relative to
+// the statement.
+struct StatementAnalysis {
+  std::vector<SemanticToken> tokens;
+  std::vector<Diagnostic> diagnostics;
+  std::vector<Symbol> symbols;
+};
+
+// Tokenize and parse a statement, and type its tokens with ClassifyTokens(). The statements of the
+// scripting language (e.g. BEGIN, IF or DECLARE) are tokenized but not parsed, since a script is
+// analyzed one statement at a time, so their tokens are typed without a parse tree.
+StatementAnalysis AnalyzeStatement(absl::string_view statement);
+
+// Find the symbols declared by a statement, from its tokens.
+std::vector<Symbol> FindSymbols(absl::string_view statement, const std::vector<SemanticToken>& tokens);
+
+// The fixes of the fixers of FixerRegistry::Global() for an error reported by BigQuery on a
+// statement, e.g. "SELECT list expression references column status which is neither grouped nor
+// aggregated at [1:8]". `offset` is the position of the error within the statement, and the
+// position in the message, relative to the script, is ignored. The edits are relative to the
+// statement.
+std::vector<QueryFix> FixStatement(absl::string_view statement, absl::string_view message, int offset);
+
+}  // bigquery::utils::zetasql_helper::lsp
+
+#endif  // ZETASQL_HELPER_LSP_STATEMENT_ANALYSIS_H_
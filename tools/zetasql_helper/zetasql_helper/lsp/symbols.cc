@@ -0,0 +1,224 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include <algorithm>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/strip.h"
+#include "zetasql_helper/lsp/statement_analysis.h"
+
+namespace bigquery::utils::zetasql_helper::lsp {
+
+namespace {
+
+// A cursor over the tokens of a statement which skips the comments.
+class TokenCursor {
+ public:
+  TokenCursor(absl::string_view statement, const std::vector<SemanticToken>& tokens)
+      : statement_(statement), tokens_(tokens) {
+    SkipComments();
+  }
+
+  bool done() const { return index_ >= tokens_.size(); }
+  const SemanticToken& token() const { return tokens_[index_]; }
+  absl::string_view text() const {
+    return done() ? "" : statement_.substr(token().start, token().end - token().start);
+  }
+  bool IsWord(absl::string_view word) const {
+    return !done() && token().type != SemanticTokensProto::STRING && absl::EqualsIgnoreCase(text(), word);
+  }
+  // Any identifier or keyword, whatever the parse tree made of it.
+  bool IsName() const {
+    switch (done() ? SemanticTokensProto::OPERATOR : token().type) {
+      case SemanticTokensProto::STRING:
+      case SemanticTokensProto::NUMBER:
+      case SemanticTokensProto::COMMENT:
+      case SemanticTokensProto::OPERATOR:
+        return false;
+      default:
+        return true;
+    }
+  }
+
+  void Next() {
+    index_++;
+    SkipComments();
+  }
+
+  // Skip the next token if it is `word`.
+  bool Accept(absl::string_view word) {
+    if (!IsWord(word)) {
+      return false;
+    }
+    Next();
+    return true;
+  }
+
+  // Read a name path (a.b.c) into `name`, without the backticks. Return false if there is none.
+  bool ReadPath(std::string* name, int* start, int* end) {
+    if (!IsName()) {
+      return false;
+    }
+    *start = token().start;
+    std::vector<absl::string_view> parts;
+    while (true) {
+      parts.push_back(absl::StripSuffix(absl::StripPrefix(text(), "`"), "`"));
+      *end = token().end;
+      Next();
+      if (!IsWord(".")) {
+        break;
+      }
+      Next();
+      if (!IsName()) {
+        break;
+      }
+    }
+    *name = absl::StrJoin(parts, ".");
+    return true;
+  }
+
+  // Skip the tokens up to the parenthesis closing the one of the current token, and return the
+  // end of the closing parenthesis.
+  int SkipParentheses() {
+    int depth = 0;
+    int end = done() ? statement_.size() : token().end;
+    while (!done()) {
+      if (IsWord("(")) {
+        depth++;
+      } else if (IsWord(")")) {
+        depth--;
+      }
+      end = token().end;
+      Next();
+      if (depth == 0) {
+        break;
+      }
+    }
+    return end;
+  }
+
+ private:
+  void SkipComments() {
+    while (!done() && tokens_[index_].type == SemanticTokensProto::COMMENT) {
+      index_++;
+    }
+  }
+
+  absl::string_view statement_;
+  const std::vector<SemanticToken>& tokens_;
+  int index_ = 0;
+};
+
+void FindCreatedObject(TokenCursor& cursor, int statement_end, std::vector<Symbol>& symbols) {
+  auto start = cursor.token().start;
+  cursor.Next();
+  cursor.Accept("OR") && cursor.Accept("REPLACE");
+  cursor.Accept("TEMP") || cursor.Accept("TEMPORARY");
+  cursor.Accept("MATERIALIZED");
+
+  SymbolKind kind;
+  if (cursor.Accept("TABLE")) {
+    kind = cursor.Accept("FUNCTION") ? SymbolKind::kFunction : SymbolKind::kClass;
+  } else if (cursor.Accept("VIEW")) {
+    kind = SymbolKind::kClass;
+  } else if (cursor.Accept("FUNCTION") || cursor.Accept("PROCEDURE")) {
+    kind = SymbolKind::kFunction;
+  } else {
+    return;
+  }
+  cursor.Accept("IF") && cursor.Accept("NOT") && cursor.Accept("EXISTS");
+
+  Symbol symbol{"", kind, start, statement_end};
+  if (cursor.ReadPath(&symbol.name, &symbol.name_start, &symbol.name_end)) {
+    symbols.push_back(symbol);
+  }
+}
+
+void FindDeclaredVariables(TokenCursor& cursor, int statement_end, std::vector<Symbol>& symbols) {
+  auto start = cursor.token().start;
+  cursor.Next();
+  do {
+    if (!cursor.IsName()) {
+      return;
+    }
+    auto name = std::string(cursor.text());
+    symbols.push_back({name, SymbolKind::kVariable, start, statement_end, cursor.token().start, cursor.token().end});
+    cursor.Next();
+  } while (cursor.Accept(","));
+}
+
+void FindWithClauses(TokenCursor& cursor, std::vector<Symbol>& symbols) {
+  cursor.Next();
+  cursor.Accept("RECURSIVE");
+  do {
+    Symbol symbol{"", SymbolKind::kClass};
+    if (!cursor.ReadPath(&symbol.name, &symbol.name_start, &symbol.name_end) || !cursor.Accept("AS") ||
+        !cursor.IsWord("(")) {
+      return;
+    }
+    symbol.start = symbol.name_start;
+    symbol.end = cursor.SkipParentheses();
+    symbols.push_back(symbol);
+  } while (cursor.Accept(","));
+}
+
+}
+
+absl::string_view TokenTypeName(SemanticTokensProto::Type type) {
+  switch (type) {
+    case SemanticTokensProto::KEYWORD:
+      return "keyword";
+    case SemanticTokensProto::TABLE:
+      return "class";
+    case SemanticTokensProto::COLUMN:
+      return "property";
+    case SemanticTokensProto::FUNCTION:
+      return "function";
+    case SemanticTokensProto::TYPE:
+      return "type";
+    case SemanticTokensProto::PARAMETER:
+      return "parameter";
+    case SemanticTokensProto::IDENTIFIER:
+      return "variable";
+    case SemanticTokensProto::STRING:
+      return "string";
+    case SemanticTokensProto::NUMBER:
+      return "number";
+    case SemanticTokensProto::COMMENT:
+      return "comment";
+    case SemanticTokensProto::OPERATOR:
+      return "operator";
+  }
+  return "unknown";
+}
+
+std::vector<Symbol> FindSymbols(absl::string_view statement, const std::vector<SemanticToken>& tokens) {
+  std::vector<Symbol> symbols;
+  TokenCursor cursor(statement, tokens);
+  if (cursor.IsWord("CREATE")) {
+    FindCreatedObject(cursor, statement.size(), symbols);
+  } else if (cursor.IsWord("DECLARE")) {
+    FindDeclaredVariables(cursor, statement.size(), symbols);
+  } else if (cursor.IsWord("WITH")) {
+    FindWithClauses(cursor, symbols);
+  }
+  return symbols;
+}
+
+}  // bigquery::utils::zetasql_helper::lsp
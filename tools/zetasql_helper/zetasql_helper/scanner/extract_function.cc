@@ -18,6 +18,7 @@
 #include "zetasql/public/analyzer.h"
 #include "zetasql/parser/parser.h"
 #include "zetasql_helper/util/util.h"
+#include "zetasql_helper/stats/server_stats.h"
 
 namespace bigquery::utils::zetasql_helper {
 
@@ -57,11 +58,11 @@ zetasql_base::StatusOr<FunctionRangeProto> FunctionRange::ToProto() const {
 absl::Status ExtractFunctionRange(absl::string_view query,
                                   int row,
                                   int column,
-                                  std::unique_ptr<FunctionRange>* output) {
+                                  std::unique_ptr<FunctionRange>* output,
+                                  const CancellationToken* cancellation) {
 
   std::unique_ptr<zetasql::ParserOutput> parser_output;
-  auto options = BigQueryOptions();
-  ZETASQL_RETURN_IF_ERROR(ParseStatement(query, options.GetParserOptions(), &parser_output));
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
 
   auto offset = get_offset(query, row, column);
   auto predicator = [offset](const zetasql::ASTNode* node) {
@@ -69,7 +70,10 @@ absl::Status ExtractFunctionRange(absl::string_view query,
         node->node_kind() == zetasql::ASTNodeKind::AST_FUNCTION_CALL;
   };
 
-  auto candidate = FindNode(parser_output->statement(), predicator);
+  stats::ScopedPhase traversal(stats::Phase::kTraversal);
+  CancellationChecker checker(cancellation);
+  auto candidate = FindNode(parser_output->statement(), predicator, &checker);
+  ZETASQL_RETURN_IF_ERROR(checker.status());
   if (candidate == nullptr) {
     return absl::Status(absl::StatusCode::kInvalidArgument, "Line and/or column numbers are incorrect");
   }
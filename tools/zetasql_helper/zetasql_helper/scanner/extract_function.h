@@ -23,6 +23,7 @@
 #include "zetasql/public/parse_location.h"
 #include "zetasql/parser/parse_tree.h"
 #include "zetasql_helper/scanner/function_range.pb.h"
+#include "zetasql_helper/util/cancellation.h"
 
 namespace bigquery::utils::zetasql_helper {
 
@@ -50,10 +51,12 @@ struct FunctionRange {
 // function: foo.bar(123, foo.bar(1,2,3), "a")
 // name: foo.bar
 // arguments: [123, foo.bar(1,2,3), "a"]
+// The optional `cancellation` is checked while the AST is traversed.
 absl::Status ExtractFunctionRange(absl::string_view query,
                                   int row,
                                   int column,
-                                  std::unique_ptr<FunctionRange>* output);
+                                  std::unique_ptr<FunctionRange>* output,
+                                  const CancellationToken* cancellation = nullptr);
 
 }
 
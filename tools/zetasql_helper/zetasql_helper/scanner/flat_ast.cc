@@ -0,0 +1,97 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "flat_ast.h"
+
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+void AppendInt32(int32_t value, std::string* output) {
+  auto bits = static_cast<uint32_t>(value);
+  char bytes[4] = {static_cast<char>(bits), static_cast<char>(bits >> 8), static_cast<char>(bits >> 16),
+                   static_cast<char>(bits >> 24)};
+  output->append(bytes, sizeof(bytes));
+}
+
+}
+
+absl::Status FlattenAst(const zetasql::ASTNode* root, bool include_identifiers, FlatAstProto* output,
+                        CancellationChecker* checker) {
+  auto* kinds = output->mutable_kinds();
+  auto* parents = output->mutable_parents();
+  auto* starts = output->mutable_starts();
+  auto* ends = output->mutable_ends();
+  auto* identifier_nodes = output->mutable_identifier_nodes();
+  absl::flat_hash_map<int, int> kind_indexes;
+
+  // An explicit stack, so that deeply nested queries do not overflow the thread stack. The
+  // children are pushed in reverse, so that they are numbered in the order of the query.
+  std::vector<std::pair<const zetasql::ASTNode*, int>> stack;
+  if (root != nullptr) {
+    stack.push_back({root, -1});
+  }
+  int32_t count = 0;
+  while (!stack.empty()) {
+    if (checker != nullptr && checker->Tick()) {
+      return checker->status();
+    }
+    auto [node, parent] = stack.back();
+    stack.pop_back();
+    int32_t index = count++;
+
+    auto kind = kind_indexes.try_emplace(node->node_kind(), output->kind_names_size());
+    if (kind.second) {
+      output->add_kind_names(node->GetNodeKindString());
+    }
+    AppendInt32(kind.first->second, kinds);
+    AppendInt32(parent, parents);
+    auto range = node->GetParseLocationRange();
+    AppendInt32(range.start().GetByteOffset(), starts);
+    AppendInt32(range.end().GetByteOffset(), ends);
+
+    if (include_identifiers && node->node_kind() == zetasql::AST_IDENTIFIER) {
+      AppendInt32(index, identifier_nodes);
+      auto name = static_cast<const zetasql::ASTIdentifier*>(node)->GetAsString();
+      output->add_identifiers(std::string(RemoveBacktick(name)));
+    }
+
+    for (int i = node->num_children() - 1; i >= 0; i--) {
+      stack.push_back({node->child(i), index});
+    }
+  }
+  output->set_node_count(count);
+  return absl::OkStatus();
+}
+
+absl::Status ExportAst(absl::string_view query, bool include_identifiers, FlatAstProto* output,
+                       const CancellationToken* cancellation) {
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
+
+  stats::ScopedPhase traversal(stats::Phase::kTraversal);
+  CancellationChecker checker(cancellation);
+  return FlattenAst(parser_output->statement(), include_identifiers, output, &checker);
+}
+
+} // bigquery::utils::zetasql_helper
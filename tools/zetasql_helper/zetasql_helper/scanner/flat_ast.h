@@ -0,0 +1,41 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_FLAT_AST_H_
+#define ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_FLAT_AST_H_
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "zetasql/parser/parse_tree.h"
+#include "zetasql_helper/scanner/flat_ast.pb.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// Flatten the AST rooted at `root` into `output` (see FlatAstProto). The names of the
+// identifiers are only exported if `include_identifiers` is set. The optional `checker` is
+// ticked for every node.
+absl::Status FlattenAst(const zetasql::ASTNode* root, bool include_identifiers, FlatAstProto* output,
+                        CancellationChecker* checker = nullptr);
+
+// Parse the query and flatten its AST into `output`. The optional `cancellation` is checked
+// while the query is parsed and while the AST is traversed.
+absl::Status ExportAst(absl::string_view query, bool include_identifiers, FlatAstProto* output,
+                       const CancellationToken* cancellation = nullptr);
+
+} // bigquery::utils::zetasql_helper
+
+#endif // ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_FLAT_AST_H_
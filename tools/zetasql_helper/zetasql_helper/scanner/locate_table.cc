@@ -17,6 +17,7 @@
 #include "locate_table.h"
 #include "zetasql/parser/parser.h"
 #include "zetasql_helper/util/util.h"
+#include "zetasql_helper/stats/server_stats.h"
 #include "absl/strings/str_join.h"
 #include <regex>
 
@@ -24,14 +25,17 @@ namespace bigquery::utils::zetasql_helper {
 
 absl::Status LocateTableRanges(absl::string_view query,
                                absl::string_view table_regex,
-                               std::vector<zetasql::ParseLocationRange>& output) {
+                               std::vector<zetasql::ParseLocationRange>& output,
+                               const CancellationToken* cancellation) {
 
   std::unique_ptr<zetasql::ParserOutput> parser_output;
-  auto options = BigQueryOptions();
-  ZETASQL_RETURN_IF_ERROR(ParseStatement(query, options.GetParserOptions(), &parser_output));
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
+
+  // Compiled once, not for every node: compiling dominates matching a table name.
+  std::regex table_pattern{std::string(table_regex)};
 
   // Predicate to find a table whose name meets the table_rex
-  auto find_table = [table_regex](const zetasql::ASTNode* node) {
+  auto find_table = [&table_pattern](const zetasql::ASTNode* node) {
     auto table_path = dynamic_cast<const zetasql::ASTTablePathExpression*>(node);
     if (table_path == nullptr) {
       return false;
@@ -41,10 +45,13 @@ absl::Status LocateTableRanges(absl::string_view query,
     auto names = ReadNames(*table_path->path_expr());
     auto full_name = absl::StrJoin(names, ".");
 
-    return std::regex_match(full_name, std::regex(std::string(table_regex)));
+    return std::regex_match(full_name, table_pattern);
   };
 
-  auto table_nodes = FindAllNodes(parser_output->statement(), find_table);
+  stats::ScopedPhase traversal(stats::Phase::kTraversal);
+  CancellationChecker checker(cancellation);
+  auto table_nodes = FindAllNodes(parser_output->statement(), find_table, &checker);
+  ZETASQL_RETURN_IF_ERROR(checker.status());
   for (const auto table_node : table_nodes) {
     output.push_back(table_node->GetParseLocationRange());
   }
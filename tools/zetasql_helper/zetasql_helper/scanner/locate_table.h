@@ -31,11 +31,13 @@ namespace bigquery::utils::zetasql_helper {
 //
 // Input is a SQL query and the regex to match table name. The found table ranges will be pushed back
 // into the output vector. If an error occurs inside this function, a status with the error will be
-// returned. Otherwise, a OKStatus will be returned.
+// returned. Otherwise, a OKStatus will be returned. The optional `cancellation` is checked while
+// the AST is traversed.
 absl::Status LocateTableRanges(
     absl::string_view query,
     absl::string_view table_regex,
-    std::vector<zetasql::ParseLocationRange>& output);
+    std::vector<zetasql::ParseLocationRange>& output,
+    const CancellationToken* cancellation = nullptr);
 
 } //bigquery::utils::zetasql_helper
 
@@ -0,0 +1,235 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "repeated_subtrees.h"
+
+#include <algorithm>
+
+#include "absl/strings/ascii.h"
+#include "zetasql/parser/keywords.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/token/token.h"
+#include "zetasql_helper/util/fingerprint.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+uint64_t Mix(uint64_t hash, uint64_t value) {
+  return Fingerprint64(absl::string_view(reinterpret_cast<const char*>(&value), sizeof(value)), hash);
+}
+
+int StartOf(const zetasql::ParseToken& token) {
+  return token.GetLocationRange().start().GetByteOffset();
+}
+
+// The hash of a token. Keywords and unquoted identifiers are case-insensitive, except the names
+// of tables when `in_table_name` is set.
+uint64_t HashToken(const zetasql::ParseToken& token, bool in_table_name) {
+  auto image = token.GetImage();
+  bool fold_case = token.kind() == zetasql::ParseToken::KEYWORD ||
+      (token.kind() == zetasql::ParseToken::IDENTIFIER_OR_KEYWORD &&
+          (!in_table_name || zetasql::parser::GetKeywordInfo(image) != nullptr));
+  if (fold_case) {
+    return Fingerprint64(absl::AsciiStrToLower(image));
+  }
+  return Fingerprint64(image);
+}
+
+// Whether the subtrees of `node` are reported.
+bool IsCandidate(const zetasql::ASTNode* node) {
+  return node->IsExpression() || node->node_kind() == zetasql::AST_QUERY;
+}
+
+
+}
+
+void RepeatedSubtreeFinder::HashSubtrees(const zetasql::ASTNode* root, int query_index,
+                                         const std::vector<zetasql::ParseToken>& tokens,
+                                         const TokenHashes& token_hashes, CancellationChecker* checker) {
+  // A node being hashed: its hash and size so far, and its next child.
+  struct Frame {
+    const zetasql::ASTNode* node;
+    bool in_table_name;
+    int next_child;
+    uint64_t hash;
+    int size;
+  };
+  // An explicit stack, so that deeply nested queries do not overflow the thread stack. A node is
+  // hashed after its children, and its tokens are consumed in the order of the query.
+  std::vector<Frame> stack;
+  auto push = [&stack](const zetasql::ASTNode* node, bool in_table_name) {
+    in_table_name = in_table_name || node->node_kind() == zetasql::AST_TABLE_PATH_EXPRESSION;
+    stack.push_back({node, in_table_name, 0, Mix(0, node->node_kind()), 1});
+  };
+  push(root, false);
+  int token_index = 0;
+  while (!stack.empty()) {
+    auto& frame = stack.back();
+    const auto& own_hashes = frame.in_table_name ? token_hashes.table_name : token_hashes.other;
+    if (frame.next_child < frame.node->num_children()) {
+      auto child = frame.node->child(frame.next_child++);
+      int child_start = child->GetParseLocationRange().start().GetByteOffset();
+      int child_end = child->GetParseLocationRange().end().GetByteOffset();
+      // The tokens of the node before the child, e.g. a keyword or an operator.
+      for (; token_index < tokens.size() && StartOf(tokens[token_index]) < child_start; token_index++) {
+        frame.hash = Mix(frame.hash, own_hashes[token_index]);
+      }
+      if (child->node_kind() == zetasql::AST_ALIAS) {
+        for (; token_index < tokens.size() && StartOf(tokens[token_index]) < child_end; token_index++) {
+        }
+        continue;
+      }
+      if (checker->Tick()) {
+        return;
+      }
+      push(child, frame.in_table_name);
+      continue;
+    }
+
+    auto range = frame.node->GetParseLocationRange();
+    int end = range.end().GetByteOffset();
+    for (; token_index < tokens.size() && StartOf(tokens[token_index]) < end; token_index++) {
+      frame.hash = Mix(frame.hash, own_hashes[token_index]);
+    }
+    if (frame.size >= min_size_ && IsCandidate(frame.node)) {
+      auto& group = groups_[{frame.hash, frame.size}];
+      if (group.kind.empty()) {
+        group.kind = frame.node->GetNodeKindString();
+      }
+      group.instances.push_back({query_index, range.start().GetByteOffset(), end});
+    }
+    auto hash = frame.hash;
+    auto size = frame.size;
+    stack.pop_back();
+    if (!stack.empty()) {
+      stack.back().hash = Mix(stack.back().hash, hash);
+      stack.back().size += size;
+    }
+  }
+}
+
+absl::Status RepeatedSubtreeFinder::AddQuery(const std::string& query, const CancellationToken* cancellation) {
+  int query_index = query_count_++;
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
+  std::vector<zetasql::ParseToken> tokens;
+  ZETASQL_RETURN_IF_ERROR(Tokenize(query, tokens, cancellation));
+
+  stats::ScopedPhase traversal(stats::Phase::kTraversal);
+  TokenHashes token_hashes;
+  token_hashes.other.reserve(tokens.size());
+  token_hashes.table_name.reserve(tokens.size());
+  for (const auto& token : tokens) {
+    token_hashes.other.push_back(HashToken(token, false));
+    token_hashes.table_name.push_back(HashToken(token, true));
+  }
+  CancellationChecker checker(cancellation);
+  HashSubtrees(parser_output->statement(), query_index, tokens, token_hashes, &checker);
+  return checker.status();
+}
+
+std::vector<RepeatedSubtree> RepeatedSubtreeFinder::Find() const {
+  std::vector<RepeatedSubtree> candidates;
+  for (const auto& [key, group] : groups_) {
+    if (group.instances.size() >= 2) {
+      candidates.push_back({key.first, key.second, group.kind, group.instances});
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const RepeatedSubtree& a, const RepeatedSubtree& b) {
+    return a.size != b.size ? a.size > b.size : a.fingerprint < b.fingerprint;
+  });
+
+  // The instances of all the candidates, with the innermost instance containing each of them. The
+  // subtrees of a query are nested or disjoint, so a sweep over the instances sorted by start finds
+  // it. A subtree contains fewer nodes than the subtrees containing it, so the candidates
+  // containing an instance are decided before the candidate of the instance.
+  struct Node {
+    const SubtreeInstance* instance;
+    int size;
+    int parent = -1;
+    // Whether the instance is in a reported instance, and whether it is reported.
+    bool covered = false;
+    bool reported = false;
+  };
+  std::vector<Node> nodes;
+  for (const auto& candidate : candidates) {
+    for (const auto& instance : candidate.instances) {
+      nodes.push_back({&instance, candidate.size});
+    }
+  }
+  std::vector<int> order(nodes.size());
+  for (int i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&nodes](int a, int b) {
+    const auto& x = *nodes[a].instance;
+    const auto& y = *nodes[b].instance;
+    if (x.query_index != y.query_index) {
+      return x.query_index < y.query_index;
+    }
+    if (x.start != y.start) {
+      return x.start < y.start;
+    }
+    // The outer one of two subtrees with the same range first.
+    return x.end != y.end ? x.end > y.end : nodes[a].size > nodes[b].size;
+  });
+  std::vector<int> enclosing;
+  for (int i = 0; i < order.size(); i++) {
+    const auto& instance = *nodes[order[i]].instance;
+    if (i > 0 && nodes[order[i - 1]].instance->query_index != instance.query_index) {
+      enclosing.clear();
+    }
+    while (!enclosing.empty() && nodes[enclosing.back()].instance->end <= instance.start) {
+      enclosing.pop_back();
+    }
+    if (!enclosing.empty()) {
+      nodes[order[i]].parent = enclosing.back();
+    }
+    enclosing.push_back(order[i]);
+  }
+
+  // Keep the instances outside of the larger reported subtrees.
+  std::vector<RepeatedSubtree> repeated;
+  int first_node = 0;
+  for (auto& candidate : candidates) {
+    int end_node = first_node + candidate.instances.size();
+    std::vector<SubtreeInstance> instances;
+    for (int i = first_node; i < end_node; i++) {
+      auto& node = nodes[i];
+      if (node.parent >= 0) {
+        node.covered = nodes[node.parent].covered || nodes[node.parent].reported;
+      }
+      if (!node.covered) {
+        instances.push_back(*node.instance);
+      }
+    }
+    if (instances.size() >= 2) {
+      for (int i = first_node; i < end_node; i++) {
+        nodes[i].reported = !nodes[i].covered;
+      }
+      // The instances of the candidate are not read by the later candidates.
+      candidate.instances = std::move(instances);
+      repeated.push_back(std::move(candidate));
+    }
+    first_node = end_node;
+  }
+  return repeated;
+}
+
+} // bigquery::utils::zetasql_helper
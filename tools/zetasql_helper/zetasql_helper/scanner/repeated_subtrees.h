@@ -0,0 +1,95 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_REPEATED_SUBTREES_H_
+#define ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_REPEATED_SUBTREES_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "zetasql/parser/parse_tree.h"
+#include "zetasql/public/parse_tokens.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// An occurrence of a subtree: the query it belongs to and its byte range [start, end).
+struct SubtreeInstance {
+  int query_index;
+  int start;
+  int end;
+};
+
+// Identical subtrees found at several places.
+struct RepeatedSubtree {
+  // The structural hash shared by the subtrees.
+  uint64_t fingerprint;
+  // The number of AST nodes of each subtree.
+  int size;
+  // The kind of the subtrees, e.g. "Query" or "BinaryExpression".
+  std::string kind;
+  // In the order of the queries, then of the query.
+  std::vector<SubtreeInstance> instances;
+};
+
+// Finds the queries and expressions repeated within or across queries, e.g. a subquery computed
+// several times, which could be a WITH clause or a materialized table.
+//
+// Every subtree gets a structural hash, computed bottom-up in one traversal from its node kind,
+// the hashes of its children and its own tokens (keywords, operators, names and literals). The
+// aliases, comments and whitespace do not count, nor the case of keywords and unquoted names
+// other than table names, so `SELECT A AS x` and `select a as y` are identical.
+class RepeatedSubtreeFinder {
+ public:
+  // Subtrees of fewer than `min_size` AST nodes are not reported.
+  explicit RepeatedSubtreeFinder(int min_size) : min_size_(min_size) {}
+
+  // Parse and hash a query. Its index is the number of queries added before. A query which does
+  // not parse returns its error and gets no subtree. The optional `cancellation` is checked while
+  // the query is parsed and while the AST is traversed.
+  absl::Status AddQuery(const std::string& query, const CancellationToken* cancellation = nullptr);
+
+  // The subtrees found at least twice, largest first. A subtree is only reported where it is not
+  // part of a larger reported one, so a repeated subquery does not also report its expressions.
+  std::vector<RepeatedSubtree> Find() const;
+
+ private:
+  struct Group {
+    std::string kind;
+    std::vector<SubtreeInstance> instances;
+  };
+
+  // The hashes of the tokens of a query, inside and outside of table names.
+  struct TokenHashes {
+    std::vector<uint64_t> other;
+    std::vector<uint64_t> table_name;
+  };
+
+  // Hash every subtree of `root`, whose tokens are `tokens`, and add the candidates to groups_.
+  void HashSubtrees(const zetasql::ASTNode* root, int query_index, const std::vector<zetasql::ParseToken>& tokens,
+                    const TokenHashes& token_hashes, CancellationChecker* checker);
+
+  const int min_size_;
+  int query_count_ = 0;
+  // By fingerprint and size.
+  absl::flat_hash_map<std::pair<uint64_t, int>, Group> groups_;
+};
+
+} // bigquery::utils::zetasql_helper
+
+#endif // ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_REPEATED_SUBTREES_H_
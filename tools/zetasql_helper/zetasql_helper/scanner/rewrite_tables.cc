@@ -0,0 +1,124 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "rewrite_tables.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+absl::Status TableRewriter::Create(const std::vector<TableRewrite>& rewrites,
+                                   std::unique_ptr<TableRewriter>* rewriter) {
+  std::unique_ptr<TableRewriter> result(new TableRewriter());
+  for (const auto& rewrite : rewrites) {
+    if (!rewrite.is_regex) {
+      // The first rewrite of a name wins.
+      result->exact_.emplace(rewrite.name, rewrite.replacement);
+      continue;
+    }
+    RegexRewrite regex_rewrite;
+    try {
+      regex_rewrite.pattern = std::regex(rewrite.name);
+    } catch (const std::regex_error& error) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          absl::StrCat("Invalid table regex ", rewrite.name, ": ", error.what()));
+    }
+    regex_rewrite.replacement = rewrite.replacement;
+    result->regexes_.push_back(std::move(regex_rewrite));
+  }
+  *rewriter = std::move(result);
+  return absl::OkStatus();
+}
+
+bool TableRewriter::Rename(const std::string& name, std::string* new_name) const {
+  auto it = exact_.find(name);
+  if (it != exact_.end()) {
+    *new_name = it->second;
+    return true;
+  }
+  for (const auto& rewrite : regexes_) {
+    std::smatch match;
+    if (std::regex_match(name, match, rewrite.pattern)) {
+      *new_name = match.format(rewrite.replacement);
+      return true;
+    }
+  }
+  return false;
+}
+
+absl::Status TableRewriter::Rewrite(absl::string_view query, std::string* output, int* replacements,
+                                    const CancellationToken* cancellation) const {
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
+
+  auto is_table = [](const zetasql::ASTNode* node) {
+    auto table_path = dynamic_cast<const zetasql::ASTTablePathExpression*>(node);
+    return table_path != nullptr && table_path->path_expr() != nullptr;
+  };
+
+  stats::ScopedPhase traversal(stats::Phase::kTraversal);
+  CancellationChecker checker(cancellation);
+  auto table_nodes = FindAllNodes(parser_output->statement(), is_table, &checker);
+  ZETASQL_RETURN_IF_ERROR(checker.status());
+
+  // Rename the tables first, then build the output in one pass, so the offsets of the later
+  // tables do not shift.
+  struct Replacement {
+    int start;
+    int end;
+    std::string name;
+  };
+  std::vector<Replacement> renamed;
+  renamed.reserve(table_nodes.size());
+  std::string new_name;
+  for (const auto node : table_nodes) {
+    auto path = static_cast<const zetasql::ASTTablePathExpression*>(node)->path_expr();
+    if (Rename(absl::StrJoin(ReadNames(*path), "."), &new_name)) {
+      auto range = path->GetParseLocationRange();
+      renamed.push_back({range.start().GetByteOffset(), range.end().GetByteOffset(), new_name});
+    }
+  }
+  std::sort(renamed.begin(), renamed.end(),
+            [](const Replacement& a, const Replacement& b) { return a.start < b.start; });
+
+  output->clear();
+  output->reserve(query.size());
+  *replacements = 0;
+  int offset = 0;
+  for (const auto& replacement : renamed) {
+    if (replacement.start < offset) {
+      continue;
+    }
+    output->append(query.data() + offset, replacement.start - offset);
+    if (query.substr(replacement.start, replacement.end - replacement.start).find('`') != absl::string_view::npos) {
+      absl::StrAppend(output, "`", replacement.name, "`");
+    } else {
+      output->append(replacement.name);
+    }
+    offset = replacement.end;
+    (*replacements)++;
+  }
+  output->append(query.data() + offset, query.size() - offset);
+  return absl::OkStatus();
+}
+
+} // bigquery::utils::zetasql_helper
@@ -0,0 +1,75 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_REWRITE_TABLES_H_
+#define ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_REWRITE_TABLES_H_
+
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// A rename of tables. A table name is matched as [[project.]dataset.]table without backticks,
+// like in LocateTableRanges.
+struct TableRewrite {
+  // Either the exact name of the table, or a regex matching the whole name.
+  std::string name;
+  bool is_regex = false;
+  // The new name. For a regex, "$1" refers to the first group of the match (see
+  // std::regex_replace). The replacement is inserted as is, except that it is enclosed in
+  // backticks if the original name has any.
+  std::string replacement;
+};
+
+// Rewrites the table names of queries. The rewrites are compiled once, so a TableRewriter can be
+// used for many queries.
+class TableRewriter {
+ public:
+  // Return InvalidArgument if a regex does not compile.
+  static absl::Status Create(const std::vector<TableRewrite>& rewrites, std::unique_ptr<TableRewriter>* rewriter);
+
+  // Replace the name of every table with the first matching rewrite, an exact name taking
+  // precedence over the regexes. The tables are found in one traversal of the AST, and the
+  // replacements are applied in one pass over the query. `replacements` is set to the number of
+  // replaced tables. The optional `cancellation` is checked while the AST is traversed.
+  absl::Status Rewrite(absl::string_view query, std::string* output, int* replacements,
+                       const CancellationToken* cancellation = nullptr) const;
+
+ private:
+  struct RegexRewrite {
+    std::regex pattern;
+    std::string replacement;
+  };
+
+  TableRewriter() = default;
+
+  // Return false if no rewrite matches `name`.
+  bool Rename(const std::string& name, std::string* new_name) const;
+
+  absl::flat_hash_map<std::string, std::string> exact_;
+  std::vector<RegexRewrite> regexes_;
+};
+
+} // bigquery::utils::zetasql_helper
+
+#endif // ZETASQL_HELPER_ZETASQL_HELPER_SCANNER_REWRITE_TABLES_H_
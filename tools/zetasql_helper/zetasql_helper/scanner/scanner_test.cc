@@ -17,6 +17,11 @@
 #include "gtest/gtest.h"
 #include "zetasql_helper/scanner/locate_table.h"
 #include "zetasql_helper/scanner/extract_function.h"
+#include "zetasql_helper/scanner/flat_ast.h"
+#include "zetasql_helper/scanner/repeated_subtrees.h"
+#include "zetasql_helper/scanner/rewrite_tables.h"
+#include "zetasql_helper/util/parser_arena.h"
+#include "zetasql_helper/util/util.h"
 
 using namespace bigquery::utils::zetasql_helper;
 
@@ -76,3 +81,184 @@ TEST_F(LocationTest, ExtractFunction) {
 
 }
 
+TEST_F(LocationTest, LocateTableCancelledDuringTraversal) {
+  std::string query = "SELECT a FROM foo";
+  for (int i = 0; i < 500; i++) {
+    query += " UNION ALL SELECT a FROM foo";
+  }
+
+  // The token is checked before and after parsing, then during the traversal.
+  int checks = 0;
+  CancellationToken cancellation([&checks]() { return checks++ >= 2; });
+  std::vector<zetasql::ParseLocationRange> ranges;
+  auto status = LocateTableRanges(query, "foo", ranges, &cancellation);
+
+  EXPECT_EQ(absl::StatusCode::kCancelled, status.code());
+  EXPECT_EQ(3, checks);
+}
+
+TEST_F(LocationTest, ReuseParserArena) {
+  auto& arena = ParserArena::ForCurrentThread();
+  std::vector<zetasql::ParseLocationRange> ranges;
+  ASSERT_TRUE(LocateTableRanges("select a from b", "b", ranges).ok());
+  auto reused = arena.reused();
+  auto allocated = arena.allocated();
+
+  // The arena of the previous parse is reset instead of being freed.
+  ASSERT_TRUE(LocateTableRanges("select a from c", "c", ranges).ok());
+  EXPECT_EQ(reused + 1, arena.reused());
+  EXPECT_EQ(allocated, arena.allocated());
+
+  // While an output is alive, the next parse gets its own arena.
+  std::unique_ptr<zetasql::ParserOutput> output;
+  ASSERT_TRUE(ParseBigQueryStatement("select 1", &output).ok());
+  std::unique_ptr<zetasql::ParserOutput> nested;
+  ASSERT_TRUE(ParseBigQueryStatement("select 2", &nested).ok());
+  EXPECT_EQ(allocated + 1, arena.allocated());
+  EXPECT_NE(output->arena(), nested->arena());
+}
+
+class ParserArenaTest : public ::testing::Test {
+
+};
+
+TEST_F(ParserArenaTest, GrowAndTrimBlock) {
+  ParserArena::Options options;
+  options.min_block_bytes = 1024;
+  options.trim_interval = 2;
+  ParserArena arena(options);
+  std::string long_query = "select ";
+  for (int i = 0; i < 1000; i++) {
+    long_query += "column_" + std::to_string(i) + ", ";
+  }
+  long_query += "1";
+
+  auto parse = [&](absl::string_view query) {
+    auto parser_options = BigQueryOptions().GetParserOptions();
+    arena.Prepare(&parser_options);
+    std::unique_ptr<zetasql::ParserOutput> output;
+    ASSERT_TRUE(zetasql::ParseStatement(query, parser_options, &output).ok());
+  };
+  parse(long_query);
+  parse("select 1");
+  // The long query did not fit in the first block.
+  EXPECT_LT(1024, arena.block_bytes());
+  auto grown = arena.block_bytes();
+
+  for (int i = 0; i < 4; i++) {
+    parse("select 1");
+  }
+  EXPECT_GT(grown, arena.block_bytes());
+}
+
+TEST_F(LocationTest, RewriteTables) {
+  std::unique_ptr<TableRewriter> rewriter;
+  ASSERT_TRUE(TableRewriter::Create({{"old.t1", false, "new.t1"},
+                                     {"old\\.(\\w+)", true, "archive.$1"}}, &rewriter).ok());
+
+  std::string query = "SELECT * FROM old.t1 AS a JOIN `old.t2` ON a.id = `old.t2`.id JOIN other.t3 USING (id)";
+  std::string output;
+  int replacements = 0;
+  ASSERT_TRUE(rewriter->Rewrite(query, &output, &replacements).ok());
+  EXPECT_EQ("SELECT * FROM new.t1 AS a JOIN `archive.t2` ON a.id = `old.t2`.id JOIN other.t3 USING (id)", output);
+  EXPECT_EQ(2, replacements);
+}
+
+TEST_F(LocationTest, RewriteTablesInSubqueries) {
+  std::unique_ptr<TableRewriter> rewriter;
+  ASSERT_TRUE(TableRewriter::Create({{"d.t", false, "p.d.t"}}, &rewriter).ok());
+
+  std::string query = "SELECT (SELECT max(x) FROM d.t) FROM d.t WHERE y IN (SELECT y FROM d.t)";
+  std::string output;
+  int replacements = 0;
+  ASSERT_TRUE(rewriter->Rewrite(query, &output, &replacements).ok());
+  EXPECT_EQ("SELECT (SELECT max(x) FROM p.d.t) FROM p.d.t WHERE y IN (SELECT y FROM p.d.t)", output);
+  EXPECT_EQ(3, replacements);
+}
+
+TEST_F(LocationTest, RewriteTablesInvalidRegex) {
+  std::unique_ptr<TableRewriter> rewriter;
+  auto status = TableRewriter::Create({{"(", true, "x"}}, &rewriter);
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument, status.code());
+}
+
+int32_t ReadInt32(const std::string& bytes, int index) {
+  auto data = reinterpret_cast<const unsigned char*>(bytes.data()) + 4 * index;
+  return static_cast<int32_t>(data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24);
+}
+
+TEST_F(LocationTest, ExportAst) {
+  std::string query = "SELECT a FROM `d.t`";
+  FlatAstProto ast;
+  ASSERT_TRUE(ExportAst(query, true, &ast).ok());
+
+  ASSERT_LT(0, ast.node_count());
+  EXPECT_EQ(4 * ast.node_count(), ast.kinds().size());
+  EXPECT_EQ(4 * ast.node_count(), ast.parents().size());
+  EXPECT_EQ(4 * ast.node_count(), ast.starts().size());
+  EXPECT_EQ(4 * ast.node_count(), ast.ends().size());
+
+  // The root is the statement, covering the query.
+  EXPECT_EQ("QueryStatement", ast.kind_names(ReadInt32(ast.kinds(), 0)));
+  EXPECT_EQ(-1, ReadInt32(ast.parents(), 0));
+  EXPECT_EQ(0, ReadInt32(ast.starts(), 0));
+  EXPECT_EQ(query.size(), ReadInt32(ast.ends(), 0));
+
+  // Parents come before their children, and children lie within their parent.
+  for (int i = 1; i < ast.node_count(); i++) {
+    auto parent = ReadInt32(ast.parents(), i);
+    ASSERT_LE(0, parent);
+    ASSERT_LT(parent, i);
+    EXPECT_LE(ReadInt32(ast.starts(), parent), ReadInt32(ast.starts(), i));
+    EXPECT_GE(ReadInt32(ast.ends(), parent), ReadInt32(ast.ends(), i));
+  }
+
+  // Identifiers in the order of the query, without backticks.
+  ASSERT_EQ(2, ast.identifiers_size());
+  EXPECT_EQ("a", ast.identifiers(0));
+  EXPECT_EQ("d.t", ast.identifiers(1));
+  auto table = ReadInt32(ast.identifier_nodes(), 1);
+  EXPECT_EQ("`d.t`", query.substr(ReadInt32(ast.starts(), table),
+                                  ReadInt32(ast.ends(), table) - ReadInt32(ast.starts(), table)));
+}
+
+TEST_F(LocationTest, ExportAstWithoutIdentifiers) {
+  FlatAstProto ast;
+  ASSERT_TRUE(ExportAst("SELECT a FROM b", false, &ast).ok());
+  EXPECT_LT(0, ast.node_count());
+  EXPECT_EQ(0, ast.identifiers_size());
+  EXPECT_TRUE(ast.identifier_nodes().empty());
+}
+
+TEST_F(LocationTest, FindRepeatedSubtrees) {
+  std::string subquery = "SELECT id, SUM(amount) AS total FROM sales WHERE year = 2020 GROUP BY id";
+  std::string other = "select id, sum(amount) as s\nfrom sales -- comment\nwhere year = 2020 group by id";
+  std::string query = "SELECT * FROM (" + subquery + ") JOIN (" + other + ") USING (id)";
+
+  RepeatedSubtreeFinder finder(5);
+  ASSERT_TRUE(finder.AddQuery(query).ok());
+  auto repeated = finder.Find();
+
+  // The subqueries only differ by their aliases, case, comments and whitespace. Their own
+  // repeated expressions are not reported.
+  ASSERT_EQ(1, repeated.size());
+  EXPECT_EQ("Query", repeated[0].kind);
+  ASSERT_EQ(2, repeated[0].instances.size());
+  EXPECT_EQ(query.find(subquery), repeated[0].instances[0].start);
+  EXPECT_EQ(query.find(subquery) + subquery.size(), repeated[0].instances[0].end);
+  EXPECT_EQ(query.find(other), repeated[0].instances[1].start);
+}
+
+TEST_F(LocationTest, FindRepeatedSubtreesAcrossQueries) {
+  RepeatedSubtreeFinder finder(5);
+  ASSERT_TRUE(finder.AddQuery("SELECT a FROM t WHERE x IN (SELECT x FROM u WHERE y > 1)").ok());
+  EXPECT_FALSE(finder.AddQuery("SELECT FROM").ok());
+  ASSERT_TRUE(finder.AddQuery("SELECT b FROM v WHERE x IN (SELECT x FROM u WHERE y > 1)").ok());
+  ASSERT_TRUE(finder.AddQuery("SELECT b FROM v WHERE x IN (SELECT x FROM u WHERE y > 2)").ok());
+
+  auto repeated = finder.Find();
+  ASSERT_LE(1, repeated.size());
+  ASSERT_EQ(2, repeated[0].instances.size());
+  EXPECT_EQ(0, repeated[0].instances[0].query_index);
+  EXPECT_EQ(2, repeated[0].instances[1].query_index);
+}
@@ -0,0 +1,155 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/stats/heap_profiler.h"
+
+#include <atomic>
+#include <cstdlib>
+
+#include "absl/synchronization/mutex.h"
+#include "zetasql_helper/stats/server_stats.h"
+
+#ifdef ZETASQL_HELPER_TCMALLOC
+#include <gperftools/malloc_extension.h>
+#include <gperftools/malloc_hook.h>
+#endif
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+namespace {
+
+constexpr int kNumShards = 64;
+
+// The counters of the threads sharing a shard, on their own cache line.
+struct alignas(64) CounterShard {
+  std::atomic<int64_t> allocations{0};
+  std::atomic<int64_t> frees{0};
+  std::atomic<int64_t> allocated_bytes{0};
+};
+
+CounterShard counter_shards[kNumShards];
+
+#ifdef ZETASQL_HELPER_TCMALLOC
+
+std::atomic<int> next_shard{0};
+
+CounterShard& ThreadShard() {
+  thread_local int shard = next_shard.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+  return counter_shards[shard];
+}
+
+// The counters at the previous profile, for the allocation rates.
+struct RateState {
+  absl::Mutex mutex;
+  int64_t time_ns = NowNanos();
+  AllocationCounters counters;
+};
+
+RateState& GetRateState() {
+  static auto* state = new RateState();
+  return *state;
+}
+
+void OnAllocation(const void* ptr, size_t size) {
+  auto& shard = ThreadShard();
+  shard.allocations.fetch_add(1, std::memory_order_relaxed);
+  shard.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto* request = RequestScope::Current()) {
+    request->add_allocation(size);
+  }
+}
+
+void OnFree(const void* ptr) {
+  if (ptr != nullptr) {
+    ThreadShard().frees.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+int64_t NumericProperty(const char* name) {
+  size_t value = 0;
+  MallocExtension::instance()->GetNumericProperty(name, &value);
+  return value;
+}
+
+#endif
+
+}
+
+bool HeapProfilingAvailable() {
+#ifdef ZETASQL_HELPER_TCMALLOC
+  return true;
+#else
+  return false;
+#endif
+}
+
+void InstallAllocationCounters() {
+#ifdef ZETASQL_HELPER_TCMALLOC
+  static bool installed = []() {
+    GetRateState();
+    return MallocHook::AddNewHook(&OnAllocation) && MallocHook::AddDeleteHook(&OnFree);
+  }();
+  (void) installed;
+#endif
+}
+
+AllocationCounters GetAllocationCounters() {
+  AllocationCounters counters;
+  for (const auto& shard : counter_shards) {
+    counters.allocations += shard.allocations.load(std::memory_order_relaxed);
+    counters.frees += shard.frees.load(std::memory_order_relaxed);
+    counters.allocated_bytes += shard.allocated_bytes.load(std::memory_order_relaxed);
+  }
+  return counters;
+}
+
+absl::Status GetHeapProfile(HeapProfileProto* profile) {
+#ifdef ZETASQL_HELPER_TCMALLOC
+  std::string sample;
+  MallocExtension::instance()->GetHeapSample(&sample);
+  profile->set_profile(sample);
+  if (const char* period = std::getenv("TCMALLOC_SAMPLE_PARAMETER")) {
+    profile->set_sample_period_bytes(std::atoll(period));
+  }
+  profile->set_allocated_bytes(NumericProperty("generic.current_allocated_bytes"));
+  profile->set_heap_bytes(NumericProperty("generic.heap_size"));
+  profile->set_free_bytes(NumericProperty("tcmalloc.pageheap_free_bytes"));
+  profile->set_unmapped_bytes(NumericProperty("tcmalloc.pageheap_unmapped_bytes"));
+
+  auto counters = GetAllocationCounters();
+  profile->set_total_allocations(counters.allocations);
+  profile->set_total_frees(counters.frees);
+  profile->set_total_allocated_bytes(counters.allocated_bytes);
+
+  auto& state = GetRateState();
+  absl::MutexLock lock(&state.mutex);
+  auto now = NowNanos();
+  double seconds = (now - state.time_ns) / 1e9;
+  if (seconds > 0) {
+    profile->set_allocations_per_second((counters.allocations - state.counters.allocations) / seconds);
+    profile->set_allocated_bytes_per_second((counters.allocated_bytes - state.counters.allocated_bytes) / seconds);
+  }
+  state.time_ns = now;
+  state.counters = counters;
+  return absl::OkStatus();
+#else
+  return absl::Status(absl::StatusCode::kFailedPrecondition,
+                      "the heap profile needs a server built with --config=heap_profile");
+#endif
+}
+
+}  // bigquery::utils::zetasql_helper::stats
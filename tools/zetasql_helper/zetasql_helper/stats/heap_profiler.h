@@ -0,0 +1,51 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_STATS_HEAP_PROFILER_H_
+#define ZETASQL_HELPER_STATS_HEAP_PROFILER_H_
+
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "zetasql_helper/stats/stats.pb.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+// Whether the binary is linked with tcmalloc, i.e. built with --config=heap_profile.
+bool HeapProfilingAvailable();
+
+// Count the allocations of the process, and attribute them to the request being served by the
+// allocating thread (see RequestScope::add_allocation). The counters are sharded and only use
+// relaxed atomics, so the cost per allocation is a few nanoseconds. Call it once, at startup.
+// It is a no-op without tcmalloc.
+void InstallAllocationCounters();
+
+// The allocations counted since InstallAllocationCounters.
+struct AllocationCounters {
+  int64_t allocations = 0;
+  int64_t frees = 0;
+  int64_t allocated_bytes = 0;
+};
+AllocationCounters GetAllocationCounters();
+
+// The sampled heap profile, the sizes of the heap and the allocation rates. Return
+// kFailedPrecondition without tcmalloc.
+absl::Status GetHeapProfile(HeapProfileProto* profile);
+
+}  // bigquery::utils::zetasql_helper::stats
+
+#endif  // ZETASQL_HELPER_STATS_HEAP_PROFILER_H_
@@ -0,0 +1,169 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zetasql_helper/stats/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+Histogram::Histogram() : buckets_(kNumBuckets, 0) {}
+
+int Histogram::BucketIndex(uint64_t value) {
+  // Values below kSubBucketCount have their own exact bucket.
+  if (value < kSubBucketCount) {
+    return static_cast<int>(value);
+  }
+  // Position of the highest set bit, which is >= kSubBucketBits here.
+  int exponent = 63 - __builtin_clzll(value);
+  int shift = exponent - kSubBucketBits;
+  int sub_bucket = static_cast<int>((value >> shift) & (kSubBucketCount - 1));
+  return ((shift + 1) << kSubBucketBits) + sub_bucket;
+}
+
+uint64_t Histogram::BucketLowerBound(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  int shift = (index >> kSubBucketBits) - 1;
+  uint64_t sub_bucket = index & (kSubBucketCount - 1);
+  return (kSubBucketCount + sub_bucket) << shift;
+}
+
+uint64_t Histogram::BucketUpperBound(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  int shift = (index >> kSubBucketBits) - 1;
+  return BucketLowerBound(index) + ((uint64_t{1} << shift) - 1);
+}
+
+void Histogram::Record(int64_t value) {
+  if (value < 0) {
+    value = 0;
+  }
+  buckets_[BucketIndex(value)]++;
+  if (count_ == 0 || value < min_) {
+    min_ = value;
+  }
+  max_ = std::max(max_, value);
+  sum_ += value;
+  count_++;
+}
+
+void Histogram::Merge(const Histogram& other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  for (int i = 0; i < kNumBuckets; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  min_ = count_ == 0 ? other.min_ : std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+  sum_ += other.sum_;
+  count_ += other.count_;
+}
+
+void Histogram::Clear() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+  min_ = 0;
+  max_ = 0;
+}
+
+int64_t Histogram::Percentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  if (percentile <= 0) {
+    return min_;
+  }
+  percentile = std::min(100.0, percentile);
+  // The rank (1-based) of the sample to report.
+  auto rank = static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_));
+  rank = std::max<uint64_t>(rank, 1);
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kNumBuckets; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // Report the highest value of the bucket, but never beyond the observed range.
+      auto value = static_cast<int64_t>(BucketUpperBound(i));
+      return std::max(min_, std::min(value, max_));
+    }
+  }
+  return max_;
+}
+
+uint64_t Histogram::CountAtOrBelow(int64_t value) const {
+  if (value < 0) {
+    return 0;
+  }
+  uint64_t count = 0;
+  for (int i = 0; i < kNumBuckets && BucketUpperBound(i) <= static_cast<uint64_t>(value); i++) {
+    count += buckets_[i];
+  }
+  return count;
+}
+
+double Histogram::Mean() const {
+  return count_ == 0 ? 0 : static_cast<double>(sum_) / count_;
+}
+
+AtomicHistogram::AtomicHistogram()
+    : buckets_(new std::atomic<uint64_t>[Histogram::kNumBuckets]),
+      min_(std::numeric_limits<int64_t>::max()) {
+  for (int i = 0; i < Histogram::kNumBuckets; i++) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void AtomicHistogram::Record(int64_t value) {
+  if (value < 0) {
+    value = 0;
+  }
+  auto& bucket = buckets_[Histogram::BucketIndex(value)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  if (value < min_.load(std::memory_order_relaxed)) {
+    min_.store(value, std::memory_order_relaxed);
+  }
+  if (value > max_.load(std::memory_order_relaxed)) {
+    max_.store(value, std::memory_order_relaxed);
+  }
+}
+
+void AtomicHistogram::MergeInto(Histogram& histogram) const {
+  int64_t count = 0;
+  for (int i = 0; i < Histogram::kNumBuckets; i++) {
+    auto bucket_count = buckets_[i].load(std::memory_order_relaxed);
+    histogram.buckets_[i] += bucket_count;
+    count += bucket_count;
+  }
+  if (count == 0) {
+    return;
+  }
+  auto min = min_.load(std::memory_order_relaxed);
+  histogram.min_ = histogram.count_ == 0 ? min : std::min(histogram.min_, min);
+  histogram.max_ = std::max(histogram.max_, max_.load(std::memory_order_relaxed));
+  histogram.sum_ += sum_.load(std::memory_order_relaxed);
+  histogram.count_ += count;
+}
+
+}  // bigquery::utils::zetasql_helper::stats
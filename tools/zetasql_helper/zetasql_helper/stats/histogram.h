@@ -0,0 +1,109 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_STATS_HISTOGRAM_H_
+#define ZETASQL_HELPER_STATS_HISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+// A log-linear histogram of non-negative integer samples (e.g. latencies in nanoseconds).
+// Every power of two is split into 2^kSubBucketBits linear sub-buckets, so the relative error
+// of a reported percentile is below 2^-kSubBucketBits (~3%) over the whole int64 range, while
+// the histogram keeps a fixed size and can be merged by adding bucket counts.
+//
+// The class is not thread-safe. Record into one histogram per thread and merge them afterwards.
+class Histogram {
+ public:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+  static constexpr int kNumBuckets = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+  Histogram();
+
+  // Record one sample. Negative values are recorded as 0.
+  void Record(int64_t value);
+
+  // Add all the samples of another histogram into this one.
+  void Merge(const Histogram& other);
+
+  // Remove all the samples.
+  void Clear();
+
+  // Return the smallest recorded value v such that at least `percentile` percent of the samples
+  // are <= v, up to the bucket resolution. `percentile` is within [0, 100]. Return 0 if the
+  // histogram is empty.
+  int64_t Percentile(double percentile) const;
+
+  // Return the number of samples whose bucket lies entirely at or below `value`.
+  uint64_t CountAtOrBelow(int64_t value) const;
+
+  int64_t count() const { return count_; }
+  int64_t sum() const { return sum_; }
+  int64_t min() const { return count_ == 0 ? 0 : min_; }
+  int64_t max() const { return max_; }
+  double Mean() const;
+
+  // Raw bucket counts, indexed by BucketIndex.
+  const std::vector<uint64_t>& buckets() const { return buckets_; }
+
+  // The index of the bucket holding `value`.
+  static int BucketIndex(uint64_t value);
+
+  // The smallest and the largest value mapped to the bucket at `index`.
+  static uint64_t BucketLowerBound(int index);
+  static uint64_t BucketUpperBound(int index);
+
+ private:
+  friend class AtomicHistogram;
+
+  std::vector<uint64_t> buckets_;
+  int64_t count_ = 0;
+  int64_t sum_ = 0;
+  int64_t min_ = 0;
+  int64_t max_ = 0;
+};
+
+// A histogram with the same buckets as Histogram, which a single thread records into while any
+// other thread may read it, without locks. Since there is one writer, Record only needs relaxed
+// loads and stores instead of read-modify-write instructions.
+//
+// Readers may observe a sample partially recorded, e.g. counted in its bucket but not yet in
+// the sum, which is fine for monitoring.
+class AtomicHistogram {
+ public:
+  AtomicHistogram();
+
+  // Record one sample. Must only be called by the owning thread.
+  void Record(int64_t value);
+
+  // Add a snapshot of the samples into `histogram`. Can be called by any thread.
+  void MergeInto(Histogram& histogram) const;
+
+ private:
+  std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+  std::atomic<int64_t> sum_{0};
+  std::atomic<int64_t> min_;
+  std::atomic<int64_t> max_{0};
+};
+
+}  // bigquery::utils::zetasql_helper::stats
+
+#endif  // ZETASQL_HELPER_STATS_HISTOGRAM_H_
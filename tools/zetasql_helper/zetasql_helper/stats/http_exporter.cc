@@ -0,0 +1,142 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zetasql_helper/stats/http_exporter.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+namespace {
+
+// Bounds of a connection, so that a client which never completes its request cannot hold the
+// exporter (and Stop()) forever.
+constexpr int kIoTimeoutSeconds = 5;
+constexpr size_t kMaxHeadBytes = 16 * 1024;
+
+// Whether accept() failed because the listening socket is unusable, rather than transiently,
+// e.g. out of file descriptors (EMFILE) or a connection reset before it was accepted.
+bool IsPermanentAcceptError(int error) {
+  return error == EBADF || error == EINVAL || error == ENOTSOCK || error == EOPNOTSUPP;
+}
+
+}
+
+HttpExporter::HttpExporter(std::function<std::string()> body) : body_(std::move(body)) {}
+
+HttpExporter::~HttpExporter() {
+  Stop();
+}
+
+absl::Status HttpExporter::Start(const std::string& address, int port) {
+  sockaddr_in socket_address{};
+  socket_address.sin_family = AF_INET;
+  socket_address.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+    return absl::Status(absl::StatusCode::kInvalidArgument, absl::StrCat("Invalid IPv4 address: ", address));
+  }
+
+  listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    return absl::Status(absl::StatusCode::kInternal, absl::StrCat("socket: ", strerror(errno)));
+  }
+  int enable = 1;
+  setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) != 0 ||
+      listen(listen_fd_, 16) != 0) {
+    auto status = absl::Status(absl::StatusCode::kUnavailable,
+                               absl::StrCat("Unable to listen on ", address, ":", port, ": ", strerror(errno)));
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return status;
+  }
+
+  thread_ = std::thread(&HttpExporter::Serve, this);
+  return absl::OkStatus();
+}
+
+void HttpExporter::Stop() {
+  if (listen_fd_ < 0) {
+    return;
+  }
+  stopping_ = true;
+  // Wake up the blocking accept().
+  shutdown(listen_fd_, SHUT_RDWR);
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  close(listen_fd_);
+  listen_fd_ = -1;
+}
+
+void HttpExporter::Serve() {
+  while (!stopping_) {
+    int connection = accept(listen_fd_, nullptr, nullptr);
+    if (connection < 0) {
+      if (stopping_ || IsPermanentAcceptError(errno)) {
+        return;
+      }
+      if (errno != EINTR && errno != ECONNABORTED) {
+        // Wait for the resources to be freed rather than spinning.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+      continue;
+    }
+    timeval timeout{};
+    timeout.tv_sec = kIoTimeoutSeconds;
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Drain the request head. Its content does not matter since every path gets the same body.
+    char buffer[4096];
+    std::string head;
+    ssize_t length;
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < kMaxHeadBytes &&
+           (length = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+      head.append(buffer, length);
+    }
+    if (head.find("\r\n\r\n") == std::string::npos) {
+      // Closed, timed out or too large.
+      close(connection);
+      continue;
+    }
+
+    auto body = body_();
+    auto response = absl::StrCat("HTTP/1.1 200 OK\r\n",
+                                 "Content-Type: text/plain; version=0.0.4\r\n",
+                                 "Content-Length: ", body.size(), "\r\n",
+                                 "Connection: close\r\n\r\n", body);
+    size_t sent = 0;
+    while (sent < response.size()) {
+      auto written = send(connection, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+      if (written <= 0) {
+        break;
+      }
+      sent += written;
+    }
+    close(connection);
+  }
+}
+
+}  // bigquery::utils::zetasql_helper::stats
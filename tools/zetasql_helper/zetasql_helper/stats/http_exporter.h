@@ -0,0 +1,58 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_STATS_HTTP_EXPORTER_H_
+#define ZETASQL_HELPER_STATS_HTTP_EXPORTER_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "absl/status/status.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+// A minimal HTTP server answering every request with the text produced by a callback, used to
+// expose the server statistics to a Prometheus scraper. Requests are served one at a time on a
+// single background thread, which is plenty for a scraper polling every few seconds. A
+// connection which does not send its request head within a few seconds is dropped.
+class HttpExporter {
+ public:
+  explicit HttpExporter(std::function<std::string()> body);
+  ~HttpExporter();
+
+  HttpExporter(const HttpExporter&) = delete;
+  HttpExporter& operator=(const HttpExporter&) = delete;
+
+  // Listen on `address`:`port` and start serving in the background.
+  absl::Status Start(const std::string& address, int port);
+
+  // Stop serving. Also called by the destructor.
+  void Stop();
+
+ private:
+  void Serve();
+
+  std::function<std::string()> body_;
+  int listen_fd_ = -1;
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+}  // bigquery::utils::zetasql_helper::stats
+
+#endif  // ZETASQL_HELPER_STATS_HTTP_EXPORTER_H_
@@ -0,0 +1,343 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "zetasql_helper/stats/server_stats.h"
+
+#include <chrono>
+
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/stats/trace_buffer.h"
+#include "zetasql_helper/util/fingerprint.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+namespace {
+
+thread_local RequestScope* current_request = nullptr;
+
+// Upper bounds (in seconds) of the buckets exported to Prometheus.
+constexpr double kPrometheusBuckets[] = {
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+};
+
+void ToProto(const Histogram& histogram, HistogramProto* proto) {
+  proto->set_count(histogram.count());
+  proto->set_sum(histogram.sum());
+  proto->set_min(histogram.min());
+  proto->set_max(histogram.max());
+  proto->set_p50(histogram.Percentile(50));
+  proto->set_p90(histogram.Percentile(90));
+  proto->set_p99(histogram.Percentile(99));
+  proto->set_p999(histogram.Percentile(99.9));
+}
+
+// Append a histogram in the Prometheus format. `labels` is the label list without braces.
+void AppendPrometheusHistogram(std::string& text, absl::string_view metric, absl::string_view labels,
+                               const Histogram& histogram) {
+  for (double bound : kPrometheusBuckets) {
+    auto count = histogram.CountAtOrBelow(static_cast<int64_t>(bound * 1e9));
+    absl::StrAppend(&text, metric, "_bucket{", labels, ",le=\"", bound, "\"} ", count, "\n");
+  }
+  absl::StrAppend(&text, metric, "_bucket{", labels, ",le=\"+Inf\"} ", histogram.count(), "\n");
+  absl::StrAppend(&text, metric, "_sum{", labels, "} ", histogram.sum() / 1e9, "\n");
+  absl::StrAppend(&text, metric, "_count{", labels, "} ", histogram.count(), "\n");
+}
+
+}
+
+absl::string_view PhaseName(Phase phase) {
+  switch (phase) {
+    case Phase::kParse:
+      return "parse";
+    case Phase::kTraversal:
+      return "traversal";
+    case Phase::kFix:
+      return "fix";
+    case Phase::kSerialization:
+      return "serialization";
+    case Phase::kQueue:
+      return "queue";
+    case Phase::kAnalyze:
+      return "analyze";
+  }
+  return "unknown";
+}
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RequestScope::RequestScope(int rpc_id)
+    : rpc_id_(rpc_id), start_ns_(NowNanos()), outer_request_(current_request) {
+  current_request = this;
+}
+
+RequestScope::~RequestScope() {
+  current_request = outer_request_;
+  auto latency_ns = NowNanos() - start_ns_;
+  ServerStats::Global().Record(*this, latency_ns);
+  TraceBuffer::Global().Record(*this, latency_ns);
+}
+
+void RequestScope::set_query(absl::string_view query) {
+  if (has_query_) {
+    return;
+  }
+  has_query_ = true;
+  query_fingerprint_ = Fingerprint64(query);
+  query_bytes_ = query.size();
+}
+
+RequestScope* RequestScope::Current() {
+  return current_request;
+}
+
+ScopedPhase::ScopedPhase(Phase phase) : request_(RequestScope::Current()), phase_(phase) {
+  if (request_ == nullptr) {
+    return;
+  }
+  start_ns_ = NowNanos();
+  outer_ = request_->active_phase_;
+  if (outer_ != nullptr) {
+    // Pause the enclosing phase.
+    request_->phase_ns_[static_cast<int>(outer_->phase_)] += start_ns_ - outer_->start_ns_;
+  }
+  request_->active_phase_ = this;
+  request_->phase_entered_[static_cast<int>(phase_)] = true;
+}
+
+ScopedPhase::~ScopedPhase() {
+  if (request_ == nullptr) {
+    return;
+  }
+  auto now = NowNanos();
+  request_->phase_ns_[static_cast<int>(phase_)] += now - start_ns_;
+  request_->active_phase_ = outer_;
+  if (outer_ != nullptr) {
+    // Resume the enclosing phase.
+    outer_->start_ns_ = now;
+  }
+}
+
+ServerStats::ServerStats() : start_ns_(NowNanos()) {}
+
+ServerStats& ServerStats::Global() {
+  static auto* stats = new ServerStats();
+  return *stats;
+}
+
+int ServerStats::RegisterRpc(absl::string_view name) {
+  absl::MutexLock lock(&mutex_);
+  for (int i = 0; i < rpc_names_.size(); i++) {
+    if (rpc_names_[i] == name) {
+      return i;
+    }
+  }
+  if (rpc_names_.size() >= kMaxRpcs) {
+    return -1;
+  }
+  rpc_names_.emplace_back(name);
+  return rpc_names_.size() - 1;
+}
+
+std::string ServerStats::RpcName(int rpc_id) {
+  absl::MutexLock lock(&mutex_);
+  if (rpc_id < 0 || rpc_id >= rpc_names_.size()) {
+    return "";
+  }
+  return rpc_names_[rpc_id];
+}
+
+ServerStats::ThreadShard* ServerStats::GetThreadShard() {
+  // Releases the shard of the thread when it exits.
+  struct Owner {
+    ServerStats* stats = nullptr;
+    ThreadShard* shard = nullptr;
+
+    ~Owner() {
+      if (shard != nullptr) {
+        stats->ReleaseThreadShard(shard);
+      }
+    }
+  };
+  thread_local Owner owner;
+  if (owner.shard == nullptr) {
+    // Shards outlive their threads, so that the requests they served stay counted. The mutex
+    // orders the writes of the previous owner of a shard before the writes of the next one.
+    absl::MutexLock lock(&mutex_);
+    if (free_shards_.empty()) {
+      owner.shard = new ThreadShard();
+      shards_.push_back(owner.shard);
+    } else {
+      owner.shard = free_shards_.back();
+      free_shards_.pop_back();
+    }
+    owner.stats = this;
+  }
+  return owner.shard;
+}
+
+void ServerStats::ReleaseThreadShard(ThreadShard* shard) {
+  absl::MutexLock lock(&mutex_);
+  free_shards_.push_back(shard);
+}
+
+int ServerStats::ThreadShardCount() {
+  absl::MutexLock lock(&mutex_);
+  return shards_.size();
+}
+
+void ServerStats::Record(const RequestScope& request, int64_t latency_ns) {
+  if (request.rpc_id_ < 0 || request.rpc_id_ >= kMaxRpcs) {
+    return;
+  }
+  auto& slot = GetThreadShard()->rpcs[request.rpc_id_];
+  auto* rpc = slot.load(std::memory_order_acquire);
+  if (rpc == nullptr) {
+    rpc = new RpcShard();
+    slot.store(rpc, std::memory_order_release);
+  }
+
+  // Only the owning thread writes to its shard, so plain loads and stores are enough.
+  auto add = [](std::atomic<int64_t>& counter, int64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  };
+  add(rpc->count, 1);
+  add(rpc->errors, request.ok_ ? 0 : 1);
+  add(rpc->coalesced, request.coalesced_ ? 1 : 0);
+  add(rpc->cached, request.cached_ ? 1 : 0);
+  add(rpc->request_bytes, request.request_bytes_);
+  add(rpc->response_bytes, request.response_bytes_);
+  add(rpc->allocations, request.allocations_);
+  add(rpc->allocated_bytes, request.allocated_bytes_);
+  rpc->latency.Record(latency_ns);
+  for (int i = 0; i < kNumPhases; i++) {
+    if (request.phase_entered_[i]) {
+      rpc->phases[i].Record(request.phase_ns_[i]);
+    }
+  }
+}
+
+std::vector<ServerStats::RpcSnapshot> ServerStats::Merge() {
+  std::vector<std::string> names;
+  std::vector<ThreadShard*> shards;
+  {
+    absl::MutexLock lock(&mutex_);
+    names = rpc_names_;
+    shards = shards_;
+  }
+
+  std::vector<RpcSnapshot> snapshots(names.size());
+  for (int i = 0; i < names.size(); i++) {
+    auto& snapshot = snapshots[i];
+    snapshot.name = names[i];
+    for (auto* shard : shards) {
+      auto* rpc = shard->rpcs[i].load(std::memory_order_acquire);
+      if (rpc == nullptr) {
+        continue;
+      }
+      snapshot.count += rpc->count.load(std::memory_order_relaxed);
+      snapshot.errors += rpc->errors.load(std::memory_order_relaxed);
+      snapshot.coalesced += rpc->coalesced.load(std::memory_order_relaxed);
+      snapshot.cached += rpc->cached.load(std::memory_order_relaxed);
+      snapshot.request_bytes += rpc->request_bytes.load(std::memory_order_relaxed);
+      snapshot.response_bytes += rpc->response_bytes.load(std::memory_order_relaxed);
+      snapshot.allocations += rpc->allocations.load(std::memory_order_relaxed);
+      snapshot.allocated_bytes += rpc->allocated_bytes.load(std::memory_order_relaxed);
+      rpc->latency.MergeInto(snapshot.latency);
+      for (int phase = 0; phase < kNumPhases; phase++) {
+        rpc->phases[phase].MergeInto(snapshot.phases[phase]);
+      }
+    }
+  }
+  return snapshots;
+}
+
+ServerStatsProto ServerStats::Snapshot() {
+  ServerStatsProto proto;
+  proto.set_uptime_seconds((NowNanos() - start_ns_) / 1000000000);
+  for (const auto& snapshot : Merge()) {
+    auto* rpc = proto.add_rpcs();
+    rpc->set_rpc(snapshot.name);
+    rpc->set_count(snapshot.count);
+    rpc->set_errors(snapshot.errors);
+    rpc->set_coalesced(snapshot.coalesced);
+    rpc->set_cached(snapshot.cached);
+    rpc->set_request_bytes(snapshot.request_bytes);
+    rpc->set_response_bytes(snapshot.response_bytes);
+    rpc->set_allocations(snapshot.allocations);
+    rpc->set_allocated_bytes(snapshot.allocated_bytes);
+    ToProto(snapshot.latency, rpc->mutable_latency());
+    for (int i = 0; i < kNumPhases; i++) {
+      if (snapshot.phases[i].count() == 0) {
+        continue;
+      }
+      auto* phase = rpc->add_phases();
+      phase->set_phase(std::string(PhaseName(static_cast<Phase>(i))));
+      ToProto(snapshot.phases[i], phase->mutable_latency());
+    }
+  }
+  return proto;
+}
+
+std::string ServerStats::ToPrometheusText() {
+  auto snapshots = Merge();
+  std::string text;
+
+  auto append_counter = [&](absl::string_view metric, absl::string_view help,
+                            int64_t RpcSnapshot::*field) {
+    absl::StrAppend(&text, "# HELP ", metric, " ", help, "\n# TYPE ", metric, " counter\n");
+    for (const auto& snapshot : snapshots) {
+      absl::StrAppend(&text, metric, "{rpc=\"", snapshot.name, "\"} ", snapshot.*field, "\n");
+    }
+  };
+  append_counter("zetasql_helper_requests_total", "Number of served requests.", &RpcSnapshot::count);
+  append_counter("zetasql_helper_request_errors_total", "Number of failed requests.", &RpcSnapshot::errors);
+  append_counter("zetasql_helper_coalesced_requests_total",
+                 "Number of requests answered by an identical request in flight.", &RpcSnapshot::coalesced);
+  append_counter("zetasql_helper_cached_requests_total",
+                 "Number of requests answered from the result cache.", &RpcSnapshot::cached);
+  append_counter("zetasql_helper_request_bytes_total", "Total size of the requests.",
+                 &RpcSnapshot::request_bytes);
+  append_counter("zetasql_helper_response_bytes_total", "Total size of the responses.",
+                 &RpcSnapshot::response_bytes);
+  append_counter("zetasql_helper_request_allocations_total",
+                 "Number of allocations made by the requests (only counted with tcmalloc).",
+                 &RpcSnapshot::allocations);
+  append_counter("zetasql_helper_request_allocated_bytes_total",
+                 "Total size of the allocations made by the requests (only counted with tcmalloc).",
+                 &RpcSnapshot::allocated_bytes);
+
+  absl::StrAppend(&text, "# HELP zetasql_helper_request_latency_seconds Latency of the requests.\n",
+                  "# TYPE zetasql_helper_request_latency_seconds histogram\n");
+  for (const auto& snapshot : snapshots) {
+    AppendPrometheusHistogram(text, "zetasql_helper_request_latency_seconds",
+                              absl::StrCat("rpc=\"", snapshot.name, "\""), snapshot.latency);
+  }
+
+  absl::StrAppend(&text, "# HELP zetasql_helper_phase_latency_seconds Time spent in each phase of the requests.\n",
+                  "# TYPE zetasql_helper_phase_latency_seconds histogram\n");
+  for (const auto& snapshot : snapshots) {
+    for (int i = 0; i < kNumPhases; i++) {
+      auto labels = absl::StrCat("rpc=\"", snapshot.name, "\",phase=\"", PhaseName(static_cast<Phase>(i)), "\"");
+      AppendPrometheusHistogram(text, "zetasql_helper_phase_latency_seconds", labels, snapshot.phases[i]);
+    }
+  }
+  return text;
+}
+
+}  // bigquery::utils::zetasql_helper::stats
@@ -0,0 +1,214 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_STATS_SERVER_STATS_H_
+#define ZETASQL_HELPER_STATS_SERVER_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "zetasql_helper/stats/histogram.h"
+#include "zetasql_helper/stats/stats.pb.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+// The phases a request goes through. The time of a request is split into these phases by
+// ScopedPhase, and the time outside of any phase is only counted in the total latency.
+enum class Phase {
+  kParse = 0,
+  kTraversal,
+  kFix,
+  kSerialization,
+  // Waiting for admission (see local_service::AdmissionController).
+  kQueue,
+  // Resolving a query against a catalog (see SchemaCatalog).
+  kAnalyze,
+};
+constexpr int kNumPhases = 6;
+
+absl::string_view PhaseName(Phase phase);
+
+// Monotonic clock used by all the timers of the stats package.
+int64_t NowNanos();
+
+class ScopedPhase;
+
+// Measures one request served by the current thread. While a RequestScope is alive, the
+// ScopedPhase timers created by the same thread (including inside the helper libraries) are
+// attributed to it. On destruction, the request is recorded into ServerStats::Global().
+class RequestScope {
+ public:
+  // `rpc_id` is returned by ServerStats::RegisterRpc.
+  explicit RequestScope(int rpc_id);
+  ~RequestScope();
+
+  RequestScope(const RequestScope&) = delete;
+  RequestScope& operator=(const RequestScope&) = delete;
+
+  void set_request_bytes(int64_t bytes) { request_bytes_ = bytes; }
+  void set_response_bytes(int64_t bytes) { response_bytes_ = bytes; }
+  void set_ok(bool ok) { ok_ = ok; }
+  // Mark the request as answered by an identical request in flight.
+  void set_coalesced(bool coalesced) { coalesced_ = coalesced; }
+  // Mark the request as answered from the result cache.
+  void set_cached(bool cached) { cached_ = cached; }
+
+  // Attach the query of the request, so that a trace of the request can identify it. Only
+  // the first call of a request is kept.
+  void set_query(absl::string_view query);
+  // Add to the number of AST nodes built while serving the request.
+  void add_ast_nodes(int64_t count) { ast_nodes_ += count; }
+  // Count an allocation made while serving the request. Called by the allocation hook of
+  // HeapProfiler, so it must not allocate.
+  void add_allocation(int64_t bytes) {
+    allocations_++;
+    allocated_bytes_ += bytes;
+  }
+
+  // The request being served by the current thread, or null.
+  static RequestScope* Current();
+
+ private:
+  friend class ScopedPhase;
+  friend class ServerStats;
+  friend class TraceBuffer;
+
+  int rpc_id_;
+  int64_t start_ns_;
+  int64_t request_bytes_ = 0;
+  int64_t response_bytes_ = 0;
+  bool ok_ = true;
+  bool coalesced_ = false;
+  bool cached_ = false;
+  bool has_query_ = false;
+  uint64_t query_fingerprint_ = 0;
+  int64_t query_bytes_ = 0;
+  int64_t ast_nodes_ = 0;
+  int64_t allocations_ = 0;
+  int64_t allocated_bytes_ = 0;
+  std::array<int64_t, kNumPhases> phase_ns_{};
+  std::array<bool, kNumPhases> phase_entered_{};
+  ScopedPhase* active_phase_ = nullptr;
+  RequestScope* outer_request_;
+};
+
+// Times a phase of the current request. Phases are exclusive: while a nested phase runs, the
+// enclosing phase is paused, so a fixer calling a traversal helper does not count the
+// traversal twice. It is a no-op if the thread is not serving a request.
+class ScopedPhase {
+ public:
+  explicit ScopedPhase(Phase phase);
+  ~ScopedPhase();
+
+  ScopedPhase(const ScopedPhase&) = delete;
+  ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+ private:
+  RequestScope* request_;
+  Phase phase_;
+  int64_t start_ns_ = 0;
+  ScopedPhase* outer_ = nullptr;
+};
+
+// Process-wide statistics of the requests served by the helper service. Every thread records
+// into its own shard of lock-free histograms and counters, and the shards are merged when a
+// snapshot is taken, so recording a request never blocks on other threads.
+class ServerStats {
+ public:
+  static constexpr int kMaxRpcs = 64;
+
+  static ServerStats& Global();
+
+  // Register an RPC and return its id. Registering the same name twice returns the same id.
+  // Return -1 if kMaxRpcs RPCs are already registered.
+  int RegisterRpc(absl::string_view name);
+
+  // The name of a registered RPC, or an empty string for an unknown id.
+  std::string RpcName(int rpc_id);
+
+  // Record a finished request. Called by RequestScope.
+  void Record(const RequestScope& request, int64_t latency_ns);
+
+  // Merge the shards of all the threads into a snapshot.
+  ServerStatsProto Snapshot();
+
+  // The snapshot in the Prometheus text exposition format.
+  std::string ToPrometheusText();
+
+  // The number of thread shards, i.e. the most threads which have recorded requests at the same
+  // time.
+  int ThreadShardCount();
+
+ private:
+  // The statistics of one RPC recorded by one thread.
+  struct RpcShard {
+    AtomicHistogram latency;
+    std::array<AtomicHistogram, kNumPhases> phases;
+    std::atomic<int64_t> count{0};
+    std::atomic<int64_t> errors{0};
+    std::atomic<int64_t> coalesced{0};
+    std::atomic<int64_t> cached{0};
+    std::atomic<int64_t> request_bytes{0};
+    std::atomic<int64_t> response_bytes{0};
+    std::atomic<int64_t> allocations{0};
+    std::atomic<int64_t> allocated_bytes{0};
+  };
+
+  // The statistics recorded by one thread. RpcShards are allocated on the first request of
+  // each RPC, and are never freed, so that readers can access them without locks. When its thread
+  // exits, a shard is given with its counts to the next new thread, so the threads created and
+  // retired on demand by gRPC or the JNI callers do not grow shards_.
+  struct ThreadShard {
+    std::array<std::atomic<RpcShard*>, kMaxRpcs> rpcs{};
+  };
+
+  // Merged statistics of one RPC.
+  struct RpcSnapshot {
+    std::string name;
+    Histogram latency;
+    std::array<Histogram, kNumPhases> phases;
+    int64_t count = 0;
+    int64_t errors = 0;
+    int64_t coalesced = 0;
+    int64_t cached = 0;
+    int64_t request_bytes = 0;
+    int64_t response_bytes = 0;
+    int64_t allocations = 0;
+    int64_t allocated_bytes = 0;
+  };
+
+  ServerStats();
+
+  ThreadShard* GetThreadShard();
+  void ReleaseThreadShard(ThreadShard* shard);
+  std::vector<RpcSnapshot> Merge();
+
+  const int64_t start_ns_;
+  // Guards rpc_names_, shards_ and free_shards_.
+  absl::Mutex mutex_;
+  std::vector<std::string> rpc_names_;
+  std::vector<ThreadShard*> shards_;
+  // The shards of the exited threads, which are also in shards_.
+  std::vector<ThreadShard*> free_shards_;
+};
+
+}  // bigquery::utils::zetasql_helper::stats
+
+#endif  // ZETASQL_HELPER_STATS_SERVER_STATS_H_
@@ -0,0 +1,260 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/stats/heap_profiler.h"
+#include "zetasql_helper/stats/histogram.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/stats/trace_buffer.h"
+#include "zetasql_helper/util/fingerprint.h"
+
+using namespace bigquery::utils::zetasql_helper;
+using namespace bigquery::utils::zetasql_helper::stats;
+
+class HistogramTest : public ::testing::Test {
+
+};
+
+TEST_F(HistogramTest, BucketBoundsAreContinuous) {
+  for (int i = 1; i < Histogram::kNumBuckets; i++) {
+    EXPECT_EQ(Histogram::BucketUpperBound(i - 1) + 1, Histogram::BucketLowerBound(i));
+  }
+  for (uint64_t value : {0ull, 1ull, 31ull, 32ull, 63ull, 64ull, 1000ull, 123456789ull, ~0ull}) {
+    auto index = Histogram::BucketIndex(value);
+    EXPECT_LE(Histogram::BucketLowerBound(index), value);
+    EXPECT_GE(Histogram::BucketUpperBound(index), value);
+  }
+}
+
+TEST_F(HistogramTest, Percentiles) {
+  Histogram histogram;
+  for (int i = 1; i <= 1000; i++) {
+    histogram.Record(i * 1000);
+  }
+
+  EXPECT_EQ(1000, histogram.count());
+  EXPECT_EQ(1000, histogram.min());
+  EXPECT_EQ(1000000, histogram.max());
+  EXPECT_NEAR(500000, histogram.Percentile(50), 500000 / 32);
+  EXPECT_NEAR(990000, histogram.Percentile(99), 990000 / 32);
+  EXPECT_EQ(1000000, histogram.Percentile(100));
+  EXPECT_EQ(1000, histogram.Percentile(0));
+}
+
+TEST_F(HistogramTest, Merge) {
+  Histogram first;
+  Histogram second;
+  first.Record(10);
+  second.Record(5);
+  second.Record(20);
+  first.Merge(second);
+
+  EXPECT_EQ(3, first.count());
+  EXPECT_EQ(5, first.min());
+  EXPECT_EQ(20, first.max());
+  EXPECT_EQ(35, first.sum());
+  EXPECT_EQ(10, first.Percentile(50));
+}
+
+TEST_F(HistogramTest, AtomicHistogram) {
+  AtomicHistogram atomic_histogram;
+  atomic_histogram.Record(100);
+  atomic_histogram.Record(300);
+
+  Histogram histogram;
+  histogram.Record(200);
+  atomic_histogram.MergeInto(histogram);
+
+  EXPECT_EQ(3, histogram.count());
+  EXPECT_EQ(100, histogram.min());
+  EXPECT_EQ(300, histogram.max());
+  EXPECT_EQ(600, histogram.sum());
+  EXPECT_EQ(1, histogram.CountAtOrBelow(150));
+  EXPECT_EQ(3, histogram.CountAtOrBelow(1000));
+}
+
+class ServerStatsTest : public ::testing::Test {
+
+};
+
+TEST_F(ServerStatsTest, RecordRequestAndPhases) {
+  auto& stats = ServerStats::Global();
+  int rpc_id = stats.RegisterRpc("ServerStatsTest");
+  EXPECT_EQ(rpc_id, stats.RegisterRpc("ServerStatsTest"));
+
+  {
+    RequestScope request(rpc_id);
+    request.set_request_bytes(10);
+    request.set_response_bytes(20);
+    request.add_allocation(64);
+    ScopedPhase parse(Phase::kParse);
+    {
+      ScopedPhase traversal(Phase::kTraversal);
+    }
+  }
+  {
+    RequestScope request(rpc_id);
+    request.set_ok(false);
+    request.set_coalesced(true);
+  }
+
+  auto snapshot = stats.Snapshot();
+  const RpcStatsProto* rpc = nullptr;
+  for (const auto& candidate : snapshot.rpcs()) {
+    if (candidate.rpc() == "ServerStatsTest") {
+      rpc = &candidate;
+    }
+  }
+  ASSERT_NE(nullptr, rpc);
+  EXPECT_EQ(2, rpc->count());
+  EXPECT_EQ(1, rpc->errors());
+  EXPECT_EQ(1, rpc->coalesced());
+  EXPECT_EQ(10, rpc->request_bytes());
+  EXPECT_EQ(20, rpc->response_bytes());
+  EXPECT_EQ(1, rpc->allocations());
+  EXPECT_EQ(64, rpc->allocated_bytes());
+  EXPECT_EQ(2, rpc->latency().count());
+  ASSERT_EQ(2, rpc->phases_size());
+  EXPECT_EQ("parse", rpc->phases(0).phase());
+  EXPECT_EQ(1, rpc->phases(0).latency().count());
+  EXPECT_EQ("traversal", rpc->phases(1).phase());
+
+  auto text = stats.ToPrometheusText();
+  EXPECT_NE(std::string::npos, text.find("zetasql_helper_requests_total{rpc=\"ServerStatsTest\"} 2"));
+}
+
+TEST_F(ServerStatsTest, ThreadShardsAreReused) {
+  auto& stats = ServerStats::Global();
+  int rpc_id = stats.RegisterRpc("ThreadShardsAreReused");
+  auto record = [rpc_id]() { RequestScope request(rpc_id); };
+  // Shards of the threads of the other tests.
+  int shards = stats.ThreadShardCount() + 4;
+
+  for (int round = 0; round < 50; round++) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back(record);
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  EXPECT_LE(stats.ThreadShardCount(), shards);
+  // The requests of the exited threads are still counted.
+  auto snapshot = stats.Snapshot();
+  for (const auto& rpc : snapshot.rpcs()) {
+    if (rpc.rpc() == "ThreadShardsAreReused") {
+      EXPECT_EQ(200, rpc.count());
+    }
+  }
+}
+
+TEST_F(ServerStatsTest, PhaseOutsideOfRequestIsIgnored) {
+  ScopedPhase phase(Phase::kParse);
+  EXPECT_EQ(nullptr, RequestScope::Current());
+}
+
+class TraceBufferTest : public ::testing::Test {
+
+};
+
+RequestTrace MakeTrace(int64_t latency_ns) {
+  RequestTrace trace;
+  trace.latency_ns = latency_ns;
+  return trace;
+}
+
+TEST_F(TraceBufferTest, KeepSlowest) {
+  TraceBuffer buffer(3, 0, 0);
+  for (int64_t latency : {5, 1, 9, 3, 7, 2}) {
+    buffer.Record(MakeTrace(latency));
+  }
+  auto slowest = buffer.Slowest();
+  ASSERT_EQ(3, slowest.size());
+  EXPECT_EQ(9, slowest[0].latency_ns);
+  EXPECT_EQ(7, slowest[1].latency_ns);
+  EXPECT_EQ(5, slowest[2].latency_ns);
+  EXPECT_TRUE(buffer.Sampled().empty());
+}
+
+TEST_F(TraceBufferTest, SampleIntoRing) {
+  TraceBuffer buffer(0, 2, 2);
+  for (int64_t latency = 1; latency <= 10; latency++) {
+    buffer.Record(MakeTrace(latency));
+  }
+  // One request out of two is sampled, and only the last two samples are kept.
+  auto sampled = buffer.Sampled();
+  ASSERT_EQ(2, sampled.size());
+  EXPECT_EQ(sampled[0].latency_ns + 2, sampled[1].latency_ns);
+  EXPECT_TRUE(buffer.Slowest().empty());
+
+  buffer.Clear();
+  EXPECT_TRUE(buffer.Sampled().empty());
+}
+
+TEST_F(TraceBufferTest, RequestTraceToJson) {
+  auto& stats = ServerStats::Global();
+  auto& buffer = TraceBuffer::Global();
+  buffer.Configure(1, 0, 0);
+  {
+    RequestScope request(stats.RegisterRpc("TraceBufferTest"));
+    request.set_query("select 1");
+    request.set_query("ignored");
+    request.add_ast_nodes(4);
+    request.add_allocation(100);
+    request.add_allocation(28);
+    ScopedPhase parse(Phase::kParse);
+  }
+
+  auto slowest = buffer.Slowest();
+  ASSERT_EQ(1, slowest.size());
+  EXPECT_EQ(Fingerprint64("select 1"), slowest[0].query_fingerprint);
+  EXPECT_EQ(8, slowest[0].query_bytes);
+  EXPECT_EQ(4, slowest[0].ast_nodes);
+  EXPECT_EQ(2, slowest[0].allocations);
+  EXPECT_EQ(128, slowest[0].allocated_bytes);
+  EXPECT_TRUE(slowest[0].phase_entered[static_cast<int>(Phase::kParse)]);
+
+  auto json = buffer.ToJson();
+  EXPECT_NE(std::string::npos, json.find("\"rpc\":\"TraceBufferTest\""));
+  EXPECT_NE(std::string::npos, json.find(absl::StrCat("\"query_fingerprint\":\"", FingerprintToHex(Fingerprint64("select 1")))));
+  EXPECT_NE(std::string::npos, json.find("\"ast_nodes\":4"));
+  EXPECT_NE(std::string::npos, json.find("\"allocations\":2,\"allocated_bytes\":128"));
+  EXPECT_NE(std::string::npos, json.find("\"phases_ns\":{\"parse\":"));
+  EXPECT_NE(std::string::npos, json.find("\"sampled\":[]"));
+}
+
+TEST_F(TraceBufferTest, FingerprintIsStable) {
+  EXPECT_EQ(Fingerprint64("select 1"), Fingerprint64(std::string("select 1")));
+  EXPECT_NE(Fingerprint64("select 1"), Fingerprint64("select 2"));
+  EXPECT_NE(Fingerprint64("abcdefgh"), Fingerprint64("abcdefgi"));
+  EXPECT_EQ(16, FingerprintToHex(Fingerprint64("")).size());
+}
+
+TEST_F(ServerStatsTest, HeapProfileNeedsTcmalloc) {
+  HeapProfileProto profile;
+  auto status = GetHeapProfile(&profile);
+  if (HeapProfilingAvailable()) {
+    ASSERT_TRUE(status.ok());
+    EXPECT_LT(0, profile.heap_bytes());
+  } else {
+    EXPECT_EQ(absl::StatusCode::kFailedPrecondition, status.code());
+  }
+}
@@ -0,0 +1,234 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/stats/trace_buffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/util/fingerprint.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+namespace {
+
+// Default capacities of the global buffer, which can be changed with TraceBuffer::Configure.
+constexpr int kDefaultSlowestCapacity = 32;
+constexpr int kDefaultSampledCapacity = 256;
+constexpr int kDefaultSampleEvery = 1000;
+
+bool FasterThan(const RequestTrace& a, const RequestTrace& b) {
+  // Used as the "less" of std::push_heap, it makes the fastest trace the top of the heap.
+  return a.latency_ns > b.latency_ns;
+}
+
+int64_t NowUnixMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void AppendTraceJson(std::string& json, const RequestTrace& trace) {
+  absl::StrAppend(&json, "{\"rpc\":\"", ServerStats::Global().RpcName(trace.rpc_id), "\"",
+                  ",\"start_unix_micros\":", trace.start_unix_micros,
+                  ",\"latency_ns\":", trace.latency_ns,
+                  ",\"ok\":", trace.ok ? "true" : "false",
+                  ",\"request_bytes\":", trace.request_bytes,
+                  ",\"response_bytes\":", trace.response_bytes);
+  if (trace.has_query) {
+    absl::StrAppend(&json, ",\"query_fingerprint\":\"", FingerprintToHex(trace.query_fingerprint), "\"",
+                    ",\"query_bytes\":", trace.query_bytes,
+                    ",\"ast_nodes\":", trace.ast_nodes);
+  }
+  if (trace.allocations > 0) {
+    absl::StrAppend(&json, ",\"allocations\":", trace.allocations, ",\"allocated_bytes\":", trace.allocated_bytes);
+  }
+  absl::StrAppend(&json, ",\"phases_ns\":{");
+  bool first = true;
+  for (int i = 0; i < kNumPhases; i++) {
+    if (!trace.phase_entered[i]) {
+      continue;
+    }
+    absl::StrAppend(&json, first ? "" : ",", "\"", PhaseName(static_cast<Phase>(i)), "\":", trace.phase_ns[i]);
+    first = false;
+  }
+  absl::StrAppend(&json, "}}");
+}
+
+void AppendTraceListJson(std::string& json, const std::vector<RequestTrace>& traces) {
+  absl::StrAppend(&json, "[");
+  for (int i = 0; i < traces.size(); i++) {
+    if (i > 0) {
+      absl::StrAppend(&json, ",");
+    }
+    AppendTraceJson(json, traces[i]);
+  }
+  absl::StrAppend(&json, "]");
+}
+
+}
+
+TraceBuffer::TraceBuffer(int slowest_capacity, int sampled_capacity, int sample_every)
+    : slow_threshold_ns_(std::numeric_limits<int64_t>::max()), sample_every_(0),
+      slowest_capacity_(0), sampled_capacity_(0) {
+  Configure(slowest_capacity, sampled_capacity, sample_every);
+}
+
+TraceBuffer& TraceBuffer::Global() {
+  static auto* buffer = new TraceBuffer(kDefaultSlowestCapacity, kDefaultSampledCapacity, kDefaultSampleEvery);
+  return *buffer;
+}
+
+void TraceBuffer::Configure(int slowest_capacity, int sampled_capacity, int sample_every) {
+  absl::MutexLock lock(&mutex_);
+  slowest_capacity_ = std::max(slowest_capacity, 0);
+  sampled_capacity_ = std::max(sampled_capacity, 0);
+  sample_every_.store(sampled_capacity_ > 0 ? std::max(sample_every, 0) : 0, std::memory_order_relaxed);
+  slowest_.clear();
+  sampled_.clear();
+  sampled_next_ = 0;
+  UpdateThresholdLocked();
+}
+
+bool TraceBuffer::IsSlow(int64_t latency_ns) const {
+  return latency_ns > slow_threshold_ns_.load(std::memory_order_relaxed);
+}
+
+bool TraceBuffer::IsSampled() const {
+  auto sample_every = sample_every_.load(std::memory_order_relaxed);
+  if (sample_every <= 0) {
+    return false;
+  }
+  // A per-thread counter keeps the threads from contending on a shared one. Each thread
+  // samples one in `sample_every` of the requests it serves.
+  thread_local int64_t requests = 0;
+  return ++requests % sample_every == 0;
+}
+
+void TraceBuffer::Record(const RequestScope& request, int64_t latency_ns) {
+  bool slow = IsSlow(latency_ns);
+  bool sampled = IsSampled();
+  if (!slow && !sampled) {
+    return;
+  }
+
+  RequestTrace trace;
+  trace.rpc_id = request.rpc_id_;
+  trace.start_unix_micros = NowUnixMicros() - latency_ns / 1000;
+  trace.latency_ns = latency_ns;
+  trace.ok = request.ok_;
+  trace.request_bytes = request.request_bytes_;
+  trace.response_bytes = request.response_bytes_;
+  trace.has_query = request.has_query_;
+  trace.query_fingerprint = request.query_fingerprint_;
+  trace.query_bytes = request.query_bytes_;
+  trace.ast_nodes = request.ast_nodes_;
+  trace.allocations = request.allocations_;
+  trace.allocated_bytes = request.allocated_bytes_;
+  trace.phase_ns = request.phase_ns_;
+  trace.phase_entered = request.phase_entered_;
+
+  absl::MutexLock lock(&mutex_);
+  RecordLocked(trace, slow, sampled);
+}
+
+void TraceBuffer::Record(const RequestTrace& trace) {
+  bool slow = IsSlow(trace.latency_ns);
+  bool sampled = IsSampled();
+  if (!slow && !sampled) {
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  RecordLocked(trace, slow, sampled);
+}
+
+void TraceBuffer::RecordLocked(const RequestTrace& trace, bool slow, bool sampled) {
+  // The threshold may have moved since it was checked without the lock.
+  if (slow && slowest_capacity_ > 0) {
+    if (slowest_.size() < slowest_capacity_) {
+      slowest_.push_back(trace);
+      std::push_heap(slowest_.begin(), slowest_.end(), FasterThan);
+    } else if (trace.latency_ns > slowest_.front().latency_ns) {
+      std::pop_heap(slowest_.begin(), slowest_.end(), FasterThan);
+      slowest_.back() = trace;
+      std::push_heap(slowest_.begin(), slowest_.end(), FasterThan);
+    }
+    UpdateThresholdLocked();
+  }
+
+  if (sampled && sampled_capacity_ > 0) {
+    if (sampled_.size() < sampled_capacity_) {
+      sampled_.push_back(trace);
+    } else {
+      sampled_[sampled_next_] = trace;
+      sampled_next_ = (sampled_next_ + 1) % sampled_capacity_;
+    }
+  }
+}
+
+void TraceBuffer::UpdateThresholdLocked() {
+  int64_t threshold;
+  if (slowest_capacity_ == 0) {
+    threshold = std::numeric_limits<int64_t>::max();
+  } else if (slowest_.size() < slowest_capacity_) {
+    threshold = -1;
+  } else {
+    threshold = slowest_.front().latency_ns;
+  }
+  slow_threshold_ns_.store(threshold, std::memory_order_relaxed);
+}
+
+void TraceBuffer::Clear() {
+  absl::MutexLock lock(&mutex_);
+  slowest_.clear();
+  sampled_.clear();
+  sampled_next_ = 0;
+  UpdateThresholdLocked();
+}
+
+std::vector<RequestTrace> TraceBuffer::Slowest() {
+  std::vector<RequestTrace> traces;
+  {
+    absl::MutexLock lock(&mutex_);
+    traces = slowest_;
+  }
+  std::sort(traces.begin(), traces.end(), FasterThan);
+  return traces;
+}
+
+std::vector<RequestTrace> TraceBuffer::Sampled() {
+  absl::MutexLock lock(&mutex_);
+  std::vector<RequestTrace> traces;
+  traces.reserve(sampled_.size());
+  traces.insert(traces.end(), sampled_.begin() + sampled_next_, sampled_.end());
+  traces.insert(traces.end(), sampled_.begin(), sampled_.begin() + sampled_next_);
+  return traces;
+}
+
+std::string TraceBuffer::ToJson() {
+  auto slowest = Slowest();
+  auto sampled = Sampled();
+  std::string json = "{\"slowest\":";
+  AppendTraceListJson(json, slowest);
+  absl::StrAppend(&json, ",\"sampled\":");
+  AppendTraceListJson(json, sampled);
+  absl::StrAppend(&json, "}");
+  return json;
+}
+
+}  // bigquery::utils::zetasql_helper::stats
@@ -0,0 +1,117 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_STATS_TRACE_BUFFER_H_
+#define ZETASQL_HELPER_STATS_TRACE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "zetasql_helper/stats/server_stats.h"
+
+namespace bigquery::utils::zetasql_helper::stats {
+
+// The trace of one finished request.
+struct RequestTrace {
+  int rpc_id = -1;
+  // Wall-clock start time of the request.
+  int64_t start_unix_micros = 0;
+  int64_t latency_ns = 0;
+  bool ok = true;
+  int64_t request_bytes = 0;
+  int64_t response_bytes = 0;
+  // Whether the request carried a query. The query itself is not kept, only its fingerprint.
+  bool has_query = false;
+  uint64_t query_fingerprint = 0;
+  int64_t query_bytes = 0;
+  int64_t ast_nodes = 0;
+  // Only counted when the server is linked with tcmalloc.
+  int64_t allocations = 0;
+  int64_t allocated_bytes = 0;
+  std::array<int64_t, kNumPhases> phase_ns{};
+  std::array<bool, kNumPhases> phase_entered{};
+};
+
+// A bounded in-memory buffer of request traces. It keeps the traces of the slowest requests
+// seen since the last Clear, and a ring of the most recent requests sampled 1-in-K from all of
+// them, so that a stall can be pinned to the queries causing it without a tracing backend.
+//
+// Recording a request which is neither slow enough nor sampled costs a relaxed atomic load and
+// a thread-local counter increment; the lock is only taken for the traces kept.
+class TraceBuffer {
+ public:
+  // Keep the `slowest_capacity` slowest requests, and the last `sampled_capacity` requests
+  // among one every `sample_every`. A zero capacity or `sample_every` disables that part.
+  TraceBuffer(int slowest_capacity, int sampled_capacity, int sample_every);
+
+  TraceBuffer(const TraceBuffer&) = delete;
+  TraceBuffer& operator=(const TraceBuffer&) = delete;
+
+  // The buffer recorded into by RequestScope.
+  static TraceBuffer& Global();
+
+  // Change the capacities and the sampling rate. The traces kept so far are dropped.
+  void Configure(int slowest_capacity, int sampled_capacity, int sample_every);
+
+  // Record a finished request. Called by RequestScope.
+  void Record(const RequestScope& request, int64_t latency_ns);
+
+  // Record a trace built by the caller.
+  void Record(const RequestTrace& trace);
+
+  // Drop all the traces.
+  void Clear();
+
+  // The slowest traces, slowest first.
+  std::vector<RequestTrace> Slowest();
+
+  // The sampled traces, oldest first.
+  std::vector<RequestTrace> Sampled();
+
+  // Both lists as a JSON object: {"slowest": [...], "sampled": [...]}.
+  std::string ToJson();
+
+ private:
+  // Whether a request that took `latency_ns` goes into the slowest traces, and whether it is
+  // sampled. These checks do not lock.
+  bool IsSlow(int64_t latency_ns) const;
+  bool IsSampled() const;
+
+  void RecordLocked(const RequestTrace& trace, bool slow, bool sampled);
+  void UpdateThresholdLocked();
+
+  // Latency a request must exceed to enter the slowest traces. It is the latency of the fastest
+  // kept trace once slowest_ is full, -1 while it is not, and the max int64 if it is disabled.
+  std::atomic<int64_t> slow_threshold_ns_;
+  std::atomic<int> sample_every_;
+
+  absl::Mutex mutex_;
+  // Guarded by mutex_. slowest_ is a min-heap on the latency.
+  int slowest_capacity_;
+  std::vector<RequestTrace> slowest_;
+  int sampled_capacity_;
+  std::vector<RequestTrace> sampled_;
+  // Index of the oldest sampled trace once sampled_ is full.
+  int sampled_next_ = 0;
+};
+
+}  // bigquery::utils::zetasql_helper::stats
+
+#endif  // ZETASQL_HELPER_STATS_TRACE_BUFFER_H_
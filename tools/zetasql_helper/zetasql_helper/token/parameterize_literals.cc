@@ -0,0 +1,161 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "parameterize_literals.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/token/token.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+// The literals which can be replaced by a parameter, as their [start, end) byte offsets, and the
+// names of the parameters of the query, in lower case.
+struct Literals {
+  absl::flat_hash_map<int, int> ranges;
+  absl::flat_hash_set<std::string> parameter_names;
+  bool has_positional_parameter = false;
+};
+
+bool IsLiteral(const zetasql::ASTNode* node) {
+  switch (node->node_kind()) {
+    case zetasql::AST_INT_LITERAL:
+    case zetasql::AST_FLOAT_LITERAL:
+    case zetasql::AST_STRING_LITERAL:
+    case zetasql::AST_BYTES_LITERAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Whether the literals below `node` must stay literals.
+bool RequiresLiterals(const zetasql::ASTNode* node) {
+  switch (node->node_kind()) {
+    case zetasql::AST_HINT:
+    case zetasql::AST_OPTIONS_LIST:
+    case zetasql::AST_WINDOW_FRAME:
+    case zetasql::AST_SAMPLE_CLAUSE:
+    // The string of DATE '2020-01-01'. NUMERIC '1' is a single node, which IsLiteral keeps.
+    case zetasql::AST_DATE_OR_TIME_LITERAL:
+    case zetasql::AST_SIMPLE_TYPE:
+    case zetasql::AST_ARRAY_TYPE:
+    case zetasql::AST_STRUCT_TYPE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Whether `literal` is a column ordinal, e.g. GROUP BY 1.
+bool IsOrdinal(const zetasql::ASTNode* literal, const zetasql::ASTNode* parent) {
+  return literal->node_kind() == zetasql::AST_INT_LITERAL &&
+      (parent->node_kind() == zetasql::AST_GROUPING_ITEM || parent->node_kind() == zetasql::AST_ORDERING_EXPRESSION);
+}
+
+absl::Status CollectLiterals(const zetasql::ASTNode* root, Literals* literals, CancellationChecker* checker) {
+  // An explicit stack, which does not descend into the subtrees requiring literals.
+  std::vector<const zetasql::ASTNode*> stack = {root};
+  while (!stack.empty()) {
+    if (checker->Tick()) {
+      return checker->status();
+    }
+    auto node = stack.back();
+    stack.pop_back();
+    switch (node->node_kind()) {
+      case zetasql::AST_NAMED_PARAMETER:
+        literals->parameter_names.insert(
+            absl::AsciiStrToLower(node->GetAs<zetasql::ASTNamedParameter>()->name()->GetAsString()));
+        break;
+      case zetasql::AST_POSITIONAL_PARAMETER:
+        literals->has_positional_parameter = true;
+        break;
+      default:
+        break;
+    }
+    for (int i = 0; i < node->num_children(); i++) {
+      auto child = node->child(i);
+      if (IsLiteral(child) && !IsOrdinal(child, node)) {
+        auto range = child->GetParseLocationRange();
+        literals->ranges[range.start().GetByteOffset()] = range.end().GetByteOffset();
+      } else if (!RequiresLiterals(child)) {
+        stack.push_back(child);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+}
+
+absl::Status ParameterizeLiterals(const std::string& query, std::string* output,
+                                  std::vector<QueryParameter>* parameters,
+                                  const CancellationToken* cancellation) {
+  // The parse tree tells which literals can be replaced, and the tokens decode their values.
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+  ZETASQL_RETURN_IF_ERROR(ParseBigQueryStatement(query, &parser_output, cancellation));
+  Literals literals;
+  {
+    stats::ScopedPhase traversal(stats::Phase::kTraversal);
+    CancellationChecker checker(cancellation);
+    ZETASQL_RETURN_IF_ERROR(CollectLiterals(parser_output->statement(), &literals, &checker));
+  }
+  if (literals.has_positional_parameter) {
+    return absl::Status(absl::StatusCode::kInvalidArgument,
+                        "The literals of a query with positional parameters cannot be replaced by named parameters.");
+  }
+  parser_output.reset();
+
+  std::vector<zetasql::ParseToken> tokens;
+  ZETASQL_RETURN_IF_ERROR(Tokenize(query, tokens, cancellation));
+
+  output->clear();
+  output->reserve(query.size());
+  int offset = 0;
+  int next_name = 0;
+  for (auto& token : tokens) {
+    if (!token.IsValue()) {
+      continue;
+    }
+    auto range = token.GetLocationRange();
+    int start = range.start().GetByteOffset();
+    int end = range.end().GetByteOffset();
+    auto it = literals.ranges.find(start);
+    if (it == literals.ranges.end() || it->second != end) {
+      continue;
+    }
+
+    std::string name;
+    do {
+      name = absl::StrCat("p", next_name++);
+    } while (literals.parameter_names.contains(name));
+    output->append(query, offset, start - offset);
+    absl::StrAppend(output, "@", name);
+    offset = end;
+    parameters->push_back({std::move(name), token.GetValue(), range});
+  }
+  output->append(query, offset, std::string::npos);
+  return absl::OkStatus();
+}
+
+}
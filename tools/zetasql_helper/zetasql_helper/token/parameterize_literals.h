@@ -0,0 +1,54 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_TOKEN_PARAMETERIZE_LITERALS_H
+#define ZETASQL_HELPER_TOKEN_PARAMETERIZE_LITERALS_H
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "zetasql/public/parse_location.h"
+#include "zetasql/public/value.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// A literal replaced by a query parameter.
+struct QueryParameter {
+  // The name of the parameter, without the "@".
+  std::string name;
+  // The value of the literal, decoded by the tokenizer.
+  zetasql::Value value;
+  // The range of the literal in the original query.
+  zetasql::ParseLocationRange range;
+};
+
+// Replace the literals of a query with the named parameters @p0, @p1, ... in the order of the
+// query, so that queries only differing by their literals have the same text. Names already used
+// by the query are skipped.
+//
+// The number, string and bytes literals are replaced, except where BigQuery requires a literal:
+// the literal of a typed literal (e.g. DATE '2020-01-01'), the ordinals of GROUP BY and ORDER
+// BY, hints, options, types, window frames and TABLESAMPLE. Return InvalidArgument if the query
+// does not parse, or if it has positional parameters, which cannot be mixed with named ones.
+absl::Status ParameterizeLiterals(const std::string& query, std::string* output,
+                                  std::vector<QueryParameter>* parameters,
+                                  const CancellationToken* cancellation = nullptr);
+
+}
+
+#endif //ZETASQL_HELPER_TOKEN_PARAMETERIZE_LITERALS_H
@@ -0,0 +1,306 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "semantic_tokens.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/ascii.h"
+#include "zetasql/parser/keywords.h"
+#include "zetasql/parser/parse_tree.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/token/token.h"
+#include "zetasql_helper/util/util.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+using Type = SemanticTokensProto::Type;
+
+struct IdentifierType {
+  Type type;
+  int modifiers;
+};
+
+// The types of the identifiers found in the parse tree, by byte offset.
+using IdentifierTypes = absl::flat_hash_map<int, IdentifierType>;
+
+int StartOf(const zetasql::ASTNode* node) {
+  return node->GetParseLocationRange().start().GetByteOffset();
+}
+
+void MarkIdentifier(const zetasql::ASTIdentifier* identifier, Type type, int modifiers, IdentifierTypes& types) {
+  if (identifier != nullptr) {
+    types[StartOf(identifier)] = {type, modifiers};
+  }
+}
+
+// Mark the names of a path. Unless `overwrite` is set, the names already marked by an enclosing
+// node (e.g. the function of a call) keep their type.
+void MarkPath(const zetasql::ASTPathExpression* path, Type type, bool overwrite, IdentifierTypes& types) {
+  if (path == nullptr) {
+    return;
+  }
+  for (const auto* name : path->names()) {
+    if (overwrite) {
+      types[StartOf(name)] = {type, 0};
+    } else {
+      types.try_emplace(StartOf(name), IdentifierType{type, 0});
+    }
+  }
+}
+
+// Type the identifiers of the nodes overlapping the byte range [start, end).
+absl::Status CollectIdentifierTypes(const zetasql::ASTNode* root, int start, int end, IdentifierTypes& types,
+                                    const CancellationToken* cancellation) {
+  stats::ScopedPhase traversal(stats::Phase::kTraversal);
+  CancellationChecker checker(cancellation);
+  // A node is always visited before its children.
+  std::vector<const zetasql::ASTNode*> stack = {root};
+  while (!stack.empty()) {
+    if (checker.Tick()) {
+      return checker.status();
+    }
+    const auto* node = stack.back();
+    stack.pop_back();
+    auto range = node->GetParseLocationRange();
+    if (range.end().GetByteOffset() < start || range.start().GetByteOffset() >= end) {
+      continue;
+    }
+    for (int i = 0; i < node->num_children(); i++) {
+      stack.push_back(node->child(i));
+    }
+
+    switch (node->node_kind()) {
+      case zetasql::AST_TABLE_PATH_EXPRESSION:
+        MarkPath(node->GetAs<zetasql::ASTTablePathExpression>()->path_expr(), SemanticTokensProto::TABLE, true,
+                 types);
+        break;
+      case zetasql::AST_FUNCTION_CALL:
+        MarkPath(node->GetAs<zetasql::ASTFunctionCall>()->function(), SemanticTokensProto::FUNCTION, true, types);
+        break;
+      case zetasql::AST_SIMPLE_TYPE:
+        MarkPath(node->GetAs<zetasql::ASTSimpleType>()->type_name(), SemanticTokensProto::TYPE, true, types);
+        break;
+      case zetasql::AST_PATH_EXPRESSION:
+        MarkPath(node->GetAs<zetasql::ASTPathExpression>(), SemanticTokensProto::COLUMN, false, types);
+        break;
+      case zetasql::AST_ALIAS:
+        MarkIdentifier(node->GetAs<zetasql::ASTAlias>()->identifier(), SemanticTokensProto::IDENTIFIER,
+                       SemanticTokensProto::DECLARATION, types);
+        break;
+      case zetasql::AST_WITH_CLAUSE_ENTRY:
+        MarkIdentifier(node->GetAs<zetasql::ASTWithClauseEntry>()->alias(), SemanticTokensProto::TABLE,
+                       SemanticTokensProto::DECLARATION, types);
+        break;
+      case zetasql::AST_COLUMN_DEFINITION:
+        MarkIdentifier(node->GetAs<zetasql::ASTColumnDefinition>()->name(), SemanticTokensProto::COLUMN,
+                       SemanticTokensProto::DECLARATION, types);
+        break;
+      case zetasql::AST_NAMED_PARAMETER:
+        MarkIdentifier(node->GetAs<zetasql::ASTNamedParameter>()->name(), SemanticTokensProto::PARAMETER, 0, types);
+        break;
+      default:
+        break;
+    }
+  }
+  return absl::OkStatus();
+}
+
+bool IsContinuationByte(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// Code points of 4 bytes in UTF-8 are surrogate pairs in UTF-16.
+int Utf16Units(char first_byte) {
+  return static_cast<unsigned char>(first_byte) >= 0xF0 ? 2 : 1;
+}
+
+// Encodes the tokens of a text, in order, into the integers of a SemanticTokensProto.
+class Encoder {
+ public:
+  Encoder(absl::string_view text, int start_line, int end_line, SemanticTokensProto* semantic_tokens)
+      : text_(text), start_line_(start_line), end_line_(end_line), data_(semantic_tokens->mutable_data()) {}
+
+  // Whether the tokens from now on are past end_line.
+  bool done() const { return end_line_ > 0 && line_ >= end_line_; }
+
+  // Encode the token of the bytes [start, end).
+  void Add(int start, int end, Type type, int modifiers) {
+    Advance(start);
+    while (!done()) {
+      auto newline = text_.find('\n', offset_);
+      int piece_end = newline == absl::string_view::npos ? end : std::min<int>(end, newline);
+      int length = 0;
+      for (int i = offset_; i < piece_end; i++) {
+        if (!IsContinuationByte(text_[i]) && text_[i] != '\r') {
+          length += Utf16Units(text_[i]);
+        }
+      }
+      if (length > 0 && line_ >= start_line_) {
+        auto delta_line = line_ - previous_line_;
+        data_->Add(delta_line);
+        data_->Add(delta_line == 0 ? character_ - previous_character_ : character_);
+        data_->Add(length);
+        data_->Add(type);
+        data_->Add(modifiers);
+        previous_line_ = line_;
+        previous_character_ = character_;
+      }
+      if (piece_end >= end) {
+        return;
+      }
+      // The rest of the token is on the next line.
+      Advance(piece_end + 1);
+    }
+  }
+
+ private:
+  // Move the position to a byte offset.
+  void Advance(int offset) {
+    for (; offset_ < offset; offset_++) {
+      if (text_[offset_] == '\n') {
+        line_++;
+        character_ = 0;
+      } else if (!IsContinuationByte(text_[offset_])) {
+        character_ += Utf16Units(text_[offset_]);
+      }
+    }
+  }
+
+  absl::string_view text_;
+  const int start_line_;
+  const int end_line_;
+  google::protobuf::RepeatedField<uint32_t>* data_;
+  int offset_ = 0;
+  int line_ = 0;
+  int character_ = 0;
+  int previous_line_ = 0;
+  int previous_character_ = 0;
+};
+
+// The byte offset of the start of a line, or the size of the text if there are fewer lines.
+int LineOffset(absl::string_view text, int line) {
+  int offset = 0;
+  for (int i = 0; i < line; i++) {
+    auto newline = text.find('\n', offset);
+    if (newline == absl::string_view::npos) {
+      return text.size();
+    }
+    offset = newline + 1;
+  }
+  return offset;
+}
+
+// The type of a token. `parsed` tells whether `types` comes from a parse tree.
+Type TypeOf(const std::vector<zetasql::ParseToken>& tokens, int index, const IdentifierTypes& types, bool parsed,
+            int* modifiers) {
+  const auto& token = tokens[index];
+  *modifiers = 0;
+  switch (token.kind()) {
+    case zetasql::ParseToken::KEYWORD:
+      // Reserved keywords and symbols.
+      return absl::ascii_isalpha(token.GetImage()[0]) ? SemanticTokensProto::KEYWORD : SemanticTokensProto::OPERATOR;
+    case zetasql::ParseToken::VALUE: {
+      auto type = token.GetValue().type();
+      return type->IsString() || type->IsBytes() ? SemanticTokensProto::STRING : SemanticTokensProto::NUMBER;
+    }
+    case zetasql::ParseToken::COMMENT:
+      return SemanticTokensProto::COMMENT;
+    default:
+      break;
+  }
+
+  auto it = types.find(token.GetLocationRange().start().GetByteOffset());
+  if (it != types.end()) {
+    *modifiers = it->second.modifiers;
+    return it->second.type;
+  }
+  // An identifier which is not in the parse tree, or the parse failed.
+  bool is_call = index + 1 < tokens.size() && tokens[index + 1].kind() == zetasql::ParseToken::KEYWORD &&
+      tokens[index + 1].GetImage() == "(";
+  if (is_call && !parsed) {
+    return SemanticTokensProto::FUNCTION;
+  }
+  // Unquoted words are either identifiers or non-reserved keywords.
+  bool is_keyword = token.kind() == zetasql::ParseToken::IDENTIFIER_OR_KEYWORD &&
+      zetasql::parser::GetKeywordInfo(token.GetImage()) != nullptr;
+  return is_keyword ? SemanticTokensProto::KEYWORD : SemanticTokensProto::IDENTIFIER;
+}
+
+}
+
+absl::Status ClassifyTokens(const std::vector<zetasql::ParseToken>& tokens, const zetasql::ASTNode* root, int start,
+                            int end, std::vector<SemanticToken>* semantic_tokens,
+                            const CancellationToken* cancellation) {
+  IdentifierTypes types;
+  if (root != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(CollectIdentifierTypes(root, start, end, types, cancellation));
+  }
+  for (int i = 0; i < tokens.size(); i++) {
+    if (tokens[i].IsEndOfInput()) {
+      break;
+    }
+    auto range = tokens[i].GetLocationRange();
+    if (range.start().GetByteOffset() >= end) {
+      break;
+    }
+    if (range.end().GetByteOffset() <= start) {
+      continue;
+    }
+    SemanticToken token{range.start().GetByteOffset(), range.end().GetByteOffset()};
+    token.type = TypeOf(tokens, i, types, root != nullptr, &token.modifiers);
+    semantic_tokens->push_back(token);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status EncodeSemanticTokens(const std::string& query, int start_line, int end_line,
+                                  SemanticTokensProto* semantic_tokens,
+                                  const CancellationToken* cancellation) {
+  std::vector<zetasql::ParseToken> tokens;
+  ZETASQL_RETURN_IF_ERROR(Tokenize(query, tokens, cancellation, /*include_comments=*/true));
+
+  std::unique_ptr<zetasql::ParserOutput> output;
+  auto status = ParseBigQueryScript(query, &output, cancellation);
+  if (!status.ok() && status.code() != absl::StatusCode::kInvalidArgument) {
+    // Cancelled.
+    return status;
+  }
+  semantic_tokens->set_from_parse_tree(status.ok());
+
+  int start = LineOffset(query, start_line);
+  int end = end_line > 0 ? LineOffset(query, end_line) : query.size();
+  std::vector<SemanticToken> typed_tokens;
+  ZETASQL_RETURN_IF_ERROR(ClassifyTokens(tokens, status.ok() ? output->script() : nullptr, start, end, &typed_tokens,
+                                         cancellation));
+
+  stats::ScopedPhase serialization(stats::Phase::kSerialization);
+  Encoder encoder(query, start_line, end_line, semantic_tokens);
+  for (const auto& token : typed_tokens) {
+    if (encoder.done()) {
+      break;
+    }
+    encoder.Add(token.start, token.end, token.type, token.modifiers);
+  }
+  return absl::OkStatus();
+}
+
+}
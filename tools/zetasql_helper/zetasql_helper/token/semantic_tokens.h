@@ -0,0 +1,62 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_TOKEN_SEMANTIC_TOKENS_H
+#define ZETASQL_HELPER_TOKEN_SEMANTIC_TOKENS_H
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "zetasql/parser/parse_tree.h"
+#include "zetasql/public/parse_tokens.h"
+#include "zetasql_helper/token/parse_token.pb.h"
+#include "zetasql_helper/util/cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// A token typed for highlighting, between the byte offsets [start, end) of its text.
+struct SemanticToken {
+  int start;
+  int end;
+  SemanticTokensProto::Type type;
+  // The bit flags of SemanticTokensProto::Modifier.
+  int modifiers = 0;
+};
+
+// Type the tokens of a text, as returned by Tokenize() with the comments. The identifiers are
+// typed with `root`, the parse tree of the same text, e.g. tables, columns and functions, and
+// with the tokens alone if `root` is null because the text does not parse.
+//
+// Only the tokens overlapping the bytes [start, end) are typed and appended to `semantic_tokens`.
+absl::Status ClassifyTokens(const std::vector<zetasql::ParseToken>& tokens, const zetasql::ASTNode* root, int start,
+                            int end, std::vector<SemanticToken>* semantic_tokens,
+                            const CancellationToken* cancellation = nullptr);
+
+// Encode the semantic tokens of a script (see SemanticTokensProto), typed by ClassifyTokens()
+// with the parse tree of the script if it parses.
+//
+// Only the tokens of the lines [start_line, end_line) are encoded, e.g. the lines visible in an
+// editor. The positions of the encoding stay relative to the start of the script, and an
+// end_line <= 0 means the end of the script.
+absl::Status EncodeSemanticTokens(const std::string& query, int start_line, int end_line,
+                                  SemanticTokensProto* semantic_tokens,
+                                  const CancellationToken* cancellation = nullptr);
+
+}
+
+#endif //ZETASQL_HELPER_TOKEN_SEMANTIC_TOKENS_H
@@ -16,13 +16,44 @@
 
 #include "token.h"
 
+#include <iterator>
+
+#include "zetasql_helper/stats/server_stats.h"
+
 namespace bigquery::utils::zetasql_helper {
 
-absl::Status Tokenize(const std::string &query, std::vector<zetasql::ParseToken>& parse_tokens) {
+// Number of tokens read between two cancellation checks.
+constexpr int kTokenizeChunkSize = 4096;
+
+absl::Status Tokenize(const std::string &query, std::vector<zetasql::ParseToken>& parse_tokens,
+                      const CancellationToken* cancellation, bool include_comments) {
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+  stats::ScopedPhase phase(stats::Phase::kParse);
+  if (auto* request = stats::RequestScope::Current()) {
+    request->set_query(query);
+  }
   auto resume_location = zetasql::ParseResumeLocation::FromString(query);
   auto options = zetasql::ParseTokenOptions();
-  ZETASQL_RETURN_IF_ERROR(GetParseTokens(options, &resume_location, &parse_tokens));
-  return absl::OkStatus();
+  options.include_comments = include_comments;
+  if (cancellation == nullptr) {
+    ZETASQL_RETURN_IF_ERROR(GetParseTokens(options, &resume_location, &parse_tokens));
+    return absl::OkStatus();
+  }
+
+  // GetParseTokens stops after max_tokens and updates the resume location, so that the next call
+  // continues from there. The last chunk ends with the END_OF_INPUT token.
+  options.max_tokens = kTokenizeChunkSize;
+  std::vector<zetasql::ParseToken> chunk;
+  while (true) {
+    chunk.clear();
+    ZETASQL_RETURN_IF_ERROR(GetParseTokens(options, &resume_location, &chunk));
+    bool end_of_input = chunk.empty() || chunk.back().IsEndOfInput();
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(parse_tokens));
+    if (end_of_input) {
+      return absl::OkStatus();
+    }
+    ZETASQL_RETURN_IF_ERROR(cancellation->Check());
+  }
 }
 
 // Serialize the ZetaSQL token's kind into its proto. It is used by the `serialize_token`
@@ -58,6 +89,14 @@ ParseTokenProto serialize_token(const zetasql::ParseToken &token) {
     token_proto.set_allocated_parse_location_range(range_proto);
   }
 
+  // The decoded value of a literal, e.g. the string of a quoted literal with its escapes resolved.
+  if (token.IsValue()) {
+    zetasql::ValueProto value_proto;
+    if (token.GetValue().Serialize(&value_proto).ok()) {
+      *token_proto.mutable_value() = std::move(value_proto);
+    }
+  }
+
   return token_proto;
 }
 
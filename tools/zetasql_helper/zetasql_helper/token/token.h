@@ -20,17 +20,22 @@
 #include "zetasql/public/parse_tokens.h"
 #include "zetasql_helper/token/parse_token.pb.h"
 #include "zetasql/public/parse_location_range.pb.h"
+#include "zetasql/public/value.pb.h"
+#include "zetasql_helper/util/cancellation.h"
 #include <vector>
 #include <string>
 
 
 namespace bigquery::utils::zetasql_helper {
 
-// Tokenize a query into a list of ZetaSQL tokens.
-absl::Status Tokenize(const std::string &query, std::vector<zetasql::ParseToken>& parse_tokens);
+// Tokenize a query into a list of ZetaSQL tokens. If `cancellation` is given, the query is
+// tokenized in chunks and the token is checked between them. The comments are only returned as
+// tokens if `include_comments` is set.
+absl::Status Tokenize(const std::string &query, std::vector<zetasql::ParseToken>& parse_tokens,
+                      const CancellationToken* cancellation = nullptr, bool include_comments = false);
 
 // Serialize a ZetaSQL token into its proto buffer, which is used to transmit
-// through RPC service.
+// through RPC service. The value of a literal is decoded into `value`.
 ParseTokenProto serialize_token(const zetasql::ParseToken &token);
 }
 
@@ -15,10 +15,37 @@
 //
 
 #include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
+#include "zetasql_helper/token/parameterize_literals.h"
+#include "zetasql_helper/token/semantic_tokens.h"
 #include "zetasql_helper/token/token.h"
 
 using namespace bigquery::utils::zetasql_helper;
 
+namespace {
+
+// Decode semantic tokens into "line:column:length:TYPE" strings, with a "+" for a declaration.
+std::vector<std::string> Decode(const SemanticTokensProto& semantic_tokens) {
+  std::vector<std::string> tokens;
+  int line = 0;
+  int column = 0;
+  const auto& data = semantic_tokens.data();
+  for (int i = 0; i + 4 < data.size(); i += 5) {
+    column = data[i] == 0 ? column + data[i + 1] : data[i + 1];
+    line += data[i];
+    auto type = static_cast<SemanticTokensProto::Type>(data[i + 3]);
+    tokens.push_back(absl::StrCat(line, ":", column, ":", data[i + 2], ":", SemanticTokensProto::Type_Name(type),
+                                  data[i + 4] & SemanticTokensProto::DECLARATION ? "+" : ""));
+  }
+  return tokens;
+}
+
+bool Contains(const std::vector<std::string>& tokens, const std::string& token) {
+  return std::find(tokens.begin(), tokens.end(), token) != tokens.end();
+}
+
+}
+
 class TokenTest : public ::testing::Test {
 
 };
@@ -33,4 +60,126 @@ TEST_F(TokenTest, TokenizeTest) {
   EXPECT_EQ(zetasql::ParseToken::Kind::KEYWORD, tokens[0].kind());
   EXPECT_EQ(1, tokens[1].GetValue().int64_value());
   EXPECT_EQ("foo", tokens[2].GetImage());
-}
\ No newline at end of file
+}
+
+TEST_F(TokenTest, TokenizeInChunks) {
+  std::string query = "select 1";
+  for (int i = 0; i < 3000; i++) {
+    query += " + foo";
+  }
+
+  std::vector<zetasql::ParseToken> expected;
+  ASSERT_TRUE(::bigquery::utils::zetasql_helper::Tokenize(query, expected).ok());
+
+  CancellationToken never_cancelled(nullptr);
+  std::vector<zetasql::ParseToken> tokens;
+  ASSERT_TRUE(::bigquery::utils::zetasql_helper::Tokenize(query, tokens, &never_cancelled).ok());
+  ASSERT_EQ(expected.size(), tokens.size());
+  for (int i = 0; i < tokens.size(); i++) {
+    EXPECT_EQ(expected[i].GetImage(), tokens[i].GetImage());
+  }
+  EXPECT_TRUE(tokens.back().IsEndOfInput());
+}
+
+TEST_F(TokenTest, TokenizeCancelled) {
+  std::string query = "select 1";
+  for (int i = 0; i < 3000; i++) {
+    query += " + foo";
+  }
+
+  // Cancel after the first chunk.
+  int checks = 0;
+  CancellationToken cancellation([&checks]() { return checks++ > 0; });
+  std::vector<zetasql::ParseToken> tokens;
+  auto status = ::bigquery::utils::zetasql_helper::Tokenize(query, tokens, &cancellation);
+  EXPECT_EQ(absl::StatusCode::kCancelled, status.code());
+}
+
+TEST_F(TokenTest, EncodeSemanticTokens) {
+  std::string query = "SELECT COUNT(x), t.y AS z -- total\n"
+                      "FROM `p.d.t` AS t WHERE CAST(t.y AS INT64) = 1";
+  SemanticTokensProto semantic_tokens;
+  ASSERT_TRUE(EncodeSemanticTokens(query, 0, 0, &semantic_tokens).ok());
+  EXPECT_TRUE(semantic_tokens.from_parse_tree());
+
+  auto tokens = Decode(semantic_tokens);
+  EXPECT_EQ("0:0:6:KEYWORD", tokens[0]);
+  EXPECT_EQ("0:7:5:FUNCTION", tokens[1]);
+  EXPECT_EQ("0:12:1:OPERATOR", tokens[2]);
+  EXPECT_EQ("0:13:1:COLUMN", tokens[3]);
+  EXPECT_TRUE(Contains(tokens, "0:17:1:COLUMN"));
+  EXPECT_TRUE(Contains(tokens, "0:24:1:IDENTIFIER+"));
+  EXPECT_TRUE(Contains(tokens, "0:26:8:COMMENT"));
+  EXPECT_TRUE(Contains(tokens, "1:5:7:TABLE"));
+  EXPECT_TRUE(Contains(tokens, "1:16:1:IDENTIFIER+"));
+  EXPECT_TRUE(Contains(tokens, "1:24:4:FUNCTION") || Contains(tokens, "1:24:4:KEYWORD"));
+  EXPECT_TRUE(Contains(tokens, "1:36:5:TYPE"));
+  EXPECT_TRUE(Contains(tokens, "1:45:1:NUMBER"));
+}
+
+TEST_F(TokenTest, EncodeSemanticTokensOfLines) {
+  std::string query = "SELECT 1;\n"
+                      "SELECT 'a\nb';\n"
+                      "SELECT 3;";
+  SemanticTokensProto semantic_tokens;
+  ASSERT_TRUE(EncodeSemanticTokens(query, 1, 2, &semantic_tokens).ok());
+
+  // The string spans two lines, and only its first line is in the range.
+  std::vector<std::string> expected = {"1:0:6:KEYWORD", "1:7:2:STRING"};
+  EXPECT_EQ(expected, Decode(semantic_tokens));
+}
+
+TEST_F(TokenTest, EncodeSemanticTokensWithoutParseTree) {
+  std::string query = "SELECT f(x FROM";
+  SemanticTokensProto semantic_tokens;
+  ASSERT_TRUE(EncodeSemanticTokens(query, 0, 0, &semantic_tokens).ok());
+  EXPECT_FALSE(semantic_tokens.from_parse_tree());
+
+  auto tokens = Decode(semantic_tokens);
+  EXPECT_TRUE(Contains(tokens, "0:7:1:FUNCTION"));
+  EXPECT_TRUE(Contains(tokens, "0:9:1:IDENTIFIER"));
+}
+
+TEST_F(TokenTest, SerializeTokenValue) {
+  std::vector<zetasql::ParseToken> tokens;
+  ASSERT_TRUE(::bigquery::utils::zetasql_helper::Tokenize("select 'a\\nb', 2.5, foo", tokens).ok());
+
+  EXPECT_EQ("a\nb", serialize_token(tokens[1]).value().string_value());
+  EXPECT_EQ(2.5, serialize_token(tokens[3]).value().double_value());
+  EXPECT_FALSE(serialize_token(tokens[5]).has_value());
+}
+
+TEST_F(TokenTest, ParameterizeLiterals) {
+  std::string query = "SELECT a, 'x\\'y' FROM t WHERE b = 10 AND c IN (1.5, b'z') AND d = @p0 "
+                      "GROUP BY 1 ORDER BY 2 LIMIT 5";
+  std::string output;
+  std::vector<QueryParameter> parameters;
+  ASSERT_TRUE(ParameterizeLiterals(query, &output, &parameters).ok());
+
+  EXPECT_EQ("SELECT a, @p1 FROM t WHERE b = @p2 AND c IN (@p3, @p4) AND d = @p0 "
+            "GROUP BY 1 ORDER BY 2 LIMIT @p5", output);
+  ASSERT_EQ(5, parameters.size());
+  EXPECT_EQ("p1", parameters[0].name);
+  EXPECT_EQ("x'y", parameters[0].value.string_value());
+  EXPECT_EQ(10, parameters[1].value.int64_value());
+  EXPECT_EQ(1.5, parameters[2].value.double_value());
+  EXPECT_EQ("z", parameters[3].value.bytes_value());
+  EXPECT_EQ(5, parameters[4].value.int64_value());
+  EXPECT_EQ(query.find("10"), parameters[1].range.start().GetByteOffset());
+}
+
+TEST_F(TokenTest, ParameterizeLiteralsKeepsRequiredLiterals) {
+  std::string query = "SELECT DATE '2020-01-01', SUM(x) OVER (ORDER BY y ROWS 2 PRECEDING) FROM t";
+  std::string output;
+  std::vector<QueryParameter> parameters;
+  ASSERT_TRUE(ParameterizeLiterals(query, &output, &parameters).ok());
+  EXPECT_EQ(query, output);
+  EXPECT_TRUE(parameters.empty());
+}
+
+TEST_F(TokenTest, ParameterizeLiteralsWithPositionalParameters) {
+  std::string output;
+  std::vector<QueryParameter> parameters;
+  auto status = ParameterizeLiterals("SELECT ? + 1", &output, &parameters);
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument, status.code());
+}
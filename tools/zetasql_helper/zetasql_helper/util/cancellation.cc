@@ -0,0 +1,52 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "cancellation.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+CancellationToken::CancellationToken(std::function<bool()> is_cancelled, absl::Time deadline)
+    : is_cancelled_(std::move(is_cancelled)), deadline_(deadline) {}
+
+absl::Status CancellationToken::Check() const {
+  if (is_cancelled_ && is_cancelled_()) {
+    return absl::Status(absl::StatusCode::kCancelled, "The request was cancelled.");
+  }
+  if (deadline_ != absl::InfiniteFuture() && absl::Now() >= deadline_) {
+    return absl::Status(absl::StatusCode::kDeadlineExceeded, "The deadline of the request passed.");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status CheckCancellation(const CancellationToken* cancellation) {
+  if (cancellation == nullptr) {
+    return absl::OkStatus();
+  }
+  return cancellation->Check();
+}
+
+CancellationChecker::CancellationChecker(const CancellationToken* cancellation)
+    : cancellation_(cancellation) {}
+
+absl::Status CancellationChecker::CheckNow() {
+  if (status_.ok()) {
+    status_ = CheckCancellation(cancellation_);
+  }
+  return status_;
+}
+
+} // bigquery::utils::zetasql_helper
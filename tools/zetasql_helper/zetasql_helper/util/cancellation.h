@@ -0,0 +1,91 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_UTIL_CANCELLATION_H
+#define ZETASQL_HELPER_UTIL_CANCELLATION_H
+
+#include <functional>
+
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// Tells long running library functions that their caller gave up, either because the request
+// was cancelled or because its deadline passed. Library functions take an optional pointer to a
+// token, check it between their steps and at bounded intervals inside the AST traversals, and
+// return the status of Check() as soon as it is not ok.
+class CancellationToken {
+ public:
+  // `is_cancelled` may be empty. It is called from the thread doing the work, so it must be
+  // thread-safe and cheap, e.g. grpc::ServerContext::IsCancelled.
+  explicit CancellationToken(std::function<bool()> is_cancelled,
+                             absl::Time deadline = absl::InfiniteFuture());
+
+  // Return kCancelled if the work was cancelled, kDeadlineExceeded if the deadline passed, and
+  // ok otherwise.
+  absl::Status Check() const;
+
+  absl::Time deadline() const { return deadline_; }
+
+ private:
+  std::function<bool()> is_cancelled_;
+  absl::Time deadline_;
+};
+
+// Check an optional token. A null token is never cancelled.
+absl::Status CheckCancellation(const CancellationToken* cancellation);
+
+// Checks a token every kInterval calls of Tick(), so that a traversal can poll it for each node
+// while only paying for the clock and the cancellation callback once in a while. Once the token
+// is cancelled, every Tick() returns true and status() holds the reason.
+class CancellationChecker {
+ public:
+  static constexpr int kInterval = 256;
+
+  // `cancellation` may be null, in which case the checker never fires.
+  explicit CancellationChecker(const CancellationToken* cancellation);
+
+  // Count one step, and return true if the work must stop.
+  bool Tick() {
+    if (cancellation_ == nullptr) {
+      return false;
+    }
+    if (!status_.ok()) {
+      return true;
+    }
+    if (++steps_ % kInterval != 0) {
+      return false;
+    }
+    status_ = cancellation_->Check();
+    return !status_.ok();
+  }
+
+  // Check the token now, regardless of the interval.
+  absl::Status CheckNow();
+
+  const absl::Status& status() const { return status_; }
+
+ private:
+  const CancellationToken* cancellation_;
+  int64_t steps_ = 0;
+  absl::Status status_;
+};
+
+} // bigquery::utils::zetasql_helper
+
+#endif //ZETASQL_HELPER_UTIL_CANCELLATION_H
@@ -0,0 +1,64 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "fingerprint.h"
+
+#include <cstring>
+
+#include "absl/strings/str_format.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+uint64_t Fingerprint64(absl::string_view data, uint64_t seed) {
+  constexpr uint64_t kMultiplier = 0xc6a4a7935bd1e995ULL;
+  constexpr int kShift = 47;
+
+  uint64_t hash = seed ^ (data.size() * kMultiplier);
+  const char* bytes = data.data();
+  size_t remaining = data.size();
+
+  while (remaining >= 8) {
+    uint64_t block;
+    std::memcpy(&block, bytes, sizeof(block));
+    block *= kMultiplier;
+    block ^= block >> kShift;
+    block *= kMultiplier;
+    hash ^= block;
+    hash *= kMultiplier;
+    bytes += 8;
+    remaining -= 8;
+  }
+
+  if (remaining > 0) {
+    uint64_t tail = 0;
+    for (size_t i = 0; i < remaining; i++) {
+      tail |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    hash ^= tail;
+    hash *= kMultiplier;
+  }
+
+  hash ^= hash >> kShift;
+  hash *= kMultiplier;
+  hash ^= hash >> kShift;
+  return hash;
+}
+
+std::string FingerprintToHex(uint64_t fingerprint) {
+  return absl::StrFormat("%016x", fingerprint);
+}
+
+} // bigquery::utils::zetasql_helper
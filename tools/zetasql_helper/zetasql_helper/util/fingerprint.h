@@ -0,0 +1,37 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ZETASQL_HELPER_UTIL_FINGERPRINT_H
+#define ZETASQL_HELPER_UTIL_FINGERPRINT_H
+
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// A 64-bit hash of a byte string (MurmurHash64A). Unlike absl::Hash, the value is stable across
+// processes and builds, so it can identify a query in logs or be persisted on disk. It is not
+// a cryptographic hash.
+uint64_t Fingerprint64(absl::string_view data, uint64_t seed = 0);
+
+// Fingerprint64 as 16 lowercase hexadecimal digits.
+std::string FingerprintToHex(uint64_t fingerprint);
+
+} // bigquery::utils::zetasql_helper
+
+#endif //ZETASQL_HELPER_UTIL_FINGERPRINT_H
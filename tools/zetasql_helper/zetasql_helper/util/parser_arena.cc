@@ -0,0 +1,87 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "zetasql_helper/util/parser_arena.h"
+
+#include <algorithm>
+
+#include "zetasql/public/id_string.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+namespace {
+
+// Round up to a power of two, so that the block size does not change for small variations.
+int64_t RoundUpToPowerOfTwo(int64_t bytes) {
+  int64_t rounded = 1;
+  while (rounded < bytes) {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+}
+
+ParserArena::ParserArena(const Options& options) : options_(options) {}
+
+ParserArena& ParserArena::ForCurrentThread() {
+  thread_local ParserArena arena;
+  return arena;
+}
+
+void ParserArena::Allocate(int64_t block_bytes) {
+  block_bytes_ = std::clamp(block_bytes, options_.min_block_bytes, options_.max_block_bytes);
+  arena_ = std::make_shared<zetasql_base::UnsafeArena>(block_bytes_);
+  allocated_++;
+}
+
+void ParserArena::Prepare(zetasql::ParserOptions* parser_options) {
+  if (arena_ == nullptr) {
+    Allocate(options_.min_block_bytes);
+  } else if (arena_.use_count() > 1) {
+    // The previous ParserOutput still points to the arena, e.g. a fixer parsing a second query.
+    auto arena = std::make_shared<zetasql_base::UnsafeArena>(block_bytes_);
+    allocated_++;
+    parser_options->set_arena(arena);
+    parser_options->set_id_string_pool(std::make_shared<zetasql::IdStringPool>(arena));
+    return;
+  } else {
+    // The bytes allocated since the last reset are the usage of the previous parse.
+    int64_t used = arena_->status().bytes_allocated();
+    high_water_bytes_ = std::max(high_water_bytes_, used);
+    parses_since_trim_++;
+    if (used > block_bytes_ && block_bytes_ < options_.max_block_bytes) {
+      Allocate(RoundUpToPowerOfTwo(used));
+    } else if (parses_since_trim_ >= options_.trim_interval) {
+      if (high_water_bytes_ < block_bytes_ / 4) {
+        Allocate(RoundUpToPowerOfTwo(high_water_bytes_));
+      } else {
+        arena_->Reset();
+        reused_++;
+      }
+      parses_since_trim_ = 0;
+      high_water_bytes_ = 0;
+    } else {
+      arena_->Reset();
+      reused_++;
+    }
+  }
+  parser_options->set_arena(arena_);
+  parser_options->set_id_string_pool(std::make_shared<zetasql::IdStringPool>(arena_));
+}
+
+} // bigquery::utils::zetasql_helper
@@ -0,0 +1,74 @@
+//
+// Copyright 2020 BigQuery Utils
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#ifndef ZETASQL_HELPER_UTIL_PARSER_ARENA_H
+#define ZETASQL_HELPER_UTIL_PARSER_ARENA_H
+
+#include <cstdint>
+#include <memory>
+
+#include "zetasql/base/arena.h"
+#include "zetasql/parser/parser.h"
+
+namespace bigquery::utils::zetasql_helper {
+
+// The arena and the IdStringPool used by the parses of one thread. Instead of allocating a new
+// arena for every parse and freeing it with the ParserOutput, the arena of the previous parse of
+// the thread is reset and reused once its ParserOutput is destroyed.
+//
+// A reset keeps the first block of the arena, so the first block is sized after the largest
+// parse recently seen: it grows when a parse needed more blocks, up to max_block_bytes, and it is
+// shrunk every trim_interval parses if none of them used more than a quarter of it.
+class ParserArena {
+ public:
+  struct Options {
+    int64_t min_block_bytes = 16 * 1024;
+    int64_t max_block_bytes = 4 << 20;
+    int trim_interval = 256;
+  };
+
+  explicit ParserArena(const Options& options = Options());
+
+  // The arena of the calling thread.
+  static ParserArena& ForCurrentThread();
+
+  // Set the arena and the IdStringPool of `parser_options` for the next parse. If the output of
+  // the previous parse is still alive, a temporary arena is used instead.
+  void Prepare(zetasql::ParserOptions* parser_options);
+
+  // Number of parses which reused the arena, and which needed a new one.
+  int64_t reused() const { return reused_; }
+  int64_t allocated() const { return allocated_; }
+  // Size of the first block of the arena.
+  int64_t block_bytes() const { return block_bytes_; }
+
+ private:
+  void Allocate(int64_t block_bytes);
+
+  const Options options_;
+  std::shared_ptr<zetasql_base::UnsafeArena> arena_;
+  int64_t block_bytes_ = 0;
+  // The largest number of bytes used by a parse since the last trim.
+  int64_t high_water_bytes_ = 0;
+  int parses_since_trim_ = 0;
+  int64_t reused_ = 0;
+  int64_t allocated_ = 0;
+};
+
+} // bigquery::utils::zetasql_helper
+
+#endif //ZETASQL_HELPER_UTIL_PARSER_ARENA_H
@@ -16,18 +16,72 @@
 
 #include "util.h"
 #include "zetasql/public/parse_helpers.h"
+#include "zetasql_helper/stats/server_stats.h"
+#include "zetasql_helper/util/parser_arena.h"
 #include "absl/strings/strip.h"
 #include "absl/strings/str_split.h"
 
 namespace bigquery::utils::zetasql_helper {
 
-zetasql::AnalyzerOptions BigQueryOptions() {
-  zetasql::AnalyzerOptions options;
-  zetasql::LanguageOptions language_options;
-  // Latest language version.
-  language_options.SetLanguageVersion(zetasql::LanguageVersion::VERSION_1_3);
-  options.set_language_options(language_options);
-  return options;
+const zetasql::AnalyzerOptions& BigQueryOptions() {
+  static const auto* options = []() {
+    auto* options = new zetasql::AnalyzerOptions();
+    zetasql::LanguageOptions language_options;
+    // Latest language version.
+    language_options.SetLanguageVersion(zetasql::LanguageVersion::VERSION_1_3);
+    options->set_language_options(language_options);
+    return options;
+  }();
+  return *options;
+}
+
+absl::Status ParseBigQueryStatement(absl::string_view query, std::unique_ptr<zetasql::ParserOutput>* output,
+                                    const CancellationToken* cancellation) {
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+  stats::ScopedPhase phase(stats::Phase::kParse);
+  auto parser_options = BigQueryOptions().GetParserOptions();
+  ParserArena::ForCurrentThread().Prepare(&parser_options);
+  ZETASQL_RETURN_IF_ERROR(zetasql::ParseStatement(query, parser_options, output));
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+
+  if (auto* request = stats::RequestScope::Current()) {
+    request->set_query(query);
+    request->add_ast_nodes(CountNodes((*output)->statement()));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ParseBigQueryScript(absl::string_view script, std::unique_ptr<zetasql::ParserOutput>* output,
+                                 const CancellationToken* cancellation) {
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+  stats::ScopedPhase phase(stats::Phase::kParse);
+  auto parser_options = BigQueryOptions().GetParserOptions();
+  ParserArena::ForCurrentThread().Prepare(&parser_options);
+  ZETASQL_RETURN_IF_ERROR(zetasql::ParseScript(script, parser_options, zetasql::ERROR_MESSAGE_WITH_PAYLOAD, output));
+  ZETASQL_RETURN_IF_ERROR(CheckCancellation(cancellation));
+
+  if (auto* request = stats::RequestScope::Current()) {
+    request->set_query(script);
+    request->add_ast_nodes(CountNodes((*output)->script()));
+  }
+  return absl::OkStatus();
+}
+
+int64_t CountNodes(const zetasql::ASTNode* root) {
+  if (root == nullptr) {
+    return 0;
+  }
+  int64_t count = 0;
+  std::vector<const zetasql::ASTNode*> stack = {root};
+  while (!stack.empty()) {
+    auto node = stack.back();
+    stack.pop_back();
+    count++;
+    for (int i = 0; i < node->num_children(); i++) {
+      stack.push_back(node->child(i));
+    }
+  }
+  return count;
 }
 
 int get_offset(absl::string_view query, int line_number, int column_number) {
@@ -20,11 +20,31 @@
 #include "absl/strings/string_view.h"
 #include "zetasql/parser/parse_tree.h"
 #include "zetasql/parser/parse_tree_visitor.h"
+#include "zetasql/parser/parser.h"
 #include "zetasql/public/analyzer.h"
+#include "zetasql_helper/util/cancellation.h"
 
 namespace bigquery::utils::zetasql_helper {
 
-zetasql::AnalyzerOptions BigQueryOptions();
+// The options of the BigQuery dialect. They are built once per process.
+const zetasql::AnalyzerOptions& BigQueryOptions();
+
+// Parse a query as a BigQuery statement. The time spent is counted as the parse phase of the
+// request being served (see stats::ScopedPhase), and the query and the size of its AST are
+// attached to the request for its trace. The output is allocated in the ParserArena of the
+// calling thread, which is reused by the next parse once the output is destroyed. The parser
+// itself cannot be interrupted, so the optional `cancellation` is checked before and after
+// parsing.
+absl::Status ParseBigQueryStatement(absl::string_view query, std::unique_ptr<zetasql::ParserOutput>* output,
+                                    const CancellationToken* cancellation = nullptr);
+
+// Parse a script (a sequence of statements, including the statements of the scripting
+// language) like ParseBigQueryStatement. The AST is the script() of the output.
+absl::Status ParseBigQueryScript(absl::string_view script, std::unique_ptr<zetasql::ParserOutput>* output,
+                                 const CancellationToken* cancellation = nullptr);
+
+// Count the nodes of an AST.
+int64_t CountNodes(const zetasql::ASTNode* root);
 
 // Get the offset in a query based on the line and column number.
 int get_offset(absl::string_view query, int line_number, int column_number);
@@ -36,20 +56,26 @@ absl::string_view RemoveBacktick(absl::string_view column);
 // Find an AST Node in a parsed AST given the node predicator. The predicator should have an
 // signature like <code> bool(zetasql::ASTNode*) </code>. If no node meets the predicator,
 // null pointer will be returned. If multiple nodes meet the predicator, only one of them will
-// be returned.
+// be returned. If a `checker` is given, it is ticked for every visited node, and the search
+// stops and returns null once it fires.
 // Should use Concept in C++20, but the current version is c++1z.
 template<typename NodePredicator>
-const zetasql::ASTNode* FindNode(const zetasql::ASTNode* root, NodePredicator predicator) {
+const zetasql::ASTNode* FindNode(const zetasql::ASTNode* root, NodePredicator predicator,
+                                 CancellationChecker* checker = nullptr) {
   if (root == nullptr) {
     return nullptr;
   }
 
+  if (checker != nullptr && checker->Tick()) {
+    return nullptr;
+  }
+
   if (predicator(root)) {
     return root;
   }
 
   for (int i = 0; i < root->num_children(); i++) {
-    auto target = FindNode(root->child(i), predicator);
+    auto target = FindNode(root->child(i), predicator, checker);
     if (target != nullptr) {
       return target;
     }
@@ -60,11 +86,12 @@ const zetasql::ASTNode* FindNode(const zetasql::ASTNode* root, NodePredicator pr
 
 // Find all the nodes in a parsed AST given the node predicator. he predicator should have an
 // signature like <code> bool(zetasql::ASTNode*) </code>. If no node meets the predicator,
-// an empty vector will be returned.
+// an empty vector will be returned. If the `checker` fires, the nodes found so far are returned.
 template<typename NodePredicator>
-std::vector<const zetasql::ASTNode*> FindAllNodes(const zetasql::ASTNode* root, NodePredicator predicator) {
+std::vector<const zetasql::ASTNode*> FindAllNodes(const zetasql::ASTNode* root, NodePredicator predicator,
+                                                  CancellationChecker* checker = nullptr) {
   std::vector<const zetasql::ASTNode*> nodes;
-  FindAllNodes(root, predicator, nodes);
+  FindAllNodes(root, predicator, nodes, checker);
   return nodes;
 }
 
@@ -73,17 +100,22 @@ std::vector<const zetasql::ASTNode*> FindAllNodes(const zetasql::ASTNode* root,
 template<typename NodePredicator>
 void FindAllNodes(const zetasql::ASTNode* root,
                   NodePredicator predicator,
-                  std::vector<const zetasql::ASTNode*> &nodes) {
+                  std::vector<const zetasql::ASTNode*> &nodes,
+                  CancellationChecker* checker = nullptr) {
   if (root == nullptr) {
     return;
   }
 
+  if (checker != nullptr && checker->Tick()) {
+    return;
+  }
+
   if (predicator(root)) {
     nodes.push_back(root);
   }
 
   for (int i = 0; i < root->num_children(); i++) {
-    FindAllNodes(root->child(i), predicator, nodes);
+    FindAllNodes(root->child(i), predicator, nodes, checker);
   }
 }
 